@@ -344,11 +344,32 @@ class Blob {
   const Dtype* cpu_diff() const;
   const Dtype* gpu_diff() const;
 
+  /**
+   * @brief Starts staging the data to or from the device of backend in the
+   *        background; see SyncedMemory::prefetch_to.
+   */
+  void prefetch_to(SyncedMemory::StagingDirection dir,
+                   const LayoutCastParam& param, DeviceBackend* backend) {
+    CHECK(data_);
+    data_->prefetch_to(dir, param, backend);
+  }
+  /// @brief Blocks until the transfer started by prefetch_to is done.
+  void wait() {
+    CHECK(data_);
+    data_->wait();
+  }
+
 #ifdef USE_MLU
   const Dtype* mlu_data();
   void set_mlu_data(Dtype* data);
   Dtype* mutable_mlu_data();
   Dtype* sync_data();
+  /// @brief prefetch_to between cpu_data() and mlu_data().
+  void prefetch_to(SyncedMemory::StagingDirection dir) {
+    CHECK(data_);
+    tensor_desc_.Create();
+    data_->prefetch_to(dir, tensor_desc_);
+  }
 
   cnmlTensor_t mlu_tensor() {
     tensor_desc_.Create();
@@ -445,6 +466,18 @@ class Blob {
    * shared_ptr calls its destructor when reset with the "=" operator.
    */
   void ShareDiff(const Blob& other);
+  /**
+   * @brief Make this Blob's data a view of the CPU data of Blob other,
+   *        starting at element offset, without copying.
+   *
+   * Only the host memory is aliased; the diff is left alone. The view keeps
+   * the SyncedMemory of other alive, so it stays valid (if stale) when a
+   * Reshape of other allocates a new one. It does not survive
+   * other.set_cpu_data, which frees the buffer it points into: the owner of
+   * the view must call ShareDataAt again. A Reshape beyond the current count
+   * gives this Blob its own memory again.
+   */
+  void ShareDataAt(const Blob& other, const int offset);
   /**
    * @brief Judge whether the blob's shape is identical to another.
    */
@@ -464,6 +497,8 @@ class Blob {
   shared_ptr<SyncedMemory> data_;
   shared_ptr<SyncedMemory> diff_;
   shared_ptr<SyncedMemory> shape_data_;
+  /// The memory data_ points into when it is a view set by ShareDataAt.
+  shared_ptr<SyncedMemory> data_owner_;
   vector<int> shape_;
   int count_;     ///< the product of all a blob's dimensions.
   int capacity_;  ///< use to check whether to ask for more memory.
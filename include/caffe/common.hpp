@@ -134,6 +134,8 @@ using std::unordered_map;
 using std::unordered_set;
 using std::vector;
 
+class ThreadPool;
+
 // A global initialization function that you should call in your main function.
 // Currently it initializes google flags and google logging.
 void GlobalInit(int* pargc, char*** pargv);
@@ -256,6 +258,16 @@ class Caffe {
   inline static bool multiprocess() { return Get().multiprocess_; }
   inline static void set_multiprocess(bool val) { Get().multiprocess_ = val; }
   inline static bool root_solver() { return Get().solver_rank_ == 0; }
+
+  // The process-wide pool for parallelism inside CPU layers, shared by all
+  // threads (see caffe/util/thread_pool.hpp). It is created on first use
+  // with $CAFFE_NUM_THREADS threads, all hardware threads by default, pinned
+  // to the cpus listed in $CAFFE_CPU_AFFINITY (e.g. "0-7,16-23") if set.
+  static ThreadPool& thread_pool();
+  // Replaces the pool. Must not be called while a layer may be using it.
+  static void set_num_threads(int num_threads,
+                              const vector<int>& cpus = vector<int>());
+  static int num_threads();
 #ifdef USE_MLU
   inline static void set_mlu_device(int dev_id) { Get().setDevice(dev_id); }
 
@@ -102,6 +102,7 @@ class Layer {
              const vector<Blob<Dtype>*>& top) {
     CheckBlobCounts(bottom, top);
     LayerSetUp(bottom, top);
+    reshaped_shapes_.clear();
 #ifdef USE_MLU
     Reshape_tensor(bottom, top);
 #else
@@ -145,6 +146,41 @@ class Layer {
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
                        const vector<Blob<Dtype>*>& top) = 0;
 
+  /**
+   * @brief Calls Reshape unless the bottom and top shapes are still the ones
+   *        left by the previous call, in which case there is nothing to do.
+   *
+   * Top and internal buffer blobs keep their high-water capacity, so
+   * alternating between a few recurring input shapes only reruns the shape
+   * arithmetic of the layers whose bottoms actually changed.
+   */
+  void ReshapeIfNeeded(const vector<Blob<Dtype>*>& bottom,
+                       const vector<Blob<Dtype>*>& top);
+
+  /**
+   * @brief Returns true if Reshape reads the contents of the bottom blobs,
+   *        not only their shapes, so that it must run before every forward.
+   */
+  virtual inline bool ReshapeDependsOnData() const { return false; }
+
+  /**
+   * @brief Returns true if the layer maps its single bottom to its single
+   *        top element by element, so that ForwardElementwise_cpu can
+   *        compute any contiguous range of the output. Net runs chains of
+   *        such in-place layers in one sweep over the blob.
+   */
+  virtual inline bool IsElementwise() const { return false; }
+
+  /**
+   * @brief Computes elements [offset, offset + count) of the top blob from
+   *        the same elements of the bottom blob. bottom and top point at
+   *        element offset and may be equal.
+   */
+  virtual void ForwardElementwise_cpu(const int offset, const int count,
+      const Dtype* bottom, Dtype* top) {
+    NOT_IMPLEMENTED;
+  }
+
 #ifdef USE_MLU
   /**
    * @brief Adjust the shapes of top blobs and internal buffers to accommodate
@@ -468,6 +504,8 @@ class Layer {
   bool external_output_;
   /** Hardware computing time **/
   float event_time_;
+  /** Bottom then top shapes after the last ReshapeIfNeeded. */
+  vector<vector<int> > reshaped_shapes_;
 
 #ifdef USE_MLU
   virtual void MLUDestroyOp() {}
@@ -657,6 +695,31 @@ inline void Layer<Dtype>::Reshape_dispatch(const vector<Blob<Dtype>*>& bottom,
 }
 #endif
 
+template <typename Dtype>
+void Layer<Dtype>::ReshapeIfNeeded(const vector<Blob<Dtype>*>& bottom,
+                                   const vector<Blob<Dtype>*>& top) {
+  const size_t num_shapes = bottom.size() + top.size();
+  bool changed = ReshapeDependsOnData() ||
+                 reshaped_shapes_.size() != num_shapes;
+  for (int i = 0; !changed && i < bottom.size(); ++i) {
+    changed = bottom[i]->shape() != reshaped_shapes_[i];
+  }
+  for (int i = 0; !changed && i < top.size(); ++i) {
+    changed = top[i]->shape() != reshaped_shapes_[bottom.size() + i];
+  }
+  if (!changed) {
+    return;
+  }
+  Reshape(bottom, top);
+  reshaped_shapes_.resize(num_shapes);
+  for (int i = 0; i < bottom.size(); ++i) {
+    reshaped_shapes_[i] = bottom[i]->shape();
+  }
+  for (int i = 0; i < top.size(); ++i) {
+    reshaped_shapes_[bottom.size() + i] = top[i]->shape();
+  }
+}
+
 // Forward and backward wrappers. You should implement the cpu and
 // gpu specific implementations instead, and should not change these
 // functions.
@@ -666,7 +729,7 @@ inline Dtype Layer<Dtype>::Forward(const vector<Blob<Dtype>*>& bottom,
   Dtype loss = 0;
   switch (Caffe::mode()) {
   case Caffe::CPU:
-    Reshape(bottom, top);
+    ReshapeIfNeeded(bottom, top);
     Forward_cpu(bottom, top);
     for (int top_id = 0; top_id < top.size(); ++top_id) {
       if (!this->loss(top_id)) { continue; }
@@ -805,6 +868,29 @@ void Layer<Dtype>::ToProto(LayerParameter* param, bool write_diff) {
 #endif
 }
 
+/**
+ * @brief Runs ForwardElementwise_cpu of each of layers, in order, over count
+ *        elements. The first layer reads bottom, the others update top in
+ *        place. The elements are processed in chunks that stay in the L1
+ *        cache for the whole chain, spread over the thread pool.
+ */
+template <typename Dtype>
+void ForwardElementwiseChain(const vector<Layer<Dtype>*>& layers,
+                             const int count, const Dtype* bottom, Dtype* top);
+
+/**
+ * @brief Runs the layers pre in place on data, adds residual into top and
+ *        runs the layers post in place on top, over elements [offset,
+ *        offset + count), in the same chunks as ForwardElementwiseChain.
+ *        The pointers point at element offset; top may equal data or
+ *        residual.
+ */
+template <typename Dtype>
+void ForwardResidualChain(const vector<Layer<Dtype>*>& pre,
+                          const vector<Layer<Dtype>*>& post, const int offset,
+                          const int count, Dtype* data, const Dtype* residual,
+                          Dtype* top);
+
 }  // namespace caffe
 
 #endif  // INCLUDE_CAFFE_LAYER_HPP_
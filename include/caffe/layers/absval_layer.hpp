@@ -59,6 +59,9 @@ class AbsValLayer : public NeuronLayer<Dtype> {
                           const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "AbsVal"; }
+  virtual inline bool IsElementwise() const { return true; }
+  virtual void ForwardElementwise_cpu(const int offset, const int count,
+      const Dtype* bottom, Dtype* top);
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
 
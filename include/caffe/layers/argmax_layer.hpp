@@ -45,7 +45,9 @@ namespace caffe {
  * Intended for use after a classification layer to produce a prediction.
  * If parameter out_max_val is set to true, output is a vector of pairs
  * (max_ind, max_val) for each image. The axis parameter specifies an axis
- * along which to maximise.
+ * along which to maximise. With softmax set, max_val is the softmax
+ * probability, so a Softmax followed by ArgMax can be replaced by this
+ * layer on the logits without producing the full probability tensor.
  *
  * NOTE: does not implement Backwards operation.
  */
@@ -63,6 +65,9 @@ class ArgMaxLayer : public Layer<Dtype> {
    *   - axis (\b optional int).
    *     if set, maximise along the specified axis else maximise the flattened
    *     trailing dimensions for each index of the first / num dimension.
+   *   - softmax (\b optional bool, default false).
+   *     if set, output max_val as softmax probabilities over the maximised
+   *     dimensions.
    */
   explicit ArgMaxLayer(const LayerParameter& param)
       : Layer<Dtype>(param) {}
@@ -99,6 +104,7 @@ class ArgMaxLayer : public Layer<Dtype> {
   size_t top_k_;
   bool has_axis_;
   int axis_;
+  bool softmax_;
 };
 
 }  // namespace caffe
@@ -47,7 +47,8 @@ template <typename Dtype>
 class BaseConvolutionLayer : public Layer<Dtype> {
   public:
   explicit BaseConvolutionLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), channels_last_(false),
+        nhwc_weights_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                           const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -70,6 +71,15 @@ class BaseConvolutionLayer : public Layer<Dtype> {
                          Dtype* output);
   void weight_cpu_gemm(const Dtype* input, const Dtype* output, Dtype* weights);
   void backward_cpu_bias(Dtype* bias, const Dtype* input);
+  /**
+   * @brief Convolves the (N, H, W, C) bottom into the (N, H', W', C') top
+   *        and adds the bias, for layers with channels_last set. Depthwise
+   *        filters are applied directly, vectorised across channels; other
+   *        filters by one GEMM per image and group over rows of
+   *        (kernel_h, kernel_w, C) windows, or over the whole batch for 1x1
+   *        filters.
+   */
+  void forward_cpu_channels_last(const Blob<Dtype>& bottom, Blob<Dtype>* top);
 
 #ifdef USE_CUDA
   void forward_gpu_gemm(const Dtype* col_input, const Dtype* weights,
@@ -124,8 +134,20 @@ class BaseConvolutionLayer : public Layer<Dtype> {
   bool conv_first_;
   bool yuv_input_;
   bool use_pad_same_;
+  /// @brief Whether the bottom and top are (N, H, W, C) rather than NCHW.
+  bool channels_last_;
 
   private:
+  /**
+   * @brief Returns bottom, or with channels_last an NCHW-shaped stand-in for
+   *        it, which is what the shape computations of LayerSetUp and
+   *        Reshape read.
+   */
+  const vector<Blob<Dtype>*>& ChannelsFirstBottom(
+      const vector<Blob<Dtype>*>& bottom);
+  /// @brief Returns the weights reordered for forward_cpu_channels_last.
+  const Dtype* ChannelsLastWeights(const bool depthwise);
+
   // wrap im2col/col2im so we don't have to remember the (long) argument lists
   inline void conv_im2col_cpu(const Dtype* data, Dtype* col_buff) {
     if (!force_nd_im2col_ && num_spatial_axes_ == 2) {
@@ -198,6 +220,19 @@ class BaseConvolutionLayer : public Layer<Dtype> {
 
   Blob<Dtype> bias_multiplier_;
 
+  /// @brief The NCHW-shaped stand-in for a channels-last bottom.
+  Blob<Dtype> nchw_bottom_;
+  vector<Blob<Dtype>*> nchw_bottom_vec_;
+  /// @brief The weights as (C', kernel_h, kernel_w, C / group), or as
+  ///        (kernel_h, kernel_w, C) for depthwise filters, shared with the
+  ///        layers reading the same weights, and the weight memory and
+  ///        version they were reordered from.
+  shared_ptr<SyncedMemory> nhwc_weights_;
+  shared_ptr<SyncedMemory> nhwc_weights_source_;
+  size_t nhwc_weights_version_;
+  /// @brief The output of one group, scattered into the channels-last top.
+  Blob<Dtype> group_output_;
+
   protected:  // accessed by subclass
   int conv_out_channels_;
   int conv_in_channels_;
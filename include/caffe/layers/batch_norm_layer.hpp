@@ -78,6 +78,12 @@ class BatchNormLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "BatchNorm"; }
   virtual inline int ExactNumBottomBlobs() const { return 1; }
   virtual inline int ExactNumTopBlobs() const { return 1; }
+  /// With the stored statistics at test time, each channel is an affine map.
+  virtual inline bool IsElementwise() const {
+    return use_global_stats_ && this->phase_ == TEST;
+  }
+  virtual void ForwardElementwise_cpu(const int offset, const int count,
+      const Dtype* bottom, Dtype* top);
 
   protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
@@ -94,6 +100,10 @@ class BatchNormLayer : public Layer<Dtype> {
   bool use_alpha_beta_;
   Dtype moving_average_fraction_;
   int channels_;
+  /// @brief The axis of the channels: 1, or 3 with channels_last. The axes
+  ///        before it are averaged over as the batch.
+  int channel_axis_;
+  int spatial_dim_;
   Dtype eps_;
 
   // extra temporarary variables is used to carry out sums/broadcasting
@@ -64,6 +64,9 @@ class BNLLLayer : public NeuronLayer<Dtype> {
       : NeuronLayer<Dtype>(param) {}
 
   virtual inline const char* type() const { return "BNLL"; }
+  virtual inline bool IsElementwise() const { return true; }
+  virtual void ForwardElementwise_cpu(const int offset, const int count,
+      const Dtype* bottom, Dtype* top);
 
   protected:
   /// @copydoc BNLLLayer
@@ -95,6 +95,20 @@ class ConvolutionLayer : public BaseConvolutionLayer<Dtype> {
 
   virtual inline const char* type() const { return "Convolution"; }
 
+  /**
+   * @brief Runs the CPU forward pass with a residual block's output stage
+   *        fused in. As each image is convolved, while its result is still
+   *        in cache, the elementwise layers pre run in place on it, residual
+   *        is added into output, and the elementwise layers post run in place
+   *        on output. output may share memory with top[0] or residual. Net
+   *        uses this to fold BatchNorm, Scale, Eltwise SUM and ReLU layers
+   *        into the convolution.
+   */
+  void ForwardResidual_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top, const vector<Layer<Dtype>*>& pre,
+      const Blob<Dtype>& residual, const vector<Layer<Dtype>*>& post,
+      Blob<Dtype>* output);
+
   protected:
   virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
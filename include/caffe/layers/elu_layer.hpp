@@ -62,6 +62,9 @@ class ELULayer : public NeuronLayer<Dtype> {
       : NeuronLayer<Dtype>(param) {}
 
   virtual inline const char* type() const { return "ELU"; }
+  virtual inline bool IsElementwise() const { return true; }
+  virtual void ForwardElementwise_cpu(const int offset, const int count,
+      const Dtype* bottom, Dtype* top);
 
   protected:
   /**
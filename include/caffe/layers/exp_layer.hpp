@@ -61,6 +61,9 @@ class ExpLayer : public NeuronLayer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Exp"; }
+  virtual inline bool IsElementwise() const { return true; }
+  virtual void ForwardElementwise_cpu(const int offset, const int count,
+      const Dtype* bottom, Dtype* top);
 
   protected:
   /**
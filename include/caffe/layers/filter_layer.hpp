@@ -57,6 +57,7 @@ class FilterLayer : public Layer<Dtype> {
   virtual inline const char* type() const { return "Filter"; }
   virtual inline int MinBottomBlobs() const { return 2; }
   virtual inline int MinTopBlobs() const { return 1; }
+  virtual inline bool ReshapeDependsOnData() const { return true; }
 
   protected:
   /**
@@ -0,0 +1,154 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef INCLUDE_CAFFE_LAYERS_FUSED_RECURRENT_LAYER_HPP_
+#define INCLUDE_CAFFE_LAYERS_FUSED_RECURRENT_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief An abstract class for recurrent layers that run their cell directly
+ *        rather than through an unrolled Net, such as LSTMLayer and GRULayer.
+ *
+ * The input-to-hidden projection of all timesteps is computed up front as
+ * one GEMM into a gate buffer. Subclasses then walk the timesteps, adding
+ * the hidden-to-hidden projection and applying a fused gate kernel. The
+ * hidden state is kept in persistent buffers, carried over to the next
+ * batch as in RecurrentLayer. Only what backpropagation needs is kept per
+ * timestep, and only in the TRAIN phase.
+ *
+ * The parameters are, in order:
+ *   -# @f$ W_x @f$, @f$ (G H \times I) @f$, the input weights,
+ *   -# @f$ b @f$, @f$ (G H) @f$, the bias, and
+ *   -# @f$ W_h @f$, @f$ (G H \times H) @f$, the hidden weights,
+ * where @f$ G @f$ is the number of gates, @f$ H @f$ is
+ * <code>recurrent_param.num_output()</code> and @f$ I @f$ is the size of one
+ * input.
+ */
+template <typename Dtype>
+class FusedRecurrentLayer : public Layer<Dtype> {
+  public:
+  explicit FusedRecurrentLayer(const LayerParameter& param)
+      : Layer<Dtype>(param) {}
+  virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  /// @brief Zeroes the hidden state carried over from the previous batch.
+  virtual void Reset();
+
+  virtual inline int MinBottomBlobs() const {
+    return 2 + (this->layer_param_.recurrent_param().expose_hidden() ?
+                NumStates() : 0);
+  }
+  virtual inline int MaxBottomBlobs() const { return MinBottomBlobs(); }
+  virtual inline int ExactNumTopBlobs() const {
+    return 1 + (this->layer_param_.recurrent_param().expose_hidden() ?
+                NumStates() : 0);
+  }
+  virtual inline bool AllowForceBackward(const int bottom_index) const {
+    // Can't propagate to sequence continuation indicators.
+    return bottom_index != 1;
+  }
+
+  protected:
+  /// @brief The number of gates, each of H elements, per timestep.
+  virtual int NumGates() const = 0;
+  /// @brief The number of state blobs: the hidden state and any others.
+  virtual int NumStates() const = 0;
+
+  /**
+   * @brief Runs the timesteps. On entry gates_ holds the input projection
+   *        with the bias added and state_ the initial state; on exit top[0]
+   *        holds the hidden state of every timestep and state_ the final
+   *        state.
+   */
+  virtual void ForwardSteps(const Dtype* cont, Dtype* top_data) = 0;
+  /**
+   * @brief Backpropagates through the timesteps: fills the diff of gates_
+   *        with the gradient of the input projection and accumulates the
+   *        gradient of W_h. The diff of state_ holds the gradient of the
+   *        final state on entry and that of the initial state on exit.
+   */
+  virtual void BackwardSteps(const Dtype* cont, const Dtype* top_data,
+                             const Dtype* top_diff) = 0;
+
+  /**
+   * @param bottom input Blob vector (length 2, or 2 + NumStates() with
+   *        expose_hidden)
+   *   -# @f$ (T \times N \times ...) @f$ the time-varying input @f$ x @f$
+   *   -# @f$ (T \times N) @f$ the sequence continuation indicators, as for
+   *      RecurrentLayer
+   *   -# @f$ (1 \times N \times H) @f$ the initial state blobs, with
+   *      expose_hidden
+   * @param top output Blob vector (length 1, or 1 + NumStates() with
+   *        expose_hidden)
+   *   -# @f$ (T \times N \times H) @f$ the hidden state @f$ h_t @f$
+   *   -# @f$ (1 \times N \times H) @f$ the final state blobs, with
+   *      expose_hidden
+   */
+  virtual void Forward_cpu(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+  virtual void Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
+
+  /**
+   * @brief Returns h_prev (N x H) with the row of each stream multiplied by
+   *        its continuation indicator, in h_conted_ unless all are 1.
+   */
+  const Dtype* ContinuedHidden(const Dtype* cont, const Dtype* h_prev);
+  /// @brief Multiplies the row of each stream in data (N x H) by its cont.
+  void ContinueRows(const Dtype* cont, Dtype* data) const;
+
+  /// @brief Timesteps, independent streams, hidden and input sizes.
+  int T_, N_, H_, I_;
+  /// @brief Whether the initial and final states are bottoms and tops.
+  bool expose_hidden_;
+  /// @brief The gates of every timestep, (T x N x G H).
+  Blob<Dtype> gates_;
+  /// @brief The current state, (N x H) each; state_[0] is the hidden state.
+  vector<shared_ptr<Blob<Dtype> > > state_;
+  /// @brief The initial state of the batch, kept for Backward.
+  vector<shared_ptr<Blob<Dtype> > > state0_;
+  /// @brief The previous hidden state with finished sequences zeroed.
+  Blob<Dtype> h_conted_;
+  /// @brief Ones for summing the bias gradient over timesteps and streams.
+  Blob<Dtype> bias_multiplier_;
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_LAYERS_FUSED_RECURRENT_LAYER_HPP_
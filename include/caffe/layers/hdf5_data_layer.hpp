@@ -36,23 +36,43 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 
 #include "caffe/blob.hpp"
+#include "caffe/internal_thread.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 
 #include "caffe/layers/base_data_layer.hpp"
 
 namespace caffe {
 
+/**
+ * @brief Consecutive rows of every top dataset of one HDF5 file, as read by
+ *        the HDF5DataLayer prefetch thread.
+ */
+template <typename Dtype>
+class HDF5Chunk {
+  public:
+  std::vector<shared_ptr<Blob<Dtype> > > blobs_;
+  /** Order in which the rows are output. */
+  std::vector<unsigned int> permutation_;
+};
+
 /**
  * @brief Provides data to the Net from HDF5 files.
  *
+ * A background thread streams the files listed in the source in chunks of
+ * chunk_size rows (whole files when chunk_size is 0), keeping up to
+ * prefetch chunks in memory, so Forward never waits on file I/O unless the
+ * reader falls behind. With shuffle, files, the chunks of a file and the
+ * rows of a chunk are all visited in random order.
+ *
  * TODO(dox): thorough documentation for Forward and proto params.
  */
 template <typename Dtype>
-class HDF5DataLayer : public Layer<Dtype> {
+class HDF5DataLayer : public Layer<Dtype>, public InternalThread {
   public:
   explicit HDF5DataLayer(const LayerParameter& param)
-      : Layer<Dtype>(param), offset_() {}
+      : Layer<Dtype>(param), current_chunk_(NULL), offset_() {}
   virtual ~HDF5DataLayer();
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                           const vector<Blob<Dtype>*>& top);
@@ -78,15 +98,18 @@ class HDF5DataLayer : public Layer<Dtype> {
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
                             const vector<bool>& propagate_down,
                             const vector<Blob<Dtype>*>& bottom) {}
+  virtual void InternalThreadEntry();
+  /** Streams one file through the free chunks into chunk_full_. */
   virtual void LoadHDF5FileData(const char* filename);
 
   std::vector<std::string> hdf_filenames_;
   unsigned int num_files_;
-  unsigned int current_file_;
-  hsize_t current_row_;
-  std::vector<shared_ptr<Blob<Dtype> > > hdf_blobs_;
-  std::vector<unsigned int> data_permutation_;
   std::vector<unsigned int> file_permutation_;
+  std::vector<shared_ptr<HDF5Chunk<Dtype> > > chunks_;
+  BlockingQueue<HDF5Chunk<Dtype>*> chunk_free_;
+  BlockingQueue<HDF5Chunk<Dtype>*> chunk_full_;
+  HDF5Chunk<Dtype>* current_chunk_;
+  hsize_t current_row_;
   uint64_t offset_;
 };
 
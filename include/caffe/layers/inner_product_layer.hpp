@@ -56,13 +56,26 @@ namespace caffe {
  * If transpose == true, any operations will be performed on the transpose
  * of the weight matrix. The weight matrix itself is not going to be transposed
  * but rather the transfer flag of operations will be toggled accordingly.
+ *
+ * pack_weights (off by default, as it keeps a second copy of the weights):
+ * In the TEST phase, batches of up to kPackedGemmMaxRows rows are computed
+ * on the CPU against a copy of the weights packed into panels (see
+ * caffe_cpu_pack_weights), made on the first such Forward and again
+ * whenever the weights are written. Layers reading the same weights, e.g.
+ * the contexts of a NetModel, share one packed copy. With the layer's
+ * cpu_weight_dtype set to DT_FLOAT16 or DT_BFLOAT16, whether or not
+ * pack_weights is set, the packed copy is stored in that type, which
+ * halves the memory each Forward reads, and every TEST batch is computed
+ * against it, kPackedGemmMaxRows rows at a time. The FP32 weights are kept
+ * as well, for the net to save and share them, so the layer then holds
+ * 1.5 times the memory of its FP32 weights.
  */
 
 template <typename Dtype>
 class InnerProductLayer : public Layer<Dtype> {
   public:
   explicit InnerProductLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), packed_version_(0) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -88,6 +101,14 @@ class InnerProductLayer : public Layer<Dtype> {
   bool bias_term_;
   Blob<Dtype> bias_multiplier_;
   bool transpose_;  ///< if true, assume transposed weights
+
+  /// @brief Whether Forward_cpu uses packed_weights_ for this batch.
+  bool UsePackedWeights() const;
+  /// @brief The weights packed for small batches, and the weight memory and
+  ///        version they were packed from.
+  shared_ptr<SyncedMemory> packed_weights_;
+  shared_ptr<SyncedMemory> packed_source_;
+  size_t packed_version_;
 };
 
 }  // namespace caffe
@@ -62,6 +62,9 @@ class LogLayer : public NeuronLayer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Log"; }
+  virtual inline bool IsElementwise() const { return true; }
+  virtual void ForwardElementwise_cpu(const int offset, const int count,
+      const Dtype* bottom, Dtype* top);
 
   protected:
   /**
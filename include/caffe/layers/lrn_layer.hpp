@@ -52,7 +52,7 @@ template <typename Dtype>
 class LRNLayer : public Layer<Dtype> {
   public:
   explicit LRNLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), scale_valid_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                           const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -89,6 +89,8 @@ class LRNLayer : public Layer<Dtype> {
   virtual void WithinChannelBackward(const vector<Blob<Dtype>*>& top,
                                      const vector<bool>& propagate_down,
                                      const vector<Blob<Dtype>*>& bottom);
+  void CrossChannelTile(const Dtype* bottom, const int len, Dtype* scale,
+                        Dtype* top, Dtype* buffer) const;
 
   int size_;
   int pre_pad_;
@@ -103,6 +105,8 @@ class LRNLayer : public Layer<Dtype> {
   // Fields used for normalization ACROSS_CHANNELS
   // scale_ stores the intermediate summing results
   Blob<Dtype> scale_;
+  // False when CrossChannelForward_cpu did not store scale_ (TEST phase).
+  bool scale_valid_;
 
   // Fields used for normalization WITHIN_CHANNEL
   shared_ptr<SplitLayer<Dtype> > split_layer_;
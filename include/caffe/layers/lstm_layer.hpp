@@ -0,0 +1,86 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef INCLUDE_CAFFE_LAYERS_LSTM_LAYER_HPP_
+#define INCLUDE_CAFFE_LAYERS_LSTM_LAYER_HPP_
+
+#include <vector>
+
+#include "caffe/blob.hpp"
+#include "caffe/layer.hpp"
+#include "caffe/layers/fused_recurrent_layer.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Processes sequential inputs using a "Long Short-Term Memory" (LSTM)
+ *        [1] style recurrent neural network (RNN), without unrolling a Net.
+ *
+ * Per timestep @f$ t @f$ and with @f$ h'_{t-1} = \delta_t h_{t-1} @f$,
+ * @f$ \delta_t @f$ being the sequence continuation indicator:
+ * @f[
+ *   [i_t', f_t', o_t', g_t'] = W_x x_t + b + W_h h'_{t-1} \\
+ *   i_t = \sigma(i_t'), f_t = \sigma(f_t'), o_t = \sigma(o_t'),
+ *   g_t = \tanh(g_t') \\
+ *   c_t = \delta_t f_t \odot c_{t-1} + i_t \odot g_t \\
+ *   h_t = o_t \odot \tanh(c_t)
+ * @f]
+ * The gates are laid out in the order i, f, o, g, as in the parameters of
+ * the unrolled BVLC LSTM (W_xc, b_c and W_hc). The states are @f$ h @f$ and
+ * @f$ c @f$, in that order.
+ *
+ * [1] Hochreiter, Sepp, and Schmidhuber, Jürgen. "Long short-term memory."
+ *     Neural Computation 9, no. 8 (1997): 1735-1780.
+ */
+template <typename Dtype>
+class LSTMLayer : public FusedRecurrentLayer<Dtype> {
+  public:
+  explicit LSTMLayer(const LayerParameter& param)
+      : FusedRecurrentLayer<Dtype>(param) {}
+  virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top);
+
+  virtual inline const char* type() const { return "LSTM"; }
+
+  protected:
+  virtual int NumGates() const { return 4; }
+  virtual int NumStates() const { return 2; }
+  virtual void ForwardSteps(const Dtype* cont, Dtype* top_data);
+  virtual void BackwardSteps(const Dtype* cont, const Dtype* top_data,
+                             const Dtype* top_diff);
+
+  /// @brief The cell state of every timestep, (T x N x H), TRAIN only.
+  Blob<Dtype> cells_;
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_LAYERS_LSTM_LAYER_HPP_
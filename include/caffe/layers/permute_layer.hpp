@@ -76,6 +76,9 @@ class PermuteLayer : public Layer<Dtype> {
 
   int num_axes_;
   bool need_permute_;
+  /// @brief Whether the order moves the channels of a 4-D blob last, or
+  ///        moves them back from last.
+  bool to_nhwc_, to_nchw_;
 
   // Use Blob because it is convenient to be accessible in .cu file.
   Blob<int> permute_order_;
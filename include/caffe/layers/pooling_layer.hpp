@@ -46,7 +46,7 @@ template <typename Dtype>
 class PoolingLayer : public Layer<Dtype> {
   public:
   explicit PoolingLayer(const LayerParameter& param)
-      : Layer<Dtype>(param) {}
+      : Layer<Dtype>(param), max_idx_valid_(false) {}
   virtual void LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top);
   virtual void Reshape(const vector<Blob<Dtype>*>& bottom,
@@ -80,8 +80,12 @@ class PoolingLayer : public Layer<Dtype> {
   int pooled_height_, pooled_width_;
   bool global_pooling_;
   bool ceil_mode_;
+  /// @brief Whether the bottom and top are (N, H, W, C) rather than NCHW.
+  bool channels_last_;
   Blob<Dtype> rand_idx_;
   Blob<int> max_idx_;
+  // False when Forward_cpu skipped max_idx_ in the TEST phase.
+  bool max_idx_valid_;
 };
 
 }  // namespace caffe
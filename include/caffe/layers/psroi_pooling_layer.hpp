@@ -36,6 +36,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/roi_util.hpp"
 
 namespace caffe {
 
@@ -95,6 +96,8 @@ class PSROIPoolingLayer : public Layer<Dtype> {
   int rois_num_;
   int roi_cols_;
   bool int8_context;
+  /// @brief The input window of each bin of each ROI.
+  vector<ROIBin> bins_;
 };
 
 }  // namespace caffe
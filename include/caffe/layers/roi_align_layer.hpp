@@ -36,20 +36,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/roi_util.hpp"
 
 
 namespace caffe {
-struct PreCalc {
-  int pos1;
-  int pos2;
-  int pos3;
-  int pos4;
-  float w1;
-  float w2;
-  float w3;
-  float w4;
-};
-
 /**
  * @brief Pooling ROIs but resolved the mis-alignment problem of ROIPoolingLayer
  *        by using bilinear interpolate.
@@ -80,20 +70,6 @@ class ROIAlignLayer : public Layer<Dtype> {
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
   virtual void Backward_gpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom);
-  void pre_calc_for_bilinear_interpolate(
-      const int height,
-      const int width,
-      const int pooled_height,
-      const int pooled_width,
-      const int iy_upper,
-      const int ix_upper,
-      Dtype roi_start_h,
-      Dtype roi_start_w,
-      Dtype bin_size_h,
-      Dtype bin_size_w,
-      int roi_bin_grid_h,
-      int roi_bin_grid_w,
-      std::vector<PreCalc> *pre_calc);
   int channels_;
   int height_;
   int width_;
@@ -104,6 +80,8 @@ class ROIAlignLayer : public Layer<Dtype> {
   int rois_num_;
   int roi_cols_;
   bool fix8_context;
+  /// @brief The bilinear samples of each ROI, shared by all its channels.
+  vector<vector<ROISample<Dtype> > > samples_;
 };
 }  // namespace caffe
 
@@ -62,6 +62,13 @@ class ScaleLayer: public Layer<Dtype> {
       const vector<Blob<Dtype>*>& top);
 
   virtual inline const char* type() const { return "Scale"; }
+  // With the scale (and bias) as parameters, the layer is elementwise. In
+  // training, in-place Forward_cpu must also save the input for Backward.
+  virtual inline bool IsElementwise() const {
+    return this->layer_param_.bottom_size() == 1 && this->phase_ == TEST;
+  }
+  virtual void ForwardElementwise_cpu(const int offset, const int count,
+      const Dtype* bottom, Dtype* top);
   // Scale
   virtual inline int MinBottomBlobs() const { return 1; }
   virtual inline int MaxBottomBlobs() const { return 2; }
@@ -41,6 +41,9 @@ vector<int> to_cpu_shape(const vector<int>& mlu_shape);
 
 vector<int> to_mlu_shape(const vector<int>& cpu_shape);
 
+// Reorders src between NC(D)HW and N(D)HWC and casts it in one pass into
+// dst, padding the channels by one for the first convolution. tmp_ptr is
+// no longer used; the conversion needs no temporary buffer.
 void transAndCast(void* src_ptr, cnrtDataType_t src_dtype,
     void* dst_ptr, cnrtDataType_t dst_dtype, void* tmp_ptr,
     const vector<int>& src_dim_values, bool is_first_conv,
@@ -41,6 +41,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/compile.hpp"
 #include "caffe/layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/mapped_weights.hpp"
 
 #ifdef USE_MLU
 #include "caffe/mlu/reshape_helper.hpp"
@@ -62,6 +63,15 @@ class Net {
   explicit Net(const string& param_file, Phase phase, const int level = 0,
                const vector<string>* stages = NULL);
   explicit Net(void* buffer, int buffer_size, Phase phase);
+  /**
+   * @brief Builds a net whose layers reuse the parameter Blob%s of
+   *        weights_owner instead of allocating and filling their own.
+   *
+   * param must describe the same layers as weights_owner (usually the very
+   * NetParameter it was built from). Only activations and layer scratch
+   * buffers are owned by the new net, see NetModel.
+   */
+  Net(const NetParameter& param, const Net* weights_owner);
   virtual ~Net() {}
 
   /// @brief Initialize a network with a NetParameter.
@@ -202,6 +212,12 @@ class Net {
   void CopyTrainedLayersFromBinaryProto(const string trained_filename);
   void CopyTrainedLayersFromBinaryProto(void* buffer, int buffer_size);
   void CopyTrainedLayersFromHDF5(const string trained_filename);
+  /**
+   * @brief Points the parameter blobs at the tensors of a memory-mapped
+   *        weights file instead of copying them (see MappedWeights). Blobs
+   *        whose data type or size differ from the file are copied.
+   */
+  void CopyTrainedLayersFromMapped(const string trained_filename);
   /// @brief Writes the net to a proto.
   void ToProto(NetParameter* param, bool write_diff = false) const;
   /// @brief Writes the net to an HDF5 file.
@@ -381,6 +397,46 @@ class Net {
   void AppendParam(const NetParameter& param, const int layer_id,
                    const int param_id);
 
+  /// @brief Hand the parameter blobs of weights_owner_ to a new layer.
+  void ShareLayerBlobs(const int layer_id);
+
+  /// @brief Finds the chains of elementwise layers run in one sweep.
+  void InitElementwiseChains();
+  /**
+   * @brief Returns the index past the elementwise chain starting at
+   *        layer_id if it can be fused in a forward pass ending at end, or
+   *        layer_id + 1 otherwise.
+   */
+  int ElementwiseChainEnd(const int layer_id, const int end) const;
+  /// @brief Runs the chain of elementwise layers [start, end) in one sweep.
+  void ForwardElementwiseLayers(const int start, const int end);
+  /**
+   * @brief Finds the residual blocks, a Convolution followed by in-place
+   *        elementwise layers, an Eltwise SUM and in-place elementwise
+   *        layers, whose output stage is folded into the convolution.
+   */
+  void InitResidualBlocks();
+  /**
+   * @brief Returns the index past the residual block starting at layer_id
+   *        if it can be fused in a forward pass ending at end, or
+   *        layer_id + 1 otherwise.
+   */
+  int ResidualBlockEnd(const int layer_id, const int end) const;
+  /// @brief Runs the residual block [start, end) as one convolution.
+  void ForwardResidualBlock(const int start, const int end);
+  /**
+   * @brief In CPU mode, makes the inputs of Concat and the outputs of Slice
+   *        views into the joined blob where their slices are contiguous,
+   *        so those layers copy nothing. Returns the number of views.
+   */
+  int InitDataViews();
+  /**
+   * @brief Points the views of Concat or Slice layer_id at the joined
+   *        blob's current memory, which a data layer may have replaced
+   *        with set_cpu_data since InitDataViews.
+   */
+  void RefreshDataViews(const int layer_id);
+
   /// @brief Helper for displaying debug info in Forward.
   void ForwardDebugInfo(const int layer_id);
 
@@ -419,6 +475,9 @@ class Net {
   string name_;
   /// @brief The phase: TRAIN or TEST
   Phase phase_;
+  /// The mapped weights files the parameter blobs may point into. Declared
+  /// before the layers so that the mappings outlive their blobs.
+  vector<shared_ptr<MappedWeights>> mapped_weights_;
   /// @brief Individual layers in the net
   vector<shared_ptr<Layer<Dtype>>> layers_;
   vector<string> layer_names_;
@@ -472,6 +531,18 @@ class Net {
   size_t memory_used_;
   /// Whether to compute and display debug info for the net.
   bool debug_info_;
+  /// For each layer, the index past the chain of elementwise layers it
+  /// starts, or 0. A chain is an elementwise layer followed by at least one
+  /// elementwise layer working in place on its top blob.
+  vector<int> elementwise_chain_end_;
+  /// For each layer, the index past the residual block it starts, or 0.
+  vector<int> residual_block_end_;
+  /// For each layer starting a residual block, the index of its Eltwise.
+  vector<int> residual_sum_id_;
+  /// For each blob, whether InitDataViews made it a view into a joined blob.
+  vector<bool> data_view_;
+  /// For each layer, whether it is a Concat or Slice with views.
+  vector<bool> joins_data_views_;
   // Callbacks
   vector<Callback*> before_forward_;
   vector<Callback*> after_forward_;
@@ -481,6 +552,8 @@ class Net {
   set<int> dump_top_idx_;
 
   NetParameter net_param_without_weights_;
+  /// The net whose parameter blobs this net reuses, if any.
+  const Net* weights_owner_ = NULL;
 #ifdef USE_MLU
   shared_ptr<NetData<Dtype>> net_data_;
   shared_ptr<ReshapeHelper<Dtype>> reshape_helper_;
@@ -0,0 +1,79 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_NET_MODEL_HPP_
+#define INCLUDE_CAFFE_NET_MODEL_HPP_
+
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A network definition plus its trained weights, shared read-only by
+ *        any number of execution contexts.
+ *
+ * A context is a Net built with Net(param, weights_owner): it owns its
+ * activations and the layers' scratch buffers (col_buffer_ and the like)
+ * but reuses the parameter Blob%s of the model, so N inference threads keep
+ * a single copy of the weights. Contexts are for Forward only; Backward or
+ * Update on a context would write to the shared weights.
+ *
+ * The model is immutable once constructed, and CreateContext may be called
+ * from any thread. Weights are shared on the host, so contexts run in
+ * Caffe::CPU mode.
+ */
+template <typename Dtype>
+class NetModel {
+  public:
+  NetModel(const string& param_file, const string& trained_file);
+  NetModel(const NetParameter& param, const string& trained_file);
+
+  /// @brief Creates a TEST phase net sharing the weights of this model.
+  shared_ptr<Net<Dtype> > CreateContext() const;
+
+  inline const NetParameter& param() const { return param_; }
+  /// @brief The net owning the weights; it is never run itself.
+  inline const Net<Dtype>& net() const { return *net_; }
+
+  protected:
+  void Init(const string& trained_file);
+
+  NetParameter param_;
+  shared_ptr<Net<Dtype> > net_;
+
+  DISABLE_COPY_AND_ASSIGN(NetModel);
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_NET_MODEL_HPP_
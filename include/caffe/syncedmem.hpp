@@ -39,6 +39,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/common.hpp"
 #include "caffe/mlu/tensor.hpp"
+#include "caffe/util/device_staging.hpp"
+#include "caffe/util/host_allocator.hpp"
+#include "caffe/util/layout_cast.hpp"
 
 namespace caffe {
 
@@ -47,7 +50,10 @@ namespace caffe {
 // The improvement in performance seems negligible in the single GPU case,
 // but might be more significant for parallel training. Most importantly,
 // it improved stability for large models on many GPUs.
-inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
+// Otherwise memory comes from the caching HostAllocator; site names the
+// caller in its statistics.
+inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda,
+                            const char* site = "CaffeMallocHost") {
 #ifdef USE_CUDA
   if (Caffe::mode() == Caffe::GPU) {
     CUDA_CHECK(cudaMallocHost(ptr, size));
@@ -55,13 +61,8 @@ inline void CaffeMallocHost(void** ptr, size_t size, bool* use_cuda) {
     return;
   }
 #endif
-#ifdef USE_MKL
-  *ptr = mkl_malloc(size ? size:1, 64);
-#else
-  *ptr = malloc(size);
-#endif
+  *ptr = HostAllocator::Get().Allocate(size, site);
   *use_cuda = false;
-  CHECK(*ptr) << "host allocation of size " << size << " failed";
 }
 
 inline void CaffeFreeHost(void* ptr, bool use_cuda) {
@@ -71,11 +72,7 @@ inline void CaffeFreeHost(void* ptr, bool use_cuda) {
     return;
   }
 #endif
-#ifdef USE_MKL
-  mkl_free(ptr);
-#else
-  free(ptr);
-#endif
+  HostAllocator::Get().Free(ptr);
 }
 
 
@@ -94,6 +91,12 @@ inline void CaffeFreeHost(void* ptr, bool use_cuda) {
  *
  * To get a thorough understanding, see the FSM figure on cambricon wiki or
  * on the internet.
+ *
+ * prefetch_to() moves data across the host/device boundary asynchronously
+ * instead: the conversion and copy run on the I/O thread of a
+ * DeviceBackend, into the back one of two device buffers, while the device
+ * keeps computing on the front one. wait() completes the transfer. Calls
+ * that would race with a pending transfer wait for it first.
  */
 
 class SyncedMemory {
@@ -119,11 +122,47 @@ class SyncedMemory {
   enum SyncedHead { UNINITIALIZED, HEAD_AT_CPU, HEAD_AT_GPU, HEAD_AT_MLU, SYNCED };
   SyncedHead head() { return head_; }
   size_t size() { return size_; }
+  /// @brief Bumped by every call that hands out writable data or replaces
+  ///        it, so that caches derived from the data can tell it changed.
+  size_t version() const { return version_; }
 
 #ifdef USE_CUDA
   void async_gpu_push(const cudaStream_t& stream);
 #endif
 
+  enum StagingDirection { STAGE_TO_DEVICE, STAGE_TO_HOST };
+  /**
+   * @brief Starts converting and copying the data to or from the device of
+   *        backend on its I/O thread; returns without waiting.
+   *
+   * STAGE_TO_DEVICE converts the host data with param into the back device
+   * buffer, which becomes the front one at wait(); device_data() keeps
+   * returning the previous batch until then. STAGE_TO_HOST copies the front
+   * device buffer back and converts it with param into the host data, and
+   * makes the other buffer the front one, so the next batch can be written
+   * to mutable_device_data() while this one is in flight. The host data is
+   * HEAD_AT_CPU after wait(). A transfer still pending is waited for first.
+   */
+  void prefetch_to(StagingDirection dir, const LayoutCastParam& param,
+                   DeviceBackend* backend);
+  /// @brief Blocks until the transfer started by prefetch_to, if any, is done.
+  void wait();
+  /// @brief The front device buffer of prefetch_to.
+  const void* device_data();
+  /// @brief The front device buffer of prefetch_to, grown to size bytes.
+  void* mutable_device_data(DeviceBackend* backend, size_t size);
+#ifdef USE_MLU
+  /**
+   * @brief prefetch_to between the host data and mlu_data(), with the
+   *        conversion of mlu_tensor_desc, on the MLU of MLUStagingBackend().
+   *
+   * STAGE_TO_DEVICE leaves the head SYNCED, so mlu_data() keeps returning
+   * the previous batch until wait() publishes the staged one. STAGE_TO_HOST
+   * copies from mlu_data() itself; mutable_mlu_data() waits for it.
+   */
+  void prefetch_to(StagingDirection dir, const MLUTensorDesc& mlu_tensor_desc);
+#endif
+
   private:
   void check_device();
 
@@ -133,6 +172,7 @@ class SyncedMemory {
   void* gpu_ptr_;
   size_t size_;
   SyncedHead head_;
+  size_t version_;
 
 #ifdef USE_MLU
   void* mlu_ptr_;
@@ -142,6 +182,11 @@ class SyncedMemory {
   void to_sync(const MLUTensorDesc& mlu_tensor_desc);
 #endif
 
+  class StagingState;
+  StagingState* staging(DeviceBackend* backend);
+  bool staging_pending(StagingDirection dir) const;
+  shared_ptr<StagingState> staging_;
+
   bool own_cpu_data_;
   bool cpu_malloc_use_cuda_;
   bool own_gpu_data_;
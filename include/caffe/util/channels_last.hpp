@@ -0,0 +1,68 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef INCLUDE_CAFFE_UTIL_CHANNELS_LAST_HPP_
+#define INCLUDE_CAFFE_UTIL_CHANNELS_LAST_HPP_
+
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+// The shape (N, C, H, W) of a channels-last (N, H, W, C) blob, and back.
+vector<int> ChannelsFirstShape(const vector<int>& nhwc_shape);
+vector<int> ChannelsLastShape(const vector<int>& nchw_shape);
+
+// Transposes num images of channels x spatial elements between NCHW and
+// NHWC, in tiles that stay in cache, spread over the thread pool.
+template <typename Dtype>
+void caffe_cpu_nchw_to_nhwc(const int num, const int channels,
+    const int spatial, const Dtype* nchw, Dtype* nhwc);
+template <typename Dtype>
+void caffe_cpu_nhwc_to_nchw(const int num, const int channels,
+    const int spatial, const Dtype* nhwc, Dtype* nchw);
+
+// Copy a NetParameter with the layers that support it set to run
+// channels-last, and Permute layers added where a blob changes layout.
+// Convolution and Pooling layers always run channels-last; ReLU, Sigmoid,
+// TanH, Dropout, Eltwise, BatchNorm, Scale and Concat layers do when all
+// their bottoms are already channels-last. The channels-last version of a
+// blob is named by ChannelsLastBlobName; the net outputs keep their names
+// and layout.
+void InsertChannelsLast(const NetParameter& param, NetParameter* param_nhwc);
+
+string ChannelsLastBlobName(const string& blob_name);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_CHANNELS_LAST_HPP_
@@ -129,6 +129,7 @@ const char* cnrtGetErrorString(cnrtRet_t status);
 
 const cnmlDataType_t to_cnml_dtype(BaseDataType type);
 const cnrtDataType_t to_cnrt_dtype(BaseDataType type);
+const BaseDataType from_cnrt_dtype(cnrtDataType_t type);
 const char* to_str_dtype(BaseDataType type);
 #endif
 
@@ -0,0 +1,115 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_DEVICE_STAGING_HPP_
+#define INCLUDE_CAFFE_UTIL_DEVICE_STAGING_HPP_
+
+#include <stdint.h>
+
+#include <functional>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+class StagingThread;
+
+/**
+ * @brief The device side of the asynchronous transfers started by
+ *        SyncedMemory::prefetch_to: device memory, copies between host and
+ *        device memory, and the I/O thread these run on.
+ *
+ * Each backend owns one I/O thread, started on the first Submit. Jobs run
+ * on it one at a time in submission order, so a transfer never competes
+ * with another for the copy engine, and the conversions they do fall back
+ * to running serially when the forward pass holds the thread pool.
+ * All submitted jobs must have been waited for before the backend is
+ * destroyed.
+ */
+class DeviceBackend {
+  public:
+  DeviceBackend();
+  virtual ~DeviceBackend();
+
+  virtual void* Malloc(size_t size) = 0;
+  virtual void Free(void* ptr) = 0;
+  virtual void CopyToDevice(void* dst, const void* src, size_t size) = 0;
+  virtual void CopyToHost(void* dst, const void* src, size_t size) = 0;
+
+  /// @brief Queues job on the I/O thread; returns a ticket for Wait.
+  uint64_t Submit(const std::function<void()>& job);
+  /// @brief Blocks until the job of ticket, and all before it, are done.
+  void Wait(uint64_t ticket);
+
+  protected:
+  /// @brief Runs on the I/O thread before its first job, e.g. to bind the
+  ///        thread to the device of the backend.
+  virtual void InitThread() {}
+
+  private:
+  friend class StagingThread;
+
+  shared_ptr<StagingThread> thread_;
+
+  DISABLE_COPY_AND_ASSIGN(DeviceBackend);
+};
+
+/**
+ * @brief A device that is a second host arena: memory comes from the
+ *        HostAllocator and copies are memcpy. It exercises the staging
+ *        paths without a device, and counts the bytes it moves.
+ */
+class HostArenaBackend : public DeviceBackend {
+  public:
+  HostArenaBackend() : bytes_to_device_(0), bytes_to_host_(0) {}
+
+  virtual void* Malloc(size_t size);
+  virtual void Free(void* ptr);
+  virtual void CopyToDevice(void* dst, const void* src, size_t size);
+  virtual void CopyToHost(void* dst, const void* src, size_t size);
+
+  /// Only meaningful once the transfers have been waited for.
+  size_t bytes_to_device() const { return bytes_to_device_; }
+  size_t bytes_to_host() const { return bytes_to_host_; }
+
+  private:
+  size_t bytes_to_device_;
+  size_t bytes_to_host_;
+};
+
+#ifdef USE_MLU
+/// @brief The backend for the MLU that is current on the calling thread.
+///        Each MLU has its own, with an I/O thread bound to it, which lives
+///        until the process exits.
+DeviceBackend* MLUStagingBackend();
+#endif
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_DEVICE_STAGING_HPP_
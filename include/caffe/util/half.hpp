@@ -0,0 +1,57 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#ifndef INCLUDE_CAFFE_UTIL_HALF_HPP_
+#define INCLUDE_CAFFE_UTIL_HALF_HPP_
+
+#include <stdint.h>
+
+namespace caffe {
+
+// IEEE binary16 (FLOAT16) and bfloat16 (BFLOAT16) values are held as their
+// bit patterns in uint16_t. Conversions from float round to nearest even,
+// keep infinities and NaN, and go through FLOAT16 denormals.
+
+float caffe_half_to_float(const uint16_t x);
+uint16_t caffe_float_to_half(const float x);
+float caffe_bfloat16_to_float(const uint16_t x);
+uint16_t caffe_float_to_bfloat16(const float x);
+
+// Array versions of the above, vectorised. They run on the calling thread,
+// so that kernels can widen a block at a time from inside a parallel_for.
+void caffe_cpu_half_to_float(const int n, const uint16_t* x, float* y);
+void caffe_cpu_float_to_half(const int n, const float* x, uint16_t* y);
+void caffe_cpu_bfloat16_to_float(const int n, const uint16_t* x, float* y);
+void caffe_cpu_float_to_bfloat16(const int n, const float* x, uint16_t* y);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_HALF_HPP_
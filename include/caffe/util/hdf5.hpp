@@ -31,7 +31,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define INCLUDE_CAFFE_UTIL_HDF5_HPP_
 #ifdef USE_HDF5
 
+#include <boost/thread/recursive_mutex.hpp>
 #include <string>
+#include <vector>
 
 #include "hdf5.h"     // NOLINT
 #include "hdf5_hl.h"  // NOLINT
@@ -40,6 +42,12 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace caffe {
 
+// A standard libhdf5 build is not reentrant, and HDF5DataLayer reads on a
+// background thread, so every HDF5 call is made holding this lock. The
+// helpers below take it themselves; callers making H5* calls of their own
+// hold it across the whole sequence, from opening the file to closing it.
+boost::recursive_mutex& hdf5_mutex();
+
 template <typename Dtype>
 void hdf5_load_nd_dataset_helper(hid_t file_id, const char* dataset_name_,
                                  int min_dim, int max_dim, Blob<Dtype>* blob,
@@ -49,6 +57,18 @@ template <typename Dtype>
 void hdf5_load_nd_dataset(hid_t file_id, const char* dataset_name_, int min_dim,
                           int max_dim, Blob<Dtype>* blob, bool reshape = false);
 
+// Reads rows [start, start + rows) along the first axis of a dataset,
+// reshaping blob to hold them.
+template <typename Dtype>
+void hdf5_load_nd_dataset_rows(hid_t file_id, const char* dataset_name_,
+                               int min_dim, int max_dim, hsize_t start,
+                               int rows, Blob<Dtype>* blob);
+
+// Checks the dataset holds numbers with min_dim to max_dim axes and returns
+// its dimensions.
+std::vector<hsize_t> hdf5_get_nd_dataset_dims(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim);
+
 template <typename Dtype>
 void hdf5_save_nd_dataset(const hid_t file_id, const string& dataset_name,
                           const Blob<Dtype>& blob, bool write_diff = false);
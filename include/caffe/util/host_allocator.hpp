@@ -0,0 +1,134 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+#define INCLUDE_CAFFE_UTIL_HOST_ALLOCATOR_HPP_
+
+#include <stdint.h>
+#include <boost/thread.hpp>
+#include <atomic>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Caching allocator behind CaffeMallocHost.
+ *
+ * Every block is aligned to kHostAllocAlignment bytes and rounded up to a
+ * size class (four classes per power of two). Freed blocks are kept on
+ * per-thread free lists and handed out again to the next request of the
+ * same class, so reshaping or per-request buffers stop going through
+ * malloc once the working set has been seen. Each thread caches at most
+ * max_cached_bytes(); blocks larger than kHostAllocMaxCachedSize are never
+ * cached.
+ *
+ * With hugepages enabled, blocks of at least kHostAllocHugePageSize bytes
+ * are aligned to a huge page and advised as MADV_HUGEPAGE.
+ *
+ * Allocation statistics, including counts per call site, are returned by
+ * stats(). They are counted per thread and summed when read, so Allocate
+ * and Free never contend on a lock. A site is a string literal naming the
+ * caller; it must outlive the allocator.
+ */
+const size_t kHostAllocAlignment = 64;
+const size_t kHostAllocMaxCachedSize = size_t(1) << 28;
+const size_t kHostAllocHugePageSize = size_t(1) << 21;
+
+class HostAllocator {
+  public:
+  struct SiteStats {
+    uint64_t allocations;
+    uint64_t bytes;
+  };
+  struct Stats {
+    size_t live_bytes;      // requested by blocks currently handed out
+    size_t peak_bytes;      // high-water mark of live_bytes
+    size_t cached_bytes;    // held on free lists, summed over threads
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t cache_hits;
+    std::map<string, SiteStats> sites;  // filled by stats() only
+  };
+
+  static HostAllocator& Get();
+
+  void* Allocate(size_t size, const char* site = "unknown");
+  void Free(void* ptr);
+  /// Returns the cached blocks of the calling thread to the system.
+  void ReleaseThreadCache();
+
+  Stats stats();
+  void ResetStats();
+
+  size_t max_cached_bytes() const { return max_cached_bytes_; }
+  void set_max_cached_bytes(size_t bytes) { max_cached_bytes_ = bytes; }
+  bool use_hugepages() const { return use_hugepages_; }
+  void set_use_hugepages(bool use) { use_hugepages_ = use; }
+
+  private:
+  struct ThreadCache;
+  // The counters of one thread, or of the threads that have exited.
+  struct Counters {
+    Counters() : allocations(0), frees(0), cache_hits(0) {}
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t cache_hits;
+    std::map<const char*, SiteStats> sites;
+  };
+
+  HostAllocator();
+  ThreadCache* thread_cache();
+  void ReleaseCache(ThreadCache* cache);
+  void RetireCache(ThreadCache* cache);
+  static void AddCounters(const Counters& counters, Stats* stats);
+  void* SystemAllocate(size_t size);
+  void AddLiveBytes(size_t size);
+
+  size_t max_cached_bytes_;
+  bool use_hugepages_;
+  boost::thread_specific_ptr<ThreadCache> thread_cache_;
+
+  std::atomic<size_t> live_bytes_;
+  std::atomic<size_t> peak_bytes_;
+  // Guards the set of live thread caches and the counters of exited threads.
+  boost::mutex mutex_;
+  std::set<ThreadCache*> caches_;
+  Counters retired_;
+
+  DISABLE_COPY_AND_ASSIGN(HostAllocator);
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_HOST_ALLOCATOR_HPP_
@@ -0,0 +1,98 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_LAYOUT_CAST_HPP_
+#define INCLUDE_CAFFE_UTIL_LAYOUT_CAST_HPP_
+
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief A host conversion between two layouts and data types, for the
+ *        tensors exchanged with a device.
+ *
+ * The source is a dense row-major tensor of src_shape. Axis i of the
+ * destination is axis order[i] of the source, grown by pad[i] elements
+ * which are written as zeros; pad may be left empty. An empty order keeps
+ * the source axis order.
+ *
+ * DT_FLOAT32, DT_FLOAT16, DT_BFLOAT16, DT_INT8, DT_UINT8, DT_INT16 and
+ * DT_INT32 are supported on either side. With quantized set, an integer
+ * value q stands for q * 2^position / scale: integer sources are scaled
+ * by that and integer destinations by its inverse. Floating-point values
+ * are stored to integers rounded to nearest even and saturated.
+ */
+struct LayoutCastParam {
+  LayoutCastParam()
+      : src_type(DT_FLOAT32), dst_type(DT_FLOAT32), quantized(false),
+        position(0), scale(1) {}
+
+  BaseDataType src_type;
+  BaseDataType dst_type;
+  vector<int> src_shape;
+  vector<int> order;
+  vector<int> pad;
+  bool quantized;
+  int position;
+  float scale;
+};
+
+/// @brief The destination shape of param: src_shape reordered and padded.
+vector<int> LayoutCastDstShape(const LayoutCastParam& param);
+
+/// @brief The size in bytes of the destination of param.
+size_t LayoutCastDstBytes(const LayoutCastParam& param);
+
+/// @brief The size in bytes of one element of type, 0 if not supported.
+size_t LayoutCastTypeSize(BaseDataType type);
+
+/// @brief Whether param leaves the bytes of src unchanged, so that the
+///        cast is a plain copy and callers may skip it.
+bool LayoutCastIsCopy(const LayoutCastParam& param);
+
+/**
+ * @brief Converts src into the caller's dst buffer in a single pass.
+ *
+ * Axes that stay adjacent are merged first. When the innermost axis moves,
+ * the tensor is walked in tiles that stay in cache: each tile is widened
+ * to float from whole source rows, transposed, and stored as whole
+ * destination rows, so the FLOAT16 and BFLOAT16 conversions use the
+ * vectorised array kernels of half.hpp. Tiles are spread over the thread
+ * pool. No temporary tensor is allocated.
+ */
+void caffe_cpu_layout_cast(const LayoutCastParam& param, const void* src,
+                           void* dst);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_LAYOUT_CAST_HPP_
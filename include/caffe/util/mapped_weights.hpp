@@ -0,0 +1,119 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+#define INCLUDE_CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
+
+#include <stdint.h>
+#include <string>
+
+#include "caffe/common.hpp"
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/**
+ * @brief Memory-mapped weights file.
+ *
+ * A .caffemodel stores every parameter as a repeated protobuf field, so
+ * loading it means parsing the whole file and then copying each BlobProto
+ * into a freshly allocated Blob. A mapped weights file instead stores the
+ * raw tensors, each aligned to kMappedWeightsAlignment bytes, followed by a
+ * small MappedWeightsIndex message:
+ *
+ *   MappedWeightsHeader | tensor 0 | pad | tensor 1 | pad | ... | index
+ *
+ * The file is mmap'ed with MAP_PRIVATE, so parameter blobs can point
+ * directly at the mapped pages (see Net::CopyTrainedLayersFromMapped).
+ * Pages are shared between all processes serving the same file and are
+ * only copied when a blob is written to (copy-on-write).
+ *
+ * Use tools/convert_mapped_weights to create one from a .caffemodel.
+ */
+const char kMappedWeightsMagic[8] = {'C', 'A', 'F', 'F', 'E', 'M', 'M', 'W'};
+const uint32_t kMappedWeightsVersion = 1;
+const uint32_t kMappedWeightsAlignment = 64;
+
+struct MappedWeightsHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t alignment;
+  uint64_t index_offset;
+  uint64_t index_size;
+};
+
+/// @brief Returns true if filename starts with the mapped weights magic.
+bool IsMappedWeightsFile(const string& filename);
+
+/**
+ * @brief Writes the parameter blobs of param into a mapped weights file.
+ *        Layers without blobs are skipped. Blobs holding double_data are
+ *        stored as DT_DOUBLE, all others as DT_FLOAT32.
+ */
+void WriteNetParamsToMappedWeights(const NetParameter& param,
+                                   const string& filename);
+
+class MappedWeights {
+  public:
+  explicit MappedWeights(const string& filename);
+  ~MappedWeights();
+
+  const string& filename() const { return filename_; }
+  const MappedWeightsIndex& index() const { return index_; }
+  size_t size() const { return size_; }
+
+  /**
+   * @brief Returns the index entry of layer_name, or NULL if the file holds
+   *        no weights for it.
+   */
+  const MappedLayerIndex* layer(const string& layer_name) const;
+
+  /**
+   * @brief Returns a pointer to the tensor described by blob. The memory is
+   *        writable but private to this process: writing triggers a
+   *        copy-on-write of the touched pages and never reaches the file.
+   */
+  void* blob_data(const MappedBlobIndex& blob) const;
+
+  /// @brief Number of bytes the tensor described by blob occupies.
+  static size_t blob_bytes(const MappedBlobIndex& blob);
+
+  private:
+  string filename_;
+  void* addr_;
+  size_t size_;
+  MappedWeightsIndex index_;
+  map<string, int> layer_names_index_;
+
+  DISABLE_COPY_AND_ASSIGN(MappedWeights);
+};
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_MAPPED_WEIGHTS_HPP_
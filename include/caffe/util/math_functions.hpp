@@ -63,6 +63,13 @@ void caffe_cpu_axpby(const int N, const Dtype alpha, const Dtype* X,
 template <typename Dtype>
 void caffe_copy(const int N, const Dtype* X, Dtype* Y);
 
+// Whether X[0, N) and Y[0, M) share any element.
+template <typename Dtype>
+inline bool caffe_overlaps(const int N, const Dtype* X, const int M,
+                           const Dtype* Y) {
+  return X < Y + M && Y < X + N;
+}
+
 template <typename Dtype>
 void caffe_set(const int N, const Dtype alpha, Dtype* X);
 
@@ -115,12 +122,21 @@ void caffe_rng_bernoulli(const int n, const Dtype p, int* r);
 template <typename Dtype>
 void caffe_rng_bernoulli(const int n, const Dtype p, unsigned int* r);
 
+// The float versions of caffe_exp, caffe_log, caffe_tanh and caffe_sigmoid
+// are vectorised polynomial approximations (see util/vector_math.cpp).
 template <typename Dtype>
 void caffe_exp(const int n, const Dtype* a, Dtype* y);
 
 template <typename Dtype>
 void caffe_log(const int n, const Dtype* a, Dtype* y);
 
+template <typename Dtype>
+void caffe_tanh(const int n, const Dtype* a, Dtype* y);
+
+// y = 1 / (1 + exp(-a))
+template <typename Dtype>
+void caffe_sigmoid(const int n, const Dtype* a, Dtype* y);
+
 template <typename Dtype>
 void caffe_abs(const int n, const Dtype* a, Dtype* y);
 
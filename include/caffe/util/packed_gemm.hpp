@@ -0,0 +1,99 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef INCLUDE_CAFFE_UTIL_PACKED_GEMM_HPP_
+#define INCLUDE_CAFFE_UTIL_PACKED_GEMM_HPP_
+
+#include <stdint.h>
+
+#include "caffe/proto/caffe.pb.h"
+
+namespace caffe {
+
+/// @brief Output neurons per panel of a packed weight matrix.
+const int kPackedPanel = 8;
+/// @brief The largest number of rows caffe_cpu_packed_gemm takes. Beyond
+///        it the sums no longer fit in registers, and a blocked GEMM with
+///        wider vectors wins.
+const int kPackedGemmMaxRows = 4;
+
+/// @brief The number of elements of the packed form of an N x K matrix.
+inline int caffe_packed_count(const int N, const int K) {
+  return (N + kPackedPanel - 1) / kPackedPanel * kPackedPanel * K;
+}
+
+/**
+ * @brief Packs the weights W of N outputs and K inputs, N x K or K x N if
+ *        transposed, into panels of kPackedPanel outputs.
+ *
+ * Panel p holds outputs [p * kPackedPanel, (p + 1) * kPackedPanel),
+ * interleaved input by input, so that a product streams each panel once
+ * from start to end. The last panel is padded with zeros.
+ */
+template <typename Dtype>
+void caffe_cpu_pack_weights(const int N, const int K, const Dtype* W,
+                            const bool transposed, Dtype* packed);
+
+/**
+ * @brief Computes C = A W^T (+ bias) for M <= kPackedGemmMaxRows rows of A
+ *        (M x K), with W packed by caffe_cpu_pack_weights; bias may be NULL.
+ *
+ * Each panel keeps M x kPackedPanel sums in registers while it is read,
+ * and the panels are spread over the thread pool, so that at small batch
+ * the product runs at memory bandwidth rather than through a general GEMM.
+ */
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const int M, const int N, const int K,
+                           const Dtype* A, const Dtype* packed,
+                           const Dtype* bias, Dtype* C);
+
+/**
+ * @brief As caffe_cpu_pack_weights, but stores the panels as type, DT_FLOAT16
+ *        or DT_BFLOAT16, which halves the memory a product streams.
+ */
+template <typename Dtype>
+void caffe_cpu_pack_weights(const int N, const int K, const Dtype* W,
+                            const bool transposed, const BaseDataType type,
+                            uint16_t* packed);
+
+/**
+ * @brief As caffe_cpu_packed_gemm, with W packed as type by the 16-bit
+ *        caffe_cpu_pack_weights. Each panel is widened a block of inputs at
+ *        a time, so the products and sums stay in Dtype.
+ */
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const int M, const int N, const int K,
+                           const Dtype* A, const BaseDataType type,
+                           const uint16_t* packed, const Dtype* bias,
+                           Dtype* C);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_PACKED_GEMM_HPP_
@@ -0,0 +1,81 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_PIXEL_TRANSFORM_HPP_
+#define INCLUDE_CAFFE_UTIL_PIXEL_TRANSFORM_HPP_
+
+namespace caffe {
+
+enum PixelMeanMode {
+  PIXEL_MEAN_NONE,
+  PIXEL_MEAN_VALUES,  // one value per channel
+  PIXEL_MEAN_FILE     // a CHW mean image
+};
+
+/**
+ * @brief Source, mean and scale of a PixelsToCHW call.
+ *
+ * src holds height rows of src_step elements, each row storing width pixels
+ * of channels interleaved values (HWC). A planar image is converted one
+ * plane at a time with channels = 1.
+ *
+ * For PIXEL_MEAN_VALUES, mean points at one value per channel. For
+ * PIXEL_MEAN_FILE, mean points at the element of channel 0 matching the
+ * first source pixel; rows are mean_step apart and channel planes
+ * mean_plane_step apart.
+ */
+template <typename Dtype, typename SrcType>
+struct PixelTransformArgs {
+  const SrcType* src;
+  int src_step;
+  int channels;
+  int height;
+  int width;
+  bool mirror;
+  PixelMeanMode mean_mode;
+  const Dtype* mean;
+  int mean_step;
+  int mean_plane_step;
+  Dtype scale;
+};
+
+/**
+ * @brief Writes (pixel - mean) * scale into height x width CHW planes at
+ *        dst, reversing each row when mirroring.
+ *
+ * The kernel is chosen once per call by mirror, mean mode and channel
+ * count (1, 3 and 4 are specialised), so the per-pixel loop has no
+ * branches and constant strides and is vectorised by the compiler.
+ */
+template <typename Dtype, typename SrcType>
+void PixelsToCHW(const PixelTransformArgs<Dtype, SrcType>& args, Dtype* dst);
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_PIXEL_TRANSFORM_HPP_
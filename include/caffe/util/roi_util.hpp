@@ -0,0 +1,121 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#ifndef INCLUDE_CAFFE_UTIL_ROI_UTIL_HPP_
+#define INCLUDE_CAFFE_UTIL_ROI_UTIL_HPP_
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+/// @brief The clipped input window [hstart, hend) x [wstart, wend) of one
+///        pooled bin.
+struct ROIBin {
+  int hstart;
+  int hend;
+  int wstart;
+  int wend;
+  inline bool empty() const { return hend <= hstart || wend <= wstart; }
+  inline int area() const { return empty() ? 0 :
+      (hend - hstart) * (wend - wstart); }
+};
+
+/// @brief One bilinear sample: four offsets into an input plane and their
+///        weights.
+template <typename Dtype>
+struct ROISample {
+  int pos[4];
+  Dtype w[4];
+};
+
+/**
+ * @brief Computes the pooled_h x pooled_w bins of ROIPooling for one ROI
+ *        [x1, y1, x2, y2], quantised to the input grid, in row-major order.
+ */
+template <typename Dtype>
+void ROIPoolingBins(const Dtype* roi, const Dtype spatial_scale,
+                    const int height, const int width,
+                    const int pooled_h, const int pooled_w, ROIBin* bins);
+
+/**
+ * @brief Computes the group_size x group_size bins of PSROIPooling for one
+ *        ROI [x1, y1, x2, y2], in row-major order.
+ */
+template <typename Dtype>
+void PSROIPoolingBins(const Dtype* roi, const Dtype spatial_scale,
+                      const int height, const int width,
+                      const int group_size, ROIBin* bins);
+
+/**
+ * @brief Computes the bilinear samples of ROIAlign for one ROI
+ *        [x1, y1, x2, y2]: a grid of samples per bin, averaged into the bin,
+ *        with the bins in row-major order.
+ * @return the number of samples per bin.
+ */
+template <typename Dtype>
+int ROIAlignSamples(const Dtype* roi, const Dtype spatial_scale,
+                    const int height, const int width,
+                    const int pooled_h, const int pooled_w,
+                    const int sampling_ratio,
+                    vector<ROISample<Dtype> >* samples);
+
+/**
+ * @brief Runs fn(roi, c_begin, c_end) over tiles of one ROI and a block of
+ *        channels on the thread pool.
+ *
+ * The geometry of each ROI is meant to be computed beforehand, once for all
+ * its channels. Blocks are sized from channel_cost, the rough number of
+ * input elements one channel of one ROI reads, so that a tile is worth
+ * scheduling and the ROIs of a small batch still spread over the pool.
+ */
+template <typename Func>
+void ROIParallelFor(const int num_rois, const int channels,
+                    const int64_t channel_cost, const Func& fn) {
+  const int64_t kTileOps = 16384;
+  const int block = std::max<int64_t>(1, std::min<int64_t>(channels,
+      kTileOps / std::max<int64_t>(1, channel_cost)));
+  const int blocks = (channels + block - 1) / block;
+  parallel_for(0, int64_t(num_rois) * blocks, 1,
+      [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; ++t) {
+      const int c = (t % blocks) * block;
+      fn(static_cast<int>(t / blocks), c, std::min(channels, c + block));
+    }
+  });
+}
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_ROI_UTIL_HPP_
@@ -0,0 +1,135 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INCLUDE_CAFFE_UTIL_THREAD_POOL_HPP_
+#define INCLUDE_CAFFE_UTIL_THREAD_POOL_HPP_
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <functional>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "caffe/common.hpp"
+
+namespace caffe {
+
+/**
+ * @brief Fork-join pool for parallelism inside CPU layers.
+ *
+ * ParallelFor() splits [begin, end) into one contiguous block per
+ * participant (the calling thread and the workers). Each participant
+ * claims grain-sized chunks of its own block and, once that is exhausted,
+ * steals chunks from the blocks of the following participants. With
+ * compact core affinity neighbouring participants share a socket, so
+ * stealing stays NUMA-local as long as there is local work.
+ *
+ * Only one ParallelFor() runs at a time. A call made while another one is
+ * running, from another thread or from inside a chunk, runs serially on
+ * the calling thread, so nested parallel regions never oversubscribe the
+ * cores.
+ *
+ * The process-wide pool is Caffe::thread_pool(); see caffe::parallel_for.
+ */
+class ThreadPool {
+  public:
+  typedef std::function<void(int64_t, int64_t)> Body;
+
+  /**
+   * @param num_threads number of participants including the caller.
+   * @param cpus if not empty, participant i is pinned to
+   *        cpus[i % cpus.size()]; the caller is not pinned.
+   */
+  explicit ThreadPool(int num_threads,
+                      const vector<int>& cpus = vector<int>());
+  ~ThreadPool();
+
+  int num_threads() const { return num_threads_; }
+
+  /// @brief Calls body(chunk_begin, chunk_end) on disjoint chunks covering
+  ///        [begin, end), each at least grain long but the last, and
+  ///        returns once all of them have finished.
+  void ParallelFor(int64_t begin, int64_t end, int64_t grain,
+                   const Body& body);
+
+  /// @brief True on a thread that is currently running a chunk.
+  static bool InParallelRegion();
+
+  private:
+  // The chunks of one participant; padded to a cache line.
+  struct Block {
+    std::atomic<int64_t> next;
+    int64_t end;
+    char pad[64 - sizeof(std::atomic<int64_t>) - sizeof(int64_t)];
+  };
+
+  void WorkerLoop(int index, int cpu);
+  void RunParticipant(int index);
+
+  const int num_threads_;
+  std::vector<std::thread> workers_;
+  std::vector<Block> blocks_;
+  // Serialises ParallelFor() calls; held for the duration of a job.
+  std::mutex job_mutex_;
+
+  // The current job, published under mutex_ by bumping generation_.
+  const Body* body_;
+  int64_t grain_;
+  int num_participants_;
+  std::atomic<int> pending_;
+  uint64_t generation_;
+  bool stop_;
+  std::mutex mutex_;
+  std::condition_variable work_cond_;
+  std::condition_variable done_cond_;
+
+  DISABLE_COPY_AND_ASSIGN(ThreadPool);
+};
+
+/**
+ * @brief Runs body(chunk_begin, chunk_end) over [begin, end) on the
+ *        process-wide pool. Ranges shorter than two grains run inline.
+ */
+inline void parallel_for(int64_t begin, int64_t end, int64_t grain,
+                         const ThreadPool::Body& body) {
+  if (end - begin < 2 * grain || ThreadPool::InParallelRegion()) {
+    if (begin < end) {
+      body(begin, end);
+    }
+    return;
+  }
+  Caffe::thread_pool().ParallelFor(begin, end, grain, body);
+}
+
+}  // namespace caffe
+
+#endif  // INCLUDE_CAFFE_UTIL_THREAD_POOL_HPP_
@@ -129,6 +129,7 @@ void Blob<Dtype>::Reshape(const vector<int>& shape) {
     capacity_ = count_;
     data_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
     diff_.reset(new SyncedMemory(capacity_ * sizeof(Dtype)));
+    data_owner_.reset();
   }
 
 #ifdef USE_MLU
@@ -201,6 +202,7 @@ void Blob<Dtype>::set_cpu_data(Dtype* data) {
     diff_.reset(new SyncedMemory(size));
   }
   data_->set_cpu_data(data);
+  data_owner_.reset();
 }
 
 template <typename Dtype>
@@ -300,6 +302,19 @@ template <typename Dtype>
 void Blob<Dtype>::ShareData(const Blob& other) {
   CHECK_EQ(count_, other.count());
   data_ = other.data();
+  data_owner_ = other.data_owner_;
+}
+
+template <typename Dtype>
+void Blob<Dtype>::ShareDataAt(const Blob& other, const int offset) {
+  CHECK_GE(offset, 0);
+  CHECK_LE(offset + count_, other.count());
+  // Hold on to the memory itself, not to a view of it.
+  data_owner_ = other.data_owner_ ? other.data_owner_ : other.data_;
+  Dtype* data = static_cast<Dtype*>(other.data_->mutable_cpu_data());
+  data_.reset(new SyncedMemory(count_ * sizeof(Dtype)));
+  data_->set_cpu_data(data + offset);
+  capacity_ = count_;
 }
 
 template <typename Dtype>
@@ -29,12 +29,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <boost/thread.hpp>
 #include <glog/logging.h>
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <ctime>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
+#include <thread>  // NOLINT(build/c++11)
 #include "caffe/common.hpp"
 #include "caffe/util/rng.hpp"
+#include "caffe/util/thread_pool.hpp"
 #include "caffe/net.hpp"
 
 
@@ -55,6 +59,56 @@ Caffe& Caffe::Get() {
   return *(thread_instance_.get());
 }
 
+// The pool is process-wide, unlike the thread local Caffe instances.
+static std::mutex thread_pool_mutex_;
+static shared_ptr<ThreadPool> thread_pool_;
+
+// Parses a cpu list such as "0-3,8,10-11".
+static vector<int> ParseCpuList(const string& list) {
+  vector<int> cpus;
+  vector<string> ranges;
+  boost::split(ranges, list, boost::is_any_of(","));
+  for (int i = 0; i < ranges.size(); ++i) {
+    if (ranges[i].empty()) {
+      continue;
+    }
+    int first, last;
+    const size_t dash = ranges[i].find('-');
+    first = atoi(ranges[i].substr(0, dash).c_str());
+    last = dash == string::npos ? first :
+        atoi(ranges[i].substr(dash + 1).c_str());
+    CHECK(first >= 0 && first <= last) << "Invalid cpu range " << ranges[i];
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+ThreadPool& Caffe::thread_pool() {
+  std::lock_guard<std::mutex> lock(thread_pool_mutex_);
+  if (!thread_pool_) {
+    const char* num_threads = getenv("CAFFE_NUM_THREADS");
+    const char* cpus = getenv("CAFFE_CPU_AFFINITY");
+    const int n = num_threads ? atoi(num_threads) :
+        std::thread::hardware_concurrency();
+    thread_pool_.reset(new ThreadPool(std::max(n, 1),
+        cpus ? ParseCpuList(cpus) : vector<int>()));
+  }
+  return *thread_pool_;
+}
+
+void Caffe::set_num_threads(int num_threads, const vector<int>& cpus) {
+  CHECK_GE(num_threads, 1);
+  std::lock_guard<std::mutex> lock(thread_pool_mutex_);
+  thread_pool_.reset();
+  thread_pool_.reset(new ThreadPool(num_threads, cpus));
+}
+
+int Caffe::num_threads() {
+  return thread_pool().num_threads();
+}
+
 // random seeding
 int64_t cluster_seedgen(void) {
   int64_t s, seed, pid;
@@ -508,6 +562,29 @@ const cnrtDataType_t to_cnrt_dtype(BaseDataType type) {
   }
 }
 
+const BaseDataType from_cnrt_dtype(cnrtDataType_t type) {
+  switch (type) {
+  case CNRT_FLOAT16:
+    return DT_FLOAT16;
+  case CNRT_FLOAT32:
+    return DT_FLOAT32;
+  case CNRT_FLOAT64:
+    return DT_DOUBLE;
+  case CNRT_INT8:
+    return DT_INT8;
+  case CNRT_UINT8:
+    return DT_UINT8;
+  case CNRT_INT16:
+    return DT_INT16;
+  case CNRT_INT32:
+    return DT_INT32;
+  case CNRT_QUANT8:
+    return DT_QUANT8;
+  default:
+    return DT_INVALID;
+  }
+}
+
 const char* to_str_dtype(BaseDataType type) {
   switch (type) {
     case DT_FLOAT16:
@@ -40,10 +40,28 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/util/bbox_util.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/pixel_transform.hpp"
 #include "caffe/util/rng.hpp"
 
 namespace caffe {
 
+// Fills the geometry and mean of a single-channel plane conversion.
+template <typename Dtype, typename SrcType>
+static void SetPlaneTransformArgs(int src_step, int height, int width,
+    bool mirror, PixelMeanMode mean_mode, const Dtype* mean, Dtype scale,
+    PixelTransformArgs<Dtype, SrcType>* args) {
+  args->src_step = src_step;
+  args->channels = 1;
+  args->height = height;
+  args->width = width;
+  args->mirror = mirror;
+  args->mean_mode = mean_mode;
+  args->mean = mean;
+  args->mean_step = src_step;
+  args->mean_plane_step = 0;
+  args->scale = scale;
+}
+
 template <typename Dtype>
 DataTransformer<Dtype>::DataTransformer(const TransformationParameter& param,
                                         Phase phase)
@@ -134,35 +152,26 @@ void DataTransformer<Dtype>::Transform(const Datum& datum,
   crop_bbox->set_xmax(Dtype(w_off + width) / datum_width);
   crop_bbox->set_ymax(Dtype(h_off + height) / datum_height);
 
-  Dtype datum_element;
-  int top_index, data_index;
+  const PixelMeanMode mean_mode = has_mean_file ? PIXEL_MEAN_FILE :
+      (has_mean_values ? PIXEL_MEAN_VALUES : PIXEL_MEAN_NONE);
+  // Datum data is planar, so each channel is converted as a 1-channel image.
   for (int c = 0; c < datum_channels; ++c) {
-    for (int h = 0; h < height; ++h) {
-      for (int w = 0; w < width; ++w) {
-        data_index = (c * datum_height + h_off + h) * datum_width + w_off + w;
-        if (do_mirror) {
-          top_index = (c * height + h) * width + (width - 1 - w);
-        } else {
-          top_index = (c * height + h) * width + w;
-        }
-        if (has_uint8) {
-          datum_element =
-              static_cast<Dtype>(static_cast<uint8_t>(data[data_index]));
-        } else {
-          datum_element = datum.float_data(data_index);
-        }
-        if (has_mean_file) {
-          transformed_data[top_index] =
-              (datum_element - mean[data_index]) * scale;
-        } else {
-          if (has_mean_values) {
-            transformed_data[top_index] =
-                (datum_element - mean_values_[c]) * scale;
-          } else {
-            transformed_data[top_index] = datum_element * scale;
-          }
-        }
-      }
+    const int data_offset = (c * datum_height + h_off) * datum_width + w_off;
+    Dtype* top_plane = transformed_data + c * height * width;
+    const Dtype* plane_mean = has_mean_file ? mean + data_offset :
+        (has_mean_values ? &mean_values_[c] : NULL);
+    if (has_uint8) {
+      PixelTransformArgs<Dtype, uint8_t> args;
+      args.src = reinterpret_cast<const uint8_t*>(data.data()) + data_offset;
+      SetPlaneTransformArgs(datum_width, height, width, *do_mirror, mean_mode,
+                            plane_mean, scale, &args);
+      PixelsToCHW(args, top_plane);
+    } else {
+      PixelTransformArgs<Dtype, float> args;
+      args.src = datum.float_data().data() + data_offset;
+      SetPlaneTransformArgs(datum_width, height, width, *do_mirror, mean_mode,
+                            plane_mean, scale, &args);
+      PixelsToCHW(args, top_plane);
     }
   }
 }
@@ -690,36 +699,26 @@ void DataTransformer<Dtype>::Transform(const cv::Mat& cv_img,
   }
   CHECK(cv_cropped_image.data);
 
-  Dtype* transformed_data = transformed_blob->mutable_cpu_data();
-  int top_index;
-  for (int h = 0; h < height; ++h) {
-    const uchar* ptr = cv_cropped_image.ptr<uchar>(h);
-    int img_index = 0;
-    int h_idx = h;
-    for (int w = 0; w < width; ++w) {
-      int w_idx = w;
-      if (*do_mirror) {
-        w_idx = (width - 1 - w);
-      }
-      int h_idx_real = h_idx;
-      int w_idx_real = w_idx;
-      for (int c = 0; c < img_channels; ++c) {
-        top_index = (c * height + h_idx_real) * width + w_idx_real;
-        Dtype pixel = static_cast<Dtype>(ptr[img_index++]);
-        if (has_mean_file) {
-          int mean_index = (c * img_height + h_off + h_idx_real) * img_width +
-                           w_off + w_idx_real;
-          transformed_data[top_index] = (pixel - mean[mean_index]) * scale;
-        } else {
-          if (has_mean_values) {
-            transformed_data[top_index] = (pixel - mean_values_[c]) * scale;
-          } else {
-            transformed_data[top_index] = pixel * scale;
-          }
-        }
-      }
-    }
+  PixelTransformArgs<Dtype, uint8_t> args;
+  args.src = cv_cropped_image.ptr<uint8_t>(0);
+  args.src_step = cv_cropped_image.step1();
+  args.channels = img_channels;
+  args.height = height;
+  args.width = width;
+  args.mirror = *do_mirror;
+  args.scale = scale;
+  if (has_mean_file) {
+    args.mean_mode = PIXEL_MEAN_FILE;
+    args.mean = mean + h_off * img_width + w_off;
+    args.mean_step = img_width;
+    args.mean_plane_step = img_height * img_width;
+  } else {
+    args.mean_mode = has_mean_values ? PIXEL_MEAN_VALUES : PIXEL_MEAN_NONE;
+    args.mean = has_mean_values ? &mean_values_[0] : NULL;
+    args.mean_step = 0;
+    args.mean_plane_step = 0;
   }
+  PixelsToCHW(args, transformed_blob->mutable_cpu_data());
 }
 
 template <typename Dtype>
@@ -27,10 +27,69 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <vector>
+
 #include "caffe/layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 INSTANTIATE_CLASS(Layer);
 
+// Elements per chunk of a chain, and per parallel task.
+const int kElementwiseChunk = 1024;
+const int kElementwiseGrain = 16 * kElementwiseChunk;
+
+template <typename Dtype>
+void ForwardElementwiseChain(const vector<Layer<Dtype>*>& layers,
+                             const int count, const Dtype* bottom,
+                             Dtype* top) {
+  parallel_for(0, count, kElementwiseGrain, [&](int64_t begin, int64_t end) {
+    for (int64_t offset = begin; offset < end; offset += kElementwiseChunk) {
+      const int n = std::min<int64_t>(kElementwiseChunk, end - offset);
+      layers[0]->ForwardElementwise_cpu(offset, n, bottom + offset,
+                                        top + offset);
+      for (int i = 1; i < layers.size(); ++i) {
+        layers[i]->ForwardElementwise_cpu(offset, n, top + offset,
+                                          top + offset);
+      }
+    }
+  });
+}
+
+template void ForwardElementwiseChain<float>(
+    const vector<Layer<float>*>& layers, const int count, const float* bottom,
+    float* top);
+template void ForwardElementwiseChain<double>(
+    const vector<Layer<double>*>& layers, const int count,
+    const double* bottom, double* top);
+
+template <typename Dtype>
+void ForwardResidualChain(const vector<Layer<Dtype>*>& pre,
+                          const vector<Layer<Dtype>*>& post, const int offset,
+                          const int count, Dtype* data, const Dtype* residual,
+                          Dtype* top) {
+  parallel_for(0, count, kElementwiseGrain, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; i += kElementwiseChunk) {
+      const int n = std::min<int64_t>(kElementwiseChunk, end - i);
+      for (int j = 0; j < pre.size(); ++j) {
+        pre[j]->ForwardElementwise_cpu(offset + i, n, data + i, data + i);
+      }
+      caffe_add(n, data + i, residual + i, top + i);
+      for (int j = 0; j < post.size(); ++j) {
+        post[j]->ForwardElementwise_cpu(offset + i, n, top + i, top + i);
+      }
+    }
+  });
+}
+
+template void ForwardResidualChain<float>(const vector<Layer<float>*>& pre,
+    const vector<Layer<float>*>& post, const int offset, const int count,
+    float* data, const float* residual, float* top);
+template void ForwardResidualChain<double>(const vector<Layer<double>*>& pre,
+    const vector<Layer<double>*>& post, const int offset, const int count,
+    double* data, const double* residual, double* top);
+
 }  // namespace caffe
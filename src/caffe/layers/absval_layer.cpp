@@ -44,10 +44,15 @@ void AbsValLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 
 template <typename Dtype>
 void AbsValLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                     const vector<Blob<Dtype>*>& top) {
-  const int count = top[0]->count();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  caffe_abs(count, bottom[0]->cpu_data(), top_data);
+    const vector<Blob<Dtype>*>& top) {
+  ForwardElementwiseChain(vector<Layer<Dtype>*>(1, this), bottom[0]->count(),
+                          bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void AbsValLayer<Dtype>::ForwardElementwise_cpu(const int offset, const int count,
+    const Dtype* bottom, Dtype* top) {
+  caffe_abs(count, bottom, top);
 }
 
 template <typename Dtype>
@@ -28,14 +28,57 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <algorithm>
+#include <cmath>
 #include <functional>
 #include <utility>
 #include <vector>
 
 #include "caffe/layers/argmax_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// Roughly the number of values one parallel task should scan.
+const int kArgMaxGrainOps = 16384;
+
+// The k largest (value, index) pairs of x in decreasing order, ties going
+// to the larger index. Keeps a k-element min-heap instead of sorting x.
+template <typename Dtype>
+void TopK(const Dtype* x, const int n, const int k,
+          std::vector<std::pair<Dtype, int> >* out) {
+  typedef std::pair<Dtype, int> Item;
+  out->clear();
+  if (k == 1) {
+    int best = 0;
+    for (int j = 1; j < n; ++j) {
+      if (x[j] >= x[best]) {
+        best = j;
+      }
+    }
+    out->push_back(Item(x[best], best));
+    return;
+  }
+  std::greater<Item> greater;
+  for (int j = 0; j < k; ++j) {
+    out->push_back(Item(x[j], j));
+  }
+  std::make_heap(out->begin(), out->end(), greater);
+  for (int j = k; j < n; ++j) {
+    const Item item(x[j], j);
+    if (greater(item, out->front())) {
+      std::pop_heap(out->begin(), out->end(), greater);
+      out->back() = item;
+      std::push_heap(out->begin(), out->end(), greater);
+    }
+  }
+  std::sort_heap(out->begin(), out->end(), greater);
+}
+
+}  // namespace
+
 template <typename Dtype>
 void ArgMaxLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -43,6 +86,7 @@ void ArgMaxLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   out_max_val_ = argmax_param.out_max_val();
   top_k_ = argmax_param.top_k();
   has_axis_ = argmax_param.has_axis();
+  softmax_ = argmax_param.softmax();
   CHECK_GE(top_k_, 1) << "top k must not be less than 1.";
   if (has_axis_) {
     axis_ = bottom[0]->CanonicalAxisIndex(argmax_param.axis());
@@ -94,34 +138,61 @@ void ArgMaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     dim = bottom[0]->count(1);
     axis_dist = 1;
   }
-  int num = bottom[0]->count() / dim;
-  std::vector<std::pair<Dtype, int> > bottom_data_vector(dim);
-  for (int i = 0; i < num; ++i) {
-    for (int j = 0; j < dim; ++j) {
-      bottom_data_vector[j] = std::make_pair(
-        bottom_data[(i / axis_dist * dim + j) * axis_dist + i % axis_dist], j);
-    }
-    std::partial_sort(
-        bottom_data_vector.begin(), bottom_data_vector.begin() + top_k_,
-        bottom_data_vector.end(), std::greater<std::pair<Dtype, int> >());
-    for (int j = 0; j < top_k_; ++j) {
-      if (out_max_val_) {
-        if (has_axis_) {
-          // Produces max_val per axis
-          top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-            = bottom_data_vector[j].first;
+  const int num = bottom[0]->count() / dim;
+  const int top_k = top_k_;
+  // The probabilities only matter when they are output.
+  const bool softmax = softmax_ && out_max_val_;
+  const int64_t grain = std::max(1, kArgMaxGrainOps / dim);
+  parallel_for(0, num, grain, [&](int64_t begin, int64_t end) {
+    std::vector<std::pair<Dtype, int> > top_values;
+    std::vector<Dtype> values(axis_dist > 1 || softmax ? dim : 0);
+    for (int i = begin; i < end; ++i) {
+      const Dtype* row =
+          bottom_data + i / axis_dist * dim * axis_dist + i % axis_dist;
+      if (axis_dist > 1) {
+        for (int j = 0; j < dim; ++j) {
+          values[j] = row[j * axis_dist];
+        }
+        row = values.data();
+      }
+      TopK(row, dim, top_k, &top_values);
+      Dtype max_val = top_values[0].first;
+      Dtype norm = 1;
+      if (softmax) {
+        // Only the normaliser is needed for the full row.
+        for (int j = 0; j < dim; ++j) {
+          values[j] = row[j] - max_val;
+        }
+        caffe_exp<Dtype>(dim, values.data(), values.data());
+        Dtype sum = 0;
+        for (int j = 0; j < dim; ++j) {
+          sum += values[j];
+        }
+        norm = Dtype(1) / sum;
+      }
+      for (int j = 0; j < top_k; ++j) {
+        Dtype value = top_values[j].first;
+        if (softmax) {
+          value = std::exp(value - max_val) * norm;
+        }
+        if (out_max_val_) {
+          if (has_axis_) {
+            // Produces max_val per axis
+            top_data[(i / axis_dist * top_k + j) * axis_dist + i % axis_dist]
+              = value;
+          } else {
+            // Produces max_ind and max_val
+            top_data[2 * i * top_k + j] = top_values[j].second;
+            top_data[2 * i * top_k + top_k + j] = value;
+          }
         } else {
-          // Produces max_ind and max_val
-          top_data[2 * i * top_k_ + j] = bottom_data_vector[j].second;
-          top_data[2 * i * top_k_ + top_k_ + j] = bottom_data_vector[j].first;
+          // Produces max_ind per axis
+          top_data[(i / axis_dist * top_k + j) * axis_dist + i % axis_dist]
+            = top_values[j].second;
         }
-      } else {
-        // Produces max_ind per axis
-        top_data[(i / axis_dist * top_k_ + j) * axis_dist + i % axis_dist]
-          = bottom_data_vector[j].second;
       }
     }
-  }
+  });
 }
 
 INSTANTIATE_CLASS(ArgMaxLayer);
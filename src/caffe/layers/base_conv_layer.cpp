@@ -34,17 +34,44 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/base_conv_layer.hpp"
+#include "caffe/util/channels_last.hpp"
 #include "caffe/util/im2col.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+#include "caffe/util/weight_cache.hpp"
 
 namespace caffe {
 
+// Rows of at least this many multiply-adds are worth a parallel chunk.
+const int kChannelsLastGrainOps = 16384;
+
 template <typename Dtype>
-void BaseConvolutionLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
-                                             const vector<Blob<Dtype>*>& top) {
+const vector<Blob<Dtype>*>& BaseConvolutionLayer<Dtype>::ChannelsFirstBottom(
+    const vector<Blob<Dtype>*>& bottom) {
+  if (!channels_last_) {
+    return bottom;
+  }
+  CHECK_EQ(bottom.size(), 1) << "Channels-last convolution takes one input.";
+  nchw_bottom_.Reshape(ChannelsFirstShape(bottom[0]->shape()));
+  nchw_bottom_vec_.assign(1, &nchw_bottom_);
+  return nchw_bottom_vec_;
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::LayerSetUp(
+    const vector<Blob<Dtype>*>& layer_bottom,
+    const vector<Blob<Dtype>*>& top) {
   // Configure the kernel size, padding, stride, and inputs.
   ConvolutionParameter conv_param = this->layer_param_.convolution_param();
+  channels_last_ = this->layer_param_.channels_last();
+  if (channels_last_) {
+    CHECK(!reverse_dimensions())
+        << "Deconvolution cannot run channels-last.";
+    CHECK_EQ(conv_param.axis(), 1)
+        << "Channels-last convolution takes the default axis.";
+  }
+  const vector<Blob<Dtype>*>& bottom = ChannelsFirstBottom(layer_bottom);
   force_nd_im2col_ = conv_param.force_nd_im2col();
   use_pad_same_ = conv_param.same_mode();
   channel_axis_ = bottom[0]->CanonicalAxisIndex(conv_param.axis());
@@ -326,8 +353,10 @@ void BaseConvolutionLayer<Dtype>::SetMean(const vector<Blob<Dtype>*>& bottom,
 #endif
 
 template <typename Dtype>
-void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
-                                          const vector<Blob<Dtype>*>& top) {
+void BaseConvolutionLayer<Dtype>::Reshape(
+    const vector<Blob<Dtype>*>& layer_bottom,
+    const vector<Blob<Dtype>*>& top) {
+  const vector<Blob<Dtype>*>& bottom = ChannelsFirstBottom(layer_bottom);
   const int first_spatial_axis = channel_axis_ + 1;
   CHECK_EQ(bottom[0]->num_axes(), first_spatial_axis + num_spatial_axes_)
       << "bottom num_axes may not change.";
@@ -378,8 +407,11 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (bias_term_) {
     vector<int> bias_multiplier_shape(1, out_spatial_dim_);
     bias_multiplier_.Reshape(bias_multiplier_shape);
-    caffe_set(bias_multiplier_.count(), Dtype(1),
-              bias_multiplier_.mutable_cpu_data());
+    // Shrinking keeps the ones already written; refill only fresh memory.
+    if (bias_multiplier_.cpu_data()[out_spatial_dim_ - 1] != Dtype(1)) {
+      caffe_set(bias_multiplier_.count(), Dtype(1),
+                bias_multiplier_.mutable_cpu_data());
+    }
   }
   // if use tf_pad, override the pad or pad_h/pad_w params
   if (use_pad_same_) {
@@ -399,6 +431,12 @@ void BaseConvolutionLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     pad_data[2] = pad_bottom;
     pad_data[3] = pad_right;
   }
+  // The counts above do not depend on the order of the axes.
+  if (channels_last_) {
+    for (int top_id = 0; top_id < top.size(); ++top_id) {
+      top[top_id]->Reshape(ChannelsLastShape(top_shape));
+    }
+  }
 }
 
 template <typename Dtype>
@@ -473,6 +511,187 @@ void BaseConvolutionLayer<Dtype>::backward_cpu_bias(Dtype* bias,
                         bias_multiplier_.cpu_data(), 1., bias);
 }
 
+// The geometry of a 2-D convolution, for the channels-last kernels.
+struct ChannelsLastConvShape {
+  int height, width, out_height, out_width;
+  int kernel_h, kernel_w, pad_h, pad_w;
+  int stride_h, stride_w, dilation_h, dilation_w;
+};
+
+// Unrolls channels [channel_begin, channel_begin + channels) of one
+// (H, W, image_channels) image into a row of (kernel_h, kernel_w, channels)
+// per output position, with zeros for the padding.
+template <typename Dtype>
+static void Im2colChannelsLast(const ChannelsLastConvShape& s,
+    const Dtype* image, const int image_channels, const int channel_begin,
+    const int channels, Dtype* col) {
+  const int row_size = s.kernel_h * s.kernel_w * channels;
+  const int64_t grain = std::max(1, kChannelsLastGrainOps /
+      std::max(1, s.out_width * row_size));
+  parallel_for(0, s.out_height, grain, [&](int64_t begin, int64_t end) {
+    for (int oh = begin; oh < end; ++oh) {
+      Dtype* row = col + static_cast<int64_t>(oh) * s.out_width * row_size;
+      for (int ow = 0; ow < s.out_width; ++ow) {
+        for (int kh = 0; kh < s.kernel_h; ++kh) {
+          const int h = oh * s.stride_h - s.pad_h + kh * s.dilation_h;
+          for (int kw = 0; kw < s.kernel_w; ++kw) {
+            const int w = ow * s.stride_w - s.pad_w + kw * s.dilation_w;
+            if (h >= 0 && h < s.height && w >= 0 && w < s.width) {
+              caffe_copy(channels, image + (static_cast<int64_t>(h) *
+                  s.width + w) * image_channels + channel_begin, row);
+            } else {
+              caffe_set(channels, Dtype(0), row);
+            }
+            row += channels;
+          }
+        }
+      }
+    }
+  });
+}
+
+// Applies one (kernel_h, kernel_w) filter per channel, with weight laid out
+// as (kernel_h, kernel_w, channels), to num (H, W, channels) images.
+template <typename Dtype>
+static void DepthwiseChannelsLast(const ChannelsLastConvShape& s,
+    const int num, const int channels, const Dtype* bottom,
+    const Dtype* weight, const Dtype* bias, Dtype* top) {
+  const int64_t grain = std::max(1, kChannelsLastGrainOps /
+      std::max(1, s.out_width * s.kernel_h * s.kernel_w * channels));
+  parallel_for(0, static_cast<int64_t>(num) * s.out_height, grain,
+      [&](int64_t begin, int64_t end) {
+    for (int64_t r = begin; r < end; ++r) {
+      const int n = r / s.out_height;
+      const int oh = r % s.out_height;
+      const Dtype* image = bottom +
+          static_cast<int64_t>(n) * s.height * s.width * channels;
+      Dtype* out = top + r * s.out_width * channels;
+      for (int ow = 0; ow < s.out_width; ++ow, out += channels) {
+        if (bias) {
+          caffe_copy(channels, bias, out);
+        } else {
+          caffe_set(channels, Dtype(0), out);
+        }
+        for (int kh = 0; kh < s.kernel_h; ++kh) {
+          const int h = oh * s.stride_h - s.pad_h + kh * s.dilation_h;
+          if (h < 0 || h >= s.height) {
+            continue;
+          }
+          for (int kw = 0; kw < s.kernel_w; ++kw) {
+            const int w = ow * s.stride_w - s.pad_w + kw * s.dilation_w;
+            if (w < 0 || w >= s.width) {
+              continue;
+            }
+            const Dtype* in = image + (h * s.width + w) * channels;
+            const Dtype* filter = weight + (kh * s.kernel_w + kw) * channels;
+            for (int c = 0; c < channels; ++c) {
+              out[c] += in[c] * filter[c];
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+const Dtype* BaseConvolutionLayer<Dtype>::ChannelsLastWeights(
+    const bool depthwise) {
+  const shared_ptr<SyncedMemory>& source = this->blobs_[0]->data();
+  if (nhwc_weights_source_ != source ||
+      nhwc_weights_version_ != source->version()) {
+    const Blob<Dtype>& weight = *this->blobs_[0];
+    // Layers reading the same weights, e.g. the contexts of a NetModel,
+    // share one reordered copy.
+    const string layout = string(depthwise ? "nhwc depthwise " : "nhwc ") +
+        weight.shape_string();
+    nhwc_weights_ = SharedWeightCopy(source, layout, [&]() {
+      shared_ptr<SyncedMemory> reordered_weights(
+          new SyncedMemory(weight.count() * sizeof(Dtype)));
+      Dtype* reordered =
+          static_cast<Dtype*>(reordered_weights->mutable_cpu_data());
+      // Both are a move of the channels after the kernel window.
+      if (depthwise) {
+        caffe_cpu_nchw_to_nhwc(1, weight.shape(0), weight.count(2),
+                               weight.cpu_data(), reordered);
+      } else {
+        caffe_cpu_nchw_to_nhwc(weight.shape(0), weight.shape(1),
+                               weight.count(2), weight.cpu_data(), reordered);
+      }
+      return reordered_weights;
+    });
+    nhwc_weights_source_ = source;
+    nhwc_weights_version_ = source->version();
+  }
+  return static_cast<const Dtype*>(nhwc_weights_->cpu_data());
+}
+
+template <typename Dtype>
+void BaseConvolutionLayer<Dtype>::forward_cpu_channels_last(
+    const Blob<Dtype>& bottom, Blob<Dtype>* top) {
+  const int* kernel_shape_data = kernel_shape_.cpu_data();
+  const int* pad_data = pad_.cpu_data();
+  const int* stride_data = stride_.cpu_data();
+  const int* dilation_data = dilation_.cpu_data();
+  const ChannelsLastConvShape s = {conv_input_shape_.cpu_data()[1],
+      conv_input_shape_.cpu_data()[2], output_shape_[0], output_shape_[1],
+      kernel_shape_data[0], kernel_shape_data[1], pad_data[0], pad_data[1],
+      stride_data[0], stride_data[1], dilation_data[0], dilation_data[1]};
+  const bool depthwise = group_ == channels_ && num_output_ == channels_;
+  const Dtype* weight = ChannelsLastWeights(depthwise);
+  const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+  const Dtype* bottom_data = bottom.cpu_data();
+  Dtype* top_data = top->mutable_cpu_data();
+  if (depthwise) {
+    DepthwiseChannelsLast(s, num_, channels_, bottom_data, weight, bias,
+                          top_data);
+    return;
+  }
+  const int out_spatial_dim = s.out_height * s.out_width;
+  const int group_channels = channels_ / group_;
+  const int group_outputs = num_output_ / group_;
+  if (is_1x1_ && group_ == 1) {
+    // The bottom already is the column matrix of the whole batch.
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, num_ * out_spatial_dim,
+                          num_output_, channels_, (Dtype)1., bottom_data,
+                          weight, (Dtype)0., top_data);
+  } else {
+    if (group_ > 1) {
+      group_output_.Reshape(vector<int>(1, out_spatial_dim * group_outputs));
+    }
+    Dtype* col_buff = col_buffer_.mutable_cpu_data();
+    for (int n = 0; n < num_; ++n) {
+      Dtype* top_image = top_data + n * top_dim_;
+      for (int g = 0; g < group_; ++g) {
+        Im2colChannelsLast(s, bottom_data + n * bottom_dim_, channels_,
+                           g * group_channels, group_channels, col_buff);
+        Dtype* output = group_ > 1 ? group_output_.mutable_cpu_data() :
+            top_image;
+        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, out_spatial_dim,
+                              group_outputs, kernel_dim_, (Dtype)1.,
+                              col_buff, weight + weight_offset_ * g,
+                              (Dtype)0., output);
+        for (int i = 0; group_ > 1 && i < out_spatial_dim; ++i) {
+          caffe_copy(group_outputs, output + i * group_outputs,
+                     top_image + i * num_output_ + g * group_outputs);
+        }
+      }
+    }
+  }
+  if (bias) {
+    const int rows = num_ * out_spatial_dim;
+    const int64_t grain = std::max(1, kChannelsLastGrainOps / num_output_);
+    parallel_for(0, rows, grain, [&](int64_t begin, int64_t end) {
+      for (int64_t r = begin; r < end; ++r) {
+        Dtype* row = top_data + r * num_output_;
+        for (int c = 0; c < num_output_; ++c) {
+          row[c] += bias[c];
+        }
+      }
+    });
+  }
+}
+
 #ifdef USE_CUDA
 
 template <typename Dtype>
@@ -28,6 +28,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/batch_norm_layer.hpp"
@@ -44,10 +45,14 @@ void BatchNormLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   use_global_stats_ = this->phase_ == TEST;
   if (param.has_use_global_stats())
     use_global_stats_ = param.use_global_stats();
+  channel_axis_ = this->layer_param_.channels_last() ? 3 : 1;
+  if (this->layer_param_.channels_last())
+    CHECK_EQ(bottom[0]->num_axes(), 4)
+        << "Channels-last blobs must have 4 axes.";
   if (bottom[0]->num_axes() == 1)
     channels_ = 1;
   else
-    channels_ = bottom[0]->shape(1);
+    channels_ = bottom[0]->shape(channel_axis_);
   eps_ = param.eps();
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -93,7 +98,8 @@ void BatchNormLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
                                     const vector<Blob<Dtype>*>& top) {
-  if (bottom[0]->num_axes() >= 1) CHECK_EQ(bottom[0]->shape(1), channels_);
+  if (bottom[0]->num_axes() >= 1)
+    CHECK_EQ(bottom[0]->shape(channel_axis_), channels_);
   if (top[0] != bottom[0]) {
     top[0]->ReshapeLike(*bottom[0]);
   }
@@ -110,10 +116,12 @@ void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   }
 
   x_norm_.Reshape(bottom[0]->shape());
-  sz[0] = bottom[0]->shape(0);
+  const int num = bottom[0]->count(0, channel_axis_);
+  sz[0] = num;
   batch_sum_multiplier_.Reshape(sz);
 
-  int spatial_dim = bottom[0]->count() / (channels_ * bottom[0]->shape(0));
+  int spatial_dim = bottom[0]->count() / (channels_ * num);
+  spatial_dim_ = spatial_dim;
   if (spatial_sum_multiplier_.num_axes() == 0 ||
       spatial_sum_multiplier_.shape(0) != spatial_dim) {
     sz[0] = spatial_dim;
@@ -122,7 +130,7 @@ void BatchNormLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     caffe_set(spatial_sum_multiplier_.count(), Dtype(1), multiplier_data);
   }
 
-  int numbychans = channels_ * bottom[0]->shape(0);
+  int numbychans = channels_ * num;
   if (num_by_chans_.num_axes() == 0 || num_by_chans_.shape(0) != numbychans) {
     sz[0] = numbychans;
     num_by_chans_.Reshape(sz);
@@ -136,8 +144,8 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                         const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  int num = bottom[0]->shape(0);
-  int spatial_dim = bottom[0]->count() / (bottom[0]->shape(0) * channels_);
+  int num = bottom[0]->count(0, channel_axis_);
+  int spatial_dim = bottom[0]->count() / (num * channels_);
 
   if (bottom[0] != top[0]) {
     caffe_copy(bottom[0]->count(), bottom_data, top_data);
@@ -236,6 +244,50 @@ void BatchNormLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void BatchNormLayer<Dtype>::ForwardElementwise_cpu(const int offset,
+    const int count, const Dtype* bottom, Dtype* top) {
+  const Dtype scale_factor = this->blobs_[2]->cpu_data()[0] == 0
+                                 ? 0
+                                 : 1 / this->blobs_[2]->cpu_data()[0];
+  const Dtype* mean_data = this->blobs_[0]->cpu_data();
+  const Dtype* variance_data = this->blobs_[1]->cpu_data();
+  if (spatial_dim_ == 1) {
+    // As when channels-last, consecutive elements are consecutive channels:
+    // walk the range one run of them at a time.
+    const Dtype* alpha_data =
+        use_alpha_beta_ ? this->blobs_[3]->cpu_data() : NULL;
+    const Dtype* beta_data =
+        use_alpha_beta_ ? this->blobs_[4]->cpu_data() : NULL;
+    for (int i = 0; i < count; ) {
+      const int c0 = (offset + i) % channels_;
+      const int n = std::min(count - i, channels_ - c0);
+      for (int j = 0; j < n; ++j) {
+        const int c = c0 + j;
+        const Dtype std = std::sqrt(variance_data[c] * scale_factor + eps_);
+        const Dtype y = (bottom[i + j] - mean_data[c] * scale_factor) / std;
+        top[i + j] = alpha_data ? y * alpha_data[c] + beta_data[c] : y;
+      }
+      i += n;
+    }
+    return;
+  }
+  // Walk the range one run of equal channel at a time.
+  for (int i = 0; i < count; ) {
+    const int index = offset + i;
+    const int c = index / spatial_dim_ % channels_;
+    const int n = std::min(count - i, spatial_dim_ - index % spatial_dim_);
+    const Dtype mean = mean_data[c] * scale_factor;
+    const Dtype std = std::sqrt(variance_data[c] * scale_factor + eps_);
+    const Dtype alpha = use_alpha_beta_ ? this->blobs_[3]->cpu_data()[c] : 1;
+    const Dtype beta = use_alpha_beta_ ? this->blobs_[4]->cpu_data()[c] : 0;
+    for (int j = i; j < i + n; ++j) {
+      top[j] = (bottom[j] - mean) / std * alpha + beta;
+    }
+    i += n;
+  }
+}
+
 template <typename Dtype>
 void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                          const vector<bool>& propagate_down,
@@ -264,8 +316,8 @@ void BatchNormLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     return;
   }
   const Dtype* top_data = x_norm_.cpu_data();
-  int num = bottom[0]->shape()[0];
-  int spatial_dim = bottom[0]->count() / (bottom[0]->shape(0) * channels_);
+  int num = bottom[0]->count(0, channel_axis_);
+  int spatial_dim = bottom[0]->count() / (num * channels_);
   // if Y = (X-mean(X))/(sqrt(var(X)+eps)), then
   //
   // dE(Y)/dX =
@@ -39,13 +39,33 @@ const float kBNLL_THRESHOLD = 50.;
 template <typename Dtype>
 void BNLLLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  const int count = bottom[0]->count();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = bottom_data[i] > 0 ?
-        bottom_data[i] + log(1. + exp(-bottom_data[i])) :
-        log(1. + exp(bottom_data[i]));
+  ForwardElementwiseChain(vector<Layer<Dtype>*>(1, this), bottom[0]->count(),
+                          bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void BNLLLayer<Dtype>::ForwardElementwise_cpu(const int offset, const int count,
+    const Dtype* bottom, Dtype* top) {
+  // max(x, 0) + log(1 + exp(-|x|)); log1p(t) is evaluated as
+  // log(u) * t / (u - 1) with u = 1 + t, which stays accurate for tiny t.
+  Dtype t[1024];
+  Dtype u[1024];
+  for (int begin = 0; begin < count; begin += 1024) {
+    const int n = std::min(count - begin, 1024);
+    for (int i = 0; i < n; ++i) {
+      t[i] = -std::abs(bottom[begin + i]);
+    }
+    caffe_exp(n, t, t);
+    for (int i = 0; i < n; ++i) {
+      u[i] = Dtype(1) + t[i];
+    }
+    caffe_log(n, u, u);
+    for (int i = 0; i < n; ++i) {
+      const Dtype denominator = (Dtype(1) + t[i]) - Dtype(1);
+      const Dtype log1p = denominator == Dtype(0) ? t[i] :
+          u[i] * t[i] / denominator;
+      top[begin + i] = std::max(bottom[begin + i], Dtype(0)) + log1p;
+    }
   }
 }
 
@@ -92,11 +92,44 @@ void ConcatLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     return;
   }
   Dtype* top_data = top[0]->mutable_cpu_data();
+  const int top_count = top[0]->count();
+  vector<const Dtype*> bottom_datas(bottom.size());
+  for (int i = 0; i < bottom.size(); ++i) {
+    bottom_datas[i] = bottom[i]->cpu_data();
+  }
+  // With a single concat the inputs may be views into top, set up by
+  // Net::InitDataViews. Those already in place are skipped; any other
+  // input lying inside top is staged before top is overwritten.
+  vector<Dtype> staged;
+  if (num_concats_ == 1) {
+    vector<int> staged_offsets(bottom.size(), -1);
+    int offset = 0;
+    for (int i = 0; i < bottom.size(); ++i) {
+      const int count = bottom[i]->count();
+      if (bottom_datas[i] == top_data + offset) {
+        bottom_datas[i] = NULL;
+      } else if (caffe_overlaps(count, bottom_datas[i], top_count,
+                                static_cast<const Dtype*>(top_data))) {
+        staged_offsets[i] = staged.size();
+        staged.insert(staged.end(), bottom_datas[i], bottom_datas[i] + count);
+      }
+      offset += count;
+    }
+    for (int i = 0; i < bottom.size(); ++i) {
+      if (staged_offsets[i] >= 0) {
+        bottom_datas[i] = staged.data() + staged_offsets[i];
+      }
+    }
+  }
   int offset_concat_axis = 0;
   const int top_concat_axis = top[0]->shape(concat_axis_);
   for (int i = 0; i < bottom.size(); ++i) {
-    const Dtype* bottom_data = bottom[i]->cpu_data();
+    const Dtype* bottom_data = bottom_datas[i];
     const int bottom_concat_axis = bottom[i]->shape(concat_axis_);
+    if (!bottom_data) {
+      offset_concat_axis += bottom_concat_axis;
+      continue;
+    }
     for (int n = 0; n < num_concats_; ++n) {
       caffe_copy(
           bottom_concat_axis * concat_input_size_,
@@ -67,6 +67,10 @@ void ConvolutionDepthwiseLayer<Dtype>::compute_output_shape() {
 template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Forward_cpu(
     const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  if (this->channels_last_) {
+    this->forward_cpu_channels_last(*bottom[0], top[0]);
+    return;
+  }
   const Dtype* weight = this->blobs_[0]->cpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
@@ -86,6 +90,7 @@ template <typename Dtype>
 void ConvolutionDepthwiseLayer<Dtype>::Backward_cpu(
     const vector<Blob<Dtype>*>& top, const vector<bool>& propagate_down,
     const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->channels_last_) << "Channels-last convolution is forward only.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
@@ -88,6 +88,10 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     }
   }
 #endif
+  if (this->channels_last_) {
+    this->forward_cpu_channels_last(*bottom[0], top[0]);
+    return;
+  }
   const Dtype* weight = this->blobs_[0]->cpu_data();
   for (int i = 0; i < bottom.size(); ++i) {
     const Dtype* bottom_data = bottom[i]->cpu_data();
@@ -103,10 +107,45 @@ void ConvolutionLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   }
 }
 
+template <typename Dtype>
+void ConvolutionLayer<Dtype>::ForwardResidual_cpu(
+    const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top,
+    const vector<Layer<Dtype>*>& pre, const Blob<Dtype>& residual,
+    const vector<Layer<Dtype>*>& post, Blob<Dtype>* output) {
+  CHECK_EQ(bottom.size(), 1) << "Residual fusion takes a single input.";
+  CHECK_EQ(residual.count(), top[0]->count());
+  CHECK_EQ(output->count(), top[0]->count());
+  const Dtype* weight = this->blobs_[0]->cpu_data();
+  const Dtype* bottom_data = bottom[0]->cpu_data();
+  const Dtype* residual_data = residual.cpu_data();
+  Dtype* top_data = top[0]->mutable_cpu_data();
+  Dtype* output_data = output->mutable_cpu_data();
+  if (this->channels_last_) {
+    // The channels of an image are interleaved, so fuse over the whole top.
+    this->forward_cpu_channels_last(*bottom[0], top[0]);
+    ForwardResidualChain(pre, post, 0, top[0]->count(), top_data,
+                         residual_data, output_data);
+    return;
+  }
+  for (int n = 0; n < this->num_; ++n) {
+    const int top_offset = n * this->top_dim_;
+    this->forward_cpu_gemm(bottom_data + n * this->bottom_dim_, weight,
+                           top_data + top_offset);
+    if (this->bias_term_) {
+      const Dtype* bias = this->blobs_[1]->cpu_data();
+      this->forward_cpu_bias(top_data + top_offset, bias);
+    }
+    ForwardResidualChain(pre, post, top_offset, this->top_dim_,
+                         top_data + top_offset, residual_data + top_offset,
+                         output_data + top_offset);
+  }
+}
+
 template <typename Dtype>
 void ConvolutionLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
                                            const vector<bool>& propagate_down,
                                            const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!this->channels_last_) << "Channels-last convolution is forward only.";
   const Dtype* weight = this->blobs_[0]->cpu_data();
   Dtype* weight_diff = this->blobs_[0]->mutable_cpu_diff();
   for (int i = 0; i < top.size(); ++i) {
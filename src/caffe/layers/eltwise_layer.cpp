@@ -87,13 +87,32 @@ void EltwiseLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       caffe_mul(count, top_data, bottom[i]->cpu_data(), top_data);
     }
     break;
-  case EltwiseParameter_EltwiseOp_SUM:
-    caffe_set(count, Dtype(0), top_data);
-    // TODO(shelhamer) does BLAS optimize to sum for coeff = 1?
+  case EltwiseParameter_EltwiseOp_SUM: {
+    // Start from the first bottom, or from the one whose memory top shares
+    // so that the sum can be formed in place.
+    int first = 0;
     for (int i = 0; i < bottom.size(); ++i) {
-      caffe_axpy(count, coeffs_[i], bottom[i]->cpu_data(), top_data);
+      if (bottom[i]->cpu_data() == top_data) {
+        first = i;
+      }
+    }
+    if (bottom[first]->cpu_data() == top_data) {
+      if (coeffs_[first] != Dtype(1)) {
+        caffe_scal(count, coeffs_[first], top_data);
+      }
+    } else if (coeffs_[first] == Dtype(1)) {
+      caffe_copy(count, bottom[first]->cpu_data(), top_data);
+    } else {
+      caffe_cpu_scale(count, coeffs_[first], bottom[first]->cpu_data(),
+                      top_data);
+    }
+    for (int i = 0; i < bottom.size(); ++i) {
+      if (i != first) {
+        caffe_axpy(count, coeffs_[i], bottom[i]->cpu_data(), top_data);
+      }
     }
     break;
+  }
   case EltwiseParameter_EltwiseOp_MAX:
     // Initialize
     mask = max_idx_.mutable_cpu_data();
@@ -36,14 +36,26 @@ namespace caffe {
 
 template <typename Dtype>
 void ELULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                  const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  const int count = bottom[0]->count();
-  Dtype alpha = this->layer_param_.elu_param().alpha();
-  for (int i = 0; i < count; ++i) {
-    top_data[i] = std::max(bottom_data[i], Dtype(0)) +
-      alpha * (exp(std::min(bottom_data[i], Dtype(0))) - Dtype(1));
+    const vector<Blob<Dtype>*>& top) {
+  ForwardElementwiseChain(vector<Layer<Dtype>*>(1, this), bottom[0]->count(),
+                          bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void ELULayer<Dtype>::ForwardElementwise_cpu(const int offset, const int count,
+    const Dtype* bottom, Dtype* top) {
+  const Dtype alpha = this->layer_param_.elu_param().alpha();
+  Dtype negative[1024];
+  for (int begin = 0; begin < count; begin += 1024) {
+    const int n = std::min(count - begin, 1024);
+    for (int i = 0; i < n; ++i) {
+      negative[i] = std::min(bottom[begin + i], Dtype(0));
+    }
+    caffe_exp(n, negative, negative);
+    for (int i = 0; i < n; ++i) {
+      top[begin + i] = std::max(bottom[begin + i], Dtype(0)) +
+          alpha * (negative[i] - Dtype(1));
+    }
   }
 }
 
@@ -58,18 +58,22 @@ void ExpLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 
 template <typename Dtype>
 void ExpLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                  const vector<Blob<Dtype>*>& top) {
-  const int count = bottom[0]->count();
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
+    const vector<Blob<Dtype>*>& top) {
+  ForwardElementwiseChain(vector<Layer<Dtype>*>(1, this), bottom[0]->count(),
+                          bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void ExpLayer<Dtype>::ForwardElementwise_cpu(const int offset, const int count,
+    const Dtype* bottom, Dtype* top) {
   if (inner_scale_ == Dtype(1)) {
-    caffe_exp(count, bottom_data, top_data);
+    caffe_exp(count, bottom, top);
   } else {
-    caffe_cpu_scale(count, inner_scale_, bottom_data, top_data);
-    caffe_exp(count, top_data, top_data);
+    caffe_cpu_scale(count, inner_scale_, bottom, top);
+    caffe_exp(count, top, top);
   }
   if (outer_scale_ != Dtype(1)) {
-    caffe_scal(count, outer_scale_, top_data);
+    caffe_scal(count, outer_scale_, top);
   }
 }
 
@@ -0,0 +1,246 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <vector>
+
+#include "caffe/filler.hpp"
+#include "caffe/layers/fused_recurrent_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+void FusedRecurrentLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  const RecurrentParameter& param = this->layer_param_.recurrent_param();
+  H_ = param.num_output();
+  CHECK_GT(H_, 0) << "num_output must be positive";
+  expose_hidden_ = param.expose_hidden();
+  CHECK_GE(bottom[0]->num_axes(), 2)
+      << "bottom[0] must have at least 2 axes -- (#timesteps, #streams, ...)";
+  I_ = bottom[0]->count(2);
+  const int gate_dim = NumGates() * H_;
+
+  if (this->blobs_.size() > 0) {
+    LOG(INFO) << "Skipping parameter initialization";
+  } else {
+    this->blobs_.resize(3);
+    vector<int> weight_shape(2);
+    weight_shape[0] = gate_dim;
+    weight_shape[1] = I_;
+    this->blobs_[0].reset(new Blob<Dtype>(weight_shape));
+    vector<int> bias_shape(1, gate_dim);
+    this->blobs_[1].reset(new Blob<Dtype>(bias_shape));
+    weight_shape[1] = H_;
+    this->blobs_[2].reset(new Blob<Dtype>(weight_shape));
+    shared_ptr<Filler<Dtype> > weight_filler(
+        GetFiller<Dtype>(param.weight_filler()));
+    weight_filler->Fill(this->blobs_[0].get());
+    weight_filler->Fill(this->blobs_[2].get());
+    shared_ptr<Filler<Dtype> > bias_filler(
+        GetFiller<Dtype>(param.bias_filler()));
+    bias_filler->Fill(this->blobs_[1].get());
+  }
+  CHECK_EQ(this->blobs_[0]->count(), gate_dim * I_);
+  CHECK_EQ(this->blobs_[1]->count(), gate_dim);
+  CHECK_EQ(this->blobs_[2]->count(), gate_dim * H_);
+  this->param_propagate_down_.resize(this->blobs_.size(), true);
+
+  state_.resize(NumStates());
+  state0_.resize(NumStates());
+  for (int i = 0; i < NumStates(); ++i) {
+    state_[i].reset(new Blob<Dtype>());
+    state0_[i].reset(new Blob<Dtype>());
+  }
+}
+
+template <typename Dtype>
+void FusedRecurrentLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  CHECK_GE(bottom[0]->num_axes(), 2)
+      << "bottom[0] must have at least 2 axes -- (#timesteps, #streams, ...)";
+  T_ = bottom[0]->shape(0);
+  N_ = bottom[0]->shape(1);
+  CHECK_EQ(I_, bottom[0]->count(2)) << "Input size changed";
+  CHECK_EQ(bottom[1]->num_axes(), 2)
+      << "bottom[1] must have exactly 2 axes -- (#timesteps, #streams)";
+  CHECK_EQ(T_, bottom[1]->shape(0));
+  CHECK_EQ(N_, bottom[1]->shape(1));
+
+  vector<int> shape(3);
+  shape[0] = T_;
+  shape[1] = N_;
+  shape[2] = NumGates() * H_;
+  gates_.Reshape(shape);
+  shape[2] = H_;
+  top[0]->Reshape(shape);
+
+  // The state carried over is only meaningful for the same streams.
+  shape[0] = 1;
+  for (int i = 0; i < NumStates(); ++i) {
+    if (state_[i]->shape() != shape) {
+      state_[i]->Reshape(shape);
+      caffe_set(state_[i]->count(), Dtype(0),
+                state_[i]->mutable_cpu_data());
+    }
+    state0_[i]->Reshape(shape);
+    if (expose_hidden_) {
+      CHECK(bottom[2 + i]->shape() == shape)
+          << "bottom[" << 2 + i << "] shape must match the state shape "
+          << state_[i]->shape_string();
+      top[1 + i]->Reshape(shape);
+    }
+  }
+  h_conted_.Reshape(shape);
+
+  vector<int> multiplier_shape(1, T_ * N_);
+  if (bias_multiplier_.shape() != multiplier_shape) {
+    bias_multiplier_.Reshape(multiplier_shape);
+    caffe_set(bias_multiplier_.count(), Dtype(1),
+              bias_multiplier_.mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+void FusedRecurrentLayer<Dtype>::Reset() {
+  for (int i = 0; i < state_.size(); ++i) {
+    caffe_set(state_[i]->count(), Dtype(0), state_[i]->mutable_cpu_data());
+  }
+}
+
+template <typename Dtype>
+const Dtype* FusedRecurrentLayer<Dtype>::ContinuedHidden(const Dtype* cont,
+      const Dtype* h_prev) {
+  bool all_continue = true;
+  for (int n = 0; n < N_ && all_continue; ++n) {
+    all_continue = cont[n] == Dtype(1);
+  }
+  if (all_continue) {
+    return h_prev;
+  }
+  Dtype* h_conted = h_conted_.mutable_cpu_data();
+  for (int n = 0; n < N_; ++n) {
+    caffe_cpu_scale(H_, cont[n], h_prev + n * H_, h_conted + n * H_);
+  }
+  return h_conted;
+}
+
+template <typename Dtype>
+void FusedRecurrentLayer<Dtype>::ContinueRows(const Dtype* cont,
+      Dtype* data) const {
+  for (int n = 0; n < N_; ++n) {
+    if (cont[n] != Dtype(1)) {
+      caffe_scal(H_, cont[n], data + n * H_);
+    }
+  }
+}
+
+template <typename Dtype>
+void FusedRecurrentLayer<Dtype>::Forward_cpu(
+      const vector<Blob<Dtype>*>& bottom, const vector<Blob<Dtype>*>& top) {
+  const int gate_dim = NumGates() * H_;
+  // The input projection of every timestep at once, plus the bias.
+  Dtype* gates = gates_.mutable_cpu_data();
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, T_ * N_, gate_dim, I_,
+      Dtype(1), bottom[0]->cpu_data(), this->blobs_[0]->cpu_data(),
+      Dtype(0), gates);
+  caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T_ * N_, gate_dim, 1,
+      Dtype(1), bias_multiplier_.cpu_data(), this->blobs_[1]->cpu_data(),
+      Dtype(1), gates);
+
+  for (int i = 0; i < NumStates(); ++i) {
+    if (expose_hidden_) {
+      caffe_copy(state_[i]->count(), bottom[2 + i]->cpu_data(),
+                 state_[i]->mutable_cpu_data());
+    }
+    if (this->phase_ == TRAIN) {
+      caffe_copy(state_[i]->count(), state_[i]->cpu_data(),
+                 state0_[i]->mutable_cpu_data());
+    }
+  }
+
+  ForwardSteps(bottom[1]->cpu_data(), top[0]->mutable_cpu_data());
+
+  if (expose_hidden_) {
+    for (int i = 0; i < NumStates(); ++i) {
+      caffe_copy(state_[i]->count(), state_[i]->cpu_data(),
+                 top[1 + i]->mutable_cpu_data());
+    }
+  }
+}
+
+template <typename Dtype>
+void FusedRecurrentLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
+      const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
+  CHECK(!propagate_down[1]) << "Cannot backpropagate to sequence indicators.";
+  CHECK_EQ(this->phase_, TRAIN)
+      << this->type() << " keeps the timesteps for Backward only in TRAIN.";
+  for (int i = 0; i < NumStates(); ++i) {
+    if (expose_hidden_) {
+      caffe_copy(state_[i]->count(), top[1 + i]->cpu_diff(),
+                 state_[i]->mutable_cpu_diff());
+    } else {
+      caffe_set(state_[i]->count(), Dtype(0), state_[i]->mutable_cpu_diff());
+    }
+  }
+
+  BackwardSteps(bottom[1]->cpu_data(), top[0]->cpu_data(),
+                top[0]->cpu_diff());
+
+  const int gate_dim = NumGates() * H_;
+  const Dtype* gates_diff = gates_.cpu_diff();
+  if (this->param_propagate_down_[0]) {
+    caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, gate_dim, I_, T_ * N_,
+        Dtype(1), gates_diff, bottom[0]->cpu_data(),
+        Dtype(1), this->blobs_[0]->mutable_cpu_diff());
+  }
+  if (this->param_propagate_down_[1]) {
+    caffe_cpu_gemv<Dtype>(CblasTrans, T_ * N_, gate_dim, Dtype(1),
+        gates_diff, bias_multiplier_.cpu_data(),
+        Dtype(1), this->blobs_[1]->mutable_cpu_diff());
+  }
+  if (propagate_down[0]) {
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, T_ * N_, I_, gate_dim,
+        Dtype(1), gates_diff, this->blobs_[0]->cpu_data(),
+        Dtype(0), bottom[0]->mutable_cpu_diff());
+  }
+  if (expose_hidden_) {
+    for (int i = 0; i < NumStates(); ++i) {
+      if (propagate_down[2 + i]) {
+        caffe_copy(state_[i]->count(), state_[i]->cpu_diff(),
+                   bottom[2 + i]->mutable_cpu_diff());
+      }
+    }
+  }
+}
+
+INSTANTIATE_CLASS(FusedRecurrentLayer);
+
+}  // namespace caffe
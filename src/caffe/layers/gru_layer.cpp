@@ -0,0 +1,176 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/gru_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Roughly the number of gate elements one parallel task should cover.
+const int kGRUGrainOps = 16384;
+
+// Activates the gates of one stream in place, given its hidden projection
+// hh, and computes its hidden state from h_prev (already continued).
+template <typename Dtype>
+void GRUCell(const int H, const Dtype* hh, const Dtype* h_prev,
+             Dtype* gates, Dtype* h) {
+  for (int d = 0; d < 2 * H; ++d) {
+    gates[d] += hh[d];
+  }
+  caffe_sigmoid<Dtype>(2 * H, gates, gates);
+  const Dtype* r = gates;
+  const Dtype* z = gates + H;
+  Dtype* n = gates + 2 * H;
+  for (int d = 0; d < H; ++d) {
+    n[d] += r[d] * hh[2 * H + d];
+  }
+  caffe_tanh<Dtype>(H, n, n);
+  for (int d = 0; d < H; ++d) {
+    h[d] = n[d] + z[d] * (h_prev[d] - n[d]);
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void GRULayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  FusedRecurrentLayer<Dtype>::Reshape(bottom, top);
+  vector<int> shape(2);
+  shape[0] = this->N_;
+  shape[1] = 3 * this->H_;
+  hidden_gates_.Reshape(shape);
+  if (this->phase_ == TRAIN) {
+    hidden_n_.ReshapeLike(*top[0]);
+  }
+}
+
+template <typename Dtype>
+void GRULayer<Dtype>::ForwardSteps(const Dtype* cont, Dtype* top_data) {
+  const int N = this->N_;
+  const int H = this->H_;
+  const int step = N * H;
+  const bool train = this->phase_ == TRAIN;
+  const Dtype* W_h = this->blobs_[2]->cpu_data();
+  Dtype* gates = this->gates_.mutable_cpu_data();
+  Dtype* hh = hidden_gates_.mutable_cpu_data();
+  const int64_t grain = std::max(1, kGRUGrainOps / (3 * H));
+  for (int t = 0; t < this->T_; ++t) {
+    const Dtype* h_prev = this->ContinuedHidden(cont + t * N,
+        t == 0 ? this->state_[0]->cpu_data() : top_data + (t - 1) * step);
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, 3 * H, H, Dtype(1),
+        h_prev, W_h, Dtype(0), hh);
+    Dtype* gates_t = gates + t * 3 * step;
+    Dtype* h = top_data + t * step;
+    parallel_for(0, N, grain, [&](int64_t begin, int64_t end) {
+      for (int64_t n = begin; n < end; ++n) {
+        GRUCell(H, hh + n * 3 * H, h_prev + n * H, gates_t + n * 3 * H,
+                h + n * H);
+      }
+    });
+    if (train) {
+      Dtype* hidden_n = hidden_n_.mutable_cpu_data() + t * step;
+      for (int n = 0; n < N; ++n) {
+        caffe_copy(H, hh + n * 3 * H + 2 * H, hidden_n + n * H);
+      }
+    }
+  }
+  caffe_copy(step, top_data + (this->T_ - 1) * step,
+             this->state_[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void GRULayer<Dtype>::BackwardSteps(const Dtype* cont,
+      const Dtype* top_data, const Dtype* top_diff) {
+  const int N = this->N_;
+  const int H = this->H_;
+  const int step = N * H;
+  const Dtype* W_h = this->blobs_[2]->cpu_data();
+  Dtype* W_h_diff = this->blobs_[2]->mutable_cpu_diff();
+  const Dtype* gates = this->gates_.cpu_data();
+  Dtype* gates_diff = this->gates_.mutable_cpu_diff();
+  Dtype* dhh = hidden_gates_.mutable_cpu_diff();
+  Dtype* dh_next = this->state_[0]->mutable_cpu_diff();
+  const int64_t grain = std::max(1, kGRUGrainOps / (3 * H));
+  for (int t = this->T_ - 1; t >= 0; --t) {
+    const Dtype* cont_t = cont + t * N;
+    const Dtype* h_prev = this->ContinuedHidden(cont_t,
+        t == 0 ? this->state0_[0]->cpu_data() : top_data + (t - 1) * step);
+    const Dtype* gates_t = gates + t * 3 * step;
+    const Dtype* hidden_n = hidden_n_.cpu_data() + t * step;
+    Dtype* dgates_t = gates_diff + t * 3 * step;
+    parallel_for(0, N, grain, [&](int64_t begin, int64_t end) {
+      for (int64_t n = begin; n < end; ++n) {
+        const Dtype* r = gates_t + n * 3 * H;
+        const Dtype* z = r + H;
+        const Dtype* nn = r + 2 * H;
+        const Dtype* hn = hidden_n + n * H;
+        const Dtype* hp = h_prev + n * H;
+        const Dtype* dh_top = top_diff + t * step + n * H;
+        Dtype* dr = dgates_t + n * 3 * H;
+        Dtype* dz = dr + H;
+        Dtype* dn = dr + 2 * H;
+        Dtype* dhh_n = dhh + n * 3 * H;
+        // On exit the direct gradient of h'_{t-1}, through z.
+        Dtype* dh = dh_next + n * H;
+        for (int d = 0; d < H; ++d) {
+          const Dtype dh_d = dh_top[d] + dh[d];
+          const Dtype dn_d = dh_d * (1 - z[d]) * (1 - nn[d] * nn[d]);
+          dr[d] = dn_d * hn[d] * r[d] * (1 - r[d]);
+          dz[d] = dh_d * (hp[d] - nn[d]) * z[d] * (1 - z[d]);
+          dn[d] = dn_d;
+          dh[d] = dh_d * z[d];
+        }
+        caffe_copy(2 * H, dr, dhh_n);
+        for (int d = 0; d < H; ++d) {
+          dhh_n[2 * H + d] = dn[d] * r[d];
+        }
+      }
+    });
+    if (this->param_propagate_down_[2]) {
+      caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, 3 * H, H, N, Dtype(1),
+          dhh, h_prev, Dtype(1), W_h_diff);
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, H, 3 * H, Dtype(1),
+        dhh, W_h, Dtype(1), dh_next);
+    this->ContinueRows(cont_t, dh_next);
+  }
+}
+
+INSTANTIATE_CLASS(GRULayer);
+REGISTER_LAYER_CLASS(GRU);
+
+}  // namespace caffe
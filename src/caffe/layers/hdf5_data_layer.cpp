@@ -28,14 +28,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #ifdef USE_HDF5
-/*
-TODO:
-- load file in a separate thread ("prefetch")
-- can be smarter about the memcpy call instead of doing it row-by-row
-  :: use util functions caffe_copy, and Blob->offset()
-  :: don't forget to update hdf5_daa_layer.cu accordingly
-- add ability to shuffle filenames if flag is set
-*/
+#include <boost/thread.hpp>
+#include <algorithm>
 #include <fstream>  // NOLINT(readability/streams)
 #include <memory>  // NOLINT
 #include <string>
@@ -47,56 +41,104 @@ TODO:
 
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/util/hdf5.hpp"
+#include "caffe/util/rng.hpp"
 
 namespace caffe {
 
 template <typename Dtype>
-HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {}
+HDF5DataLayer<Dtype>::~HDF5DataLayer<Dtype>() {
+  this->StopInternalThread();
+}
 
-// Load data and label from HDF5 filename into the class property blobs.
+template <typename Dtype>
+void HDF5DataLayer<Dtype>::InternalThreadEntry() {
+  try {
+    while (!must_stop()) {
+      if (this->layer_param_.hdf5_data_param().shuffle()) {
+        shuffle(file_permutation_.begin(), file_permutation_.end());
+      }
+      for (int i = 0; i < num_files_ && !must_stop(); ++i) {
+        LoadHDF5FileData(hdf_filenames_[file_permutation_[i]].c_str());
+      }
+      DLOG(INFO) << "Looping around to first file.";
+    }
+  } catch (boost::thread_interrupted&) {
+    // Interrupted exception is expected on shutdown
+  }
+}
+
+// Read the rows of every top dataset of an HDF5 file, chunk by chunk, into
+// free chunks and hand them over to Forward.
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::LoadHDF5FileData(const char* filename) {
   DLOG(INFO) << "Loading HDF5 file: " << filename;
-  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  // The HDF5 lock is taken per call rather than for the whole file, so it
+  // is never held while waiting for a free chunk.
+  hid_t file_id;
+  {
+    boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+    file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  }
   if (file_id < 0) {
     LOG(FATAL) << "Failed opening HDF5 file: " << filename;
   }
 
-  int top_size = this->layer_param_.top_size();
-  hdf_blobs_.resize(top_size);
-
+  const int top_size = this->layer_param_.top_size();
   const int MIN_DATA_DIM = 1;
   const int MAX_DATA_DIM = INT_MAX;
 
-  for (int i = 0; i < top_size; ++i) {
-    hdf_blobs_[i] = shared_ptr<Blob<Dtype> >(new Blob<Dtype>());
-    // Allow reshape here, as we are loading data not params
-    hdf5_load_nd_dataset(file_id, this->layer_param_.top(i).c_str(),
-                         MIN_DATA_DIM, MAX_DATA_DIM, hdf_blobs_[i].get(), true);
-  }
-
-  herr_t status = H5Fclose(file_id);
-  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
-
   // MinTopBlobs==1 guarantees at least one top blob
-  CHECK_GE(hdf_blobs_[0]->num_axes(), 1) << "Input must have at least 1 axis.";
-  const int num = hdf_blobs_[0]->shape(0);
+  const hsize_t num = hdf5_get_nd_dataset_dims(file_id,
+      this->layer_param_.top(0).c_str(), MIN_DATA_DIM, MAX_DATA_DIM)[0];
+  CHECK_GT(num, 0) << "No rows in HDF5 file: " << filename;
   for (int i = 1; i < top_size; ++i) {
-    CHECK_EQ(hdf_blobs_[i]->shape(0), num);
+    CHECK_EQ(hdf5_get_nd_dataset_dims(file_id,
+        this->layer_param_.top(i).c_str(), MIN_DATA_DIM, MAX_DATA_DIM)[0],
+        num);
   }
-  // Default to identity permutation.
-  data_permutation_.clear();
-  data_permutation_.resize(hdf_blobs_[0]->shape(0));
-  for (int i = 0; i < hdf_blobs_[0]->shape(0); i++) data_permutation_[i] = i;
-
-  // Shuffle if needed.
-  if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0)
-               << " rows (shuffled)";
-  } else {
-    DLOG(INFO) << "Successfully loaded " << hdf_blobs_[0]->shape(0) << " rows";
+
+  const HDF5DataParameter& param = this->layer_param_.hdf5_data_param();
+  const hsize_t chunk_size = param.chunk_size() > 0 ? param.chunk_size() : num;
+  vector<hsize_t> chunk_starts;
+  for (hsize_t start = 0; start < num; start += chunk_size) {
+    chunk_starts.push_back(start);
   }
+  if (param.shuffle()) {
+    shuffle(chunk_starts.begin(), chunk_starts.end());
+  }
+
+  try {
+    for (int c = 0; c < chunk_starts.size(); ++c) {
+      HDF5Chunk<Dtype>* chunk = chunk_free_.pop();
+      const int rows = std::min(chunk_size, num - chunk_starts[c]);
+      for (int i = 0; i < top_size; ++i) {
+        // Allow reshape here, as we are loading data not params
+        hdf5_load_nd_dataset_rows(file_id, this->layer_param_.top(i).c_str(),
+            MIN_DATA_DIM, MAX_DATA_DIM, chunk_starts[c], rows,
+            chunk->blobs_[i].get());
+      }
+      // Default to identity permutation.
+      chunk->permutation_.resize(rows);
+      for (int i = 0; i < rows; ++i) {
+        chunk->permutation_[i] = i;
+      }
+      // Shuffle if needed.
+      if (param.shuffle()) {
+        shuffle(chunk->permutation_.begin(), chunk->permutation_.end());
+      }
+      chunk_full_.push(chunk);
+    }
+  } catch (boost::thread_interrupted&) {
+    boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+    H5Fclose(file_id);
+    throw;
+  }
+
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+  herr_t status = H5Fclose(file_id);
+  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+  DLOG(INFO) << "Successfully loaded " << num << " rows in "
+             << chunk_starts.size() << " chunks";
 }
 
 template <typename Dtype>
@@ -105,6 +147,8 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // Refuse transformation parameters since HDF5 is totally generic.
   CHECK(!this->layer_param_.has_transform_param())
       << this->type() << " does not transform data.";
+  // A repeated SetUp starts reading over.
+  this->StopInternalThread();
   // Read the source to parse the filenames.
   const string& source = this->layer_param_.hdf5_data_param().source();
   LOG(INFO) << "Loading list of HDF5 filenames from: " << source;
@@ -120,39 +164,56 @@ void HDF5DataLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   }
   source_file.close();
   num_files_ = hdf_filenames_.size();
-  current_file_ = 0;
   LOG(INFO) << "Number of HDF5 files: " << num_files_;
   CHECK_GE(num_files_, 1) << "Must have at least 1 HDF5 filename listed in "
                           << source;
 
   file_permutation_.clear();
   file_permutation_.resize(num_files_);
-  // Default to identity permutation.
+  // Default to identity permutation; the prefetch thread shuffles it.
   for (int i = 0; i < num_files_; i++) {
     file_permutation_[i] = i;
   }
 
-  // Shuffle if needed.
-  if (this->layer_param_.hdf5_data_param().shuffle()) {
-    std::random_shuffle(file_permutation_.begin(), file_permutation_.end());
+  // Reshape blobs from the dataset dimensions of the first file.
+  const char* filename = hdf_filenames_[0].c_str();
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+  hid_t file_id = H5Fopen(filename, H5F_ACC_RDONLY, H5P_DEFAULT);
+  if (file_id < 0) {
+    LOG(FATAL) << "Failed opening HDF5 file: " << filename;
   }
-
-  // Load the first HDF5 file and initialize the line counter.
-  LoadHDF5FileData(hdf_filenames_[file_permutation_[current_file_]].c_str());
-  current_row_ = 0;
-
-  // Reshape blobs.
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
   const int top_size = this->layer_param_.top_size();
-  vector<int> top_shape;
   for (int i = 0; i < top_size; ++i) {
-    top_shape.resize(hdf_blobs_[i]->num_axes());
+    vector<hsize_t> dims = hdf5_get_nd_dataset_dims(file_id,
+        this->layer_param_.top(i).c_str(), 1, INT_MAX);
+    vector<int> top_shape(dims.begin(), dims.end());
     top_shape[0] = batch_size;
-    for (int j = 1; j < top_shape.size(); ++j) {
-      top_shape[j] = hdf_blobs_[i]->shape(j);
-    }
     top[i]->Reshape(top_shape);
   }
+  herr_t status = H5Fclose(file_id);
+  CHECK_GE(status, 0) << "Failed to close HDF5 file: " << filename;
+  lock.unlock();
+
+  // Set up the chunk buffers; at least two, so reading overlaps output.
+  const int num_chunks =
+      std::max(2u, this->layer_param_.hdf5_data_param().prefetch());
+  HDF5Chunk<Dtype>* chunk;
+  while (chunk_full_.try_pop(&chunk)) {}
+  while (chunk_free_.try_pop(&chunk)) {}
+  chunks_.resize(num_chunks);
+  for (int c = 0; c < num_chunks; ++c) {
+    chunks_[c].reset(new HDF5Chunk<Dtype>());
+    chunks_[c]->blobs_.resize(top_size);
+    for (int i = 0; i < top_size; ++i) {
+      chunks_[c]->blobs_[i].reset(new Blob<Dtype>());
+    }
+    chunk_free_.push(chunks_[c].get());
+  }
+  current_chunk_ = NULL;
+  current_row_ = 0;
+  DLOG(INFO) << "Initializing prefetch";
+  this->StartInternalThread();
 }
 
 template <typename Dtype>
@@ -167,23 +228,10 @@ bool HDF5DataLayer<Dtype>::Skip() {
 
 template <typename Dtype>
 void HDF5DataLayer<Dtype>::Next() {
-  if (++current_row_ == hdf_blobs_[0]->shape(0)) {
-    if (num_files_ > 1) {
-      ++current_file_;
-      if (current_file_ == num_files_) {
-        current_file_ = 0;
-        if (this->layer_param_.hdf5_data_param().shuffle()) {
-          std::random_shuffle(file_permutation_.begin(),
-                              file_permutation_.end());
-        }
-        DLOG(INFO) << "Looping around to first file.";
-      }
-      LoadHDF5FileData(
-          hdf_filenames_[file_permutation_[current_file_]].c_str());
-    }
+  if (++current_row_ == current_chunk_->permutation_.size()) {
+    chunk_free_.push(current_chunk_);
+    current_chunk_ = chunk_full_.pop("Waiting for HDF5 data");
     current_row_ = 0;
-    if (this->layer_param_.hdf5_data_param().shuffle())
-      std::random_shuffle(data_permutation_.begin(), data_permutation_.end());
   }
   offset_++;
 }
@@ -192,6 +240,10 @@ template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                        const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  if (!current_chunk_) {
+    current_chunk_ = chunk_full_.pop("Waiting for HDF5 data");
+    current_row_ = 0;
+  }
   for (int i = 0; i < batch_size; ++i) {
     while (Skip()) {
       Next();
@@ -199,8 +251,8 @@ void HDF5DataLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     for (int j = 0; j < this->layer_param_.top_size(); ++j) {
       int data_dim = top[j]->count() / top[j]->shape(0);
       caffe_copy(data_dim,
-                 &hdf_blobs_[j]
-                      ->cpu_data()[data_permutation_[current_row_] * data_dim],
+                 &current_chunk_->blobs_[j]->cpu_data()[
+                     current_chunk_->permutation_[current_row_] * data_dim],
                  &top[j]->mutable_cpu_data()[i * data_dim]);
     }
     Next();
@@ -27,11 +27,6 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
-/*
-TODO:
-- only load parts of the file, in accordance with a prototxt param "max_mem"
-*/
-
 #include <stdint.h>
 #include <vector>
 
@@ -46,6 +41,10 @@ template <typename Dtype>
 void HDF5DataLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const int batch_size = this->layer_param_.hdf5_data_param().batch_size();
+  if (!current_chunk_) {
+    current_chunk_ = chunk_full_.pop("Waiting for HDF5 data");
+    current_row_ = 0;
+  }
   for (int i = 0; i < batch_size; ++i) {
     while (Skip()) {
       Next();
@@ -53,8 +52,9 @@ void HDF5DataLayer<Dtype>::Forward_gpu(const vector<Blob<Dtype>*>& bottom,
     for (int j = 0; j < this->layer_param_.top_size(); ++j) {
       int data_dim = top[j]->count() / top[j]->shape(0);
       caffe_copy(data_dim,
-          &hdf_blobs_[j]->cpu_data()[data_permutation_[current_row_]
-            * data_dim], &top[j]->mutable_gpu_data()[i * data_dim]);
+          &current_chunk_->blobs_[j]->cpu_data()[
+            current_chunk_->permutation_[current_row_] * data_dim],
+          &top[j]->mutable_gpu_data()[i * data_dim]);
     }
     Next();
   }
@@ -27,14 +27,44 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <sstream>
 #include <vector>
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/weight_cache.hpp"
 
 namespace caffe {
 
+// Returns the weights in source packed for caffe_cpu_packed_gemm, shared
+// with the other layers reading them.
+template <typename Dtype>
+static shared_ptr<SyncedMemory> SharedPackedWeights(
+    const shared_ptr<SyncedMemory>& source, const int N, const int K,
+    const bool transpose, const BaseDataType type) {
+  std::ostringstream layout;
+  layout << "packed " << BaseDataType_Name(type) << " " << N << "x" << K
+         << (transpose ? " transposed" : "");
+  return SharedWeightCopy(source, layout.str(), [&]() {
+    const Dtype* weight = static_cast<const Dtype*>(source->cpu_data());
+    const size_t count = caffe_packed_count(N, K);
+    shared_ptr<SyncedMemory> packed;
+    if (type == DT_FLOAT32) {
+      packed.reset(new SyncedMemory(count * sizeof(Dtype)));
+      caffe_cpu_pack_weights(N, K, weight, transpose,
+          static_cast<Dtype*>(packed->mutable_cpu_data()));
+    } else {
+      packed.reset(new SyncedMemory(count * sizeof(uint16_t)));
+      caffe_cpu_pack_weights(N, K, weight, transpose, type,
+          static_cast<uint16_t*>(packed->mutable_cpu_data()));
+    }
+    return packed;
+  });
+}
+
 template <typename Dtype>
 void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -48,6 +78,13 @@ void InnerProductLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
   // length K_ vector. For example, if bottom[0]'s shape is (N, C, H, W),
   // and axis == 1, N inner products with dimension CHW are performed.
   K_ = bottom[0]->count(axis);
+  const BaseDataType weight_dtype = this->layer_param_.cpu_weight_dtype();
+  CHECK(weight_dtype == DT_FLOAT32 || weight_dtype == DT_FLOAT16 ||
+        weight_dtype == DT_BFLOAT16)
+      << "Unsupported cpu_weight_dtype: " << BaseDataType_Name(weight_dtype);
+  LOG_IF(WARNING, weight_dtype != DT_FLOAT32 && this->phase_ != TEST)
+      << this->layer_param_.name() << " keeps its weights in FLOAT32: "
+      << "cpu_weight_dtype only applies in the TEST phase.";
   // Check if we need to set up the weights
   if (this->blobs_.size() > 0) {
     LOG(INFO) << "Skipping parameter initialization";
@@ -105,8 +142,24 @@ void InnerProductLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   if (bias_term_) {
     vector<int> bias_shape(1, M_);
     bias_multiplier_.Reshape(bias_shape);
-    caffe_set(M_, Dtype(1), bias_multiplier_.mutable_cpu_data());
+    if (M_ > 0 && bias_multiplier_.cpu_data()[M_ - 1] != Dtype(1)) {
+      caffe_set(M_, Dtype(1), bias_multiplier_.mutable_cpu_data());
+    }
+  }
+}
+
+template <typename Dtype>
+bool InnerProductLayer<Dtype>::UsePackedWeights() const {
+  // Training writes the weights every iteration, so packing only pays off
+  // for inference. Past kPackedGemmMaxRows rows GEMM outruns the packed
+  // kernels, unless the weights are to be kept in 16 bits, which only the
+  // packed copy can hold.
+  if (this->phase_ != TEST || M_ == 0) {
+    return false;
   }
+  return this->layer_param_.cpu_weight_dtype() != DT_FLOAT32 ||
+      (this->layer_param_.inner_product_param().pack_weights() &&
+       M_ <= kPackedGemmMaxRows);
 }
 
 template <typename Dtype>
@@ -115,6 +168,30 @@ void InnerProductLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* weight = this->blobs_[0]->cpu_data();
+  if (UsePackedWeights()) {
+    const shared_ptr<SyncedMemory>& source = this->blobs_[0]->data();
+    const BaseDataType type = this->layer_param_.cpu_weight_dtype();
+    if (packed_source_ != source || packed_version_ != source->version()) {
+      packed_weights_ =
+          SharedPackedWeights<Dtype>(source, N_, K_, transpose_, type);
+      packed_source_ = source;
+      packed_version_ = source->version();
+    }
+    const Dtype* bias = bias_term_ ? this->blobs_[1]->cpu_data() : NULL;
+    if (type == DT_FLOAT32) {
+      caffe_cpu_packed_gemm(M_, N_, K_, bottom_data,
+          static_cast<const Dtype*>(packed_weights_->cpu_data()), bias,
+          top_data);
+    } else {
+      const uint16_t* packed =
+          static_cast<const uint16_t*>(packed_weights_->cpu_data());
+      for (int m = 0; m < M_; m += kPackedGemmMaxRows) {
+        caffe_cpu_packed_gemm(std::min(kPackedGemmMaxRows, M_ - m), N_, K_,
+            bottom_data + m * K_, type, packed, bias, top_data + m * N_);
+      }
+    }
+    return;
+  }
   caffe_cpu_gemm<Dtype>(CblasNoTrans, transpose_ ? CblasNoTrans : CblasTrans,
       M_, N_, K_, (Dtype)1.,
       bottom_data, weight, (Dtype)0., top_data);
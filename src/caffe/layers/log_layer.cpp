@@ -60,25 +60,30 @@ void LogLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 
 template <typename Dtype>
 void LogLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                  const vector<Blob<Dtype>*>& top) {
-  const int count = bottom[0]->count();
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
+    const vector<Blob<Dtype>*>& top) {
+  ForwardElementwiseChain(vector<Layer<Dtype>*>(1, this), bottom[0]->count(),
+                          bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+}
 
+template <typename Dtype>
+void LogLayer<Dtype>::ForwardElementwise_cpu(const int offset, const int count,
+    const Dtype* bottom, Dtype* top) {
   if (input_scale_ == Dtype(1) && input_shift_ == Dtype(0)) {
-    caffe_log(count, bottom_data, top_data);
+    caffe_log(count, bottom, top);
   } else {
-    caffe_copy(count, bottom_data, top_data);
+    if (bottom != top) {
+      caffe_copy(count, bottom, top);
+    }
     if (input_scale_ != Dtype(1)) {
-      caffe_scal(count, input_scale_, top_data);
+      caffe_scal(count, input_scale_, top);
     }
     if (input_shift_ != Dtype(0)) {
-      caffe_add_scalar(count, input_shift_, top_data);
+      caffe_add_scalar(count, input_shift_, top);
     }
-    caffe_log(count, top_data, top_data);
+    caffe_log(count, top, top);
   }
   if (base_scale_ != Dtype(1)) {
-    caffe_scal(count, base_scale_, top_data);
+    caffe_scal(count, base_scale_, top);
   }
 }
 
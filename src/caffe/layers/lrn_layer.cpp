@@ -27,13 +27,39 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 
 #include "caffe/layers/lrn_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// Spatial positions normalised together; the window state for a tile
+// stays in L1 while the channels are walked.
+const int kLRNTile = 256;
+// Roughly the number of elements one parallel task should cover.
+const int kLRNGrainOps = 16384;
+
+// y = x^-beta, with the default beta of 0.75 done with square roots.
+template <typename Dtype>
+void PowNegBeta(const int n, const Dtype* x, const Dtype beta, Dtype* y) {
+  if (beta == Dtype(0.75)) {
+    for (int i = 0; i < n; ++i) {
+      const Dtype root = std::sqrt(x[i]);
+      y[i] = Dtype(1) / (root * std::sqrt(root));
+    }
+  } else {
+    caffe_powx<Dtype>(n, x, -beta, y);
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void LRNLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
                                  const vector<Blob<Dtype>*>& top) {
@@ -139,46 +165,77 @@ void LRNLayer<Dtype>::CrossChannelForward_cpu(const vector<Blob<Dtype>*>& bottom
                                               const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  // start with the constant value
-  for (int i = 0; i < scale_.count(); ++i) {
-    scale_data[i] = k_;
-  }
-  Blob<Dtype> padded_square(1, channels_ + size_ - 1, height_, width_);
-  Dtype* padded_square_data = padded_square.mutable_cpu_data();
-  caffe_set(padded_square.count(), Dtype(0), padded_square_data);
-  Dtype alpha_over_size = alpha_ / size_;
-  // go through the images
-  for (int n = 0; n < num_; ++n) {
-    // compute the padded square
-    caffe_sqr(channels_ * height_ * width_,
-        bottom_data + bottom[0]->offset(n),
-        padded_square_data + padded_square.offset(0, pre_pad_));
-    // Create the first channel scale
-    for (int c = 0; c < size_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c),
-          scale_data + scale_.offset(n, 0));
+  // The scale is only kept for Backward; in the TEST phase it stays in a
+  // per-tile buffer and Backward_cpu recomputes it if it is ever called.
+  const bool store_scale = this->phase_ == TRAIN;
+  Dtype* scale_data = store_scale ? scale_.mutable_cpu_data() : NULL;
+  const int spatial_dim = height_ * width_;
+  const int tiles = (spatial_dim + kLRNTile - 1) / kLRNTile;
+  const int64_t grain = std::max(1, kLRNGrainOps /
+      std::max(1, channels_ * std::min(spatial_dim, kLRNTile)));
+  parallel_for(0, int64_t(num_) * tiles, grain,
+      [&](int64_t begin, int64_t end) {
+    vector<Dtype> buffer((size_ + 3) * kLRNTile);
+    for (int64_t t = begin; t < end; ++t) {
+      const int offset = (t / tiles) * channels_ * spatial_dim +
+          (t % tiles) * kLRNTile;
+      const int len =
+          std::min<int>(kLRNTile, spatial_dim - (t % tiles) * kLRNTile);
+      CrossChannelTile(bottom_data + offset, len,
+                       store_scale ? scale_data + offset : NULL,
+                       top_data + offset, buffer.data());
+    }
+  });
+  scale_valid_ = store_scale;
+}
+
+// Computes the scale of len consecutive positions of one image, channel
+// rows being height_ * width_ apart, sliding the window down the channels
+// with a ring of the last size_ + 1 squared rows. If top is not NULL it
+// also writes top = bottom * scale^-beta. Every row of bottom is read
+// before the matching row of top is written, so top may alias bottom.
+// buffer holds (size_ + 3) * kLRNTile values; scale may be NULL, in which
+// case the scale of each row only lives in the buffer.
+template <typename Dtype>
+void LRNLayer<Dtype>::CrossChannelTile(const Dtype* bottom, const int len,
+                                       Dtype* scale, Dtype* top,
+                                       Dtype* buffer) const {
+  const int stride = height_ * width_;
+  const int ring_size = size_ + 1;
+  Dtype* ring = buffer;
+  Dtype* accum = buffer + ring_size * kLRNTile;
+  const Dtype alpha_over_size = alpha_ / size_;
+  std::fill(accum, accum + len, Dtype(0));
+  for (int c = -pre_pad_; c < channels_; ++c) {
+    const int head = c + pre_pad_;
+    if (head < channels_) {
+      const Dtype* row = bottom + head * stride;
+      Dtype* square = ring + (head % ring_size) * kLRNTile;
+      for (int k = 0; k < len; ++k) {
+        square[k] = row[k] * row[k];
+        accum[k] += square[k];
+      }
+    }
+    const int tail = c - pre_pad_ - 1;
+    if (tail >= 0) {
+      const Dtype* square = ring + (tail % ring_size) * kLRNTile;
+      for (int k = 0; k < len; ++k) {
+        accum[k] -= square[k];
+      }
+    }
+    if (c < 0) {
+      continue;
     }
-    for (int c = 1; c < channels_; ++c) {
-      // copy previous scale
-      caffe_copy<Dtype>(height_ * width_,
-          scale_data + scale_.offset(n, c - 1),
-          scale_data + scale_.offset(n, c));
-      // add head
-      caffe_axpy<Dtype>(height_ * width_, alpha_over_size,
-          padded_square_data + padded_square.offset(0, c + size_ - 1),
-          scale_data + scale_.offset(n, c));
-      // subtract tail
-      caffe_axpy<Dtype>(height_ * width_, -alpha_over_size,
-          padded_square_data + padded_square.offset(0, c - 1),
-          scale_data + scale_.offset(n, c));
+    Dtype* scale_row = scale ? scale + c * stride : accum + kLRNTile;
+    for (int k = 0; k < len; ++k) {
+      scale_row[k] = k_ + alpha_over_size * accum[k];
+    }
+    if (top) {
+      PowNegBeta(len, scale_row, beta_, top + c * stride);
+      caffe_mul<Dtype>(len, top + c * stride, bottom + c * stride,
+                       top + c * stride);
     }
   }
-
-  // In the end, compute output
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, top_data);
-  caffe_mul<Dtype>(scale_.count(), top_data, bottom_data, top_data);
 }
 
 template <typename Dtype>
@@ -214,52 +271,74 @@ void LRNLayer<Dtype>::CrossChannelBackward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* top_diff = top[0]->cpu_diff();
   const Dtype* top_data = top[0]->cpu_data();
   const Dtype* bottom_data = bottom[0]->cpu_data();
-  const Dtype* scale_data = scale_.cpu_data();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Blob<Dtype> padded_ratio(1, channels_ + size_ - 1, height_, width_);
-  Blob<Dtype> accum_ratio(1, 1, height_, width_);
-  Dtype* padded_ratio_data = padded_ratio.mutable_cpu_data();
-  Dtype* accum_ratio_data = accum_ratio.mutable_cpu_data();
-  // We hack a little bit by using the diff() to store an additional result
-  Dtype* accum_ratio_times_bottom = accum_ratio.mutable_cpu_diff();
-  caffe_set(padded_ratio.count(), Dtype(0), padded_ratio_data);
-  Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
-
-  caffe_powx<Dtype>(scale_.count(), scale_data, -beta_, bottom_diff);
-  caffe_mul<Dtype>(scale_.count(), top_diff, bottom_diff, bottom_diff);
-
-  // go through individual data
-  int inverse_pre_pad = size_ - (size_ + 1) / 2;
-  for (int n = 0; n < num_; ++n) {
-    int block_offset = scale_.offset(n);
-    // first, compute diff_i * y_i / s_i
-    caffe_mul<Dtype>(channels_ * height_ * width_,
-        top_diff + block_offset, top_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    caffe_div<Dtype>(channels_ * height_ * width_,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad),
-        scale_data + block_offset,
-        padded_ratio_data + padded_ratio.offset(0, inverse_pre_pad));
-    // Now, compute the accumulated ratios and the bottom diff
-    caffe_set(accum_ratio.count(), Dtype(0), accum_ratio_data);
-    for (int c = 0; c < size_ - 1; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
-    }
-    for (int c = 0; c < channels_; ++c) {
-      caffe_axpy<Dtype>(height_ * width_, 1.,
-          padded_ratio_data + padded_ratio.offset(0, c + size_ - 1),
-          accum_ratio_data);
-      // compute bottom diff
-      caffe_mul<Dtype>(height_ * width_,
-          bottom_data + top[0]->offset(n, c),
-          accum_ratio_data, accum_ratio_times_bottom);
-      caffe_axpy<Dtype>(height_ * width_, -cache_ratio_value,
-          accum_ratio_times_bottom, bottom_diff + top[0]->offset(n, c));
-      caffe_axpy<Dtype>(height_ * width_, -1.,
-          padded_ratio_data + padded_ratio.offset(0, c), accum_ratio_data);
-    }
+  const int spatial_dim = height_ * width_;
+  const int tiles = (spatial_dim + kLRNTile - 1) / kLRNTile;
+  const int64_t grain = std::max(1, kLRNGrainOps /
+      std::max(1, channels_ * std::min(spatial_dim, kLRNTile)));
+  if (!scale_valid_) {
+    Dtype* scale_data = scale_.mutable_cpu_data();
+    parallel_for(0, int64_t(num_) * tiles, grain,
+        [&](int64_t begin, int64_t end) {
+      vector<Dtype> buffer((size_ + 3) * kLRNTile);
+      for (int64_t t = begin; t < end; ++t) {
+        const int offset = (t / tiles) * channels_ * spatial_dim +
+            (t % tiles) * kLRNTile;
+        const int len =
+            std::min<int>(kLRNTile, spatial_dim - (t % tiles) * kLRNTile);
+        CrossChannelTile(bottom_data + offset, len, scale_data + offset,
+                         static_cast<Dtype*>(NULL), buffer.data());
+      }
+    });
+    scale_valid_ = true;
   }
+  const Dtype* scale_data = scale_.cpu_data();
+  const Dtype cache_ratio_value = 2. * alpha_ * beta_ / size_;
+  const int ring_size = size_ + 1;
+  // bottom_diff = top_diff * scale^-beta - cache_ratio * bottom *
+  //     sum over the window of top_diff * top_data / scale, sliding the
+  //     window sum down the channels as in the forward pass.
+  parallel_for(0, int64_t(num_) * tiles, grain,
+      [&](int64_t begin, int64_t end) {
+    vector<Dtype> buffer((ring_size + 1) * kLRNTile);
+    Dtype* ring = buffer.data();
+    Dtype* accum = ring + ring_size * kLRNTile;
+    for (int64_t t = begin; t < end; ++t) {
+      const int offset = (t / tiles) * channels_ * spatial_dim +
+          (t % tiles) * kLRNTile;
+      const int len =
+          std::min<int>(kLRNTile, spatial_dim - (t % tiles) * kLRNTile);
+      std::fill(accum, accum + len, Dtype(0));
+      for (int c = -pre_pad_; c < channels_; ++c) {
+        const int head = c + pre_pad_;
+        if (head < channels_) {
+          const int row = offset + head * spatial_dim;
+          Dtype* ratio = ring + (head % ring_size) * kLRNTile;
+          for (int k = 0; k < len; ++k) {
+            ratio[k] = top_diff[row + k] * top_data[row + k] /
+                scale_data[row + k];
+            accum[k] += ratio[k];
+          }
+        }
+        const int tail = c - pre_pad_ - 1;
+        if (tail >= 0) {
+          const Dtype* ratio = ring + (tail % ring_size) * kLRNTile;
+          for (int k = 0; k < len; ++k) {
+            accum[k] -= ratio[k];
+          }
+        }
+        if (c < 0) {
+          continue;
+        }
+        const int row = offset + c * spatial_dim;
+        PowNegBeta(len, scale_data + row, beta_, bottom_diff + row);
+        for (int k = 0; k < len; ++k) {
+          bottom_diff[row + k] = top_diff[row + k] * bottom_diff[row + k] -
+              cache_ratio_value * bottom_data[row + k] * accum[k];
+        }
+      }
+    }
+  });
 }
 
 template <typename Dtype>
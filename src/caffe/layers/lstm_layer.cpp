@@ -0,0 +1,179 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/layers/lstm_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Roughly the number of gate elements one parallel task should cover.
+const int kLSTMGrainOps = 16384;
+
+// Activates the gates of one stream in place and computes its cell and
+// hidden state; c_prev may alias c.
+template <typename Dtype>
+void LSTMCell(const int H, const Dtype cont, const Dtype* c_prev,
+              Dtype* gates, Dtype* c, Dtype* h) {
+  caffe_sigmoid<Dtype>(3 * H, gates, gates);
+  caffe_tanh<Dtype>(H, gates + 3 * H, gates + 3 * H);
+  const Dtype* i = gates;
+  const Dtype* f = gates + H;
+  const Dtype* o = gates + 2 * H;
+  const Dtype* g = gates + 3 * H;
+  for (int d = 0; d < H; ++d) {
+    c[d] = cont * f[d] * c_prev[d] + i[d] * g[d];
+  }
+  caffe_tanh<Dtype>(H, c, h);
+  for (int d = 0; d < H; ++d) {
+    h[d] *= o[d];
+  }
+}
+
+}  // namespace
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
+      const vector<Blob<Dtype>*>& top) {
+  FusedRecurrentLayer<Dtype>::Reshape(bottom, top);
+  if (this->phase_ == TRAIN) {
+    cells_.ReshapeLike(*top[0]);
+  }
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::ForwardSteps(const Dtype* cont, Dtype* top_data) {
+  const int N = this->N_;
+  const int H = this->H_;
+  const int step = N * H;
+  const bool train = this->phase_ == TRAIN;
+  const Dtype* W_h = this->blobs_[2]->cpu_data();
+  Dtype* gates = this->gates_.mutable_cpu_data();
+  // Without Backward only the latest cell state is kept, updated in place.
+  Dtype* c_state = this->state_[1]->mutable_cpu_data();
+  Dtype* cells = train ? cells_.mutable_cpu_data() : NULL;
+  const int64_t grain = std::max(1, kLSTMGrainOps / (4 * H));
+  for (int t = 0; t < this->T_; ++t) {
+    const Dtype* cont_t = cont + t * N;
+    const Dtype* h_prev = t == 0 ? this->state_[0]->cpu_data() :
+                          top_data + (t - 1) * step;
+    const Dtype* c_prev = (t == 0 || !train) ? c_state :
+                          cells + (t - 1) * step;
+    Dtype* c = train ? cells + t * step : c_state;
+    Dtype* h = top_data + t * step;
+    Dtype* gates_t = gates + t * 4 * step;
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasTrans, N, 4 * H, H, Dtype(1),
+        this->ContinuedHidden(cont_t, h_prev), W_h, Dtype(1), gates_t);
+    parallel_for(0, N, grain, [&](int64_t begin, int64_t end) {
+      for (int64_t n = begin; n < end; ++n) {
+        LSTMCell(H, cont_t[n], c_prev + n * H, gates_t + n * 4 * H,
+                 c + n * H, h + n * H);
+      }
+    });
+  }
+  caffe_copy(step, top_data + (this->T_ - 1) * step,
+             this->state_[0]->mutable_cpu_data());
+  if (train) {
+    caffe_copy(step, cells + (this->T_ - 1) * step, c_state);
+  }
+}
+
+template <typename Dtype>
+void LSTMLayer<Dtype>::BackwardSteps(const Dtype* cont,
+      const Dtype* top_data, const Dtype* top_diff) {
+  const int N = this->N_;
+  const int H = this->H_;
+  const int step = N * H;
+  const Dtype* W_h = this->blobs_[2]->cpu_data();
+  Dtype* W_h_diff = this->blobs_[2]->mutable_cpu_diff();
+  const Dtype* gates = this->gates_.cpu_data();
+  Dtype* gates_diff = this->gates_.mutable_cpu_diff();
+  const Dtype* cells = cells_.cpu_data();
+  // Scratch for tanh(c_t).
+  Dtype* tanh_cells = cells_.mutable_cpu_diff();
+  Dtype* dh_next = this->state_[0]->mutable_cpu_diff();
+  Dtype* dc_next = this->state_[1]->mutable_cpu_diff();
+  const int64_t grain = std::max(1, kLSTMGrainOps / (4 * H));
+  for (int t = this->T_ - 1; t >= 0; --t) {
+    const Dtype* cont_t = cont + t * N;
+    const Dtype* h_prev = t == 0 ? this->state0_[0]->cpu_data() :
+                          top_data + (t - 1) * step;
+    const Dtype* c_prev = t == 0 ? this->state0_[1]->cpu_data() :
+                          cells + (t - 1) * step;
+    const Dtype* gates_t = gates + t * 4 * step;
+    Dtype* dgates_t = gates_diff + t * 4 * step;
+    parallel_for(0, N, grain, [&](int64_t begin, int64_t end) {
+      for (int64_t n = begin; n < end; ++n) {
+        const Dtype* i = gates_t + n * 4 * H;
+        const Dtype* f = i + H;
+        const Dtype* o = i + 2 * H;
+        const Dtype* g = i + 3 * H;
+        Dtype* di = dgates_t + n * 4 * H;
+        Dtype* df = di + H;
+        Dtype* d_o = di + 2 * H;
+        Dtype* dg = di + 3 * H;
+        const Dtype* dh_top = top_diff + t * step + n * H;
+        const Dtype* c_prev_n = c_prev + n * H;
+        Dtype* tanh_c = tanh_cells + t * step + n * H;
+        Dtype* dh = dh_next + n * H;
+        Dtype* dc = dc_next + n * H;
+        caffe_tanh<Dtype>(H, cells + t * step + n * H, tanh_c);
+        for (int d = 0; d < H; ++d) {
+          const Dtype dh_d = dh_top[d] + dh[d];
+          const Dtype dc_d = dh_d * o[d] * (1 - tanh_c[d] * tanh_c[d]) +
+                             dc[d];
+          d_o[d] = dh_d * tanh_c[d] * o[d] * (1 - o[d]);
+          di[d] = dc_d * g[d] * i[d] * (1 - i[d]);
+          df[d] = dc_d * cont_t[n] * c_prev_n[d] * f[d] * (1 - f[d]);
+          dg[d] = dc_d * i[d] * (1 - g[d] * g[d]);
+          dc[d] = dc_d * cont_t[n] * f[d];
+        }
+      }
+    });
+    if (this->param_propagate_down_[2]) {
+      caffe_cpu_gemm<Dtype>(CblasTrans, CblasNoTrans, 4 * H, H, N, Dtype(1),
+          dgates_t, this->ContinuedHidden(cont_t, h_prev), Dtype(1),
+          W_h_diff);
+    }
+    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, N, H, 4 * H, Dtype(1),
+        dgates_t, W_h, Dtype(0), dh_next);
+    this->ContinueRows(cont_t, dh_next);
+  }
+}
+
+INSTANTIATE_CLASS(LSTMLayer);
+REGISTER_LAYER_CLASS(LSTM);
+
+}  // namespace caffe
@@ -27,14 +27,56 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <cmath>
 #include <memory>
 #include <vector>
 
 #include "caffe/filler.hpp"
 #include "caffe/layers/normalize_layer.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// Elements per parallel task in the flat (across_spatial) passes.
+const int kNormalizeBlock = 16384;
+const int kNormalizeMaxTile = 256;
+
+// Spatial positions per tile, so that the channel rows of a tile (about
+// kNormalizeBlock values) stay in L2 between the two passes over them.
+int NormalizeTile(const int channels, const int spatial_dim) {
+  const int tile = std::max(16, kNormalizeBlock / channels);
+  return std::min(std::min(tile, kNormalizeMaxTile), spatial_dim);
+}
+
+// out[n] = dot(a + n * dim, b + n * dim) for n < num, summing blocks of
+// each row in parallel.
+template <typename Dtype>
+void BlockedDots(const int num, const int dim, const Dtype* a,
+                 const Dtype* b, Dtype* out) {
+  const int blocks = (dim + kNormalizeBlock - 1) / kNormalizeBlock;
+  vector<Dtype> partial(num * blocks);
+  parallel_for(0, int64_t(num) * blocks, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t i = begin; i < end; ++i) {
+      const int start = (i % blocks) * kNormalizeBlock;
+      const int offset = (i / blocks) * dim + start;
+      partial[i] = caffe_cpu_dot<Dtype>(
+          std::min(kNormalizeBlock, dim - start), a + offset, b + offset);
+    }
+  });
+  for (int n = 0; n < num; ++n) {
+    out[n] = 0;
+    for (int i = 0; i < blocks; ++i) {
+      out[n] += partial[n * blocks + i];
+    }
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void NormalizeLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -121,55 +163,70 @@ void NormalizeLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
   const Dtype* scale = this->blobs_[0]->cpu_data();
-  Dtype* buffer_data = buffer_.mutable_cpu_data();
   Dtype* norm_data = norm_.mutable_cpu_data();
-  // add eps to avoid overflow
-  caffe_set<Dtype>(norm_.count(), Dtype(eps_), norm_data);
-  const Dtype* sum_channel_multiplier = sum_channel_multiplier_.cpu_data();
-  const Dtype* sum_spatial_multiplier = sum_spatial_multiplier_.cpu_data();
-  int num = bottom[0]->num();
-  int dim = bottom[0]->count() / num;
-  int spatial_dim = bottom[0]->height() * bottom[0]->width();
-  int channels = bottom[0]->channels();
-  for (int n = 0; n < num; ++n) {
-    caffe_sqr<Dtype>(dim, bottom_data, buffer_data);
-    if (across_spatial_) {
-      // add eps to avoid overflow
-      norm_data[n] = pow(caffe_cpu_asum<Dtype>(dim, buffer_data)+eps_,
-                         Dtype(0.5));
-      caffe_cpu_scale<Dtype>(dim, Dtype(1.0 / norm_data[n]), bottom_data,
-                             top_data);
-    } else {
-      caffe_cpu_gemv<Dtype>(CblasTrans, channels, spatial_dim, Dtype(1),
-                            buffer_data, sum_channel_multiplier, Dtype(1),
-                            norm_data);
-      // compute norm
-      caffe_powx<Dtype>(spatial_dim, norm_data, Dtype(0.5), norm_data);
-      // LOG(INFO) << "after sqrt " << norm_data[0];
-      // scale the layer
-      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, spatial_dim,
-                            1, Dtype(1), sum_channel_multiplier, norm_data,
-                            Dtype(0), buffer_data);
-      // LOG(INFO) << "after gemm1 " << buffer_data[0];
-      caffe_div<Dtype>(dim, bottom_data, buffer_data, top_data);
-      // LOG(INFO) << "after div " << top_data[0];
-      norm_data += spatial_dim;
-    }
-    // scale the output
-    if (channel_shared_) {
-      caffe_scal<Dtype>(dim, scale[0], top_data);
-    } else {
-      caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, spatial_dim,
-                            1, Dtype(1), scale, sum_spatial_multiplier,
-                            Dtype(0),
-                            buffer_data);
-      // LOG(INFO) << "after gemm2 " << buffer_data[0];
-      caffe_mul<Dtype>(dim, top_data, buffer_data, top_data);
-      // LOG(INFO) << "after mul " << top_data[0];
+  const int num = bottom[0]->num();
+  const int dim = bottom[0]->count() / num;
+  const int spatial_dim = bottom[0]->height() * bottom[0]->width();
+  const int channels = bottom[0]->channels();
+  if (across_spatial_) {
+    // add eps to avoid overflow
+    BlockedDots(num, dim, bottom_data, bottom_data, norm_data);
+    for (int n = 0; n < num; ++n) {
+      norm_data[n] = std::sqrt(norm_data[n] + eps_);
     }
-    bottom_data += dim;
-    top_data += dim;
+    const int blocks = (dim + kNormalizeBlock - 1) / kNormalizeBlock;
+    parallel_for(0, int64_t(num) * blocks, 1, [&](int64_t begin, int64_t end) {
+      for (int64_t b = begin; b < end; ++b) {
+        const int n = b / blocks;
+        const int start = (b % blocks) * kNormalizeBlock;
+        const int stop = std::min(dim, start + kNormalizeBlock);
+        const Dtype inv_norm = Dtype(1) / norm_data[n];
+        for (int i = start; i < stop; ++i) {
+          const Dtype channel_scale =
+              channel_shared_ ? scale[0] : scale[i / spatial_dim];
+          top_data[n * dim + i] =
+              bottom_data[n * dim + i] * inv_norm * channel_scale;
+        }
+      }
+    });
+    return;
   }
+  // One tile of spatial positions at a time: sum the squares down the
+  // channels, then normalise and scale the same rows while they are still
+  // in cache.
+  const int tile = NormalizeTile(channels, spatial_dim);
+  const int tiles = (spatial_dim + tile - 1) / tile;
+  parallel_for(0, int64_t(num) * tiles, 1, [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; ++t) {
+      const int n = t / tiles;
+      const int s = (t % tiles) * tile;
+      const int len = std::min(tile, spatial_dim - s);
+      const Dtype* x = bottom_data + n * dim + s;
+      Dtype* y = top_data + n * dim + s;
+      Dtype* norm = norm_data + n * spatial_dim + s;
+      // add eps to avoid overflow
+      std::fill(norm, norm + len, Dtype(eps_));
+      for (int c = 0; c < channels; ++c) {
+        const Dtype* row = x + c * spatial_dim;
+        for (int k = 0; k < len; ++k) {
+          norm[k] += row[k] * row[k];
+        }
+      }
+      Dtype inv_norm[kNormalizeMaxTile];
+      for (int k = 0; k < len; ++k) {
+        norm[k] = std::sqrt(norm[k]);
+        inv_norm[k] = Dtype(1) / norm[k];
+      }
+      for (int c = 0; c < channels; ++c) {
+        const Dtype channel_scale = channel_shared_ ? scale[0] : scale[c];
+        const Dtype* row = x + c * spatial_dim;
+        Dtype* top_row = y + c * spatial_dim;
+        for (int k = 0; k < len; ++k) {
+          top_row[k] = row[k] * inv_norm[k] * channel_scale;
+        }
+      }
+    }
+  });
 }
 
 template <typename Dtype>
@@ -181,84 +238,95 @@ void NormalizeLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   const Dtype* scale = this->blobs_[0]->cpu_data();
   const Dtype* norm_data = norm_.cpu_data();
-  Dtype* buffer_data = buffer_.mutable_cpu_data();
-  Dtype* buffer_channel = buffer_channel_.mutable_cpu_data();
-  Dtype* buffer_spatial = buffer_spatial_.mutable_cpu_data();
-  const Dtype* sum_channel_multiplier = sum_channel_multiplier_.cpu_data();
-  const Dtype* sum_spatial_multiplier = sum_spatial_multiplier_.cpu_data();
-  int count = top[0]->count();
-  int num = top[0]->num();
-  int dim = count / num;
-  int spatial_dim = top[0]->height() * top[0]->width();
-  int channels = top[0]->channels();
+  const int count = top[0]->count();
+  const int num = top[0]->num();
+  const int dim = count / num;
+  const int spatial_dim = top[0]->height() * top[0]->width();
+  const int channels = top[0]->channels();
 
   // Propagate to param
   if (this->param_propagate_down_[0]) {
     Dtype* scale_diff = this->blobs_[0]->mutable_cpu_diff();
     if (channel_shared_) {
-      scale_diff[0] +=
-          caffe_cpu_dot<Dtype>(count, top_data, top_diff) / scale[0];
+      Dtype dot;
+      BlockedDots(1, count, top_data, top_diff, &dot);
+      scale_diff[0] += dot / scale[0];
     } else {
-      for (int n = 0; n < num; ++n) {
-        caffe_mul<Dtype>(dim, top_data+n*dim, top_diff+n*dim, buffer_data);
-        caffe_cpu_gemv<Dtype>(CblasNoTrans, channels, spatial_dim, Dtype(1),
-                              buffer_data, sum_spatial_multiplier, Dtype(0),
-                              buffer_channel);
-        // store a / scale[i] in buffer_data temporary
-        caffe_div<Dtype>(channels, buffer_channel, scale, buffer_channel);
-        caffe_add<Dtype>(channels, buffer_channel, scale_diff, scale_diff);
-      }
+      parallel_for(0, channels,
+          std::max(1, kNormalizeBlock / (num * spatial_dim)),
+          [&](int64_t begin, int64_t end) {
+        for (int c = begin; c < end; ++c) {
+          Dtype dot = 0;
+          for (int n = 0; n < num; ++n) {
+            dot += caffe_cpu_dot<Dtype>(spatial_dim,
+                top_data + n * dim + c * spatial_dim,
+                top_diff + n * dim + c * spatial_dim);
+          }
+          scale_diff[c] += dot / scale[c];
+        }
+      });
     }
   }
 
-  // Propagate to bottom
+  // Propagate to bottom:
+  //   bottom_diff = scale * (top_diff - bottom * a / norm^2) / norm
+  // with a the dot product of bottom and top_diff over the normalised
+  // positions.
   if (propagate_down[0]) {
-    for (int n = 0; n < num; ++n) {
-      if (across_spatial_) {
-        Dtype a = caffe_cpu_dot<Dtype>(dim, bottom_data, top_diff);
-        caffe_cpu_scale<Dtype>(dim, a / norm_data[n] / norm_data[n],
-                               bottom_data, bottom_diff);
-        caffe_sub<Dtype>(dim, top_diff, bottom_diff, bottom_diff);
-        caffe_scal<Dtype>(dim, Dtype(1.0 / norm_data[n]), bottom_diff);
-      } else {
-        // dot product between bottom_data and top_diff
-        caffe_mul<Dtype>(dim, bottom_data, top_diff, buffer_data);
-        caffe_cpu_gemv<Dtype>(CblasTrans, channels, spatial_dim, Dtype(1),
-                              buffer_data, sum_channel_multiplier, Dtype(0),
-                              buffer_spatial);
-        // scale bottom_diff
-        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, spatial_dim,
-                              1, Dtype(1), sum_channel_multiplier,
-                              buffer_spatial, Dtype(0), buffer_data);
-        caffe_mul<Dtype>(dim, bottom_data, buffer_data, bottom_diff);
-        // divide by square of norm
-        caffe_powx<Dtype>(spatial_dim, norm_data, Dtype(2), buffer_spatial);
-        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, spatial_dim,
-                              1, Dtype(1), sum_channel_multiplier,
-                              buffer_spatial, Dtype(0), buffer_data);
-        caffe_div<Dtype>(dim, bottom_diff, buffer_data, bottom_diff);
-        // subtract
-        caffe_sub<Dtype>(dim, top_diff, bottom_diff, bottom_diff);
-        // divide by norm
-        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, spatial_dim,
-                              1, Dtype(1), sum_channel_multiplier, norm_data,
-                              Dtype(0), buffer_data);
-        caffe_div<Dtype>(dim, bottom_diff, buffer_data, bottom_diff);
-        norm_data += spatial_dim;
-      }
-      // scale the diff
-      if (channel_shared_) {
-        caffe_scal<Dtype>(dim, scale[0], bottom_diff);
-      } else {
-        caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, spatial_dim,
-                              1, Dtype(1), scale, sum_spatial_multiplier,
-                              Dtype(0), buffer_data);
-        caffe_mul<Dtype>(dim, bottom_diff, buffer_data, bottom_diff);
-      }
-      bottom_data += dim;
-      top_diff += dim;
-      bottom_diff += dim;
+    if (across_spatial_) {
+      vector<Dtype> dots(num);
+      BlockedDots(num, dim, bottom_data, top_diff, dots.data());
+      const int blocks = (dim + kNormalizeBlock - 1) / kNormalizeBlock;
+      parallel_for(0, int64_t(num) * blocks, 1,
+          [&](int64_t begin, int64_t end) {
+        for (int64_t b = begin; b < end; ++b) {
+          const int n = b / blocks;
+          const int start = (b % blocks) * kNormalizeBlock;
+          const int stop = std::min(dim, start + kNormalizeBlock);
+          const Dtype inv_norm = Dtype(1) / norm_data[n];
+          const Dtype a = dots[n] * inv_norm * inv_norm;
+          for (int i = n * dim + start; i < n * dim + stop; ++i) {
+            const Dtype channel_scale =
+                channel_shared_ ? scale[0] : scale[(i % dim) / spatial_dim];
+            bottom_diff[i] = (top_diff[i] - bottom_data[i] * a) * inv_norm *
+                channel_scale;
+          }
+        }
+      });
+      return;
     }
+    const int tile = NormalizeTile(channels, spatial_dim);
+    const int tiles = (spatial_dim + tile - 1) / tile;
+    parallel_for(0, int64_t(num) * tiles, 1, [&](int64_t begin, int64_t end) {
+      for (int64_t t = begin; t < end; ++t) {
+        const int n = t / tiles;
+        const int s = (t % tiles) * tile;
+        const int len = std::min(tile, spatial_dim - s);
+        const int offset = n * dim + s;
+        const Dtype* norm = norm_data + n * spatial_dim + s;
+        Dtype a[kNormalizeMaxTile];
+        std::fill(a, a + len, Dtype(0));
+        for (int c = 0; c < channels; ++c) {
+          const int row = offset + c * spatial_dim;
+          for (int k = 0; k < len; ++k) {
+            a[k] += bottom_data[row + k] * top_diff[row + k];
+          }
+        }
+        Dtype inv_norm[kNormalizeMaxTile];
+        for (int k = 0; k < len; ++k) {
+          inv_norm[k] = Dtype(1) / norm[k];
+          a[k] *= inv_norm[k] * inv_norm[k];
+        }
+        for (int c = 0; c < channels; ++c) {
+          const Dtype channel_scale = channel_shared_ ? scale[0] : scale[c];
+          const int row = offset + c * spatial_dim;
+          for (int k = 0; k < len; ++k) {
+            bottom_diff[row + k] = (top_diff[row + k] -
+                bottom_data[row + k] * a[k]) * inv_norm[k] * channel_scale;
+          }
+        }
+      }
+    });
   }
 }
 
@@ -27,9 +27,11 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
 #include <vector>
 
 #include "caffe/layers/permute_layer.hpp"
+#include "caffe/util/channels_last.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
@@ -89,6 +91,14 @@ void PermuteLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
     }
   }
 
+  // Moving the channels of a 4-D blob last or back is a batched transpose.
+  const int to_nhwc[] = {0, 2, 3, 1};
+  const int to_nchw[] = {0, 3, 1, 2};
+  to_nhwc_ = num_axes_ == 4 && std::equal(orders.begin(), orders.end(),
+                                          to_nhwc);
+  to_nchw_ = num_axes_ == 4 && std::equal(orders.begin(), orders.end(),
+                                          to_nchw);
+
   vector<int> top_shape(num_axes_, 1);
   permute_order_.Reshape(num_axes_, 1, 1, 1);
   old_steps_.Reshape(num_axes_, 1, 1, 1);
@@ -126,7 +136,19 @@ void PermuteLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void PermuteLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
-  if (need_permute_) {
+  if (to_nhwc_ || to_nchw_) {
+    const Blob<Dtype>& nchw = to_nhwc_ ? *bottom[0] : *top[0];
+    const int num = nchw.shape(0);
+    const int channels = nchw.shape(1);
+    const int spatial = nchw.count(2);
+    if (to_nhwc_) {
+      caffe_cpu_nchw_to_nhwc(num, channels, spatial, bottom[0]->cpu_data(),
+                             top[0]->mutable_cpu_data());
+    } else {
+      caffe_cpu_nhwc_to_nchw(num, channels, spatial, bottom[0]->cpu_data(),
+                             top[0]->mutable_cpu_data());
+    }
+  } else if (need_permute_) {
     Dtype* bottom_data = bottom[0]->mutable_cpu_data();
     Dtype* top_data = top[0]->mutable_cpu_data();
     const int top_count = top[0]->count();
@@ -145,7 +167,19 @@ void PermuteLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void PermuteLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
       const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
-  if (need_permute_) {
+  if (to_nhwc_ || to_nchw_) {
+    const Blob<Dtype>& nchw = to_nhwc_ ? *bottom[0] : *top[0];
+    const int num = nchw.shape(0);
+    const int channels = nchw.shape(1);
+    const int spatial = nchw.count(2);
+    if (to_nhwc_) {
+      caffe_cpu_nhwc_to_nchw(num, channels, spatial, top[0]->cpu_diff(),
+                             bottom[0]->mutable_cpu_diff());
+    } else {
+      caffe_cpu_nchw_to_nhwc(num, channels, spatial, top[0]->cpu_diff(),
+                             bottom[0]->mutable_cpu_diff());
+    }
+  } else if (need_permute_) {
     Dtype* top_diff = top[0]->mutable_cpu_diff();
     Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
     const int top_count = top[0]->count();
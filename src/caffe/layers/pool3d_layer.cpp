@@ -36,6 +36,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/layers/pool3d_layer.hpp"
 #include "caffe/util/benchmark.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
@@ -100,10 +101,11 @@ void Pooling3DLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 template <typename Dtype>
 void Pooling3DLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
                                         const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  static const int index_array[] = {0, 1, 0, 0, 0};
-  vector<int> offset_indices(index_array, index_array + 5);
+  const Dtype* bottom_base = bottom[0]->cpu_data();
+  Dtype* top_base = top[0]->mutable_cpu_data();
+  const int num_planes = bottom[0]->shape(0) * channels_;
+  const int bottom_plane = length_ * height_ * width_;
+  const int top_plane = pooled_length_ * pooled_height_ * pooled_width_;
 
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more codes.
@@ -111,12 +113,12 @@ void Pooling3DLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   switch (this->layer_param_.pooling3d_param().pool()) {
     case Pooling3DParameter_PoolMethod_MAX:
       // Initialize
-      for (int i = 0; i < top_count; ++i) {
-        top_data[i] = Dtype(-FLT_MAX);
-      }
-      // The main loop
-      for (int n = 0; n < bottom[0]->shape(0); ++n) {
-        for (int c = 0; c < channels_; ++c) {
+      caffe_set(top_count, Dtype(-FLT_MAX), top_base);
+      // The main loop, parallel over the (n, c) planes
+      parallel_for(0, num_planes, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t p = begin; p < end; ++p) {
+          const Dtype* bottom_data = bottom_base + p * bottom_plane;
+          Dtype* top_data = top_base + p * top_plane;
           for (int pl = 0; pl < pooled_length_; ++pl) {
             for (int ph = 0; ph < pooled_height_; ++ph) {
               for (int pw = 0; pw < pooled_width_; ++pw) {
@@ -141,19 +143,16 @@ void Pooling3DLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
               }
             }
           }
-          // compute offset
-          bottom_data += bottom[0]->offset(offset_indices);
-          top_data += top[0]->offset(offset_indices);
         }
-      }
+      });
       break;
     case Pooling3DParameter_PoolMethod_AVE:
-      for (int i = 0; i < top_count; ++i) {
-        top_data[i] = 0;
-      }
-      // The main loop
-      for (int n = 0; n < bottom[0]->shape(0); ++n) {
-        for (int c = 0; c < channels_; ++c) {
+      caffe_set(top_count, Dtype(0), top_base);
+      // The main loop, parallel over the (n, c) planes
+      parallel_for(0, num_planes, 1, [&](int64_t begin, int64_t end) {
+        for (int64_t p = begin; p < end; ++p) {
+          const Dtype* bottom_data = bottom_base + p * bottom_plane;
+          Dtype* top_data = top_base + p * top_plane;
           for (int pl = 0; pl < pooled_length_; ++pl) {
             for (int ph = 0; ph < pooled_height_; ++ph) {
               for (int pw = 0; pw < pooled_width_; ++pw) {
@@ -185,11 +184,8 @@ void Pooling3DLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
               }
             }
           }
-          // compute offset
-          bottom_data += bottom[0]->offset(offset_indices);
-          top_data += top[0]->offset(offset_indices);
         }
-      }
+      });
       break;
     case Pooling3DParameter_PoolMethod_STOCHASTIC:
       NOT_IMPLEMENTED;
@@ -33,12 +33,278 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/layers/pooling_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
 using std::min;
 using std::max;
 
+// Planes of at least this many multiply-adds are worth a parallel chunk.
+const int kPoolingGrainOps = 16384;
+
+// Geometry of one (n, c) plane. Windows of the outputs in
+// [inner_ph_begin, inner_ph_end) x [inner_pw_begin, inner_pw_end) lie
+// entirely inside the image and need no clipping.
+struct PoolingShape {
+  int height, width, pooled_height, pooled_width;
+  int kernel_h, kernel_w, stride_h, stride_w, pad_h, pad_w;
+  int inner_ph_begin, inner_ph_end, inner_pw_begin, inner_pw_end;
+  // The window is the whole plane.
+  bool global;
+};
+
+static void InnerRange(int size, int pooled, int kernel, int stride, int pad,
+                       int* begin, int* end) {
+  *begin = min(pooled, (pad + stride - 1) / stride);
+  *end = size + pad < kernel ? *begin :
+      max(*begin, min(pooled, (size + pad - kernel) / stride + 1));
+}
+
+static PoolingShape MakePoolingShape(int height, int width,
+    int pooled_height, int pooled_width, int kernel_h, int kernel_w,
+    int stride_h, int stride_w, int pad_h, int pad_w) {
+  PoolingShape s = {height, width, pooled_height, pooled_width, kernel_h,
+      kernel_w, stride_h, stride_w, pad_h, pad_w, 0, 0, 0, 0, false};
+  InnerRange(height, pooled_height, kernel_h, stride_h, pad_h,
+             &s.inner_ph_begin, &s.inner_ph_end);
+  InnerRange(width, pooled_width, kernel_w, stride_w, pad_w,
+             &s.inner_pw_begin, &s.inner_pw_end);
+  s.global = pooled_height == 1 && pooled_width == 1 && pad_h == 0 &&
+      pad_w == 0 && kernel_h == height && kernel_w == width;
+  return s;
+}
+
+// Max pools one plane. KH and KW, if not 0, fix the kernel size of the
+// inner windows at compile time so their loops unroll. Ties and NaNs are
+// resolved as before: the first strictly greater value wins.
+template <typename Dtype, typename MaskT, bool kWithMask, int KH, int KW>
+static void MaxPoolPlane(const PoolingShape& s, const Dtype* bottom,
+                         Dtype* top, MaskT* mask) {
+  const int kernel_h = KH > 0 ? KH : s.kernel_h;
+  const int kernel_w = KW > 0 ? KW : s.kernel_w;
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    const bool inner_row = ph >= s.inner_ph_begin && ph < s.inner_ph_end;
+    for (int pw = 0; pw < s.pooled_width; ++pw) {
+      int hstart = ph * s.stride_h - s.pad_h;
+      int wstart = pw * s.stride_w - s.pad_w;
+      Dtype best = Dtype(-FLT_MAX);
+      int best_index = -1;
+      if (inner_row && pw >= s.inner_pw_begin && pw < s.inner_pw_end) {
+        const Dtype* window = bottom + hstart * s.width + wstart;
+        for (int h = 0; h < kernel_h; ++h) {
+          for (int w = 0; w < kernel_w; ++w) {
+            if (window[h * s.width + w] > best) {
+              best = window[h * s.width + w];
+              if (kWithMask) {
+                best_index = (hstart + h) * s.width + wstart + w;
+              }
+            }
+          }
+        }
+      } else {
+        const int hend = min(hstart + s.kernel_h, s.height);
+        const int wend = min(wstart + s.kernel_w, s.width);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            if (bottom[h * s.width + w] > best) {
+              best = bottom[h * s.width + w];
+              if (kWithMask) {
+                best_index = h * s.width + w;
+              }
+            }
+          }
+        }
+      }
+      top[ph * s.pooled_width + pw] = best;
+      if (kWithMask) {
+        mask[ph * s.pooled_width + pw] = static_cast<MaskT>(best_index);
+      }
+    }
+  }
+}
+
+template <typename Dtype, typename MaskT, bool kWithMask>
+static void MaxPoolGlobal(const PoolingShape& s, const Dtype* bottom,
+                          Dtype* top, MaskT* mask) {
+  const int count = s.height * s.width;
+  if (kWithMask) {
+    Dtype best = Dtype(-FLT_MAX);
+    int best_index = -1;
+    for (int i = 0; i < count; ++i) {
+      if (bottom[i] > best) {
+        best = bottom[i];
+        best_index = i;
+      }
+    }
+    top[0] = best;
+    mask[0] = static_cast<MaskT>(best_index);
+    return;
+  }
+  // Independent running maxima, so the loop is not one dependency chain.
+  Dtype best[4] = {Dtype(-FLT_MAX), Dtype(-FLT_MAX), Dtype(-FLT_MAX),
+                   Dtype(-FLT_MAX)};
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (int j = 0; j < 4; ++j) {
+      best[j] = bottom[i + j] > best[j] ? bottom[i + j] : best[j];
+    }
+  }
+  for (; i < count; ++i) {
+    best[0] = bottom[i] > best[0] ? bottom[i] : best[0];
+  }
+  top[0] = max(max(best[0], best[1]), max(best[2], best[3]));
+}
+
+template <typename Dtype, typename MaskT, bool kWithMask>
+static void MaxPoolPlanes(const PoolingShape& s, const Dtype* bottom,
+                          Dtype* top, MaskT* mask, int64_t begin,
+                          int64_t end) {
+  const int bottom_size = s.height * s.width;
+  const int top_size = s.pooled_height * s.pooled_width;
+  for (int64_t p = begin; p < end; ++p) {
+    const Dtype* plane_bottom = bottom + p * bottom_size;
+    Dtype* plane_top = top + p * top_size;
+    MaskT* plane_mask = kWithMask ? mask + p * top_size : NULL;
+    if (s.global) {
+      MaxPoolGlobal<Dtype, MaskT, kWithMask>(s, plane_bottom, plane_top,
+                                             plane_mask);
+    } else if (s.kernel_h == 2 && s.kernel_w == 2) {
+      MaxPoolPlane<Dtype, MaskT, kWithMask, 2, 2>(s, plane_bottom,
+                                                  plane_top, plane_mask);
+    } else if (s.kernel_h == 3 && s.kernel_w == 3) {
+      MaxPoolPlane<Dtype, MaskT, kWithMask, 3, 3>(s, plane_bottom,
+                                                  plane_top, plane_mask);
+    } else {
+      MaxPoolPlane<Dtype, MaskT, kWithMask, 0, 0>(s, plane_bottom,
+                                                  plane_top, plane_mask);
+    }
+  }
+}
+
+// Average pools one plane; the divisor counts the padding as before.
+template <typename Dtype, int KH, int KW>
+static void AvePoolPlane(const PoolingShape& s, const Dtype* bottom,
+                         Dtype* top) {
+  const int kernel_h = KH > 0 ? KH : s.kernel_h;
+  const int kernel_w = KW > 0 ? KW : s.kernel_w;
+  for (int ph = 0; ph < s.pooled_height; ++ph) {
+    const bool inner_row = ph >= s.inner_ph_begin && ph < s.inner_ph_end;
+    for (int pw = 0; pw < s.pooled_width; ++pw) {
+      int hstart = ph * s.stride_h - s.pad_h;
+      int wstart = pw * s.stride_w - s.pad_w;
+      Dtype sum = 0;
+      int pool_size;
+      if (inner_row && pw >= s.inner_pw_begin && pw < s.inner_pw_end) {
+        const Dtype* window = bottom + hstart * s.width + wstart;
+        for (int h = 0; h < kernel_h; ++h) {
+          for (int w = 0; w < kernel_w; ++w) {
+            sum += window[h * s.width + w];
+          }
+        }
+        pool_size = kernel_h * kernel_w;
+      } else {
+        int hend = min(hstart + s.kernel_h, s.height + s.pad_h);
+        int wend = min(wstart + s.kernel_w, s.width + s.pad_w);
+        pool_size = (hend - hstart) * (wend - wstart);
+        hstart = max(hstart, 0);
+        wstart = max(wstart, 0);
+        hend = min(hend, s.height);
+        wend = min(wend, s.width);
+        for (int h = hstart; h < hend; ++h) {
+          for (int w = wstart; w < wend; ++w) {
+            sum += bottom[h * s.width + w];
+          }
+        }
+      }
+      top[ph * s.pooled_width + pw] = sum / pool_size;
+    }
+  }
+}
+
+template <typename Dtype>
+static void AvePoolGlobal(const PoolingShape& s, const Dtype* bottom,
+                          Dtype* top) {
+  const int count = s.height * s.width;
+  Dtype sum[4] = {0, 0, 0, 0};
+  int i = 0;
+  for (; i + 4 <= count; i += 4) {
+    for (int j = 0; j < 4; ++j) {
+      sum[j] += bottom[i + j];
+    }
+  }
+  for (; i < count; ++i) {
+    sum[0] += bottom[i];
+  }
+  top[0] = ((sum[0] + sum[1]) + (sum[2] + sum[3])) / count;
+}
+
+template <typename Dtype>
+static void AvePoolPlanes(const PoolingShape& s, const Dtype* bottom,
+                          Dtype* top, int64_t begin, int64_t end) {
+  const int bottom_size = s.height * s.width;
+  const int top_size = s.pooled_height * s.pooled_width;
+  for (int64_t p = begin; p < end; ++p) {
+    const Dtype* plane_bottom = bottom + p * bottom_size;
+    Dtype* plane_top = top + p * top_size;
+    if (s.global) {
+      AvePoolGlobal(s, plane_bottom, plane_top);
+    } else if (s.kernel_h == 2 && s.kernel_w == 2) {
+      AvePoolPlane<Dtype, 2, 2>(s, plane_bottom, plane_top);
+    } else if (s.kernel_h == 3 && s.kernel_w == 3) {
+      AvePoolPlane<Dtype, 3, 3>(s, plane_bottom, plane_top);
+    } else {
+      AvePoolPlane<Dtype, 0, 0>(s, plane_bottom, plane_top);
+    }
+  }
+}
+
+// Pools output rows [begin, end) of channels-last images, where row r is
+// output row r % pooled_height of image r / pooled_height. Every window
+// position is read across all channels at once; the window clipping,
+// average divisor and max tie-breaking are those of the planes above.
+template <typename Dtype, bool kMax>
+static void PoolRowsChannelsLast(const PoolingShape& s, const int channels,
+                                 const Dtype* bottom, Dtype* top,
+                                 int64_t begin, int64_t end) {
+  const int64_t image_size =
+      static_cast<int64_t>(s.height) * s.width * channels;
+  for (int64_t r = begin; r < end; ++r) {
+    const Dtype* image = bottom + r / s.pooled_height * image_size;
+    const int ph = r % s.pooled_height;
+    Dtype* out = top + r * s.pooled_width * channels;
+    for (int pw = 0; pw < s.pooled_width; ++pw, out += channels) {
+      int hstart = ph * s.stride_h - s.pad_h;
+      int wstart = pw * s.stride_w - s.pad_w;
+      int hend = min(hstart + s.kernel_h, s.height + s.pad_h);
+      int wend = min(wstart + s.kernel_w, s.width + s.pad_w);
+      const int pool_size = (hend - hstart) * (wend - wstart);
+      hstart = max(hstart, 0);
+      wstart = max(wstart, 0);
+      hend = min(hend, s.height);
+      wend = min(wend, s.width);
+      caffe_set(channels, kMax ? Dtype(-FLT_MAX) : Dtype(0), out);
+      for (int h = hstart; h < hend; ++h) {
+        for (int w = wstart; w < wend; ++w) {
+          const Dtype* in = image + (h * s.width + w) * channels;
+          for (int c = 0; c < channels; ++c) {
+            if (kMax) {
+              out[c] = in[c] > out[c] ? in[c] : out[c];
+            } else {
+              out[c] += in[c];
+            }
+          }
+        }
+      }
+      for (int c = 0; !kMax && c < channels; ++c) {
+        out[c] /= pool_size;
+      }
+    }
+  }
+}
+
 template <typename Dtype>
 void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -65,9 +331,15 @@ void PoolingLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
       << "Stride is stride OR stride_h and stride_w are required.";
   global_pooling_ = pool_param.global_pooling();
   ceil_mode_ = pool_param.ceil_mode();
+  channels_last_ = this->layer_param_.channels_last();
+  if (channels_last_) {
+    CHECK_NE(pool_param.pool(), PoolingParameter_PoolMethod_STOCHASTIC)
+        << "Stochastic pooling cannot run channels-last.";
+    CHECK_EQ(top.size(), 1) << "Channels-last pooling has no mask output.";
+  }
   if (global_pooling_) {
-    kernel_h_ = bottom[0]->height();
-    kernel_w_ = bottom[0]->width();
+    kernel_h_ = bottom[0]->shape(channels_last_ ? 1 : 2);
+    kernel_w_ = bottom[0]->shape(channels_last_ ? 2 : 3);
   } else {
     if (pool_param.has_kernel_size()) {
       kernel_h_ = kernel_w_ = pool_param.kernel_size();
@@ -110,12 +382,18 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   CHECK_EQ(4, bottom[0]->num_axes()) << "Input must have 4 axes, "
       << "corresponding to (num, channels, height, width)";
-  channels_ = bottom[0]->channels();
-  height_ = bottom[0]->height();
-  width_ = bottom[0]->width();
+  if (channels_last_) {
+    channels_ = bottom[0]->shape(3);
+    height_ = bottom[0]->shape(1);
+    width_ = bottom[0]->shape(2);
+  } else {
+    channels_ = bottom[0]->channels();
+    height_ = bottom[0]->height();
+    width_ = bottom[0]->width();
+  }
   if (global_pooling_) {
-    kernel_h_ = bottom[0]->height();
-    kernel_w_ = bottom[0]->width();
+    kernel_h_ = height_;
+    kernel_w_ = width_;
   }
   //  Modified to support ceil_mode in densenet
   if (ceil_mode_) {
@@ -141,6 +419,11 @@ void PoolingLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
     CHECK_LT((pooled_height_ - 1) * stride_h_, height_ + pad_h_);
     CHECK_LT((pooled_width_ - 1) * stride_w_, width_ + pad_w_);
   }
+  if (channels_last_) {
+    top[0]->Reshape(bottom[0]->num(), pooled_height_, pooled_width_,
+        channels_);
+    return;
+  }
   top[0]->Reshape(bottom[0]->num(), channels_, pooled_height_,
       pooled_width_);
   if (top.size() > 1) {
@@ -165,94 +448,64 @@ void PoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  const int top_count = top[0]->count();
+  const PoolingShape shape = MakePoolingShape(height_, width_,
+      pooled_height_, pooled_width_, kernel_h_, kernel_w_, stride_h_,
+      stride_w_, pad_h_, pad_w_);
+  if (channels_last_) {
+    const int num_rows = bottom[0]->num() * pooled_height_;
+    const int64_t grain = max(1, kPoolingGrainOps /
+        max(1, pooled_width_ * kernel_h_ * kernel_w_ * channels_));
+    if (this->layer_param_.pooling_param().pool() ==
+        PoolingParameter_PoolMethod_MAX) {
+      parallel_for(0, num_rows, grain, [&](int64_t begin, int64_t end) {
+        PoolRowsChannelsLast<Dtype, true>(shape, channels_, bottom_data,
+                                          top_data, begin, end);
+      });
+    } else {
+      parallel_for(0, num_rows, grain, [&](int64_t begin, int64_t end) {
+        PoolRowsChannelsLast<Dtype, false>(shape, channels_, bottom_data,
+                                           top_data, begin, end);
+      });
+    }
+    max_idx_valid_ = false;
+    return;
+  }
+  // Planes are independent, so they are split across the thread pool.
+  const int num_planes = bottom[0]->num() * channels_;
+  const int64_t grain = max(1, kPoolingGrainOps /
+      max(1, pooled_height_ * pooled_width_ * kernel_h_ * kernel_w_));
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
-  int* mask = NULL;  // suppress warnings about uninitalized variables
-  Dtype* top_mask = NULL;
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more code.
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // Initialize
     if (use_top_mask) {
-      top_mask = top[1]->mutable_cpu_data();
-      caffe_set(top_count, Dtype(-1), top_mask);
+      Dtype* top_mask = top[1]->mutable_cpu_data();
+      parallel_for(0, num_planes, grain, [&](int64_t begin, int64_t end) {
+        MaxPoolPlanes<Dtype, Dtype, true>(shape, bottom_data, top_data,
+                                          top_mask, begin, end);
+      });
+    } else if (this->phase_ == TRAIN) {
+      int* mask = max_idx_.mutable_cpu_data();
+      parallel_for(0, num_planes, grain, [&](int64_t begin, int64_t end) {
+        MaxPoolPlanes<Dtype, int, true>(shape, bottom_data, top_data, mask,
+                                        begin, end);
+      });
     } else {
-      mask = max_idx_.mutable_cpu_data();
-      caffe_set(top_count, -1, mask);
-    }
-    caffe_set(top_count, Dtype(-FLT_MAX), top_data);
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_);
-            int wend = min(wstart + kernel_w_, width_);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            const int pool_index = ph * pooled_width_ + pw;
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                const int index = h * width_ + w;
-                if (bottom_data[index] > top_data[pool_index]) {
-                  top_data[pool_index] = bottom_data[index];
-                  if (use_top_mask) {
-                    top_mask[pool_index] = static_cast<Dtype>(index);
-                  } else {
-                    mask[pool_index] = index;
-                  }
-                }
-              }
-            }
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
-        }
-      }
+      // Nothing consumes the mask when testing; Backward_cpu recomputes it
+      // should it be called anyway.
+      parallel_for(0, num_planes, grain, [&](int64_t begin, int64_t end) {
+        MaxPoolPlanes<Dtype, int, false>(shape, bottom_data, top_data, NULL,
+                                         begin, end);
+      });
     }
+    max_idx_valid_ = use_top_mask || this->phase_ == TRAIN;
     break;
   case PoolingParameter_PoolMethod_AVE:
-    for (int i = 0; i < top_count; ++i) {
-      top_data[i] = 0;
-    }
-    // The main loop
-    for (int n = 0; n < bottom[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            int hstart = ph * stride_h_ - pad_h_;
-            int wstart = pw * stride_w_ - pad_w_;
-            int hend = min(hstart + kernel_h_, height_ + pad_h_);
-            int wend = min(wstart + kernel_w_, width_ + pad_w_);
-            int pool_size = (hend - hstart) * (wend - wstart);
-            hstart = max(hstart, 0);
-            wstart = max(wstart, 0);
-            hend = min(hend, height_);
-            wend = min(wend, width_);
-            for (int h = hstart; h < hend; ++h) {
-              for (int w = wstart; w < wend; ++w) {
-                top_data[ph * pooled_width_ + pw] +=
-                    bottom_data[h * width_ + w];
-              }
-            }
-            top_data[ph * pooled_width_ + pw] /= pool_size;
-          }
-        }
-        // compute offset
-        bottom_data += bottom[0]->offset(0, 1);
-        top_data += top[0]->offset(0, 1);
-      }
-    }
+    parallel_for(0, num_planes, grain, [&](int64_t begin, int64_t end) {
+      AvePoolPlanes(shape, bottom_data, top_data, begin, end);
+    });
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -268,47 +521,65 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   if (!propagate_down[0]) {
     return;
   }
+  CHECK(!channels_last_) << "Channels-last pooling is forward only.";
   const Dtype* top_diff = top[0]->cpu_diff();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
   // Different pooling methods. We explicitly do the switch outside the for
   // loop to save time, although this results in more codes.
   caffe_set(bottom[0]->count(), Dtype(0), bottom_diff);
+  const int num_planes = top[0]->num() * channels_;
+  const int bottom_size = height_ * width_;
+  const int top_size = pooled_height_ * pooled_width_;
+  const int64_t grain = max(1, kPoolingGrainOps /
+      max(1, top_size * kernel_h_ * kernel_w_));
   // We'll output the mask to top[1] if it's of size >1.
   const bool use_top_mask = top.size() > 1;
-  const int* mask = NULL;  // suppress warnings about uninitialized variables
-  const Dtype* top_mask = NULL;
   switch (this->layer_param_.pooling_param().pool()) {
   case PoolingParameter_PoolMethod_MAX:
-    // The main loop
     if (use_top_mask) {
-      top_mask = top[1]->cpu_data();
-    } else {
-      mask = max_idx_.cpu_data();
-    }
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
-        for (int ph = 0; ph < pooled_height_; ++ph) {
-          for (int pw = 0; pw < pooled_width_; ++pw) {
-            const int index = ph * pooled_width_ + pw;
-            const int bottom_index =
-                use_top_mask ? top_mask[index] : mask[index];
-            bottom_diff[bottom_index] += top_diff[index];
+      const Dtype* top_mask = top[1]->cpu_data();
+      parallel_for(0, num_planes, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t p = begin; p < end; ++p) {
+          for (int i = 0; i < top_size; ++i) {
+            const int bottom_index = top_mask[p * top_size + i];
+            bottom_diff[p * bottom_size + bottom_index] +=
+                top_diff[p * top_size + i];
           }
         }
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
-        if (use_top_mask) {
-          top_mask += top[0]->offset(0, 1);
-        } else {
-          mask += top[0]->offset(0, 1);
+      });
+      break;
+    }
+    if (!max_idx_valid_) {
+      const PoolingShape shape = MakePoolingShape(height_, width_,
+          pooled_height_, pooled_width_, kernel_h_, kernel_w_, stride_h_,
+          stride_w_, pad_h_, pad_w_);
+      const Dtype* bottom_data = bottom[0]->cpu_data();
+      Dtype* top_data = top[0]->mutable_cpu_data();
+      int* mask = max_idx_.mutable_cpu_data();
+      parallel_for(0, num_planes, grain, [&](int64_t begin, int64_t end) {
+        MaxPoolPlanes<Dtype, int, true>(shape, bottom_data, top_data, mask,
+                                        begin, end);
+      });
+      max_idx_valid_ = true;
+    }
+    {
+      const int* mask = max_idx_.cpu_data();
+      parallel_for(0, num_planes, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t p = begin; p < end; ++p) {
+          for (int i = 0; i < top_size; ++i) {
+            const int bottom_index = mask[p * top_size + i];
+            bottom_diff[p * bottom_size + bottom_index] +=
+                top_diff[p * top_size + i];
+          }
         }
-      }
+      });
     }
     break;
   case PoolingParameter_PoolMethod_AVE:
-    // The main loop
-    for (int n = 0; n < top[0]->num(); ++n) {
-      for (int c = 0; c < channels_; ++c) {
+    parallel_for(0, num_planes, grain, [&](int64_t begin, int64_t end) {
+      for (int64_t p = begin; p < end; ++p) {
+        Dtype* plane_bottom_diff = bottom_diff + p * bottom_size;
+        const Dtype* plane_top_diff = top_diff + p * top_size;
         for (int ph = 0; ph < pooled_height_; ++ph) {
           for (int pw = 0; pw < pooled_width_; ++pw) {
             int hstart = ph * stride_h_ - pad_h_;
@@ -322,17 +593,14 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
             wend = min(wend, width_);
             for (int h = hstart; h < hend; ++h) {
               for (int w = wstart; w < wend; ++w) {
-                bottom_diff[h * width_ + w] +=
-                  top_diff[ph * pooled_width_ + pw] / pool_size;
+                plane_bottom_diff[h * width_ + w] +=
+                  plane_top_diff[ph * pooled_width_ + pw] / pool_size;
               }
             }
           }
         }
-        // offset
-        bottom_diff += bottom[0]->offset(0, 1);
-        top_diff += top[0]->offset(0, 1);
       }
-    }
+    });
     break;
   case PoolingParameter_PoolMethod_STOCHASTIC:
     NOT_IMPLEMENTED;
@@ -342,7 +610,6 @@ void PoolingLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   }
 }
 
-
 #ifndef USE_CUDA
 STUB_GPU(PoolingLayer);
 #endif
@@ -47,25 +47,31 @@ void PowerLayer<Dtype>::LayerSetUp(const vector<Blob<Dtype>*>& bottom,
 // Compute y = (shift + scale * x)^power
 template <typename Dtype>
 void PowerLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                    const vector<Blob<Dtype>*>& top) {
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  const int count = bottom[0]->count();
+    const vector<Blob<Dtype>*>& top) {
+  ForwardElementwiseChain(vector<Layer<Dtype>*>(1, this), bottom[0]->count(),
+                          bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void PowerLayer<Dtype>::ForwardElementwise_cpu(const int offset, const int count,
+    const Dtype* bottom, Dtype* top) {
   // Special case where we can ignore the input: scale or power is 0.
   if (diff_scale_ == Dtype(0)) {
     Dtype value = (power_ == 0) ? Dtype(1) : pow(shift_, power_);
-    caffe_set(count, value, top_data);
+    caffe_set(count, value, top);
     return;
   }
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  caffe_copy(count, bottom_data, top_data);
+  if (bottom != top) {
+    caffe_copy(count, bottom, top);
+  }
   if (scale_ != Dtype(1)) {
-    caffe_scal(count, scale_, top_data);
+    caffe_scal(count, scale_, top);
   }
   if (shift_ != Dtype(0)) {
-    caffe_add_scalar(count, shift_, top_data);
+    caffe_add_scalar(count, shift_, top);
   }
   if (power_ != Dtype(1)) {
-    caffe_powx(count, top_data, power_, top_data);
+    caffe_powx(count, top, power_, top);
   }
 }
 
@@ -38,9 +38,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/util/math_functions.hpp"
 
 using std::max;
-using std::min;
-using std::floor;
-using std::ceil;
 
 namespace caffe {
 template <typename Dtype>
@@ -81,80 +78,47 @@ void PSROIPoolingLayer<Dtype>::Forward_cpu(
   int channels = bottom[0]->channels();
   int height = bottom[0]->height();
   int width = bottom[0]->width();
-  int pooled_height = group_size_;
-  int pooled_width = group_size_;
   int* mapping_channel = mapping_channel_.mutable_cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  int count = top[0]->count();
-  caffe_set(count, Dtype(0), top_data);
-  caffe_set(count, -1, mapping_channel);
-  for (int n = 0; n < rois_num; ++n) {
-    int roi_add = n*5;
-    // [start, end) interval for spatial sampling
-    int roi_batch_ind = bottom_rois[roi_add];
-    Dtype roi_start_w =
-        static_cast<Dtype>(round(bottom_rois[roi_add + 1])) * spatial_scale_;
-    Dtype roi_start_h =
-        static_cast<Dtype>(round(bottom_rois[roi_add + 2])) * spatial_scale_;
-    Dtype roi_end_w =
-        static_cast<Dtype>(round(bottom_rois[roi_add + 3])
-                           + 1.) * spatial_scale_;
-    Dtype roi_end_h =
-        static_cast<Dtype>(round(bottom_rois[roi_add + 4])
-                           + 1.) * spatial_scale_;
+  const int num_bins = group_size_ * group_size_;
 
-    // Force too small ROIs to be 1x1
-    Dtype roi_width = max<Dtype>(roi_end_w - roi_start_w, 0.1);  // avoid 0
-    Dtype roi_height = max<Dtype>(roi_end_h - roi_start_h, 0.1);
+  // The pooling windows of each ROI, shared by all output channels.
+  bins_.resize(rois_num * num_bins);
+  int64_t window = 0;
+  for (int n = 0; n < rois_num; ++n) {
+    PSROIPoolingBins(bottom_rois + n * 5 + 1, spatial_scale_, height, width,
+                     group_size_, &bins_[n * num_bins]);
+    for (int i = 0; i < num_bins; ++i) {
+      window += bins_[n * num_bins + i].area();
+    }
+  }
 
-    // Compute w and h at bottom, prepare pooling in rois
-    Dtype bin_size_h = roi_height / static_cast<Dtype>(pooled_height);
-    Dtype bin_size_w = roi_width / static_cast<Dtype>(pooled_width);
-    // Suppose rois anchor is feathure map, pooling in the rois feathure map
-    for (int ctop = 0; ctop < output_dim_; ++ctop) {
-      for (int ph = 0; ph < pooled_height; ++ph) {
-        for (int pw = 0; pw < pooled_width; ++pw) {
-          // The output is in order (n, ctop, ph, pw)
-          int index = n*output_dim_*pooled_height*pooled_width
-                      + ctop*pooled_height*pooled_width + ph*pooled_width + pw;
-          int hstart = floor(static_cast<Dtype>(ph) * bin_size_h
-                          + roi_start_h);
-          int wstart = floor(static_cast<Dtype>(pw)* bin_size_w
-                          + roi_start_w);
-          int hend = ceil(static_cast<Dtype>(ph + 1) * bin_size_h
-                          + roi_start_h);
-          int wend = ceil(static_cast<Dtype>(pw + 1) * bin_size_w
-                      + roi_start_w);
-          // Add roi offsets and clip to input boundaries
-          hstart = min(max(hstart, 0), height);
-          hend = min(max(hend, 0), height);
-          wstart = min(max(wstart, 0), width);
-          wend = min(max(wend, 0), width);
-          // bottom_rois may give locs that is not a anchor, then it's empty
-          bool is_empty = (hend <= hstart) || (wend <= wstart);
-          int gw = pw;
-          int gh = ph;
-          int c = (ctop*group_size_ + gh)*group_size_ + gw;
-          // sum the data in the pooling group and get average pooling
-          Dtype out_sum = 0;
-          for (int h = hstart; h < hend; ++h) {
-            for (int w = wstart; w < wend; ++w) {
-              int bottom_index = h*width + w;
-              out_sum += bottom_data[(roi_batch_ind * channels + c)
-                                      * height * width + bottom_index];
-            }
-          }
-          Dtype bin_area = (hend - hstart)*(wend - wstart);
-          if (is_empty) {
-            top_data[index] = 0;
-          } else {
-            top_data[index] = out_sum/bin_area;
+  ROIParallelFor(rois_num, output_dim_, window / max(rois_num, 1) + num_bins,
+      [&](int n, int ctop_begin, int ctop_end) {
+    const int roi_batch_ind = bottom_rois[n * 5];
+    const ROIBin* bins = &bins_[n * num_bins];
+    for (int ctop = ctop_begin; ctop < ctop_end; ++ctop) {
+      // The output is in order (n, ctop, ph, pw)
+      const int top_offset = (n * output_dim_ + ctop) * num_bins;
+      for (int i = 0; i < num_bins; ++i) {
+        // Bin i of output channel ctop pools input channel c
+        const int c = ctop * num_bins + i;
+        const Dtype* plane =
+            bottom_data + (roi_batch_ind * channels + c) * height * width;
+        const ROIBin& bin = bins[i];
+        // sum the data in the pooling group and get average pooling
+        Dtype out_sum = 0;
+        for (int h = bin.hstart; h < bin.hend; ++h) {
+          for (int w = bin.wstart; w < bin.wend; ++w) {
+            out_sum += plane[h * width + w];
           }
-          mapping_channel[index] = c;
         }
+        top_data[top_offset + i] = bin.empty() ? Dtype(0) :
+            out_sum / static_cast<Dtype>(bin.area());
+        mapping_channel[top_offset + i] = c;
       }
     }
-  }
+  });
 }
 
 template <typename Dtype>
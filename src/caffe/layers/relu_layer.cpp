@@ -36,16 +36,20 @@ namespace caffe {
 
 template <typename Dtype>
 void ReLULayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
-                                   const vector<Blob<Dtype>*>& top) {
-  const Dtype* bottom_data = bottom[0]->cpu_data();
-  Dtype* top_data = top[0]->mutable_cpu_data();
-  const int count = bottom[0]->count();
+    const vector<Blob<Dtype>*>& top) {
+  ForwardElementwiseChain(vector<Layer<Dtype>*>(1, this), bottom[0]->count(),
+                          bottom[0]->cpu_data(), top[0]->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void ReLULayer<Dtype>::ForwardElementwise_cpu(const int offset, const int count,
+    const Dtype* bottom, Dtype* top) {
   Dtype negative_slope = this->layer_param_.relu_param().negative_slope();
   int upper_limit = this->layer_param_.relu_param().upper_limit();
   for (int i = 0; i < count; ++i) {
-    Dtype temp_top = std::max(bottom_data[i], Dtype(0)) +
-                  negative_slope * std::min(bottom_data[i], Dtype(0));
-    top_data[i] = upper_limit ? std::min(temp_top, Dtype(upper_limit)) : temp_top;
+    Dtype temp_top = std::max(bottom[i], Dtype(0)) +
+                  negative_slope * std::min(bottom[i], Dtype(0));
+    top[i] = upper_limit ? std::min(temp_top, Dtype(upper_limit)) : temp_top;
   }
 }
 
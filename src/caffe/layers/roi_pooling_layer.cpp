@@ -36,9 +36,6 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // NOLINT(build/include_what_you_use)
 
 using std::max;
-using std::min;
-using std::floor;
-using std::ceil;
 
 namespace caffe {
 
@@ -89,78 +86,53 @@ void ROIPoolingLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int num_rois = rois_num_;
   int roi_cols = roi_cols_;
   int batch_size = bottom[0]->num();
-  int top_count = top[0]->count();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  caffe_set(top_count, Dtype(-FLT_MAX), top_data);
   int* argmax_data = max_idx_.mutable_cpu_data();
-  caffe_set(top_count, -1, argmax_data);
+  const int num_bins = pooled_height_ * pooled_width_;
 
-  // For each ROI R = [batch_index x1 y1 x2 y2]: max pool over R
+  // For each ROI R = [batch_index x1 y1 x2 y2], the pooling windows,
+  // shared by all channels.
+  bins_.resize(num_rois * num_bins);
+  int64_t window = 0;
   for (int n = 0; n < num_rois; ++n) {
-    int roi_batch_ind = bottom_rois[0];
-    int roi_start_w = round(bottom_rois[1] * spatial_scale_);
-    int roi_start_h = round(bottom_rois[2] * spatial_scale_);
-    int roi_end_w = round(bottom_rois[3] * spatial_scale_);
-    int roi_end_h = round(bottom_rois[4] * spatial_scale_);
+    const Dtype* roi = bottom_rois + n * roi_cols;
+    const int roi_batch_ind = roi[0];
     CHECK_GE(roi_batch_ind, 0);
     CHECK_LT(roi_batch_ind, batch_size);
+    ROIPoolingBins(roi + 1, spatial_scale_, height_, width_,
+                   pooled_height_, pooled_width_, &bins_[n * num_bins]);
+    for (int i = 0; i < num_bins; ++i) {
+      window += bins_[n * num_bins + i].area();
+    }
+  }
 
-    int roi_height = max(roi_end_h - roi_start_h + 1, 1);
-    int roi_width = max(roi_end_w - roi_start_w + 1, 1);
-    const Dtype bin_size_h =
-        static_cast<Dtype>(roi_height) / static_cast<Dtype>(pooled_height_);
-    const Dtype bin_size_w =
-        static_cast<Dtype>(roi_width) / static_cast<Dtype>(pooled_width_);
-
-    const Dtype* batch_data = bottom_data + bottom[0]->offset(roi_batch_ind);
-
-    for (int c = 0; c < channels_; ++c) {
-      for (int ph = 0; ph < pooled_height_; ++ph) {
-        for (int pw = 0; pw < pooled_width_; ++pw) {
-          // Compute pooling region for this output unit:
-          //  start (included) = floor(ph * roi_height / pooled_height_)
-          //  end (excluded) = ceil((ph + 1) * roi_height / pooled_height_)
-          int hstart =
-              static_cast<int>(floor(static_cast<Dtype>(ph) * bin_size_h));
-          int wstart =
-              static_cast<int>(floor(static_cast<Dtype>(pw) * bin_size_w));
-          int hend =
-              static_cast<int>(ceil(static_cast<Dtype>(ph + 1) * bin_size_h));
-          int wend =
-              static_cast<int>(ceil(static_cast<Dtype>(pw + 1) * bin_size_w));
-
-          hstart = min(max(hstart + roi_start_h, 0), height_);
-          hend = min(max(hend + roi_start_h, 0), height_);
-          wstart = min(max(wstart + roi_start_w, 0), width_);
-          wend = min(max(wend + roi_start_w, 0), width_);
-
-          bool is_empty = (hend <= hstart) || (wend <= wstart);
-
-          const int pool_index = ph * pooled_width_ + pw;
-          if (is_empty) {
-            top_data[pool_index] = 0;
-            argmax_data[pool_index] = -1;
-          }
-
-          for (int h = hstart; h < hend; ++h) {
-            for (int w = wstart; w < wend; ++w) {
-              const int index = h * width_ + w;
-              if (batch_data[index] > top_data[pool_index]) {
-                top_data[pool_index] = batch_data[index];
-                argmax_data[pool_index] = index;
-              }
+  // Max pool over each window
+  ROIParallelFor(num_rois, channels_, window / max(num_rois, 1) + num_bins,
+      [&](int n, int c_begin, int c_end) {
+    const int roi_batch_ind = bottom_rois[n * roi_cols];
+    const ROIBin* bins = &bins_[n * num_bins];
+    for (int c = c_begin; c < c_end; ++c) {
+      const Dtype* batch_data =
+          bottom_data + bottom[0]->offset(roi_batch_ind, c);
+      const int top_offset = (n * channels_ + c) * num_bins;
+      for (int i = 0; i < num_bins; ++i) {
+        const ROIBin& bin = bins[i];
+        Dtype max_val = bin.empty() ? Dtype(0) : Dtype(-FLT_MAX);
+        int argmax = -1;
+        for (int h = bin.hstart; h < bin.hend; ++h) {
+          for (int w = bin.wstart; w < bin.wend; ++w) {
+            const int index = h * width_ + w;
+            if (batch_data[index] > max_val) {
+              max_val = batch_data[index];
+              argmax = index;
             }
           }
         }
+        top_data[top_offset + i] = max_val;
+        argmax_data[top_offset + i] = argmax;
       }
-      // Increment all data pointers by one channel
-      batch_data += bottom[0]->offset(0, 1);
-      top_data += top[0]->offset(0, 1);
-      argmax_data += max_idx_.offset(0, 1);
     }
-    // Increment ROI data pointer
-    bottom_rois += roi_cols;
-  }
+  });
 }
 
 template <typename Dtype>
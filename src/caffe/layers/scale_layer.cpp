@@ -157,12 +157,21 @@ void ScaleLayer<Dtype>::Forward_cpu(
   const Dtype* scale_data =
       ((bottom.size() > 1) ? bottom[1] : this->blobs_[0].get())->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  for (int n = 0; n < outer_dim_; ++n) {
-    for (int d = 0; d < scale_dim_; ++d) {
-      const Dtype factor = scale_data[d];
-      caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
-      bottom_data += inner_dim_;
-      top_data += inner_dim_;
+  if (inner_dim_ == 1) {
+    // One element per scale index, as when channels-last.
+    for (int n = 0; n < outer_dim_; ++n) {
+      caffe_mul(scale_dim_, bottom_data, scale_data, top_data);
+      bottom_data += scale_dim_;
+      top_data += scale_dim_;
+    }
+  } else {
+    for (int n = 0; n < outer_dim_; ++n) {
+      for (int d = 0; d < scale_dim_; ++d) {
+        const Dtype factor = scale_data[d];
+        caffe_cpu_scale(inner_dim_, factor, bottom_data, top_data);
+        bottom_data += inner_dim_;
+        top_data += inner_dim_;
+      }
     }
   }
   if (bias_layer_) {
@@ -170,6 +179,40 @@ void ScaleLayer<Dtype>::Forward_cpu(
   }
 }
 
+template <typename Dtype>
+void ScaleLayer<Dtype>::ForwardElementwise_cpu(const int offset,
+    const int count, const Dtype* bottom, Dtype* top) {
+  const Dtype* scale_data = this->blobs_[0]->cpu_data();
+  const Dtype* bias_data = bias_layer_ ?
+      this->blobs_[bias_param_id_]->cpu_data() : NULL;
+  if (inner_dim_ == 1) {
+    // As when channels-last, consecutive elements have consecutive scale
+    // indices: walk the range one run of them at a time.
+    for (int i = 0; i < count; ) {
+      const int d0 = (offset + i) % scale_dim_;
+      const int n = std::min(count - i, scale_dim_ - d0);
+      for (int j = 0; j < n; ++j) {
+        const Dtype bias = bias_data ? bias_data[d0 + j] : Dtype(0);
+        top[i + j] = bottom[i + j] * scale_data[d0 + j] + bias;
+      }
+      i += n;
+    }
+    return;
+  }
+  // Walk the range one run of equal scale index at a time.
+  for (int i = 0; i < count; ) {
+    const int index = offset + i;
+    const int d = index / inner_dim_ % scale_dim_;
+    const int n = std::min(count - i, inner_dim_ - index % inner_dim_);
+    const Dtype factor = scale_data[d];
+    const Dtype bias = bias_data ? bias_data[d] : Dtype(0);
+    for (int j = i; j < i + n; ++j) {
+      top[j] = bottom[j] * factor + bias;
+    }
+    i += n;
+  }
+}
+
 template <typename Dtype>
 void ScaleLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
     const vector<bool>& propagate_down, const vector<Blob<Dtype>*>& bottom) {
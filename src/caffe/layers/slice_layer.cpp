@@ -109,9 +109,33 @@ void SliceLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
   int offset_slice_axis = 0;
   const Dtype* bottom_data = bottom[0]->cpu_data();
   const int bottom_slice_axis = bottom[0]->shape(slice_axis_);
+  // With a single slice the outputs may be views into bottom, set up by
+  // Net::InitDataViews. Those already in place are skipped; if any other
+  // output lies inside bottom, bottom is staged before it is overwritten.
+  vector<bool> in_place(top.size(), false);
+  vector<Dtype> staged;
+  if (num_slices_ == 1) {
+    int offset = 0;
+    bool stage = false;
+    for (int i = 0; i < top.size(); ++i) {
+      const Dtype* top_data = top[i]->cpu_data();
+      in_place[i] = top_data == bottom_data + offset;
+      stage = stage || (!in_place[i] && caffe_overlaps(top[i]->count(),
+          top_data, bottom[0]->count(), bottom_data));
+      offset += top[i]->count();
+    }
+    if (stage) {
+      staged.assign(bottom_data, bottom_data + bottom[0]->count());
+      bottom_data = staged.data();
+    }
+  }
   for (int i = 0; i < top.size(); ++i) {
-    Dtype* top_data = top[i]->mutable_cpu_data();
     const int top_slice_axis = top[i]->shape(slice_axis_);
+    if (in_place[i]) {
+      offset_slice_axis += top_slice_axis;
+      continue;
+    }
+    Dtype* top_data = top[i]->mutable_cpu_data();
     for (int n = 0; n < num_slices_; ++n) {
       const int top_offset = n * top_slice_axis * slice_size_;
       const int bottom_offset =
@@ -32,9 +32,97 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/layers/softmax_layer.hpp"
 #include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
 
 namespace caffe {
 
+namespace {
+
+// Inner positions handled together when the softmax axis is strided; the
+// max, sum and one row of the tile stay in L1.
+const int kSoftmaxTile = 256;
+// Roughly the number of elements one parallel task should cover.
+const int kSoftmaxGrainOps = 16384;
+
+// Softmax of a contiguous row: max, then exp with the sum, then scale.
+template <typename Dtype>
+void SoftmaxRow(const int channels, const Dtype* bottom, Dtype* top) {
+  const Dtype max_val = *std::max_element(bottom, bottom + channels);
+  for (int j = 0; j < channels; ++j) {
+    top[j] = bottom[j] - max_val;
+  }
+  caffe_exp<Dtype>(channels, top, top);
+  Dtype sum = 0;
+  for (int j = 0; j < channels; ++j) {
+    sum += top[j];
+  }
+  caffe_scal<Dtype>(channels, Dtype(1) / sum, top);
+}
+
+// Softmax over channels for len consecutive inner positions, channel rows
+// being inner apart. Every pass walks the rows contiguously.
+template <typename Dtype>
+void SoftmaxTile(const int channels, const int inner, const int len,
+                 const Dtype* bottom, Dtype* top) {
+  Dtype max_val[kSoftmaxTile];
+  Dtype sum[kSoftmaxTile];
+  std::copy(bottom, bottom + len, max_val);
+  for (int j = 1; j < channels; ++j) {
+    const Dtype* row = bottom + j * inner;
+    for (int k = 0; k < len; ++k) {
+      max_val[k] = std::max(max_val[k], row[k]);
+    }
+  }
+  std::fill(sum, sum + len, Dtype(0));
+  for (int j = 0; j < channels; ++j) {
+    const Dtype* row = bottom + j * inner;
+    Dtype* top_row = top + j * inner;
+    for (int k = 0; k < len; ++k) {
+      top_row[k] = row[k] - max_val[k];
+    }
+    caffe_exp<Dtype>(len, top_row, top_row);
+    for (int k = 0; k < len; ++k) {
+      sum[k] += top_row[k];
+    }
+  }
+  for (int k = 0; k < len; ++k) {
+    sum[k] = Dtype(1) / sum[k];
+  }
+  for (int j = 0; j < channels; ++j) {
+    Dtype* top_row = top + j * inner;
+    for (int k = 0; k < len; ++k) {
+      top_row[k] *= sum[k];
+    }
+  }
+}
+
+// bottom_diff = (top_diff - dot(top_diff, top_data)) * top_data over
+// channels, for len consecutive inner positions.
+template <typename Dtype>
+void SoftmaxBackwardTile(const int channels, const int inner, const int len,
+                         const Dtype* top_data, const Dtype* top_diff,
+                         Dtype* bottom_diff) {
+  Dtype dot[kSoftmaxTile];
+  std::fill(dot, dot + len, Dtype(0));
+  for (int j = 0; j < channels; ++j) {
+    const Dtype* data_row = top_data + j * inner;
+    const Dtype* diff_row = top_diff + j * inner;
+    for (int k = 0; k < len; ++k) {
+      dot[k] += data_row[k] * diff_row[k];
+    }
+  }
+  for (int j = 0; j < channels; ++j) {
+    const Dtype* data_row = top_data + j * inner;
+    const Dtype* diff_row = top_diff + j * inner;
+    Dtype* bottom_row = bottom_diff + j * inner;
+    for (int k = 0; k < len; ++k) {
+      bottom_row[k] = (diff_row[k] - dot[k]) * data_row[k];
+    }
+  }
+}
+
+}  // namespace
+
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
       const vector<Blob<Dtype>*>& top) {
@@ -52,40 +140,35 @@ void SoftmaxLayer<Dtype>::Reshape(const vector<Blob<Dtype>*>& bottom,
   scale_.Reshape(scale_dims);
 }
 
+// The CPU passes work on one softmax row (inner_num_ == 1) or on a tile of
+// inner positions at a time, so the data is read from memory once and the
+// exp and normalisation run on cache-resident values. Tiles are
+// independent and run in parallel.
 template <typename Dtype>
 void SoftmaxLayer<Dtype>::Forward_cpu(const vector<Blob<Dtype>*>& bottom,
     const vector<Blob<Dtype>*>& top) {
   const Dtype* bottom_data = bottom[0]->cpu_data();
   Dtype* top_data = top[0]->mutable_cpu_data();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  int channels = bottom[0]->shape(softmax_axis_);
-  int dim = bottom[0]->count() / outer_num_;
-  caffe_copy(bottom[0]->count(), bottom_data, top_data);
-  // We need to subtract the max to avoid numerical issues, compute the exp,
-  // and then normalize.
-  for (int i = 0; i < outer_num_; ++i) {
-    // initialize scale_data to the first plane
-    caffe_copy(inner_num_, bottom_data + i * dim, scale_data);
-    for (int j = 0; j < channels; j++) {
-      for (int k = 0; k < inner_num_; k++) {
-        scale_data[k] = std::max(scale_data[k],
-            bottom_data[i * dim + j * inner_num_ + k]);
+  const int channels = bottom[0]->shape(softmax_axis_);
+  const int dim = channels * inner_num_;
+  const int inner = inner_num_;
+  const int tiles = (inner + kSoftmaxTile - 1) / kSoftmaxTile;
+  const int64_t grain = std::max(1, kSoftmaxGrainOps /
+      std::max(1, channels * std::min(inner, kSoftmaxTile)));
+  parallel_for(0, int64_t(outer_num_) * tiles, grain,
+      [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; ++t) {
+      const int i = t / tiles;
+      const int k = (t % tiles) * kSoftmaxTile;
+      const int offset = i * dim + k;
+      if (inner == 1) {
+        SoftmaxRow(channels, bottom_data + offset, top_data + offset);
+      } else {
+        SoftmaxTile(channels, inner, std::min(kSoftmaxTile, inner - k),
+                    bottom_data + offset, top_data + offset);
       }
     }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_,
-        1, -1., sum_multiplier_.cpu_data(), scale_data, 1., top_data);
-    // exponentiation
-    caffe_exp<Dtype>(dim, top_data, top_data);
-    // sum after exp
-    caffe_cpu_gemv<Dtype>(CblasTrans, channels, inner_num_, 1.,
-        top_data, sum_multiplier_.cpu_data(), 0., scale_data);
-    // division
-    for (int j = 0; j < channels; j++) {
-      caffe_div(inner_num_, top_data, scale_data, top_data);
-      top_data += inner_num_;
-    }
-  }
+  });
 }
 
 template <typename Dtype>
@@ -95,23 +178,23 @@ void SoftmaxLayer<Dtype>::Backward_cpu(const vector<Blob<Dtype>*>& top,
   const Dtype* top_diff = top[0]->cpu_diff();
   const Dtype* top_data = top[0]->cpu_data();
   Dtype* bottom_diff = bottom[0]->mutable_cpu_diff();
-  Dtype* scale_data = scale_.mutable_cpu_data();
-  int channels = top[0]->shape(softmax_axis_);
-  int dim = top[0]->count() / outer_num_;
-  caffe_copy(top[0]->count(), top_diff, bottom_diff);
-  for (int i = 0; i < outer_num_; ++i) {
-    // compute dot(top_diff, top_data) and subtract them from the bottom diff
-    for (int k = 0; k < inner_num_; ++k) {
-      scale_data[k] = caffe_cpu_strided_dot<Dtype>(channels,
-          bottom_diff + i * dim + k, inner_num_,
-          top_data + i * dim + k, inner_num_);
+  const int channels = top[0]->shape(softmax_axis_);
+  const int dim = channels * inner_num_;
+  const int inner = inner_num_;
+  const int tiles = (inner + kSoftmaxTile - 1) / kSoftmaxTile;
+  const int64_t grain = std::max(1, kSoftmaxGrainOps /
+      std::max(1, channels * std::min(inner, kSoftmaxTile)));
+  parallel_for(0, int64_t(outer_num_) * tiles, grain,
+      [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; ++t) {
+      const int i = t / tiles;
+      const int k = (t % tiles) * kSoftmaxTile;
+      const int offset = i * dim + k;
+      SoftmaxBackwardTile(channels, inner, std::min(kSoftmaxTile, inner - k),
+                          top_data + offset, top_diff + offset,
+                          bottom_diff + offset);
     }
-    // subtraction
-    caffe_cpu_gemm<Dtype>(CblasNoTrans, CblasNoTrans, channels, inner_num_, 1,
-        -1., sum_multiplier_.cpu_data(), scale_data, 1., bottom_diff + i * dim);
-  }
-  // elementwise multiplication
-  caffe_mul(top[0]->count(), bottom_diff, top_data, bottom_diff);
+  });
 }
 
 
@@ -46,6 +46,8 @@ template <typename Dtype>
 LayerParameter SPPLayer<Dtype>::GetPoolingParam(const int pyramid_level,
       const int bottom_h, const int bottom_w, const SPPParameter spp_param) {
   LayerParameter pooling_param;
+  // Lets the pooling layers skip the max mask when testing.
+  pooling_param.set_phase(this->phase_);
   int num_bins = pow(2, pyramid_level);
 
   // find padding and kernel size so that the pooling is
@@ -30,6 +30,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifdef USE_MLU
 
 #include "caffe/mlu/data_trans.hpp"
+#include "caffe/util/layout_cast.hpp"
 
 namespace caffe {
 
@@ -61,62 +62,27 @@ void transAndCast(void* src_ptr, cnrtDataType_t src_dtype,
     void* dst_ptr, cnrtDataType_t dst_dtype, void* tmp_ptr,
     const vector<int>& src_dim_values, bool is_first_conv,
     string trans_direction) {
-  vector<int> src_dim_values_non_const = src_dim_values;
-  vector<int> dst_dim_values;
-  vector<int> dim_strides(src_dim_values.size(), 0);
-  vector<int> dim_order(src_dim_values.size());
   vector<int> dim_order_tmp(src_dim_values.size());
   for (int i = 0; i < src_dim_values.size(); i++) {
     dim_order_tmp[i] = i;
   }
 
+  LayoutCastParam param;
+  param.src_type = from_cnrt_dtype(src_dtype);
+  param.dst_type = from_cnrt_dtype(dst_dtype);
+  param.src_shape = src_dim_values;
   if ("CPU2MLU" == trans_direction) {
-    dst_dim_values = to_mlu_shape(src_dim_values);
-    dim_order = to_mlu_shape(dim_order_tmp);
-    if (is_first_conv) {
-      dim_strides[dim_strides.size() - 1] = 1;
+    param.order = to_mlu_shape(dim_order_tmp);
+    if (is_first_conv && src_dtype != dst_dtype) {
+      param.pad.assign(src_dim_values.size(), 0);
+      param.pad[src_dim_values.size() - 1] = 1;
     }
   } else if ("MLU2CPU" == trans_direction) {
-    dst_dim_values = to_cpu_shape(src_dim_values);
-    dim_order = to_cpu_shape(dim_order_tmp);
+    param.order = to_cpu_shape(dim_order_tmp);
   } else {
     LOG(FATAL) << "Unsupport trans direction.";
   }
-
-  if (src_dtype != dst_dtype) {
-    if (is_first_conv) {
-      CNRT_CHECK(cnrtTransOrderAndCast(reinterpret_cast<void*>(src_ptr),
-                                       src_dtype,
-                                       reinterpret_cast<void*>(tmp_ptr),
-                                       dst_dtype,
-                                       nullptr,
-                                       src_dim_values.size(),
-                                       src_dim_values_non_const.data(),
-                                       dim_order.data()));
-      CNRT_CHECK(cnrtAddDataStride(reinterpret_cast<void*>(tmp_ptr),
-                                   dst_dtype,
-                                   reinterpret_cast<void*>(dst_ptr),
-                                   src_dim_values.size(),
-                                   dst_dim_values.data(),
-                                   dim_strides.data()));
-    } else {
-      CNRT_CHECK(cnrtTransOrderAndCast(reinterpret_cast<void*>(src_ptr),
-                                       src_dtype,
-                                       reinterpret_cast<void*>(dst_ptr),
-                                       dst_dtype,
-                                       nullptr,
-                                       src_dim_values.size(),
-                                       src_dim_values_non_const.data(),
-                                       dim_order.data()));
-    }
-  } else {
-    CNRT_CHECK(cnrtTransDataOrder(reinterpret_cast<void*>(src_ptr),
-                                  src_dtype,
-                                  reinterpret_cast<void*>(dst_ptr),
-                                  src_dim_values.size(),
-                                  src_dim_values_non_const.data(),
-                                  dim_order.data()));
-  }
+  caffe_cpu_layout_cast(param, src_ptr, dst_ptr);
 }
 
 }  // namespace caffe
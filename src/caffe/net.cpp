@@ -43,9 +43,11 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #endif
 #include "caffe/common.hpp"
 #include "caffe/layer.hpp"
+#include "caffe/layers/conv_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/parallel.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/channels_last.hpp"
 #include "caffe/util/hdf5.hpp"
 #include "caffe/util/insert_splits.hpp"
 #include "caffe/util/io.hpp"
@@ -97,6 +99,15 @@ Net<Dtype>::Net(void* buffer, int buffer_size, Phase phase) {
   LOG(INFO) << "net init finished" << std::endl;
 }
 
+template <typename Dtype>
+Net<Dtype>::Net(const NetParameter& param, const Net* weights_owner)
+    : weights_owner_(weights_owner) {
+  CHECK(weights_owner_ != NULL);
+  Init(param);
+  // The parameter blobs belong to weights_owner_, which must outlive us.
+  weights_owner_ = NULL;
+}
+
 template <typename Dtype>
 void Net<Dtype>::Init(const NetParameter& in_param) {
   // Set phase from the state.
@@ -140,6 +151,16 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         param.DebugString();
   }
 #endif
+  // Run what can be channels-last, transposing at the boundaries.
+  if (param.channels_last() && phase_ == TEST &&
+      Caffe::mode() == Caffe::CPU) {
+    NetParameter channels_last_param;
+    InsertChannelsLast(param, &channels_last_param);
+    param = channels_last_param;
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Channels-last parameter: " << std::endl
+        << param.DebugString();
+  }
 
   // Basically, build all the layers and set up their connections.
   name_ = param.name();
@@ -157,6 +178,10 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
     // Inherit phase from net if unset.
     if (!param.layer(layer_id).has_phase())
       param.mutable_layer(layer_id)->set_phase(phase_);
+    if (param.has_cpu_weight_dtype() &&
+        !param.layer(layer_id).has_cpu_weight_dtype())
+      param.mutable_layer(layer_id)->set_cpu_weight_dtype(
+          param.cpu_weight_dtype());
 #ifdef USE_MLU
     if (param.layer(layer_id).blobs_dtype_size() &&
         (param.layer(layer_id).blobs_dtype(0).type() == DT_INT8)) {
@@ -221,8 +246,14 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
         AppendTop(param, layer_id, num_top, NULL, NULL);
       }
     }
+    if (weights_owner_ != NULL) {
+      ShareLayerBlobs(layer_id);
+    }
     // After this layer is connected, set it up.
     layers_[layer_id]->SetUp(bottom_vecs_[layer_id], top_vecs_[layer_id]);
+    if (weights_owner_ != NULL) {
+      ShareLayerBlobs(layer_id);
+    }
     LOG_IF(INFO, Caffe::root_solver()) << "Setting up "
                                        << layer_names_[layer_id];
 
@@ -391,6 +422,24 @@ void Net<Dtype>::Init(const NetParameter& in_param) {
   }
   ShareWeights();
   debug_info_ = in_param.debug_info();
+  InitElementwiseChains();
+  InitResidualBlocks();
+  const int num_views = InitDataViews();
+  LOG_IF(INFO, Caffe::root_solver() && num_views > 0)
+      << num_views << " Concat/Slice parts share memory with their result";
+  if (param.cpu_weight_dtype() != DT_FLOAT32) {
+    // Only the packed CPU InnerProduct weights can be kept in 16 bits.
+    bool weights_converted = false;
+    for (int i = 0; i < layers_.size(); ++i) {
+      weights_converted = weights_converted ||
+          (string(layers_[i]->type()) == "InnerProduct" &&
+           layers_[i]->layer_param().phase() == TEST);
+    }
+    LOG_IF(WARNING, Caffe::mode() != Caffe::CPU || !weights_converted)
+        << "cpu_weight_dtype " << BaseDataType_Name(param.cpu_weight_dtype())
+        << " has no effect: no layer of " << name_
+        << " keeps its weights in it in this mode.";
+  }
   LOG_IF(INFO, Caffe::root_solver()) << "Network initialization done.";
 
 #ifdef USE_MLU
@@ -998,9 +1047,24 @@ Dtype Net<Dtype>::ForwardFromTo_default(int start, int end) {
   vector<int> debug_layer_ids;
   debug_layer_ids.clear();
   for (int i = start; i <= end; ++i) {
+    const int block_end = ResidualBlockEnd(i, end);
+    if (block_end > i + 1) {
+      ForwardResidualBlock(i, block_end);
+      i = block_end - 1;
+      continue;
+    }
+    const int chain_end = ElementwiseChainEnd(i, end);
+    if (chain_end > i + 1) {
+      ForwardElementwiseLayers(i, chain_end);
+      i = chain_end - 1;
+      continue;
+    }
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
+    if (joins_data_views_[i]) {
+      RefreshDataViews(i);
+    }
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
 
@@ -1066,9 +1130,24 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
   CHECK_LT(end, layers_.size());
   Dtype loss = 0;
   for (int i = start; i <= end; ++i) {
+    const int block_end = ResidualBlockEnd(i, end);
+    if (block_end > i + 1) {
+      ForwardResidualBlock(i, block_end);
+      i = block_end - 1;
+      continue;
+    }
+    const int chain_end = ElementwiseChainEnd(i, end);
+    if (chain_end > i + 1) {
+      ForwardElementwiseLayers(i, chain_end);
+      i = chain_end - 1;
+      continue;
+    }
     for (int c = 0; c < before_forward_.size(); ++c) {
       before_forward_[c]->run(i);
     }
+    if (joins_data_views_[i]) {
+      RefreshDataViews(i);
+    }
     Dtype layer_loss = layers_[i]->Forward(bottom_vecs_[i], top_vecs_[i]);
     loss += layer_loss;
     if (debug_info_) {
@@ -1083,6 +1162,312 @@ Dtype Net<Dtype>::ForwardFromTo(int start, int end) {
 
 #endif  // USE_MLU
 
+template <typename Dtype>
+void Net<Dtype>::InitElementwiseChains() {
+  elementwise_chain_end_.assign(layers_.size(), 0);
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (!layers_[i]->IsElementwise() || bottom_vecs_[i].size() != 1 ||
+        top_vecs_[i].size() != 1 || layers_[i]->loss(0) != 0) {
+      continue;
+    }
+    Blob<Dtype>* blob = top_vecs_[i][0];
+    int end = i + 1;
+    while (end < layers_.size() && layers_[end]->IsElementwise() &&
+           bottom_vecs_[end].size() == 1 && top_vecs_[end].size() == 1 &&
+           bottom_vecs_[end][0] == blob && top_vecs_[end][0] == blob &&
+           layers_[end]->loss(0) == 0) {
+      ++end;
+    }
+    if (end - i > 1) {
+      elementwise_chain_end_[i] = end;
+      LOG_IF(INFO, Caffe::root_solver())
+          << "Fusing elementwise layers " << layer_names_[i] << " to "
+          << layer_names_[end - 1];
+      i = end - 1;
+    }
+  }
+}
+
+template <typename Dtype>
+int Net<Dtype>::ElementwiseChainEnd(const int layer_id, const int end) const {
+  const int chain_end = elementwise_chain_end_[layer_id];
+  // The layers of a chain run as one, so only whole chains are fused and
+  // not when anything needs to observe the individual layers.
+  if (chain_end == 0 || chain_end > end + 1 || Caffe::mode() != Caffe::CPU ||
+      debug_info_ || !before_forward_.empty() || !after_forward_.empty()) {
+    return layer_id + 1;
+  }
+  return chain_end;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ForwardElementwiseLayers(const int start, const int end) {
+  // Layers such as Scale and BatchNorm index channels by their shapes.
+  vector<Layer<Dtype>*> layers;
+  for (int i = start; i < end; ++i) {
+    layers_[i]->ReshapeIfNeeded(bottom_vecs_[i], top_vecs_[i]);
+    layers.push_back(layers_[i].get());
+  }
+  Blob<Dtype>* top = top_vecs_[start][0];
+  const Dtype* bottom_data = bottom_vecs_[start][0]->cpu_data();
+  ForwardElementwiseChain(layers, top->count(), bottom_data,
+                          top->mutable_cpu_data());
+}
+
+template <typename Dtype>
+void Net<Dtype>::InitResidualBlocks() {
+  residual_block_end_.assign(layers_.size(), 0);
+  residual_sum_id_.assign(layers_.size(), 0);
+  // The sum aliases the convolution's output, which only the fused CPU
+  // forward pass expects.
+  if (phase_ != TEST || Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  vector<bool> is_output(blobs_.size(), false);
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    is_output[net_output_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < layers_.size(); ++i) {
+    // A first convolution that also normalises its input is left alone.
+    const ConvolutionParameter& conv_param =
+        layers_[i]->layer_param().convolution_param();
+    if (!dynamic_cast<ConvolutionLayer<Dtype>*>(layers_[i].get()) ||
+        bottom_vecs_[i].size() != 1 || top_vecs_[i].size() != 1 ||
+        bottom_vecs_[i][0] == top_vecs_[i][0] || conv_param.has_mean_file() ||
+        conv_param.mean_value_size() > 0 || conv_param.has_std() ||
+        conv_param.has_scale()) {
+      continue;
+    }
+    Blob<Dtype>* conv_top = top_vecs_[i][0];
+    int sum_id = i + 1;
+    while (sum_id < layers_.size() && layers_[sum_id]->IsElementwise() &&
+           bottom_vecs_[sum_id][0] == conv_top &&
+           top_vecs_[sum_id][0] == conv_top &&
+           layers_[sum_id]->loss(0) == 0) {
+      ++sum_id;
+    }
+    if (sum_id == layers_.size()) {
+      break;
+    }
+    const LayerParameter& sum_param = layers_[sum_id]->layer_param();
+    const EltwiseParameter& eltwise_param = sum_param.eltwise_param();
+    bool unit_coeffs = true;
+    for (int j = 0; j < eltwise_param.coeff_size(); ++j) {
+      unit_coeffs = unit_coeffs && eltwise_param.coeff(j) == 1;
+    }
+    if (sum_param.type() != "Eltwise" ||
+        eltwise_param.operation() != EltwiseParameter_EltwiseOp_SUM ||
+        !unit_coeffs || bottom_vecs_[sum_id].size() != 2 ||
+        top_vecs_[sum_id].size() != 1 ||
+        (bottom_vecs_[sum_id][0] == conv_top) ==
+        (bottom_vecs_[sum_id][1] == conv_top)) {
+      continue;
+    }
+    // The convolution's own output must not be needed after the sum.
+    const int conv_top_id = top_id_vecs_[i][0];
+    bool conv_top_read = is_output[conv_top_id];
+    for (int j = sum_id + 1; j < layers_.size(); ++j) {
+      const vector<int>& bottom_ids = bottom_id_vecs_[j];
+      conv_top_read = conv_top_read || std::find(bottom_ids.begin(),
+          bottom_ids.end(), conv_top_id) != bottom_ids.end();
+    }
+    if (conv_top_read) {
+      continue;
+    }
+    Blob<Dtype>* sum = top_vecs_[sum_id][0];
+    int end = sum_id + 1;
+    while (end < layers_.size() && layers_[end]->IsElementwise() &&
+           bottom_vecs_[end][0] == sum && top_vecs_[end][0] == sum &&
+           layers_[end]->loss(0) == 0) {
+      ++end;
+    }
+    // The sum is formed in the convolution's output, so the Eltwise needs
+    // no memory of its own; EltwiseLayer also sums in place when unfused.
+    if (sum != conv_top && sum != bottom_vecs_[sum_id][0] &&
+        sum != bottom_vecs_[sum_id][1]) {
+      sum->ShareData(*conv_top);
+    }
+    residual_block_end_[i] = end;
+    residual_sum_id_[i] = sum_id;
+    LOG_IF(INFO, Caffe::root_solver())
+        << "Fusing residual block " << layer_names_[i] << " to "
+        << layer_names_[end - 1];
+    i = end - 1;
+  }
+}
+
+template <typename Dtype>
+int Net<Dtype>::ResidualBlockEnd(const int layer_id, const int end) const {
+  const int block_end = residual_block_end_[layer_id];
+  if (block_end == 0 || block_end > end + 1 || Caffe::mode() != Caffe::CPU ||
+      debug_info_ || !before_forward_.empty() || !after_forward_.empty()) {
+    return layer_id + 1;
+  }
+  return block_end;
+}
+
+template <typename Dtype>
+void Net<Dtype>::ForwardResidualBlock(const int start, const int end) {
+  const int sum_id = residual_sum_id_[start];
+  for (int i = start; i < end; ++i) {
+    layers_[i]->ReshapeIfNeeded(bottom_vecs_[i], top_vecs_[i]);
+  }
+  Blob<Dtype>* conv_top = top_vecs_[start][0];
+  Blob<Dtype>* sum = top_vecs_[sum_id][0];
+  const Blob<Dtype>* residual = bottom_vecs_[sum_id][0] == conv_top ?
+      bottom_vecs_[sum_id][1] : bottom_vecs_[sum_id][0];
+  // The convolution's output may have been reallocated by a reshape.
+  if (sum != conv_top && sum != residual && sum->data() != conv_top->data()) {
+    sum->ShareData(*conv_top);
+  }
+  vector<Layer<Dtype>*> pre, post;
+  for (int i = start + 1; i < sum_id; ++i) {
+    pre.push_back(layers_[i].get());
+  }
+  for (int i = sum_id + 1; i < end; ++i) {
+    post.push_back(layers_[i].get());
+  }
+  static_cast<ConvolutionLayer<Dtype>*>(layers_[start].get())->
+      ForwardResidual_cpu(bottom_vecs_[start], top_vecs_[start], pre,
+                          *residual, post, sum);
+}
+
+template <typename Dtype>
+int Net<Dtype>::InitDataViews() {
+  data_view_.assign(blobs_.size(), false);
+  joins_data_views_.assign(layers_.size(), false);
+  if (Caffe::mode() != Caffe::CPU) {
+    return 0;
+  }
+  // Inputs and outputs are handed to the caller and keep their own memory.
+  vector<bool> pinned(blobs_.size(), false);
+  for (int i = 0; i < net_input_blob_indices_.size(); ++i) {
+    pinned[net_input_blob_indices_[i]] = true;
+  }
+  for (int i = 0; i < net_output_blob_indices_.size(); ++i) {
+    pinned[net_output_blob_indices_[i]] = true;
+  }
+  // Blobs whose memory may belong to the caller: the pinned ones and the
+  // outputs of data layers, e.g. the buffer given to a MemoryData layer.
+  vector<bool> external(pinned);
+  for (int i = 0; i < layers_.size(); ++i) {
+    if (bottom_id_vecs_[i].empty()) {
+      for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+        external[top_id_vecs_[i][j]] = true;
+      }
+    }
+  }
+  // Layers reading each blob and layers writing it in place, in order.
+  vector<vector<int> > readers(blobs_.size());
+  vector<vector<int> > writers(blobs_.size());
+  for (int i = 0; i < layers_.size(); ++i) {
+    const vector<int>& bottom_ids = bottom_id_vecs_[i];
+    for (int j = 0; j < bottom_ids.size(); ++j) {
+      readers[bottom_ids[j]].push_back(i);
+    }
+    for (int j = 0; j < top_id_vecs_[i].size(); ++j) {
+      if (std::find(bottom_ids.begin(), bottom_ids.end(),
+                    top_id_vecs_[i][j]) != bottom_ids.end()) {
+        writers[top_id_vecs_[i][j]].push_back(i);
+      }
+    }
+  }
+  // Going backwards, a Concat feeding another Concat becomes a view into
+  // the outer result before its own inputs are placed inside it.
+  vector<bool>& viewed = data_view_;
+  int num_views = 0;
+  for (int i = layers_.size() - 1; i >= 0; --i) {
+    const LayerParameter& param = layers_[i]->layer_param();
+    const bool concat = param.type() == "Concat";
+    if (!concat && param.type() != "Slice") {
+      continue;
+    }
+    const vector<int>& part_ids =
+        concat ? bottom_id_vecs_[i] : top_id_vecs_[i];
+    const int whole_id = concat ? top_id_vecs_[i][0] : bottom_id_vecs_[i][0];
+    Blob<Dtype>* whole = blobs_[whole_id].get();
+    // Writing the whole in place later would change the parts, which
+    // Backward may still read, or which a Slice hands on.
+    const bool whole_modified = !writers[whole_id].empty() &&
+        writers[whole_id].back() > i;
+    if (part_ids.size() < 2 || (whole_modified && (!concat ||
+                                                   phase_ == TRAIN))) {
+      continue;
+    }
+    // Slice outputs are repointed by RefreshDataViews before they are
+    // written, but the inputs of a Concat are written by earlier layers, so
+    // its output must not be handed memory by the caller.
+    if (concat && pinned[whole_id]) {
+      continue;
+    }
+    int axis;
+    if (concat) {
+      const ConcatParameter& concat_param = param.concat_param();
+      axis = concat_param.has_concat_dim() ? concat_param.concat_dim() :
+          whole->CanonicalAxisIndex(concat_param.axis());
+    } else {
+      const SliceParameter& slice_param = param.slice_param();
+      axis = slice_param.has_slice_dim() ? slice_param.slice_dim() :
+          whole->CanonicalAxisIndex(slice_param.axis());
+    }
+    // The parts are contiguous in the whole only if nothing is outside.
+    if (whole->count(0, axis) != 1) {
+      continue;
+    }
+    const bool whole_read = !readers[whole_id].empty() &&
+        readers[whole_id].back() > i;
+    int offset = 0;
+    for (int j = 0; j < part_ids.size(); ++j) {
+      const int part_id = part_ids[j];
+      Blob<Dtype>* part = blobs_[part_id].get();
+      const bool part_modified = !writers[part_id].empty() &&
+          writers[part_id].back() > i;
+      const bool part_read = !readers[part_id].empty() &&
+          readers[part_id].back() > i;
+      // A part written in place after the join must not show through
+      // the whole where it is still read, and vice versa. Nor may it write
+      // into memory of the caller, which would change the next input.
+      const bool safe = concat ?
+          !part_modified && !(whole_modified && part_read) :
+          !part_modified || (phase_ != TRAIN && !whole_read &&
+                             !external[whole_id]);
+      // A part whose memory is shared, e.g. by a Flatten, keeps it.
+      if (safe && !pinned[part_id] && !viewed[part_id] &&
+          part->data().use_count() == 1) {
+        part->ShareDataAt(*whole, offset);
+        viewed[part_id] = true;
+        joins_data_views_[i] = true;
+        ++num_views;
+      }
+      offset += part->count();
+    }
+  }
+  return num_views;
+}
+
+template <typename Dtype>
+void Net<Dtype>::RefreshDataViews(const int layer_id) {
+  // Sizes the parts for the whole's current shape first.
+  layers_[layer_id]->ReshapeIfNeeded(bottom_vecs_[layer_id],
+                                     top_vecs_[layer_id]);
+  const bool concat = layers_[layer_id]->layer_param().type() == "Concat";
+  const vector<Blob<Dtype>*>& parts =
+      concat ? bottom_vecs_[layer_id] : top_vecs_[layer_id];
+  const vector<int>& part_ids =
+      concat ? bottom_id_vecs_[layer_id] : top_id_vecs_[layer_id];
+  Blob<Dtype>* whole =
+      concat ? top_vecs_[layer_id][0] : bottom_vecs_[layer_id][0];
+  const Dtype* whole_data = whole->cpu_data();
+  int offset = 0;
+  for (int j = 0; j < parts.size(); ++j) {
+    if (data_view_[part_ids[j]] &&
+        parts[j]->cpu_data() != whole_data + offset) {
+      parts[j]->ShareDataAt(*whole, offset);
+    }
+    offset += parts[j]->count();
+  }
+}
+
 template <typename Dtype>
 Dtype Net<Dtype>::ForwardFrom(int start) {
   return ForwardFromTo(start, layers_.size() - 1);
@@ -1475,6 +1860,35 @@ void Net<Dtype>::OfflineDestroy() {
 
 #endif
 
+template <typename Dtype>
+void Net<Dtype>::ShareLayerBlobs(const int layer_id) {
+  CHECK_LT(layer_id, weights_owner_->layers().size())
+      << "Net does not match the layers of its weights owner";
+  CHECK_EQ(layer_names_[layer_id], weights_owner_->layer_names()[layer_id])
+      << "Net does not match the layers of its weights owner";
+  const vector<shared_ptr<Blob<Dtype>>>& source_blobs =
+      weights_owner_->layers()[layer_id]->blobs();
+  vector<shared_ptr<Blob<Dtype>>>& target_blobs = layers_[layer_id]->blobs();
+  if (target_blobs.empty()) {
+    // Before SetUp: layers skip parameter initialization when their blobs
+    // are already present, so the owner's blobs are simply handed over.
+    target_blobs = source_blobs;
+    return;
+  }
+  // After SetUp: layers that rebuild their blobs (e.g. RecurrentLayer) get
+  // their storage replaced by the owner's.
+  CHECK_EQ(target_blobs.size(), source_blobs.size())
+      << "Incompatible number of blobs for layer " << layer_names_[layer_id];
+  for (int i = 0; i < target_blobs.size(); ++i) {
+    if (target_blobs[i] != source_blobs[i]) {
+      CHECK(target_blobs[i]->shape() == source_blobs[i]->shape())
+          << "Cannot share param " << i << " of layer "
+          << layer_names_[layer_id] << "; shape mismatch.";
+      target_blobs[i]->ShareData(*source_blobs[i]);
+    }
+  }
+}
+
 template <typename Dtype>
 void Net<Dtype>::ShareTrainedLayersWith(const Net* other) {
   int num_source_layers = other->layers().size();
@@ -1560,9 +1974,10 @@ void Net<Dtype>::Reshape() {
   }
 #else   // USE_MLU (false)
   for (int i = 0; i < layers_.size(); ++i) {
-    layers_[i]->Reshape(bottom_vecs_[i], top_vecs_[i]);
+    layers_[i]->ReshapeIfNeeded(bottom_vecs_[i], top_vecs_[i]);
   }
 #endif  // USE_MLU
+  InitDataViews();
 }
 
 template <typename Dtype>
@@ -1633,6 +2048,10 @@ void Net<Dtype>::CopyTrainedLayersFrom(const NetParameter& param) {
 
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFrom(const string trained_filename) {
+  if (IsMappedWeightsFile(trained_filename)) {
+    CopyTrainedLayersFromMapped(trained_filename);
+    return;
+  }
 #ifdef USE_HDF5
   if (H5Fis_hdf5(trained_filename.c_str())) {
     CopyTrainedLayersFromHDF5(trained_filename);
@@ -1672,6 +2091,7 @@ void Net<Dtype>::CopyTrainedLayersFromBinaryProto(void* buffer,
 template <typename Dtype>
 void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
 #ifdef USE_HDF5
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hid_t file_hid =
       H5Fopen(trained_filename.c_str(), H5F_ACC_RDONLY, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << trained_filename;
@@ -1720,6 +2140,70 @@ void Net<Dtype>::CopyTrainedLayersFromHDF5(const string trained_filename) {
 #endif
 }
 
+template <typename Dtype>
+void Net<Dtype>::CopyTrainedLayersFromMapped(const string trained_filename) {
+#ifdef USE_MLU
+  // ConvBnScale folding rewrites the convolution weights, which would touch
+  // every mapped page; convert the folded model instead.
+  CHECK_GE(opt_level_, 0) << "ConvBnScale optimization is not supported "
+                          << "with mapped weights: " << trained_filename;
+#endif
+  shared_ptr<MappedWeights> weights(new MappedWeights(trained_filename));
+  const MappedWeightsIndex& index = weights->index();
+  const BaseDataType dtype = sizeof(Dtype) == sizeof(double) ? DT_DOUBLE
+                                                             : DT_FLOAT32;
+  for (int i = 0; i < index.layer_size(); ++i) {
+    const MappedLayerIndex& source_layer = index.layer(i);
+    const string& source_layer_name = source_layer.name();
+    if (!layer_names_index_.count(source_layer_name)) {
+      LOG(INFO) << "Ignoring source layer " << source_layer_name;
+      continue;
+    }
+    int target_layer_id = layer_names_index_[source_layer_name];
+    DLOG(INFO) << "Mapping source layer " << source_layer_name;
+    vector<shared_ptr<Blob<Dtype>>>& target_blobs =
+        layers_[target_layer_id]->blobs();
+    CHECK_EQ(target_blobs.size(), source_layer.blobs_size())
+        << "Incompatible number of blobs for layer " << source_layer_name;
+    for (int j = 0; j < target_blobs.size(); ++j) {
+      const MappedBlobIndex& source_blob = source_layer.blobs(j);
+      // Equal counts are not enough: a transposed matrix would load
+      // scrambled.
+      BlobProto source_shape;
+      *source_shape.mutable_shape() = source_blob.shape();
+      if (!target_blobs[j]->ShapeEquals(source_shape)) {
+        Blob<Dtype> shaped;
+        shaped.Reshape(source_blob.shape());
+        LOG(FATAL)
+            << "Cannot copy param " << j << " weights from layer '"
+            << source_layer_name << "'; shape mismatch.  Source param shape is "
+            << shaped.shape_string() << "; target param shape is "
+            << target_blobs[j]->shape_string() << ". "
+            << "To learn this layer's parameters from scratch rather than "
+            << "copying from a saved net, rename the layer.";
+      }
+      const int count = target_blobs[j]->count();
+      void* data = weights->blob_data(source_blob);
+      if (source_blob.dtype() == dtype) {
+        target_blobs[j]->set_cpu_data(static_cast<Dtype*>(data));
+      } else if (source_blob.dtype() == DT_FLOAT32) {
+        const float* source_data = static_cast<const float*>(data);
+        Dtype* target_data = target_blobs[j]->mutable_cpu_data();
+        for (int k = 0; k < count; ++k) {
+          target_data[k] = source_data[k];
+        }
+      } else {
+        const double* source_data = static_cast<const double*>(data);
+        Dtype* target_data = target_blobs[j]->mutable_cpu_data();
+        for (int k = 0; k < count; ++k) {
+          target_data[k] = source_data[k];
+        }
+      }
+    }
+  }
+  mapped_weights_.push_back(weights);
+}
+
 template <typename Dtype>
 void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
   param->Clear();
@@ -1735,6 +2219,7 @@ void Net<Dtype>::ToProto(NetParameter* param, bool write_diff) const {
 template <typename Dtype>
 void Net<Dtype>::ToHDF5(const string& filename, bool write_diff) const {
 #ifdef USE_HDF5
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hid_t file_hid =
       H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
   CHECK_GE(file_hid, 0) << "Couldn't open " << filename << " to save weights.";
@@ -1830,6 +2315,12 @@ void Net<Dtype>::ShareWeights() {
     if (param_owners_[i] < 0) {
       continue;
     }
+    // Blobs handed over by a weights owner are shared already; leave them
+    // untouched as other nets may be reading them concurrently.
+    if (params_[i]->data() == params_[param_owners_[i]]->data() &&
+        params_[i]->diff() == params_[param_owners_[i]]->diff()) {
+      continue;
+    }
     params_[i]->ShareData(*params_[param_owners_[i]]);
     params_[i]->ShareDiff(*params_[param_owners_[i]]);
   }
@@ -0,0 +1,78 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <vector>
+
+#include "caffe/net_model.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+NetModel<Dtype>::NetModel(const string& param_file,
+                          const string& trained_file) {
+  ReadNetParamsFromTextFileOrDie(param_file, &param_);
+  Init(trained_file);
+}
+
+template <typename Dtype>
+NetModel<Dtype>::NetModel(const NetParameter& param,
+                          const string& trained_file)
+    : param_(param) {
+  Init(trained_file);
+}
+
+template <typename Dtype>
+void NetModel<Dtype>::Init(const string& trained_file) {
+  CHECK_EQ(Caffe::mode(), Caffe::CPU)
+      << "NetModel shares weights on the host and only supports CPU mode";
+  param_.mutable_state()->set_phase(TEST);
+  net_.reset(new Net<Dtype>(param_));
+  if (!trained_file.empty()) {
+    net_->CopyTrainedLayersFrom(trained_file);
+  }
+  // Move every parameter to the host now, so that the contexts only ever
+  // read the SyncedMemory state and never have to change it.
+  const vector<shared_ptr<Blob<Dtype> > >& params = net_->params();
+  for (int i = 0; i < params.size(); ++i) {
+    params[i]->cpu_data();
+  }
+}
+
+template <typename Dtype>
+shared_ptr<Net<Dtype> > NetModel<Dtype>::CreateContext() const {
+  CHECK_EQ(Caffe::mode(), Caffe::CPU)
+      << "NetModel contexts only support CPU mode";
+  return shared_ptr<Net<Dtype> >(new Net<Dtype>(param_, net_.get()));
+}
+
+INSTANTIATE_CLASS(NetModel);
+
+}  // namespace caffe
@@ -32,28 +32,27 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/mlu/tensor.hpp"
 #include "caffe/syncedmem.hpp"
+#include "caffe/util/layout_cast.hpp"
 #include "caffe/util/math_functions.hpp"
 
 namespace caffe {
 
-static inline void cast_data_type(void* src_addr, void* dst_addr,
-   cnrtMemTransDir_t dir, const MLUTensorDesc& mlu_tensor_desc) {
-  cnrtDataType_t src_data_type, dst_data_type;
+#ifdef USE_MLU
+// The conversion between the host (NCHW, cpu_type) and device (NHWC,
+// mlu_type) forms of a tensor in direction dir.
+static LayoutCastParam layout_cast_param(cnrtMemTransDir_t dir,
+    const MLUTensorDesc& mlu_tensor_desc) {
   BaseDataType mlu_type = mlu_tensor_desc.mlu_type();
   cnmlTensorType_t type = mlu_tensor_desc.type();
   int shape_dim = mlu_tensor_desc.shape_dim();
-  vector<int> dim_values;
   vector<int> dim_order(shape_dim, 0);
-  size_t size;
-  MLU_CHECK(cnmlGetTensorSize_V2(mlu_tensor_desc.mlu(), &size));
-  cnrtDataType_t cpu_dtype = to_cnrt_dtype(mlu_tensor_desc.cpu_type());
-  cnrtDataType_t mlu_dtype = to_cnrt_dtype(mlu_tensor_desc.mlu_type());
+  LayoutCastParam param;
 
   // init
   if (dir == CNRT_MEM_TRANS_DIR_HOST2DEV) {
-    src_data_type = cpu_dtype;
-    dst_data_type = mlu_dtype;
-    dim_values = mlu_tensor_desc.cpu_shape();
+    param.src_type = mlu_tensor_desc.cpu_type();
+    param.dst_type = mlu_type;
+    param.src_shape = mlu_tensor_desc.cpu_shape();
     dim_order[0] = 0;
     dim_order[shape_dim - 1] = 1;
     for (int i = 1; i < shape_dim - 1; i++) {
@@ -63,9 +62,9 @@ static inline void cast_data_type(void* src_addr, void* dst_addr,
     if (mlu_tensor_desc.has_dim_strides())
        LOG(WARNING) << "The data is supplemented with the stride,"
          << " and the data is synchronized from the mlu device.";
-    src_data_type = mlu_dtype;
-    dst_data_type = cpu_dtype;
-    dim_values = mlu_tensor_desc.mlu_shape();
+    param.src_type = mlu_type;
+    param.dst_type = mlu_tensor_desc.cpu_type();
+    param.src_shape = mlu_tensor_desc.mlu_shape();
     dim_order[0] = 0;
     dim_order[1] = shape_dim - 1;
     for (int i = 2 ; i < shape_dim; i++) {
@@ -76,59 +75,124 @@ static inline void cast_data_type(void* src_addr, void* dst_addr,
   }
 
   // quantized param
-  cnrtQuantizedParam_t param = nullptr;
   if ((mlu_type == DT_INT8 || mlu_type == DT_INT16) &&
       (type == CNML_FILTER || type == CNML_CONST)) {
     if (!mlu_tensor_desc.has_position()) {
       LOG(FATAL) << "Quantize tensor should have position";
     }
-    CNRT_CHECK(cnrtCreateQuantizedParam(&param, mlu_tensor_desc.position(),
-          mlu_tensor_desc.scale(), 0));
+    param.quantized = true;
+    param.position = mlu_tensor_desc.position();
+    param.scale = mlu_tensor_desc.scale();
   }
 
-  // castDataType
-  int cast_size = mlu_tensor_desc.data_num() * cnrtDataTypeSize(dst_data_type);
-  void* cast_ptr = malloc(cast_size);
-  if (src_data_type != dst_data_type) {
-     cnrtCastDataType(src_addr, src_data_type, cast_ptr, dst_data_type,
-         mlu_tensor_desc.data_num(), param);
-  } else {
-     memcpy(cast_ptr, src_addr, cast_size);
+  // Reorder and stride padding only apply to preprocessed tensors; the
+  // strides are given for the host axes.
+  if (mlu_tensor_desc.is_preprocess()) {
+    param.order = dim_order;
+    if (mlu_tensor_desc.has_dim_strides() &&
+        dir == CNRT_MEM_TRANS_DIR_HOST2DEV) {
+      const vector<int> dim_strides = mlu_tensor_desc.dim_strides();
+      param.pad.resize(shape_dim);
+      for (int i = 0; i < shape_dim; i++) {
+        param.pad[i] = dim_strides[dim_order[i]];
+      }
+    }
   }
+  return param;
+}
 
-  // addStrideData
-  void* stride_ptr = nullptr;
-  vector<int> dim_value_for_trans = dim_values;
-  bool add_stride = mlu_tensor_desc.has_dim_strides() &&
-    dir == CNRT_MEM_TRANS_DIR_HOST2DEV;
-  if (add_stride) {
-     stride_ptr = malloc(size);
-     cnrtAddDataStride(cast_ptr, dst_data_type, stride_ptr, shape_dim,
-        mlu_tensor_desc.cpu_shape().data(), mlu_tensor_desc.dim_strides().data());
-     for (int i = 0; i < mlu_tensor_desc.shape_dim(); i++) {
-        dim_value_for_trans[i] += mlu_tensor_desc.dim_strides().data()[i];
-     }
+// Converts between the two forms in one pass over the data, into dst_addr.
+static inline void cast_data_type(void* src_addr, void* dst_addr,
+   cnrtMemTransDir_t dir, const MLUTensorDesc& mlu_tensor_desc) {
+  caffe_cpu_layout_cast(layout_cast_param(dir, mlu_tensor_desc), src_addr,
+      dst_addr);
+}
+#endif
+
+// The device buffers and host staging area of prefetch_to. The front slot
+// is the one the device computes on; transfers to the device fill the
+// other. Jobs only touch buffers captured at submission, so the state may
+// change on the calling thread while one is in flight.
+class SyncedMemory::StagingState {
+  public:
+  explicit StagingState(DeviceBackend* backend)
+      : backend_(backend), front_(0), host_(NULL), host_size_(0), ticket_(0),
+        pending_(false), direction_(STAGE_TO_DEVICE), mlu_(false) {
+    for (int i = 0; i < 2; ++i) {
+      slot_[i] = NULL;
+      slot_size_[i] = 0;
+    }
   }
 
-  // transDataOrder
-  if (!mlu_tensor_desc.is_preprocess()) {
-    memcpy(dst_addr, cast_ptr, cast_size);
-    return;
+  ~StagingState() {
+    for (int i = 0; i < 2; ++i) {
+      if (slot_[i]) {
+        backend_->Free(slot_[i]);
+      }
+    }
+    if (host_) {
+      HostAllocator::Get().Free(host_);
+    }
+  }
+
+  void* slot(int i, size_t size) {
+    if (slot_size_[i] < size) {
+      if (slot_[i]) {
+        backend_->Free(slot_[i]);
+      }
+      slot_[i] = backend_->Malloc(size);
+      slot_size_[i] = size;
+    }
+    return slot_[i];
   }
-  cnrtTransDataOrder(add_stride? stride_ptr: cast_ptr,
-                     dst_data_type, dst_addr, shape_dim,
-                     dim_value_for_trans.data(), dim_order.data());
 
-  // free
-  if (param) {
-    CNRT_CHECK(cnrtDestroyQuantizedParam(param));
+  void* host(size_t size) {
+    if (host_size_ < size) {
+      if (host_) {
+        HostAllocator::Get().Free(host_);
+      }
+      host_ = HostAllocator::Get().Allocate(size, "SyncedMemory::staging");
+      host_size_ = size;
+    }
+    return host_;
   }
-  if (cast_ptr != nullptr) free(cast_ptr);
-  if (stride_ptr != nullptr) free(stride_ptr);
+
+  DeviceBackend* backend_;
+  void* slot_[2];
+  size_t slot_size_[2];
+  int front_;
+  void* host_;
+  size_t host_size_;
+  uint64_t ticket_;
+  bool pending_;
+  StagingDirection direction_;
+  bool mlu_;  // the transfer pending is between the host data and mlu_ptr_
+};
+
+// Queues the transfer of src to dst, converted by param, on the I/O thread
+// of backend. The conversion goes through host when given; without it the
+// data is copied as is.
+static uint64_t submit_transfer(DeviceBackend* backend,
+    SyncedMemory::StagingDirection dir, const LayoutCastParam& param,
+    const void* src, void* host, void* dst, size_t device_size) {
+  return backend->Submit([=]() {
+    if (dir == SyncedMemory::STAGE_TO_DEVICE) {
+      if (host) {
+        caffe_cpu_layout_cast(param, src, host);
+      }
+      backend->CopyToDevice(dst, host ? host : src, device_size);
+    } else {
+      backend->CopyToHost(host ? host : dst, src, device_size);
+      if (host) {
+        caffe_cpu_layout_cast(param, host, dst);
+      }
+    }
+  });
 }
 
 SyncedMemory::SyncedMemory()
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(0), head_(UNINITIALIZED),
+    version_(0),
 #ifdef USE_MLU
     mlu_ptr_(nullptr), sync_ptr_(NULL),
 #endif
@@ -147,6 +211,7 @@ SyncedMemory::SyncedMemory()
 
 SyncedMemory::SyncedMemory(size_t size)
   : cpu_ptr_(NULL), gpu_ptr_(NULL), size_(size), head_(UNINITIALIZED),
+    version_(0),
 #ifdef USE_MLU
     mlu_ptr_(nullptr), sync_ptr_(NULL),
 #endif
@@ -165,6 +230,7 @@ SyncedMemory::SyncedMemory(size_t size)
 
 SyncedMemory::~SyncedMemory() {
   check_device();
+  wait();
   if (cpu_ptr_ && own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
   }
@@ -189,7 +255,8 @@ inline void SyncedMemory::to_cpu() {
   check_device();
   switch (head_) {
   case UNINITIALIZED:
-    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+        "SyncedMemory");
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -197,7 +264,8 @@ inline void SyncedMemory::to_cpu() {
   case HEAD_AT_GPU:
 #ifdef USE_CUDA
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+          "SyncedMemory");
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
@@ -253,6 +321,9 @@ inline void SyncedMemory::to_gpu() {
 
 const void* SyncedMemory::cpu_data() {
   check_device();
+  if (staging_pending(STAGE_TO_HOST)) {
+    wait();
+  }
   to_cpu();
   return (const void*)cpu_ptr_;
 }
@@ -260,12 +331,14 @@ const void* SyncedMemory::cpu_data() {
 void SyncedMemory::set_cpu_data(void* data) {
   check_device();
   CHECK(data);
+  wait();
   if (own_cpu_data_) {
     CaffeFreeHost(cpu_ptr_, cpu_malloc_use_cuda_);
   }
   cpu_ptr_ = data;
   head_ = HEAD_AT_CPU;
   own_cpu_data_ = false;
+  ++version_;
 }
 
 const void* SyncedMemory::gpu_data() {
@@ -289,6 +362,7 @@ void SyncedMemory::set_gpu_data(void* data) {
   gpu_ptr_ = data;
   head_ = HEAD_AT_GPU;
   own_gpu_data_ = false;
+  ++version_;
 #else
   NO_GPU;
 #endif
@@ -296,8 +370,10 @@ void SyncedMemory::set_gpu_data(void* data) {
 
 void* SyncedMemory::mutable_cpu_data() {
   check_device();
+  wait();
   to_cpu();
   head_ = HEAD_AT_CPU;
+  ++version_;
   return cpu_ptr_;
 }
 
@@ -306,6 +382,7 @@ void* SyncedMemory::mutable_gpu_data() {
 #ifdef USE_CUDA
   to_gpu();
   head_ = HEAD_AT_GPU;
+  ++version_;
   return gpu_ptr_;
 #else
   NO_GPU;
@@ -318,6 +395,7 @@ void* SyncedMemory::mutable_gpu_data() {
 void* SyncedMemory::mutable_sync_data(const MLUTensorDesc& mlu_tensor_desc) {
   check_device();
   to_sync(mlu_tensor_desc);
+  ++version_;
   return sync_ptr_;
 }
 
@@ -329,7 +407,8 @@ void SyncedMemory::to_sync(const MLUTensorDesc& mlu_tensor_desc) {
     size_t sync_cpu_size;
     MLU_CHECK(cnmlGetTensorSize_V2(mlu_tensor_desc.mlu(), &sync_cpu_size));
     if (sync_ptr_ == NULL) {
-      CaffeMallocHost(&sync_ptr_, sync_cpu_size, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&sync_ptr_, sync_cpu_size, &cpu_malloc_use_cuda_,
+          "SyncedMemory::sync");
     }
     cast_data_type(cpu_ptr_, sync_ptr_, CNRT_MEM_TRANS_DIR_HOST2DEV, mlu_tensor_desc);
     break;
@@ -337,7 +416,8 @@ void SyncedMemory::to_sync(const MLUTensorDesc& mlu_tensor_desc) {
     break;
   case UNINITIALIZED:
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+          "SyncedMemory");
       caffe_memset(size_, 0, cpu_ptr_);
       head_ = HEAD_AT_CPU;
     }
@@ -346,7 +426,8 @@ void SyncedMemory::to_sync(const MLUTensorDesc& mlu_tensor_desc) {
     size_t sync_uninitalized_size;
     MLU_CHECK(cnmlGetTensorSize_V2(mlu_tensor_desc.mlu(), &sync_uninitalized_size));
     if (sync_ptr_ == NULL) {
-      CaffeMallocHost(&sync_ptr_, sync_uninitalized_size, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&sync_ptr_, sync_uninitalized_size, &cpu_malloc_use_cuda_,
+          "SyncedMemory::sync");
     }
     break;
   case HEAD_AT_GPU:
@@ -360,23 +441,30 @@ void SyncedMemory::to_sync(const MLUTensorDesc& mlu_tensor_desc) {
 
 void SyncedMemory::set_mlu_data(void* data) {
   CHECK(data);
+  wait();
   if (own_mlu_data_) {
     CNRT_CHECK(cnrtFree(mlu_ptr_));
   }
   mlu_ptr_ = data;
   head_ = HEAD_AT_MLU;
   own_mlu_data_ = false;
+  ++version_;
 }
 
 void* SyncedMemory::mutable_cpu_data(const MLUTensorDesc& mlu_tensor_desc) {
   check_device();
+  wait();
   to_cpu(mlu_tensor_desc);
   head_ = HEAD_AT_CPU;
+  ++version_;
   return cpu_ptr_;
 }
 
 const void* SyncedMemory::cpu_data(const MLUTensorDesc& mlu_tensor_desc) {
   check_device();
+  if (staging_pending(STAGE_TO_HOST)) {
+    wait();
+  }
   to_cpu(mlu_tensor_desc);
   return (const void*)cpu_ptr_;
 }
@@ -385,7 +473,8 @@ inline void SyncedMemory::to_cpu(const MLUTensorDesc& mlu_tensor_desc) {
   check_device();
   switch (head_) {
   case UNINITIALIZED:
-    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+    CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+        "SyncedMemory");
     caffe_memset(size_, 0, cpu_ptr_);
     head_ = HEAD_AT_CPU;
     own_cpu_data_ = true;
@@ -393,7 +482,8 @@ inline void SyncedMemory::to_cpu(const MLUTensorDesc& mlu_tensor_desc) {
   case HEAD_AT_GPU:
 #ifdef USE_CUDA
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+          "SyncedMemory");
       own_cpu_data_ = true;
     }
     caffe_gpu_memcpy(size_, gpu_ptr_, cpu_ptr_);
@@ -407,11 +497,13 @@ inline void SyncedMemory::to_cpu(const MLUTensorDesc& mlu_tensor_desc) {
     size_t cpu_sync_size;
     MLU_CHECK(cnmlGetTensorSize_V2(mlu_tensor_desc.mlu(), &cpu_sync_size));
     if (cpu_ptr_ == NULL) {
-      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+          "SyncedMemory");
       own_cpu_data_ = true;
     }
     if (sync_ptr_ == NULL) {
-      CaffeMallocHost(&sync_ptr_, cpu_sync_size, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&sync_ptr_, cpu_sync_size, &cpu_malloc_use_cuda_,
+          "SyncedMemory::sync");
     }
     CNRT_CHECK(cnrtMemcpy(sync_ptr_, mlu_ptr_, cpu_sync_size,
           CNRT_MEM_TRANS_DIR_DEV2HOST));
@@ -448,15 +540,16 @@ inline void SyncedMemory::to_mlu(const MLUTensorDesc& mlu_tensor_desc) {
     if (mlu_ptr_ == nullptr) {
       CNRT_CHECK(cnrtMalloc(&mlu_ptr_, mlu_cpu_size));
       CHECK_NOTNULL(mlu_ptr_);
+      own_mlu_data_ = true;
     }
     if (sync_ptr_ == NULL) {
-      CaffeMallocHost(&sync_ptr_, mlu_cpu_size, &cpu_malloc_use_cuda_);
+      CaffeMallocHost(&sync_ptr_, mlu_cpu_size, &cpu_malloc_use_cuda_,
+          "SyncedMemory::sync");
     }
     cast_data_type(cpu_ptr_, sync_ptr_, CNRT_MEM_TRANS_DIR_HOST2DEV, mlu_tensor_desc);
     CNRT_CHECK(cnrtMemcpy(mlu_ptr_, sync_ptr_, mlu_cpu_size,
           CNRT_MEM_TRANS_DIR_HOST2DEV));
     head_ = SYNCED;
-    own_mlu_data_ = true;
     break;
   case HEAD_AT_MLU:
   case SYNCED:
@@ -467,12 +560,18 @@ inline void SyncedMemory::to_mlu(const MLUTensorDesc& mlu_tensor_desc) {
 }
 
 void* SyncedMemory::mutable_mlu_data(const MLUTensorDesc& mlu_tensor_desc) {
+  wait();
   to_mlu(mlu_tensor_desc);
   head_ = HEAD_AT_MLU;
+  ++version_;
   return mlu_ptr_;
 }
 
 const void* SyncedMemory::mlu_data(const MLUTensorDesc& mlu_tensor_desc) {
+  // The first batch staged has no previous one to compute on meanwhile.
+  if (mlu_ptr_ == nullptr && staging_pending(STAGE_TO_DEVICE)) {
+    wait();
+  }
   to_mlu(mlu_tensor_desc);
   return (const void*)mlu_ptr_;
 }
@@ -480,6 +579,139 @@ const void* SyncedMemory::mlu_data(const MLUTensorDesc& mlu_tensor_desc) {
 #endif
 
 
+SyncedMemory::StagingState* SyncedMemory::staging(DeviceBackend* backend) {
+  CHECK(backend);
+  if (!staging_) {
+    staging_.reset(new StagingState(backend));
+  }
+  CHECK(staging_->backend_ == backend)
+      << "A SyncedMemory is staged to a single device backend.";
+  return staging_.get();
+}
+
+bool SyncedMemory::staging_pending(StagingDirection dir) const {
+  return staging_ && staging_->pending_ && staging_->direction_ == dir;
+}
+
+void SyncedMemory::prefetch_to(StagingDirection dir,
+    const LayoutCastParam& param, DeviceBackend* backend) {
+  check_device();
+  StagingState* state = staging(backend);
+  wait();
+  size_t count = 1;
+  for (int i = 0; i < param.src_shape.size(); ++i) {
+    count *= param.src_shape[i];
+  }
+  const size_t src_size = count * LayoutCastTypeSize(param.src_type);
+  const size_t dst_size = LayoutCastDstBytes(param);
+  const bool copy = LayoutCastIsCopy(param);
+  if (dir == STAGE_TO_DEVICE) {
+    CHECK_EQ(src_size, size_) << "param does not describe the host data.";
+    to_cpu();
+    void* host = copy ? NULL : state->host(dst_size);
+    void* dst = state->slot(1 - state->front_, dst_size);
+    state->ticket_ = submit_transfer(backend, dir, param, cpu_ptr_, host, dst,
+        dst_size);
+  } else {
+    CHECK_EQ(dst_size, size_) << "param does not describe the host data.";
+    CHECK_LE(src_size, state->slot_size_[state->front_])
+        << "The device data is smaller than param describes.";
+    if (cpu_ptr_ == NULL) {
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+          "SyncedMemory");
+      own_cpu_data_ = true;
+    }
+    void* host = copy ? NULL : state->host(src_size);
+    state->ticket_ = submit_transfer(backend, dir, param,
+        state->slot_[state->front_], host, cpu_ptr_, src_size);
+    state->front_ = 1 - state->front_;
+  }
+  state->pending_ = true;
+  state->direction_ = dir;
+  state->mlu_ = false;
+}
+
+void SyncedMemory::wait() {
+  if (!staging_ || !staging_->pending_) {
+    return;
+  }
+  StagingState* state = staging_.get();
+  state->backend_->Wait(state->ticket_);
+  state->pending_ = false;
+  if (state->direction_ == STAGE_TO_DEVICE) {
+    state->front_ = 1 - state->front_;
+#ifdef USE_MLU
+    if (state->mlu_) {
+      mlu_ptr_ = state->slot_[state->front_];
+      own_mlu_data_ = false;
+    }
+#endif
+  } else if (state->mlu_) {
+    head_ = SYNCED;
+  } else {
+    head_ = HEAD_AT_CPU;
+    ++version_;
+  }
+}
+
+const void* SyncedMemory::device_data() {
+  CHECK(staging_ && staging_->slot_[staging_->front_])
+      << "No device data has been staged.";
+  return staging_->slot_[staging_->front_];
+}
+
+void* SyncedMemory::mutable_device_data(DeviceBackend* backend, size_t size) {
+  StagingState* state = staging(backend);
+  return state->slot(state->front_, size);
+}
+
+#ifdef USE_MLU
+void SyncedMemory::prefetch_to(StagingDirection dir,
+    const MLUTensorDesc& mlu_tensor_desc) {
+  check_device();
+  StagingState* state = staging(MLUStagingBackend());
+  wait();
+  size_t mlu_size;
+  MLU_CHECK(cnmlGetTensorSize_V2(mlu_tensor_desc.mlu(), &mlu_size));
+  if (dir == STAGE_TO_DEVICE) {
+    const LayoutCastParam param =
+        layout_cast_param(CNRT_MEM_TRANS_DIR_HOST2DEV, mlu_tensor_desc);
+    to_cpu();
+    if (mlu_ptr_ && own_mlu_data_) {
+      // Compute keeps running on the buffer it has, as the front slot.
+      CHECK(state->slot_[state->front_] == NULL);
+      state->slot_[state->front_] = mlu_ptr_;
+      state->slot_size_[state->front_] = mlu_size;
+      own_mlu_data_ = false;
+    }
+    CHECK(mlu_ptr_ == nullptr || mlu_ptr_ == state->slot_[state->front_])
+        << "Cannot stage into device memory given by set_mlu_data.";
+    void* host = LayoutCastIsCopy(param) ? NULL : state->host(mlu_size);
+    void* dst = state->slot(1 - state->front_, mlu_size);
+    state->ticket_ = submit_transfer(state->backend_, dir, param, cpu_ptr_,
+        host, dst, mlu_size);
+    head_ = SYNCED;
+  } else {
+    if (head_ != HEAD_AT_MLU) {
+      return;
+    }
+    const LayoutCastParam param =
+        layout_cast_param(CNRT_MEM_TRANS_DIR_DEV2HOST, mlu_tensor_desc);
+    if (cpu_ptr_ == NULL) {
+      CaffeMallocHost(&cpu_ptr_, size_, &cpu_malloc_use_cuda_,
+          "SyncedMemory");
+      own_cpu_data_ = true;
+    }
+    void* host = LayoutCastIsCopy(param) ? NULL : state->host(mlu_size);
+    state->ticket_ = submit_transfer(state->backend_, dir, param, mlu_ptr_,
+        host, cpu_ptr_, mlu_size);
+  }
+  state->pending_ = true;
+  state->direction_ = dir;
+  state->mlu_ = true;
+}
+#endif
+
 #ifdef USE_CUDA
 void SyncedMemory::async_gpu_push(const cudaStream_t& stream) {
   check_device();
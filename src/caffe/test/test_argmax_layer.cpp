@@ -28,6 +28,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include <algorithm>
+#include <cmath>
+#include <functional>
 #include <utility>
 #include <vector>
 
@@ -325,6 +327,71 @@ TYPED_TEST(ArgMaxLayerTest, TestCPUAxisMaxValTopK) {
   }
 }
 
+TYPED_TEST(ArgMaxLayerTest, TestCPUSoftmaxMaxValTopK) {
+  LayerParameter layer_param;
+  ArgMaxParameter* argmax_param = layer_param.mutable_argmax_param();
+  argmax_param->set_out_max_val(true);
+  argmax_param->set_top_k(this->top_k_);
+  argmax_param->set_softmax(true);
+  ArgMaxLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Now, check values against the softmax of each datum
+  const TypeParam* bottom_data = this->blob_bottom_->cpu_data();
+  int num = this->blob_bottom_->num();
+  int dim = this->blob_bottom_->count() / num;
+  for (int i = 0; i < num; ++i) {
+    double sum = 0;
+    for (int k = 0; k < dim; ++k) {
+      sum += std::exp(static_cast<double>(bottom_data[i * dim + k]));
+    }
+    for (int j = 0; j < this->top_k_; ++j) {
+      const int max_ind = this->blob_top_->data_at(i, 0, j, 0);
+      const TypeParam prob = this->blob_top_->data_at(i, 1, j, 0);
+      EXPECT_NEAR(std::exp(bottom_data[i * dim + max_ind]) / sum, prob, 1e-5);
+      int count = 0;
+      for (int k = 0; k < dim; ++k) {
+        if (bottom_data[i * dim + k] > bottom_data[i * dim + max_ind]) {
+          ++count;
+        }
+      }
+      EXPECT_EQ(j, count);
+    }
+  }
+}
+
+TYPED_TEST(ArgMaxLayerTest, TestCPUSoftmaxAxisMaxValTopK) {
+  LayerParameter layer_param;
+  ArgMaxParameter* argmax_param = layer_param.mutable_argmax_param();
+  argmax_param->set_axis(1);
+  argmax_param->set_top_k(this->top_k_);
+  argmax_param->set_out_max_val(true);
+  argmax_param->set_softmax(true);
+  ArgMaxLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Now, check values against the softmax along the channels
+  std::vector<int> shape = this->blob_bottom_->shape();
+  for (int i = 0; i < shape[0]; ++i) {
+    for (int k = 0; k < shape[2]; ++k) {
+      for (int l = 0; l < shape[3]; ++l) {
+        double sum = 0;
+        vector<TypeParam> values;
+        for (int j = 0; j < shape[1]; ++j) {
+          const TypeParam value = this->blob_bottom_->data_at(i, j, k, l);
+          sum += std::exp(static_cast<double>(value));
+          values.push_back(value);
+        }
+        std::sort(values.begin(), values.end(), std::greater<TypeParam>());
+        for (int m = 0; m < this->top_k_; ++m) {
+          EXPECT_NEAR(std::exp(values[m]) / sum,
+                      this->blob_top_->data_at(i, m, k, l), 1e-5);
+        }
+      }
+    }
+  }
+}
+
 #ifdef USE_MLU
 
 template <typename TypeParam>
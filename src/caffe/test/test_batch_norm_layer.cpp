@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/batch_norm_layer.hpp"
+#include "caffe/util/channels_last.hpp"
 #ifdef USE_MLU
 #include "caffe/layers/mlu_batch_norm_layer.hpp"
 #endif
@@ -156,6 +157,95 @@ TYPED_TEST(BatchNormLayerTest, TestForwardInplace) {
   }
 }
 
+TYPED_TEST(BatchNormLayerTest, TestForwardElementwise) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  layer_param.mutable_batch_norm_param()->set_use_alpha_beta(true);
+  BatchNormLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_TRUE(layer.IsElementwise());
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    filler.Fill(layer.blobs()[i].get());
+  }
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Cover the range in pieces that do not line up with the channels.
+  const int count = this->blob_bottom_->count();
+  const Dtype* bottom_data = this->blob_bottom_->cpu_data();
+  vector<Dtype> top_data(count);
+  const int kPiece = 7;
+  for (int offset = 0; offset < count; offset += kPiece) {
+    layer.ForwardElementwise_cpu(offset, std::min(kPiece, count - offset),
+                                 bottom_data + offset, &top_data[offset]);
+  }
+  for (int i = 0; i < count; ++i) {
+    EXPECT_NEAR(this->blob_top_->cpu_data()[i], top_data[i], 1e-5);
+  }
+}
+
+TYPED_TEST(BatchNormLayerTest, TestForwardChannelsLast) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Channels-last is a CPU inference layout.
+  Caffe::set_mode(Caffe::CPU);
+  Blob<Dtype> bottom(2, 5, 3, 4);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> gaussian_filler(filler_param);
+  gaussian_filler.Fill(&bottom);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  layer_param.mutable_batch_norm_param()->set_use_alpha_beta(true);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  BatchNormLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> filler(filler_param);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    filler.Fill(layer.blobs()[i].get());
+  }
+  layer.Forward(bottom_vec, this->blob_top_vec_);
+
+  Blob<Dtype> bottom_nhwc(ChannelsLastShape(bottom.shape()));
+  caffe_cpu_nchw_to_nhwc(2, 5, 12, bottom.cpu_data(),
+                         bottom_nhwc.mutable_cpu_data());
+  layer_param.set_channels_last(true);
+  BatchNormLayer<Dtype> nhwc_layer(layer_param);
+  Blob<Dtype> top_nhwc;
+  vector<Blob<Dtype>*> nhwc_bottom_vec(1, &bottom_nhwc);
+  vector<Blob<Dtype>*> nhwc_top_vec(1, &top_nhwc);
+  nhwc_layer.SetUp(nhwc_bottom_vec, nhwc_top_vec);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    nhwc_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+  }
+  nhwc_layer.Forward(nhwc_bottom_vec, nhwc_top_vec);
+  // The elementwise path, in pieces that do not line up with the channels.
+  const int count = bottom_nhwc.count();
+  vector<Dtype> piece_data(count);
+  const int kPiece = 7;
+  for (int offset = 0; offset < count; offset += kPiece) {
+    nhwc_layer.ForwardElementwise_cpu(offset,
+        std::min(kPiece, count - offset), bottom_nhwc.cpu_data() + offset,
+        &piece_data[offset]);
+  }
+  const Blob<Dtype>& top = *this->blob_top_;
+  for (int n = 0; n < 2; ++n) {
+    for (int c = 0; c < 5; ++c) {
+      for (int h = 0; h < 3; ++h) {
+        for (int w = 0; w < 4; ++w) {
+          EXPECT_NEAR(top_nhwc.data_at(n, h, w, c), top.data_at(n, c, h, w),
+                      1e-5);
+          EXPECT_NEAR(piece_data[top_nhwc.offset(n, h, w, c)],
+                      top.data_at(n, c, h, w), 1e-5);
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(BatchNormLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -88,6 +88,25 @@ TYPED_TEST(BlobSimpleTest, TestReshapeZero) {
   EXPECT_EQ(this->blob_->count(), 0);
 }
 
+TYPED_TEST(BlobSimpleTest, TestShareDataAt) {
+  shared_ptr<Blob<TypeParam> > whole(new Blob<TypeParam>(1, 5, 2, 2));
+  for (int i = 0; i < whole->count(); ++i) {
+    whole->mutable_cpu_data()[i] = i;
+  }
+  Blob<TypeParam> part(1, 2, 2, 2);
+  part.ShareDataAt(*whole, 12);
+  EXPECT_EQ(whole->cpu_data() + 12, part.cpu_data());
+  part.mutable_cpu_data()[0] = -1;
+  EXPECT_EQ(-1, whole->cpu_data()[12]);
+  // The view keeps the memory alive after the whole is gone.
+  whole.reset();
+  EXPECT_EQ(19, part.cpu_data()[7]);
+  // Growing the view gives it memory of its own.
+  part.Reshape(1, 3, 2, 2);
+  part.mutable_cpu_data()[11] = 11;
+  EXPECT_EQ(11, part.cpu_data()[11]);
+}
+
 TYPED_TEST(BlobSimpleTest, TestLegacyBlobProtoShapeEquals) {
   BlobProto blob_proto;
 
@@ -51,6 +51,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
+#include "caffe/util/channels_last.hpp"
+#include "caffe/util/host_allocator.hpp"
 namespace caffe {
 // Reference convolution for checking results:
 // accumulate through explicit loops over input, output, and filters.
@@ -657,6 +659,108 @@ TYPED_TEST(ConvolutionLayerTest, TestNDAgainst2D) {
   }
 }
 
+TYPED_TEST(ConvolutionLayerTest, TestForwardChannelsLast) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Channels-last is a CPU inference layout.
+  Caffe::set_mode(Caffe::CPU);
+  Blob<Dtype> bottom(2, 6, 7, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  Blob<Dtype> bottom_nhwc(ChannelsLastShape(bottom.shape()));
+  caffe_cpu_nchw_to_nhwc(2, 6, 35, bottom.cpu_data(),
+                         bottom_nhwc.mutable_cpu_data());
+  // kernel, pad, stride, dilation, group, num_output: the whole-batch 1x1
+  // GEMM, the im2col GEMM, grouped filters and depthwise filters.
+  const int kConfigs[][6] = {{1, 0, 1, 1, 1, 4}, {1, 0, 2, 1, 1, 4},
+      {3, 1, 1, 1, 1, 5}, {3, 2, 2, 2, 1, 3}, {3, 1, 2, 1, 2, 4},
+      {2, 0, 1, 1, 3, 6}, {3, 1, 1, 1, 6, 6}, {3, 2, 2, 2, 6, 6},
+      {3, 1, 1, 1, 6, 12}};
+  for (int i = 0; i < sizeof(kConfigs) / sizeof(kConfigs[0]); ++i) {
+    LayerParameter layer_param;
+    ConvolutionParameter* convolution_param =
+        layer_param.mutable_convolution_param();
+    convolution_param->add_kernel_size(kConfigs[i][0]);
+    convolution_param->add_pad(kConfigs[i][1]);
+    convolution_param->add_stride(kConfigs[i][2]);
+    convolution_param->add_dilation(kConfigs[i][3]);
+    convolution_param->set_group(kConfigs[i][4]);
+    convolution_param->set_num_output(kConfigs[i][5]);
+    convolution_param->mutable_weight_filler()->set_type("gaussian");
+    convolution_param->mutable_bias_filler()->set_type("gaussian");
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+    ConvolutionLayer<Dtype> layer(layer_param);
+    layer.SetUp(bottom_vec, this->blob_top_vec_);
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+
+    layer_param.set_phase(TEST);
+    layer_param.set_channels_last(true);
+    ConvolutionLayer<Dtype> nhwc_layer(layer_param);
+    Blob<Dtype> top_nhwc;
+    vector<Blob<Dtype>*> nhwc_bottom_vec(1, &bottom_nhwc);
+    vector<Blob<Dtype>*> nhwc_top_vec(1, &top_nhwc);
+    nhwc_layer.SetUp(nhwc_bottom_vec, nhwc_top_vec);
+    for (int j = 0; j < layer.blobs().size(); ++j) {
+      nhwc_layer.blobs()[j]->ShareData(*layer.blobs()[j]);
+    }
+    nhwc_layer.Forward(nhwc_bottom_vec, nhwc_top_vec);
+    const Blob<Dtype>& top = *this->blob_top_;
+    ASSERT_TRUE(top_nhwc.shape() == ChannelsLastShape(top.shape()));
+    for (int n = 0; n < top.num(); ++n) {
+      for (int c = 0; c < top.channels(); ++c) {
+        for (int h = 0; h < top.height(); ++h) {
+          for (int w = 0; w < top.width(); ++w) {
+            EXPECT_NEAR(top_nhwc.data_at(n, h, w, c), top.data_at(n, c, h, w),
+                        1e-4) << "config " << i;
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(ConvolutionLayerTest, TestForwardChannelsLastShared) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_mode(Caffe::CPU);
+  // NHWC, with 3 channels.
+  Blob<Dtype> bottom(2, 6, 4, 3);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  layer_param.set_channels_last(true);
+  ConvolutionParameter* convolution_param =
+      layer_param.mutable_convolution_param();
+  convolution_param->add_kernel_size(3);
+  convolution_param->set_num_output(4);
+  convolution_param->mutable_weight_filler()->set_type("gaussian");
+  convolution_param->mutable_bias_filler()->set_type("gaussian");
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  ConvolutionLayer<Dtype> layer(layer_param);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  layer.Forward(bottom_vec, this->blob_top_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_top_, false, true);
+  // A second layer reading the same weights, as in another NetModel
+  // context, reuses the reordered weights of the first. Its own first
+  // Forward sets up its buffers.
+  ConvolutionLayer<Dtype> other(layer_param);
+  other.SetUp(bottom_vec, this->blob_top_vec_);
+  other.Forward(bottom_vec, this->blob_top_vec_);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    other.blobs()[i]->ShareData(*layer.blobs()[i]);
+  }
+  const uint64_t allocations =
+      HostAllocator::Get().stats().sites["SyncedMemory"].allocations;
+  other.Forward(bottom_vec, this->blob_top_vec_);
+  EXPECT_EQ(allocations,
+            HostAllocator::Get().stats().sites["SyncedMemory"].allocations);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(ConvolutionLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -0,0 +1,323 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/gru_layer.hpp"
+#include "caffe/layers/lstm_layer.hpp"
+#include "caffe/test/test_caffe_main.hpp"
+#include "caffe/test/test_gradient_check_util.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+static Dtype Sigmoid(Dtype x) { return 1. / (1. + exp(-x)); }
+
+// The cells under test: the layer, its gates and states, and its equations
+// run naively for one instance and timestep. state holds the states in
+// bottom order, h first; h is read before it is overwritten.
+template <typename TypeParam>
+struct LSTMCell {
+  typedef TypeParam Dtype;
+  typedef LSTMLayer<Dtype> Layer;
+  static const int kNumGates = 4;
+  static const int kNumStates = 2;
+
+  static void Step(const Dtype* W_x, const Dtype* b, const Dtype* W_h,
+                   const int I, const int H, const Dtype* x,
+                   const Dtype cont, Dtype* const* state) {
+    Dtype* h = state[0];
+    Dtype* c = state[1];
+    vector<Dtype> pre(4 * H);
+    for (int j = 0; j < 4 * H; ++j) {
+      pre[j] = b[j];
+      for (int k = 0; k < I; ++k) {
+        pre[j] += W_x[j * I + k] * x[k];
+      }
+      for (int k = 0; k < H; ++k) {
+        pre[j] += W_h[j * H + k] * cont * h[k];
+      }
+    }
+    for (int d = 0; d < H; ++d) {
+      const Dtype i = Sigmoid(pre[d]);
+      const Dtype f = Sigmoid(pre[H + d]);
+      const Dtype o = Sigmoid(pre[2 * H + d]);
+      const Dtype g = tanh(pre[3 * H + d]);
+      c[d] = cont * f * c[d] + i * g;
+      h[d] = o * tanh(c[d]);
+    }
+  }
+};
+
+template <typename TypeParam>
+struct GRUCell {
+  typedef TypeParam Dtype;
+  typedef GRULayer<Dtype> Layer;
+  static const int kNumGates = 3;
+  static const int kNumStates = 1;
+
+  static void Step(const Dtype* W_x, const Dtype* b, const Dtype* W_h,
+                   const int I, const int H, const Dtype* x,
+                   const Dtype cont, Dtype* const* state) {
+    Dtype* h = state[0];
+    vector<Dtype> xg(3 * H), hg(3 * H);
+    for (int j = 0; j < 3 * H; ++j) {
+      xg[j] = b[j];
+      hg[j] = 0;
+      for (int k = 0; k < I; ++k) {
+        xg[j] += W_x[j * I + k] * x[k];
+      }
+      for (int k = 0; k < H; ++k) {
+        hg[j] += W_h[j * H + k] * cont * h[k];
+      }
+    }
+    for (int d = 0; d < H; ++d) {
+      const Dtype r = Sigmoid(xg[d] + hg[d]);
+      const Dtype z = Sigmoid(xg[H + d] + hg[H + d]);
+      const Dtype g = tanh(xg[2 * H + d] + r * hg[2 * H + d]);
+      h[d] = (1 - z) * g + z * cont * h[d];
+    }
+  }
+};
+
+template <typename TypeParam>
+class FusedRecurrentLayerTest
+    : public CPUDeviceTest<typename TypeParam::Dtype> {
+  typedef typename TypeParam::Dtype Dtype;
+
+  protected:
+  FusedRecurrentLayerTest() : num_output_(4) {
+    blob_bottom_vec_.push_back(&blob_bottom_);
+    blob_bottom_vec_.push_back(&blob_bottom_cont_);
+    blob_top_vec_.push_back(&blob_top_);
+
+    ReshapeBlobs(3, 2);
+
+    layer_param_.mutable_recurrent_param()->set_num_output(num_output_);
+    FillerParameter* weight_filler =
+        layer_param_.mutable_recurrent_param()->mutable_weight_filler();
+    weight_filler->set_type("uniform");
+    weight_filler->set_min(-0.5);
+    weight_filler->set_max(0.5);
+    FillerParameter* bias_filler =
+        layer_param_.mutable_recurrent_param()->mutable_bias_filler();
+    bias_filler->set_type("uniform");
+    bias_filler->set_min(-0.2);
+    bias_filler->set_max(0.2);
+  }
+
+  void ReshapeBlobs(int num_timesteps, int num_instances) {
+    blob_bottom_.Reshape(num_timesteps, num_instances, 3, 2);
+    vector<int> shape(2);
+    shape[0] = num_timesteps;
+    shape[1] = num_instances;
+    blob_bottom_cont_.Reshape(shape);
+    shape[0] = 1;
+    shape.push_back(num_output_);
+    for (int i = 0; i < TypeParam::kNumStates; ++i) {
+      blob_bottom_state_[i].Reshape(shape);
+    }
+
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&blob_bottom_);
+    for (int i = 0; i < TypeParam::kNumStates; ++i) {
+      filler.Fill(&blob_bottom_state_[i]);
+    }
+    // A sequence that begins at the first timestep then continues.
+    for (int t = 0; t < num_timesteps; ++t) {
+      for (int n = 0; n < num_instances; ++n) {
+        blob_bottom_cont_.mutable_cpu_data()[t * num_instances + n] = t > 0;
+      }
+    }
+  }
+
+  void ExposeHidden() {
+    layer_param_.mutable_recurrent_param()->set_expose_hidden(true);
+    for (int i = 0; i < TypeParam::kNumStates; ++i) {
+      blob_bottom_vec_.push_back(&blob_bottom_state_[i]);
+      blob_top_vec_.push_back(&blob_top_state_[i]);
+    }
+  }
+
+  // Runs the cell naively from the initial state bottoms.
+  void Reference(typename TypeParam::Layer* layer, vector<Dtype>* out) {
+    const int T = blob_bottom_.shape(0);
+    const int N = blob_bottom_.shape(1);
+    const int I = blob_bottom_.count(2);
+    const int H = num_output_;
+    const Dtype* W_x = layer->blobs()[0]->cpu_data();
+    const Dtype* b = layer->blobs()[1]->cpu_data();
+    const Dtype* W_h = layer->blobs()[2]->cpu_data();
+    vector<vector<Dtype> > states(TypeParam::kNumStates);
+    for (int i = 0; i < TypeParam::kNumStates; ++i) {
+      const Dtype* initial = blob_bottom_state_[i].cpu_data();
+      states[i].assign(initial, initial + N * H);
+    }
+    out->resize(T * N * H);
+    for (int t = 0; t < T; ++t) {
+      for (int n = 0; n < N; ++n) {
+        Dtype* state[TypeParam::kNumStates];
+        for (int i = 0; i < TypeParam::kNumStates; ++i) {
+          state[i] = &states[i][n * H];
+        }
+        TypeParam::Step(W_x, b, W_h, I, H,
+                        blob_bottom_.cpu_data() + (t * N + n) * I,
+                        blob_bottom_cont_.cpu_data()[t * N + n], state);
+        caffe_copy(H, state[0], out->data() + (t * N + n) * H);
+      }
+    }
+  }
+
+  int num_output_;
+  LayerParameter layer_param_;
+  Blob<Dtype> blob_bottom_;
+  Blob<Dtype> blob_bottom_cont_;
+  Blob<Dtype> blob_bottom_state_[2];
+  Blob<Dtype> blob_top_;
+  Blob<Dtype> blob_top_state_[2];
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+typedef ::testing::Types<LSTMCell<float>, LSTMCell<double>,
+                         GRUCell<float>, GRUCell<double> > TestCells;
+
+TYPED_TEST_CASE(FusedRecurrentLayerTest, TestCells);
+
+TYPED_TEST(FusedRecurrentLayerTest, TestSetUp) {
+  typename TypeParam::Layer layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  vector<int> expected_top_shape = this->blob_bottom_.shape();
+  expected_top_shape.resize(3);
+  expected_top_shape[2] = this->num_output_;
+  EXPECT_TRUE(this->blob_top_.shape() == expected_top_shape);
+  ASSERT_EQ(layer.blobs().size(), 3);
+  EXPECT_EQ(layer.blobs()[0]->shape(0),
+            TypeParam::kNumGates * this->num_output_);
+  EXPECT_EQ(layer.blobs()[0]->shape(1), this->blob_bottom_.count(2));
+  EXPECT_EQ(layer.blobs()[2]->shape(1), this->num_output_);
+}
+
+TYPED_TEST(FusedRecurrentLayerTest, TestForward) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->ExposeHidden();
+  for (int i = 0; i < this->blob_bottom_cont_.count(); ++i) {
+    this->blob_bottom_cont_.mutable_cpu_data()[i] = i != 3;
+  }
+  typename TypeParam::Layer layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  vector<Dtype> expected;
+  this->Reference(&layer, &expected);
+  const Dtype kEpsilon = 1e-5;
+  for (int i = 0; i < this->blob_top_.count(); ++i) {
+    EXPECT_NEAR(this->blob_top_.cpu_data()[i], expected[i], kEpsilon);
+  }
+  const Blob<Dtype>& top_h = this->blob_top_state_[0];
+  const int last = this->blob_top_.count() - top_h.count();
+  for (int i = 0; i < top_h.count(); ++i) {
+    EXPECT_EQ(top_h.cpu_data()[i], this->blob_top_.cpu_data()[last + i]);
+  }
+}
+
+TYPED_TEST(FusedRecurrentLayerTest, TestForwardCarriedState) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int kNumTimesteps = 3;
+  const int num = this->blob_bottom_.shape(1);
+  this->layer_param_.set_phase(TEST);
+
+  // Process the full sequence in a single batch.
+  typename TypeParam::Layer layer(this->layer_param_);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> bottom_copy(this->blob_bottom_.shape());
+  bottom_copy.CopyFrom(this->blob_bottom_);
+  Blob<Dtype> top_copy(this->blob_top_.shape());
+  top_copy.CopyFrom(this->blob_top_);
+
+  // Process the batch one timestep at a time with the same weights; the
+  // state carried between calls must give the same result.
+  this->ReshapeBlobs(1, num);
+  typename TypeParam::Layer step_layer(this->layer_param_);
+  step_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < layer.blobs().size(); ++i) {
+    step_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+  }
+  const int bottom_count = this->blob_bottom_.count();
+  const int top_count = this->blob_top_.count();
+  const Dtype kEpsilon = 1e-5;
+  for (int t = 0; t < kNumTimesteps; ++t) {
+    caffe_copy(bottom_count, bottom_copy.cpu_data() + t * bottom_count,
+               this->blob_bottom_.mutable_cpu_data());
+    for (int n = 0; n < num; ++n) {
+      this->blob_bottom_cont_.mutable_cpu_data()[n] = t > 0;
+    }
+    step_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    for (int i = 0; i < top_count; ++i) {
+      EXPECT_NEAR(this->blob_top_.cpu_data()[i],
+                  top_copy.cpu_data()[t * top_count + i], kEpsilon)
+          << "t = " << t << "; i = " << i;
+    }
+  }
+}
+
+TYPED_TEST(FusedRecurrentLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  typename TypeParam::Layer layer(this->layer_param_);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+                                  this->blob_top_vec_, 0);
+}
+
+TYPED_TEST(FusedRecurrentLayerTest, TestGradientExposeHidden) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->ExposeHidden();
+  for (int i = 0; i < this->blob_bottom_cont_.count(); ++i) {
+    this->blob_bottom_cont_.mutable_cpu_data()[i] = i != 3;
+  }
+  typename TypeParam::Layer layer(this->layer_param_);
+  GradientChecker<Dtype> checker(1e-2, 1e-3);
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+                                  this->blob_top_vec_, 0);
+  // The initial states follow the input and the continuation indicators.
+  for (int i = 0; i < TypeParam::kNumStates; ++i) {
+    checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+                                    this->blob_top_vec_, 2 + i);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,153 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+#include <stdint.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HalfTest : public ::testing::Test {
+  protected:
+  static float FromBits(uint32_t u) {
+    float x;
+    memcpy(&x, &u, sizeof(x));
+    return x;
+  }
+
+  static bool IsHalfNaN(uint16_t h) { return (h & 0x7fff) > 0x7c00; }
+  static bool IsBfloat16NaN(uint16_t h) { return (h & 0x7fff) > 0x7f80; }
+};
+
+TEST_F(HalfTest, TestHalfRoundTrip) {
+  for (int i = 0; i < 65536; ++i) {
+    const uint16_t h = i;
+    const float x = caffe_half_to_float(h);
+    if (IsHalfNaN(h)) {
+      EXPECT_TRUE(std::isnan(x));
+      EXPECT_TRUE(IsHalfNaN(caffe_float_to_half(x)));
+    } else {
+      EXPECT_EQ(h, caffe_float_to_half(x)) << h;
+    }
+  }
+}
+
+TEST_F(HalfTest, TestHalfValues) {
+  EXPECT_EQ(1.f, caffe_half_to_float(0x3c00));
+  EXPECT_EQ(-2.f, caffe_half_to_float(0xc000));
+  EXPECT_EQ(65504.f, caffe_half_to_float(0x7bff));
+  EXPECT_EQ(std::ldexp(1.f, -24), caffe_half_to_float(0x0001));
+  EXPECT_EQ(std::ldexp(1023.f, -24), caffe_half_to_float(0x03ff));
+  EXPECT_EQ(INFINITY, caffe_half_to_float(0x7c00));
+  EXPECT_EQ(0x3c00, caffe_float_to_half(1.f));
+  EXPECT_EQ(0x8000, caffe_float_to_half(-0.f));
+  EXPECT_EQ(0x7c00, caffe_float_to_half(1e6f));
+  EXPECT_EQ(0xfc00, caffe_float_to_half(-INFINITY));
+  // Ties round to even, in the normal and the denormal range.
+  EXPECT_EQ(0x3c00, caffe_float_to_half(1.f + std::ldexp(1.f, -11)));
+  EXPECT_EQ(0x3c02, caffe_float_to_half(1.f + std::ldexp(3.f, -11)));
+  EXPECT_EQ(0x0000, caffe_float_to_half(std::ldexp(1.f, -25)));
+  EXPECT_EQ(0x0002, caffe_float_to_half(std::ldexp(3.f, -25)));
+  // 65520 is halfway between 65504 and the next power of two.
+  EXPECT_EQ(0x7bff, caffe_float_to_half(65519.f));
+  EXPECT_EQ(0x7c00, caffe_float_to_half(65520.f));
+}
+
+TEST_F(HalfTest, TestHalfRoundsToNearest) {
+  // Sweep the floats that round to finite FLOAT16 values, below 65520, and
+  // check that no neighbour of the result is closer.
+  for (uint32_t u = 0x30000000; u < 0x477ff000; u += 4099) {
+    const float x = FromBits(u);
+    const uint16_t h = caffe_float_to_half(x);
+    const double error = std::fabs(x - caffe_half_to_float(h));
+    if (h > 0) {
+      EXPECT_LE(error, std::fabs(x - caffe_half_to_float(h - 1))) << x;
+    }
+    if (h < 0x7bff) {
+      EXPECT_LE(error, std::fabs(x - caffe_half_to_float(h + 1))) << x;
+    }
+    EXPECT_EQ(h | 0x8000, caffe_float_to_half(-x));
+  }
+}
+
+TEST_F(HalfTest, TestBfloat16) {
+  for (int i = 0; i < 65536; ++i) {
+    const uint16_t h = i;
+    const float x = caffe_bfloat16_to_float(h);
+    if (IsBfloat16NaN(h)) {
+      EXPECT_TRUE(std::isnan(x));
+      EXPECT_TRUE(IsBfloat16NaN(caffe_float_to_bfloat16(x)));
+    } else {
+      EXPECT_EQ(h, caffe_float_to_bfloat16(x)) << h;
+    }
+  }
+  EXPECT_EQ(0x3f80, caffe_float_to_bfloat16(1.f));
+  // Ties round to even; a NaN never becomes infinity.
+  EXPECT_EQ(0x3f80, caffe_float_to_bfloat16(FromBits(0x3f808000)));
+  EXPECT_EQ(0x3f82, caffe_float_to_bfloat16(FromBits(0x3f818000)));
+  EXPECT_EQ(0x3f81, caffe_float_to_bfloat16(FromBits(0x3f808001)));
+  EXPECT_EQ(0x7f80, caffe_float_to_bfloat16(FromBits(0x7f7fffff)));
+  EXPECT_TRUE(IsBfloat16NaN(caffe_float_to_bfloat16(FromBits(0x7f800001))));
+}
+
+TEST_F(HalfTest, TestArrays) {
+  // Not a multiple of the vector width.
+  const int n = 1003;
+  std::vector<float> x(n);
+  for (int i = 0; i < n; ++i) {
+    x[i] = std::ldexp(static_cast<float>(i - n / 2) / 7.f, i % 40 - 25);
+  }
+  std::vector<uint16_t> h(n);
+  std::vector<float> y(n);
+  caffe_cpu_float_to_half(n, &x[0], &h[0]);
+  caffe_cpu_half_to_float(n, &h[0], &y[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(caffe_float_to_half(x[i]), h[i]);
+    EXPECT_EQ(caffe_half_to_float(h[i]), y[i]);
+  }
+  caffe_cpu_float_to_bfloat16(n, &x[0], &h[0]);
+  caffe_cpu_bfloat16_to_float(n, &h[0], &y[0]);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(caffe_float_to_bfloat16(x[i]), h[i]);
+    EXPECT_EQ(caffe_bfloat16_to_float(h[i]), y[i]);
+  }
+}
+
+}  // namespace caffe
@@ -28,6 +28,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
 #ifdef USE_HDF5
+#include <fstream>  // NOLINT(readability/streams)
+#include <set>
 #include <string>
 #include <vector>
 
@@ -39,6 +41,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/layers/hdf5_data_layer.hpp"
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/hdf5.hpp"
+#include "caffe/util/io.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
 
@@ -192,5 +196,106 @@ TYPED_TEST(HDF5DataLayerTest, TestSkip) {
   Caffe::set_solver_rank(0);
 }
 */
+
+// Writes num_files files of rows_per_file rows; row r of the whole set has
+// label r and data 10 * r, 10 * r + 1.
+template <typename Dtype>
+static string WriteChunkedSampleData(int num_files, int rows_per_file) {
+  string source;
+  MakeTempFilename(&source);
+  std::ofstream source_file(source.c_str());
+  for (int f = 0; f < num_files; ++f) {
+    string filename;
+    MakeTempFilename(&filename);
+    Blob<Dtype> data(rows_per_file, 2, 1, 1);
+    Blob<Dtype> label(vector<int>(1, rows_per_file));
+    for (int r = 0; r < rows_per_file; ++r) {
+      const int row = f * rows_per_file + r;
+      label.mutable_cpu_data()[r] = row;
+      data.mutable_cpu_data()[2 * r] = 10 * row;
+      data.mutable_cpu_data()[2 * r + 1] = 10 * row + 1;
+    }
+    hid_t file_id = H5Fcreate(filename.c_str(), H5F_ACC_TRUNC, H5P_DEFAULT,
+                              H5P_DEFAULT);
+    hdf5_save_nd_dataset(file_id, "data", data);
+    hdf5_save_nd_dataset(file_id, "label", label);
+    H5Fclose(file_id);
+    source_file << filename << std::endl;
+  }
+  return source;
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestChunkedRead) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int num_files = 2;
+  const int rows_per_file = 7;
+  const int total_rows = num_files * rows_per_file;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  const int batch_size = 4;
+  hdf5_data_param->set_batch_size(batch_size);
+  hdf5_data_param->set_chunk_size(3);
+  hdf5_data_param->set_source(
+      WriteChunkedSampleData<Dtype>(num_files, rows_per_file));
+
+  vector<Blob<Dtype>*> top_vec;
+  top_vec.push_back(this->blob_top_data_);
+  top_vec.push_back(this->blob_top_label_);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, top_vec);
+  EXPECT_EQ(this->blob_top_data_->shape(0), batch_size);
+  EXPECT_EQ(this->blob_top_data_->shape(1), 2);
+  EXPECT_EQ(this->blob_top_label_->num_axes(), 1);
+
+  // Rows come in file order across chunk and file boundaries, and wrap.
+  for (int iter = 0; iter < 10; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, top_vec);
+    for (int i = 0; i < batch_size; ++i) {
+      const int row = (iter * batch_size + i) % total_rows;
+      EXPECT_EQ(row, this->blob_top_label_->cpu_data()[i]);
+      EXPECT_EQ(10 * row, this->blob_top_data_->cpu_data()[2 * i]);
+      EXPECT_EQ(10 * row + 1, this->blob_top_data_->cpu_data()[2 * i + 1]);
+    }
+  }
+}
+
+TYPED_TEST(HDF5DataLayerTest, TestChunkedShuffle) {
+  typedef typename TypeParam::Dtype Dtype;
+  const int num_files = 3;
+  const int rows_per_file = 5;
+  const int total_rows = num_files * rows_per_file;
+  LayerParameter param;
+  param.add_top("data");
+  param.add_top("label");
+  HDF5DataParameter* hdf5_data_param = param.mutable_hdf5_data_param();
+  hdf5_data_param->set_batch_size(total_rows);
+  hdf5_data_param->set_chunk_size(2);
+  hdf5_data_param->set_shuffle(true);
+  hdf5_data_param->set_source(
+      WriteChunkedSampleData<Dtype>(num_files, rows_per_file));
+
+  vector<Blob<Dtype>*> top_vec;
+  top_vec.push_back(this->blob_top_data_);
+  top_vec.push_back(this->blob_top_label_);
+  HDF5DataLayer<Dtype> layer(param);
+  layer.SetUp(this->blob_bottom_vec_, top_vec);
+  // Every epoch outputs each row once, keeping the rows of a file together.
+  for (int iter = 0; iter < 3; ++iter) {
+    layer.Forward(this->blob_bottom_vec_, top_vec);
+    std::set<int> rows;
+    for (int i = 0; i < total_rows; ++i) {
+      const int row = this->blob_top_label_->cpu_data()[i];
+      EXPECT_EQ(10 * row, this->blob_top_data_->cpu_data()[2 * i]);
+      EXPECT_EQ(row / rows_per_file,
+                static_cast<int>(this->blob_top_label_->cpu_data()[
+                    i / rows_per_file * rows_per_file]) / rows_per_file);
+      rows.insert(row);
+    }
+    EXPECT_EQ(total_rows, rows.size());
+  }
+}
+
 }  // namespace caffe
 #endif
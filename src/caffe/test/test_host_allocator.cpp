@@ -0,0 +1,132 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdint.h>
+#include <boost/thread.hpp>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class HostAllocatorTest : public ::testing::Test {
+  protected:
+  virtual void SetUp() {
+    HostAllocator::Get().ReleaseThreadCache();
+    HostAllocator::Get().ResetStats();
+  }
+};
+
+TEST_F(HostAllocatorTest, TestAlignment) {
+  const size_t sizes[] = {0, 1, 63, 65, 1000, 4097, size_t(3) << 20};
+  for (int i = 0; i < sizeof(sizes) / sizeof(sizes[0]); ++i) {
+    void* ptr = HostAllocator::Get().Allocate(sizes[i], "test");
+    ASSERT_TRUE(ptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % kHostAllocAlignment, 0);
+    HostAllocator::Get().Free(ptr);
+  }
+}
+
+TEST_F(HostAllocatorTest, TestReuse) {
+  HostAllocator& allocator = HostAllocator::Get();
+  void* first = allocator.Allocate(1000, "test");
+  allocator.Free(first);
+  // 1000 and 1020 bytes fall into the same size class.
+  void* second = allocator.Allocate(1020, "test");
+  EXPECT_EQ(first, second);
+  allocator.Free(second);
+  HostAllocator::Stats stats = allocator.stats();
+  EXPECT_EQ(stats.allocations, 2);
+  EXPECT_EQ(stats.frees, 2);
+  EXPECT_EQ(stats.cache_hits, 1);
+}
+
+TEST_F(HostAllocatorTest, TestStats) {
+  HostAllocator& allocator = HostAllocator::Get();
+  const size_t live_before = allocator.stats().live_bytes;
+  void* a = allocator.Allocate(100, "test_a");
+  void* b = allocator.Allocate(300, "test_b");
+  HostAllocator::Stats stats = allocator.stats();
+  EXPECT_EQ(stats.live_bytes, live_before + 400);
+  EXPECT_GE(stats.peak_bytes, live_before + 400);
+  EXPECT_EQ(stats.sites["test_a"].allocations, 1);
+  EXPECT_EQ(stats.sites["test_b"].bytes, 300);
+  allocator.Free(a);
+  allocator.Free(b);
+  stats = allocator.stats();
+  EXPECT_EQ(stats.live_bytes, live_before);
+  EXPECT_GE(stats.peak_bytes, live_before + 400);
+  EXPECT_GE(stats.cached_bytes, 400);
+  allocator.ReleaseThreadCache();
+  EXPECT_EQ(allocator.stats().cached_bytes, 0);
+}
+
+static void AllocateAndFree(int count) {
+  for (int i = 0; i < count; ++i) {
+    HostAllocator::Get().Free(HostAllocator::Get().Allocate(1000, "test_t"));
+  }
+}
+
+TEST_F(HostAllocatorTest, TestStatsAcrossThreads) {
+  boost::thread first(AllocateAndFree, 10);
+  boost::thread second(AllocateAndFree, 20);
+  first.join();
+  second.join();
+  // The counters of exited threads are kept.
+  HostAllocator::Stats stats = HostAllocator::Get().stats();
+  EXPECT_EQ(stats.sites["test_t"].allocations, 30);
+  EXPECT_EQ(stats.allocations, 30);
+  EXPECT_EQ(stats.frees, 30);
+  EXPECT_EQ(stats.cache_hits, 28);
+}
+
+TEST_F(HostAllocatorTest, TestCacheLimit) {
+  HostAllocator& allocator = HostAllocator::Get();
+  const size_t max_cached_bytes = allocator.max_cached_bytes();
+  allocator.set_max_cached_bytes(0);
+  allocator.Free(allocator.Allocate(1000, "test"));
+  EXPECT_EQ(allocator.stats().cached_bytes, 0);
+  allocator.set_max_cached_bytes(max_cached_bytes);
+}
+
+TEST_F(HostAllocatorTest, TestSyncedMemory) {
+  {
+    SyncedMemory mem(1000);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(mem.cpu_data()) %
+              kHostAllocAlignment, 0);
+  }
+  EXPECT_EQ(HostAllocator::Get().stats().sites["SyncedMemory"].allocations, 1);
+}
+
+}  // namespace caffe
@@ -35,6 +35,8 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/filler.hpp"
 #include "caffe/layers/inner_product_layer.hpp"
 #include "caffe/layers/mlu_inner_product_layer.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/host_allocator.hpp"
 #include "caffe/test/test_caffe_main.hpp"
 #include "caffe/test/test_gradient_check_util.hpp"
 #include "gtest/gtest.h"
@@ -408,6 +410,170 @@ TYPED_TEST(InnerProductLayerTest, TestBackwardTranspose) {
   }
 }
 
+TYPED_TEST(InnerProductLayerTest, TestForwardPacked) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  // Rows past kPackedGemmMaxRows take the GEMM path in both phases.
+  const int kRows[] = {1, 3, 4, 5};
+  for (int transpose = 0; transpose < 2; ++transpose) {
+    for (int r = 0; r < 4; ++r) {
+      this->blob_bottom_->Reshape(kRows[r], 3, 4, 5);
+      FillerParameter filler_param;
+      UniformFiller<Dtype> filler(filler_param);
+      filler.Fill(this->blob_bottom_);
+      LayerParameter layer_param;
+      InnerProductParameter* inner_product_param =
+          layer_param.mutable_inner_product_param();
+      // Not a multiple of the panel width.
+      inner_product_param->set_num_output(21);
+      inner_product_param->set_transpose(transpose);
+      inner_product_param->set_pack_weights(true);
+      inner_product_param->mutable_weight_filler()->set_type("uniform");
+      inner_product_param->mutable_bias_filler()->set_type("uniform");
+      InnerProductLayer<Dtype> layer(layer_param);
+      layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      Blob<Dtype> expected;
+      expected.CopyFrom(*this->blob_top_, false, true);
+
+      // The TEST phase packs the weights on its first Forward.
+      layer_param.set_phase(TEST);
+      InnerProductLayer<Dtype> packed_layer(layer_param);
+      packed_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < 2; ++i) {
+        packed_layer.blobs()[i]->ShareData(*layer.blobs()[i]);
+      }
+      packed_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < expected.count(); ++i) {
+        EXPECT_NEAR(this->blob_top_->cpu_data()[i], expected.cpu_data()[i],
+                    1e-4);
+      }
+
+      // Writing the weights invalidates the packed copy.
+      caffe_scal(layer.blobs()[0]->count(), Dtype(-2),
+                 layer.blobs()[0]->mutable_cpu_data());
+      layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      expected.CopyFrom(*this->blob_top_);
+      packed_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+      for (int i = 0; i < expected.count(); ++i) {
+        EXPECT_NEAR(this->blob_top_->cpu_data()[i], expected.cpu_data()[i],
+                    1e-4);
+      }
+    }
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardPackedShared) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  this->blob_bottom_->Reshape(2, 3, 4, 5);
+  FillerParameter filler_param;
+  UniformFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->set_pack_weights(true);
+  inner_product_param->mutable_weight_filler()->set_type("uniform");
+  inner_product_param->mutable_bias_filler()->set_type("uniform");
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  Blob<Dtype> expected;
+  expected.CopyFrom(*this->blob_top_, false, true);
+  // A second layer reading the same weights, as in another NetModel
+  // context, reuses the packed copy of the first.
+  InnerProductLayer<Dtype> other(layer_param);
+  other.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  for (int i = 0; i < 2; ++i) {
+    other.blobs()[i]->ShareData(*layer.blobs()[i]);
+  }
+  const uint64_t allocations =
+      HostAllocator::Get().stats().sites["SyncedMemory"].allocations;
+  other.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(allocations,
+            HostAllocator::Get().stats().sites["SyncedMemory"].allocations);
+  for (int i = 0; i < expected.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], this->blob_top_->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardUnpackedByDefault) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  this->blob_bottom_->Reshape(2, 3, 4, 5);
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  InnerProductParameter* inner_product_param =
+      layer_param.mutable_inner_product_param();
+  inner_product_param->set_num_output(10);
+  inner_product_param->mutable_weight_filler()->set_type("uniform");
+  InnerProductLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  // Without pack_weights, writing the weights leaves no copy to remake.
+  caffe_scal(layer.blobs()[0]->count(), Dtype(-2),
+             layer.blobs()[0]->mutable_cpu_data());
+  const uint64_t allocations =
+      HostAllocator::Get().stats().sites["SyncedMemory"].allocations;
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(allocations,
+            HostAllocator::Get().stats().sites["SyncedMemory"].allocations);
+}
+
+TYPED_TEST(InnerProductLayerTest, TestForwardPacked16) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->blob_bottom_vec_.push_back(this->blob_bottom_);
+  const BaseDataType kTypes[] = {DT_FLOAT16, DT_BFLOAT16};
+  // 16-bit weights are packed whatever the batch size.
+  const int kRows[] = {3, 6};
+  for (int r = 0; r < 2; ++r) {
+    this->blob_bottom_->Reshape(kRows[r], 3, 4, 5);
+    FillerParameter filler_param;
+    UniformFiller<Dtype> filler(filler_param);
+    filler.Fill(this->blob_bottom_);
+    for (int transpose = 0; transpose < 2; ++transpose) {
+      for (int t = 0; t < 2; ++t) {
+        LayerParameter layer_param;
+        InnerProductParameter* inner_product_param =
+            layer_param.mutable_inner_product_param();
+        inner_product_param->set_num_output(21);
+        inner_product_param->set_transpose(transpose);
+        inner_product_param->mutable_weight_filler()->set_type("uniform");
+        inner_product_param->mutable_bias_filler()->set_type("uniform");
+        InnerProductLayer<Dtype> layer(layer_param);
+        layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+
+        layer_param.set_phase(TEST);
+        layer_param.set_cpu_weight_dtype(kTypes[t]);
+        InnerProductLayer<Dtype> packed_layer(layer_param);
+        packed_layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        for (int i = 0; i < 2; ++i) {
+          packed_layer.blobs()[i]->CopyFrom(*layer.blobs()[i]);
+        }
+        packed_layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        Blob<Dtype> packed_top;
+        packed_top.CopyFrom(*this->blob_top_, false, true);
+
+        // The same product in full precision, with the weights rounded.
+        Dtype* weight = layer.blobs()[0]->mutable_cpu_data();
+        for (int i = 0; i < layer.blobs()[0]->count(); ++i) {
+          weight[i] = kTypes[t] == DT_FLOAT16 ?
+              caffe_half_to_float(caffe_float_to_half(weight[i])) :
+              caffe_bfloat16_to_float(caffe_float_to_bfloat16(weight[i]));
+        }
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        for (int i = 0; i < packed_top.count(); ++i) {
+          EXPECT_NEAR(packed_top.cpu_data()[i], this->blob_top_->cpu_data()[i],
+                      1e-4);
+        }
+      }
+    }
+  }
+}
+
 #ifdef USE_MLU
 template <typename TypeParam>
 class MLUInnerProductLayerTest : public MLUDeviceTest<TypeParam> {
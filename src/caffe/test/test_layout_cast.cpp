@@ -0,0 +1,285 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdint.h>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/layout_cast.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class LayoutCastTest : public ::testing::Test {
+  protected:
+  static LayoutCastParam MakeParam(const vector<int>& src_shape,
+                                   const vector<int>& order,
+                                   BaseDataType src_type,
+                                   BaseDataType dst_type) {
+    LayoutCastParam param;
+    param.src_shape = src_shape;
+    param.order = order;
+    param.src_type = src_type;
+    param.dst_type = dst_type;
+    return param;
+  }
+
+  static vector<float> Ramp(int count) {
+    vector<float> data(count);
+    for (int i = 0; i < count; ++i) {
+      data[i] = 0.25f * (i % 97) - 7.f;
+    }
+    return data;
+  }
+
+  // The source index read by each destination element, or -1 for padding,
+  // computed one element at a time.
+  static vector<int> ReferenceIndices(const LayoutCastParam& param) {
+    const int num_axes = param.src_shape.size();
+    const vector<int> dst_shape = LayoutCastDstShape(param);
+    int dst_count = 1;
+    for (int i = 0; i < num_axes; ++i) {
+      dst_count *= dst_shape[i];
+    }
+    vector<int> indices(dst_count);
+    vector<int> position(num_axes);
+    for (int d = 0; d < dst_count; ++d) {
+      int rest = d;
+      bool is_pad = false;
+      for (int i = num_axes - 1; i >= 0; --i) {
+        position[i] = rest % dst_shape[i];
+        rest /= dst_shape[i];
+        const int axis = param.order.empty() ? i : param.order[i];
+        is_pad = is_pad || position[i] >= param.src_shape[axis];
+      }
+      if (is_pad) {
+        indices[d] = -1;
+        continue;
+      }
+      vector<int> src_position(num_axes);
+      for (int i = 0; i < num_axes; ++i) {
+        src_position[param.order.empty() ? i : param.order[i]] = position[i];
+      }
+      int s = 0;
+      for (int i = 0; i < num_axes; ++i) {
+        s = s * param.src_shape[i] + src_position[i];
+      }
+      indices[d] = s;
+    }
+    return indices;
+  }
+
+  // Checks a float to float reorder against the reference.
+  static void CheckReorder(const LayoutCastParam& param) {
+    int count = 1;
+    for (int i = 0; i < param.src_shape.size(); ++i) {
+      count *= param.src_shape[i];
+    }
+    const vector<float> src = Ramp(count);
+    const vector<int> indices = ReferenceIndices(param);
+    vector<float> dst(indices.size(), -1000.f);
+    caffe_cpu_layout_cast(param, src.data(), dst.data());
+    for (int d = 0; d < indices.size(); ++d) {
+      const float expected = indices[d] < 0 ? 0.f : src[indices[d]];
+      ASSERT_EQ(expected, dst[d]) << "at " << d;
+    }
+  }
+};
+
+TEST_F(LayoutCastTest, TestDstShape) {
+  LayoutCastParam param = MakeParam({2, 3, 4, 5}, {0, 2, 3, 1},
+                                    DT_FLOAT32, DT_FLOAT16);
+  param.pad = {0, 0, 0, 1};
+  const vector<int> shape = LayoutCastDstShape(param);
+  EXPECT_EQ(vector<int>({2, 4, 5, 4}), shape);
+  EXPECT_EQ(2 * 4 * 5 * 4 * 2, LayoutCastDstBytes(param));
+}
+
+TEST_F(LayoutCastTest, TestNCHWToNHWC) {
+  CheckReorder(MakeParam({2, 3, 7, 5}, {0, 2, 3, 1}, DT_FLOAT32, DT_FLOAT32));
+  CheckReorder(MakeParam({3, 67, 9, 11}, {0, 2, 3, 1},
+                         DT_FLOAT32, DT_FLOAT32));
+}
+
+TEST_F(LayoutCastTest, TestNHWCToNCHW) {
+  CheckReorder(MakeParam({2, 7, 5, 3}, {0, 3, 1, 2}, DT_FLOAT32, DT_FLOAT32));
+  CheckReorder(MakeParam({2, 9, 11, 67}, {0, 3, 1, 2},
+                         DT_FLOAT32, DT_FLOAT32));
+}
+
+TEST_F(LayoutCastTest, TestIdentityAndUnitAxes) {
+  CheckReorder(MakeParam({4, 1, 6, 5}, vector<int>(),
+                         DT_FLOAT32, DT_FLOAT32));
+  CheckReorder(MakeParam({1, 1, 6, 1}, {0, 2, 3, 1}, DT_FLOAT32, DT_FLOAT32));
+  CheckReorder(MakeParam({5, 1, 1, 1}, {0, 2, 3, 1}, DT_FLOAT32, DT_FLOAT32));
+}
+
+TEST_F(LayoutCastTest, TestNCDHWToNDHWC) {
+  CheckReorder(MakeParam({2, 5, 3, 4, 6}, {0, 2, 3, 4, 1},
+                         DT_FLOAT32, DT_FLOAT32));
+}
+
+TEST_F(LayoutCastTest, TestPadInnermost) {
+  // The first convolution of a device net takes 3 channels padded to 4.
+  LayoutCastParam param = MakeParam({2, 3, 37, 41}, {0, 2, 3, 1},
+                                    DT_FLOAT32, DT_FLOAT32);
+  param.pad = {0, 0, 0, 1};
+  CheckReorder(param);
+  // Channels spanning several tiles, and padding wider than a tile.
+  param.src_shape = {2, 45, 7, 9};
+  param.pad = {0, 0, 0, 3};
+  CheckReorder(param);
+  param.pad = {0, 0, 0, 40};
+  CheckReorder(param);
+}
+
+TEST_F(LayoutCastTest, TestPadOuter) {
+  LayoutCastParam param = MakeParam({2, 3, 5, 6}, {0, 2, 3, 1},
+                                    DT_FLOAT32, DT_FLOAT32);
+  param.pad = {1, 0, 2, 1};
+  CheckReorder(param);
+  param.order.clear();
+  param.pad = {0, 1, 0, 3};
+  CheckReorder(param);
+}
+
+TEST_F(LayoutCastTest, TestFloatToHalfReorder) {
+  const LayoutCastParam param = MakeParam({2, 5, 33, 9}, {0, 2, 3, 1},
+                                          DT_FLOAT32, DT_FLOAT16);
+  const vector<float> src = Ramp(2 * 5 * 33 * 9);
+  const vector<int> indices = ReferenceIndices(param);
+  vector<uint16_t> dst(indices.size());
+  caffe_cpu_layout_cast(param, src.data(), dst.data());
+  for (int d = 0; d < indices.size(); ++d) {
+    ASSERT_EQ(caffe_float_to_half(src[indices[d]]), dst[d]) << "at " << d;
+  }
+
+  // And back, which is exact for these values.
+  const LayoutCastParam back = MakeParam({2, 33, 9, 5}, {0, 3, 1, 2},
+                                         DT_FLOAT16, DT_FLOAT32);
+  vector<float> round_trip(src.size());
+  caffe_cpu_layout_cast(back, dst.data(), round_trip.data());
+  for (int i = 0; i < src.size(); ++i) {
+    ASSERT_EQ(src[i], round_trip[i]) << "at " << i;
+  }
+}
+
+TEST_F(LayoutCastTest, TestFloatToBfloat16) {
+  const LayoutCastParam param = MakeParam({3, 100}, vector<int>(),
+                                          DT_FLOAT32, DT_BFLOAT16);
+  const vector<float> src = Ramp(300);
+  vector<uint16_t> dst(300);
+  caffe_cpu_layout_cast(param, src.data(), dst.data());
+  for (int i = 0; i < src.size(); ++i) {
+    EXPECT_EQ(caffe_float_to_bfloat16(src[i]), dst[i]);
+  }
+}
+
+TEST_F(LayoutCastTest, TestQuantizeInt8) {
+  LayoutCastParam param = MakeParam({1, 8}, vector<int>(),
+                                    DT_FLOAT32, DT_INT8);
+  param.quantized = true;
+  param.position = -2;
+  param.scale = 2.f;
+  // Each step of the int8 value is 2^-2 / 2 = 0.125.
+  const float src[] = {0.f, 0.125f, -0.25f, 0.1875f, 0.3125f, -0.1875f,
+                       100.f, -100.f};
+  const int8_t expected[] = {0, 1, -2, 2, 2, -2, 127, -128};
+  int8_t dst[8];
+  caffe_cpu_layout_cast(param, src, dst);
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(expected[i], dst[i]) << "at " << i;
+  }
+
+  param.src_type = DT_INT8;
+  param.dst_type = DT_FLOAT32;
+  float back[8];
+  caffe_cpu_layout_cast(param, dst, back);
+  for (int i = 0; i < 8; ++i) {
+    EXPECT_EQ(expected[i] * 0.125f, back[i]) << "at " << i;
+  }
+}
+
+TEST_F(LayoutCastTest, TestQuantizeInt16Reorder) {
+  LayoutCastParam param = MakeParam({2, 3, 4, 5}, {0, 2, 3, 1},
+                                    DT_FLOAT32, DT_INT16);
+  param.quantized = true;
+  param.position = 3;
+  param.scale = 1.f;
+  const vector<float> src = Ramp(2 * 3 * 4 * 5);
+  const vector<int> indices = ReferenceIndices(param);
+  vector<int16_t> dst(indices.size());
+  caffe_cpu_layout_cast(param, src.data(), dst.data());
+  for (int d = 0; d < indices.size(); ++d) {
+    const float x = src[indices[d]] / 8.f;
+    EXPECT_EQ(static_cast<int16_t>(std::nearbyint(x)), dst[d]) << "at " << d;
+  }
+}
+
+TEST_F(LayoutCastTest, TestFloatToUint8Saturates) {
+  const LayoutCastParam param = MakeParam({1, 9}, vector<int>(),
+                                          DT_FLOAT32, DT_UINT8);
+  const float src[] = {-3.f, 0.5f, 1.5f, 2.5f, 254.4f, 255.5f, 1e9f,
+                       NAN, 17.f};
+  const uint8_t expected[] = {0, 0, 2, 2, 254, 255, 255, 0, 17};
+  uint8_t dst[9];
+  caffe_cpu_layout_cast(param, src, dst);
+  for (int i = 0; i < 9; ++i) {
+    EXPECT_EQ(expected[i], dst[i]) << "at " << i;
+  }
+}
+
+TEST_F(LayoutCastTest, TestUint8ToFloat) {
+  const LayoutCastParam param = MakeParam({1, 2, 2, 3}, {0, 3, 1, 2},
+                                          DT_UINT8, DT_FLOAT32);
+  const uint8_t src[] = {0, 1, 2, 10, 11, 12, 20, 21, 22, 250, 251, 255};
+  const float expected[] = {0, 10, 20, 250, 1, 11, 21, 251, 2, 12, 22, 255};
+  float dst[12];
+  caffe_cpu_layout_cast(param, src, dst);
+  for (int i = 0; i < 12; ++i) {
+    EXPECT_EQ(expected[i], dst[i]);
+  }
+}
+
+TEST_F(LayoutCastTest, TestLargeReorder) {
+  // Big enough to be split over the thread pool.
+  CheckReorder(MakeParam({4, 64, 56, 56}, {0, 2, 3, 1},
+                         DT_FLOAT32, DT_FLOAT32));
+  CheckReorder(MakeParam({4, 56, 56, 64}, {0, 3, 1, 2},
+                         DT_FLOAT32, DT_FLOAT32));
+}
+
+}  // namespace caffe
@@ -0,0 +1,137 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/net.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/mapped_weights.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename TypeParam>
+class MappedWeightsTest : public MultiDeviceTest<TypeParam> {
+  typedef typename TypeParam::Dtype Dtype;
+
+  protected:
+  virtual void SetUp() {
+    const string proto =
+        "name: 'MappedWeightsNet' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 4 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'innerproduct' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 7 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'innerproduct' "
+        "} ";
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &net_param_));
+    net_.reset(new Net<Dtype>(net_param_));
+    MakeTempFilename(&filename_);
+  }
+
+  void WriteMappedWeights(const Net<Dtype>& net) {
+    NetParameter trained_param;
+    net.ToProto(&trained_param);
+    WriteNetParamsToMappedWeights(trained_param, filename_);
+  }
+
+  NetParameter net_param_;
+  shared_ptr<Net<Dtype> > net_;
+  string filename_;
+};
+
+TYPED_TEST_CASE(MappedWeightsTest, TestDtypesAndDevices);
+
+TYPED_TEST(MappedWeightsTest, TestWriteAndRead) {
+  this->WriteMappedWeights(*this->net_);
+  EXPECT_TRUE(IsMappedWeightsFile(this->filename_));
+  MappedWeights weights(this->filename_);
+  EXPECT_EQ(weights.index().name(), "MappedWeightsNet");
+  EXPECT_TRUE(weights.layer("data") == NULL);
+  const MappedLayerIndex* layer = weights.layer("innerproduct");
+  ASSERT_TRUE(layer != NULL);
+  ASSERT_EQ(layer->blobs_size(), 2);
+  for (int i = 0; i < layer->blobs_size(); ++i) {
+    EXPECT_EQ(layer->blobs(i).offset() % kMappedWeightsAlignment, 0);
+  }
+}
+
+TYPED_TEST(MappedWeightsTest, TestCopyTrainedLayers) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->WriteMappedWeights(*this->net_);
+  Net<Dtype> mapped_net(this->net_param_);
+  mapped_net.CopyTrainedLayersFrom(this->filename_);
+  const vector<shared_ptr<Blob<Dtype> > >& source =
+      this->net_->layer_by_name("innerproduct")->blobs();
+  const vector<shared_ptr<Blob<Dtype> > >& target =
+      mapped_net.layer_by_name("innerproduct")->blobs();
+  ASSERT_EQ(source.size(), target.size());
+  for (int i = 0; i < source.size(); ++i) {
+    ASSERT_EQ(source[i]->count(), target[i]->count());
+    for (int j = 0; j < source[i]->count(); ++j) {
+      EXPECT_EQ(source[i]->cpu_data()[j], target[i]->cpu_data()[j]);
+    }
+  }
+}
+
+TYPED_TEST(MappedWeightsTest, TestCopyOnWrite) {
+  typedef typename TypeParam::Dtype Dtype;
+  this->WriteMappedWeights(*this->net_);
+  Net<Dtype> mapped_net(this->net_param_);
+  mapped_net.CopyTrainedLayersFrom(this->filename_);
+  Blob<Dtype>* weight = mapped_net.layer_by_name("innerproduct")->blobs()[0]
+      .get();
+  const Dtype expected = weight->cpu_data()[0];
+  weight->mutable_cpu_data()[0] = expected + 1;
+  // Writes stay private to the mapping and never reach the file.
+  Net<Dtype> other_net(this->net_param_);
+  other_net.CopyTrainedLayersFrom(this->filename_);
+  EXPECT_EQ(other_net.layer_by_name("innerproduct")->blobs()[0]->cpu_data()[0],
+            expected);
+}
+
+}  // namespace caffe
@@ -29,7 +29,10 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <stdint.h>  // for uint32_t & uint64_t
 #include <time.h>
+#include <cfloat>
 #include <cmath>  // for std::fabs
+#include <limits>
+#include <vector>
 
 #include "gtest/gtest.h"
 
@@ -148,6 +151,86 @@ TYPED_TEST(CPUMathFunctionsTest, TestCopy) {
   }
 }
 
+TYPED_TEST(CPUMathFunctionsTest, TestTranscendental) {
+  // Inputs over the useful range of each function, including the ends
+  // where float results become denormal or overflow.
+  vector<TypeParam> x;
+  for (int i = -2000; i <= 2000; ++i) {
+    x.push_back(i * TypeParam(0.0443));
+  }
+  x.push_back(TypeParam(1e-30));
+  x.push_back(TypeParam(3e-38));
+  x.push_back(TypeParam(-100));
+  const int n = x.size();
+  vector<TypeParam> y(n);
+  // A few ulp of the type, relative to the exact result.
+  const double tolerance = sizeof(TypeParam) == 4 ? 4 * FLT_EPSILON :
+      4 * DBL_EPSILON;
+  caffe_exp<TypeParam>(n, x.data(), y.data());
+  for (int i = 0; i < n; ++i) {
+    const double expected = std::exp(static_cast<double>(x[i]));
+    if (expected > FLT_MAX && sizeof(TypeParam) == 4) {
+      EXPECT_TRUE(std::isinf(y[i]));
+    } else if (expected > FLT_MIN) {
+      EXPECT_NEAR(y[i], expected, tolerance * expected) << "exp " << x[i];
+    }
+  }
+  caffe_tanh<TypeParam>(n, x.data(), y.data());
+  for (int i = 0; i < n; ++i) {
+    const double expected = std::tanh(static_cast<double>(x[i]));
+    EXPECT_NEAR(y[i], expected, tolerance * std::fabs(expected) + 1e-38)
+        << "tanh " << x[i];
+  }
+  caffe_sigmoid<TypeParam>(n, x.data(), y.data());
+  for (int i = 0; i < n; ++i) {
+    const double expected = 1 / (1 + std::exp(-static_cast<double>(x[i])));
+    if (expected > FLT_MIN) {
+      EXPECT_NEAR(y[i], expected, tolerance * expected) << "sigmoid " << x[i];
+    }
+  }
+  for (int i = 0; i < n; ++i) {
+    x[i] = std::fabs(x[i]);
+  }
+  caffe_log<TypeParam>(n, x.data(), y.data());
+  for (int i = 0; i < n; ++i) {
+    const double expected = std::log(static_cast<double>(x[i]));
+    if (x[i] == 0) {
+      EXPECT_TRUE(std::isinf(y[i]) && y[i] < 0);
+    } else {
+      EXPECT_NEAR(y[i], expected, tolerance * std::fabs(expected) + 1e-38)
+          << "log " << x[i];
+    }
+  }
+}
+
+TYPED_TEST(CPUMathFunctionsTest, TestTranscendentalSpecialValues) {
+  const TypeParam inf = std::numeric_limits<TypeParam>::infinity();
+  const TypeParam nan = std::numeric_limits<TypeParam>::quiet_NaN();
+  const TypeParam x[] = {-inf, inf, nan, 0, -1};
+  TypeParam y[5];
+  caffe_exp<TypeParam>(5, x, y);
+  EXPECT_EQ(y[0], 0);
+  EXPECT_EQ(y[1], inf);
+  EXPECT_TRUE(std::isnan(y[2]));
+  EXPECT_EQ(y[3], 1);
+  caffe_log<TypeParam>(5, x, y);
+  EXPECT_TRUE(std::isnan(y[0]));
+  EXPECT_EQ(y[1], inf);
+  EXPECT_TRUE(std::isnan(y[2]));
+  EXPECT_EQ(y[3], -inf);
+  EXPECT_TRUE(std::isnan(y[4]));
+  caffe_tanh<TypeParam>(5, x, y);
+  EXPECT_EQ(y[0], -1);
+  EXPECT_EQ(y[1], 1);
+  EXPECT_TRUE(std::isnan(y[2]));
+  EXPECT_EQ(y[3], 0);
+  caffe_sigmoid<TypeParam>(5, x, y);
+  EXPECT_EQ(y[0], 0);
+  EXPECT_EQ(y[1], 1);
+  EXPECT_TRUE(std::isnan(y[2]));
+  EXPECT_EQ(y[3], 0.5);
+}
+
 #ifdef USE_CUDA
 
 template <typename Dtype>
@@ -37,6 +37,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
+#include "caffe/layers/memory_data_layer.hpp"
 #include "caffe/net.hpp"
 #include "caffe/util/io.hpp"
 #include "caffe/util/math_functions.hpp"
@@ -2475,6 +2476,514 @@ TYPED_TEST(NetTest, TestReshape) {
   EXPECT_FALSE(same_spatial_shape);
 }
 
+TYPED_TEST(NetTest, TestElementwiseChainReshape) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(this->seed_);
+  const string& proto =
+      "name: 'ElementwiseChainNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 1 dim: 3 dim: 4 dim: 4 } } "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'data' "
+      "  top: 'out' "
+      "} "
+      "layer { "
+      "  name: 'scale' "
+      "  type: 'Scale' "
+      "  bottom: 'out' "
+      "  top: 'out' "
+      "  scale_param { "
+      "    filler { type: 'gaussian' } "
+      "    bias_term: true "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype>* data = this->net_->blob_by_name("data").get();
+  Blob<Dtype>* out = this->net_->blob_by_name("out").get();
+  // The Scale layer, second in the chain, must follow the new inner size.
+  for (int size = 4; size <= 6; size += 2) {
+    data->Reshape(size - 3, 3, size, size + 1);
+    filler.Fill(data);
+    this->net_->Forward();
+    Blob<Dtype> fused;
+    fused.CopyFrom(*out, false, true);
+    // Running one layer at a time does not fuse the chain.
+    for (int i = 0; i < this->net_->layers().size(); ++i) {
+      this->net_->ForwardFromTo(i, i);
+    }
+    ASSERT_EQ(fused.count(), out->count());
+    for (int i = 0; i < out->count(); ++i) {
+      EXPECT_NEAR(out->cpu_data()[i], fused.cpu_data()[i], 1e-5);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestConcatSliceViews) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_mode(Caffe::CPU);
+  const string& proto =
+      "name: 'ConcatSliceNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 1 dim: 2 dim: 3 dim: 2 } } "
+      "} "
+      "layer { "
+      "  name: 'scale' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'scaled' "
+      "  power_param { scale: 2 } "
+      "} "
+      "layer { "
+      "  name: 'shift' "
+      "  type: 'Power' "
+      "  bottom: 'data' "
+      "  top: 'shifted' "
+      "  power_param { shift: 1 } "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'scaled' "
+      "  bottom: 'shifted' "
+      "  top: 'concat' "
+      "} "
+      "layer { "
+      "  name: 'slice' "
+      "  type: 'Slice' "
+      "  bottom: 'concat' "
+      "  top: 'first' "
+      "  top: 'second' "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'first' "
+      "  bottom: 'second' "
+      "  top: 'sum' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  Blob<Dtype>* data = this->net_->blob_by_name("data").get();
+  Blob<Dtype>* concat = this->net_->blob_by_name("concat").get();
+  const char* names[] = {"scaled", "shifted", "first", "second"};
+  // Each half of the concatenation is shared by a producer and a consumer.
+  for (int i = 0; i < 4; ++i) {
+    const int offset = (i % 2) * data->count();
+    EXPECT_EQ(concat->cpu_data() + offset,
+              this->net_->blob_by_name(names[i])->cpu_data()) << names[i];
+  }
+  // Run at the planned shape, at a smaller one whose stale views overlap
+  // the concatenation, and at a larger one that needs fresh memory.
+  const int kNumShapes = 3;
+  const int widths[kNumShapes] = {2, 1, 4};
+  for (int s = 0; s < kNumShapes; ++s) {
+    data->Reshape(1, 2, 3, widths[s]);
+    for (int i = 0; i < data->count(); ++i) {
+      data->mutable_cpu_data()[i] = i - 3;
+    }
+    this->net_->Forward();
+    const Blob<Dtype>* sum = this->net_->blob_by_name("sum").get();
+    ASSERT_EQ(data->count(), sum->count());
+    for (int i = 0; i < sum->count(); ++i) {
+      EXPECT_EQ(3 * (i - 3) + 1, sum->cpu_data()[i]) << "width " << widths[s];
+    }
+  }
+  // Reshaping the net plans the views again.
+  data->Reshape(1, 2, 3, 1);
+  this->net_->Reshape();
+  concat = this->net_->blob_by_name("concat").get();
+  for (int i = 0; i < 4; ++i) {
+    const int offset = (i % 2) * data->count();
+    EXPECT_EQ(concat->cpu_data() + offset,
+              this->net_->blob_by_name(names[i])->cpu_data()) << names[i];
+  }
+}
+
+TYPED_TEST(NetTest, TestSliceViewsOfDataLayer) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_mode(Caffe::CPU);
+  const string& proto =
+      "name: 'SliceDataNetwork' "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'MemoryData' "
+      "  top: 'data' "
+      "  top: 'label' "
+      "  memory_data_param { "
+      "    batch_size: 2 channels: 3 height: 1 width: 1 "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'slice' "
+      "  type: 'Slice' "
+      "  bottom: 'data' "
+      "  top: 'first' "
+      "  top: 'second' "
+      "  slice_param { axis: 0 } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'first' "
+      "  bottom: 'second' "
+      "  top: 'sum' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  const int kNum = 4;
+  const int kChannels = 3;
+  vector<Dtype> data(kNum * kChannels);
+  vector<Dtype> labels(kNum);
+  for (int i = 0; i < data.size(); ++i) {
+    data[i] = i;
+  }
+  shared_ptr<MemoryDataLayer<Dtype> > layer =
+      boost::static_pointer_cast<MemoryDataLayer<Dtype> >(
+          this->net_->layer_by_name("data"));
+  layer->Reset(data.data(), labels.data(), kNum);
+  // The data layer hands its top new memory on every Forward; the slices
+  // follow it rather than the buffer it replaced.
+  const Blob<Dtype>* top = this->net_->blob_by_name("data").get();
+  const Blob<Dtype>* first = this->net_->blob_by_name("first").get();
+  const Blob<Dtype>* second = this->net_->blob_by_name("second").get();
+  const Blob<Dtype>* sum = this->net_->blob_by_name("sum").get();
+  for (int n = 0; n < kNum; n += 2) {
+    this->net_->Forward();
+    EXPECT_EQ(top->cpu_data(), first->cpu_data());
+    EXPECT_EQ(top->cpu_data() + kChannels, second->cpu_data());
+    for (int c = 0; c < kChannels; ++c) {
+      EXPECT_EQ(data[n * kChannels + c] + data[(n + 1) * kChannels + c],
+                sum->cpu_data()[c]);
+    }
+  }
+}
+
+TYPED_TEST(NetTest, TestSliceWrittenInPlaceKeepsInput) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(this->seed_);
+  const string& proto =
+      "name: 'SliceInPlaceNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 4 dim: 3 } } "
+      "} "
+      "layer { "
+      "  name: 'slice' "
+      "  type: 'Slice' "
+      "  bottom: 'data' "
+      "  top: 'first' "
+      "  top: 'second' "
+      "  slice_param { axis: 0 } "
+      "} "
+      "layer { "
+      "  name: 'scale' "
+      "  type: 'Scale' "
+      "  bottom: 'first' "
+      "  top: 'first' "
+      "  scale_param { "
+      "    filler { type: 'constant' value: 2 } "
+      "    bias_term: true "
+      "    bias_filler { type: 'constant' value: 1 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'first' "
+      "  bottom: 'second' "
+      "  top: 'sum' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  Blob<Dtype>* data = this->net_->input_blobs()[0];
+  for (int i = 0; i < data->count(); ++i) {
+    data->mutable_cpu_data()[i] = i;
+  }
+  // Scaling the first slice in place must leave the input as it was, so
+  // that a second Forward on it computes the same sum.
+  this->net_->Forward();
+  Blob<Dtype> sum;
+  sum.CopyFrom(*this->net_->blob_by_name("sum"), false, true);
+  this->net_->Forward();
+  for (int i = 0; i < data->count(); ++i) {
+    EXPECT_EQ(Dtype(i), data->cpu_data()[i]);
+  }
+  const Blob<Dtype>* second_sum = this->net_->blob_by_name("sum").get();
+  for (int i = 0; i < sum.count(); ++i) {
+    EXPECT_EQ(sum.cpu_data()[i], second_sum->cpu_data()[i]);
+    EXPECT_EQ(2 * Dtype(i) + 1 + Dtype(i + sum.count()),
+              second_sum->cpu_data()[i]);
+  }
+}
+
+TYPED_TEST(NetTest, TestResidualBlockFusion) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(this->seed_);
+  const string& proto =
+      "name: 'ResidualNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  top: 'shortcut' "
+      "  input_param { "
+      "    shape { dim: 1 dim: 3 dim: 5 dim: 5 } "
+      "    shape { dim: 1 dim: 4 dim: 5 dim: 5 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'conv' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } "
+      "    bias_filler { type: 'gaussian' std: 0.5 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bn' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "} "
+      "layer { "
+      "  name: 'scale' "
+      "  type: 'Scale' "
+      "  bottom: 'conv' "
+      "  top: 'conv' "
+      "  scale_param { "
+      "    filler { type: 'gaussian' } "
+      "    bias_term: true "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'shortcut' "
+      "  bottom: 'conv' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'relu' "
+      "  type: 'ReLU' "
+      "  bottom: 'sum' "
+      "  top: 'sum' "
+      "} ";
+  this->InitNetFromProtoString(proto);
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> stats_filler(filler_param);
+  const vector<shared_ptr<Blob<Dtype> > >& bn_blobs =
+      this->net_->layer_by_name("bn")->blobs();
+  for (int i = 0; i < bn_blobs.size(); ++i) {
+    stats_filler.Fill(bn_blobs[i].get());
+  }
+  // The sum is formed in the convolution's output.
+  Blob<Dtype>* sum = this->net_->blob_by_name("sum").get();
+  EXPECT_EQ(this->net_->blob_by_name("conv")->cpu_data(), sum->cpu_data());
+  GaussianFiller<Dtype> filler(filler_param);
+  Blob<Dtype>* data = this->net_->blob_by_name("data").get();
+  Blob<Dtype>* shortcut = this->net_->blob_by_name("shortcut").get();
+  for (int num = 1; num <= 2; ++num) {
+    data->Reshape(num, 3, 5, 5);
+    shortcut->Reshape(num, 4, 5, 5);
+    filler.Fill(data);
+    filler.Fill(shortcut);
+    this->net_->Forward();
+    Blob<Dtype> fused;
+    fused.CopyFrom(*sum, false, true);
+    // Running one layer at a time does not fuse the block.
+    for (int i = 0; i < this->net_->layers().size(); ++i) {
+      this->net_->ForwardFromTo(i, i);
+    }
+    ASSERT_EQ(fused.count(), sum->count());
+    int num_positive = 0;
+    for (int i = 0; i < sum->count(); ++i) {
+      EXPECT_NEAR(sum->cpu_data()[i], fused.cpu_data()[i], 1e-5);
+      num_positive += fused.cpu_data()[i] > 0;
+    }
+    EXPECT_GT(num_positive, 0);
+    EXPECT_LT(num_positive, sum->count());
+  }
+}
+
+TYPED_TEST(NetTest, TestChannelsLast) {
+  typedef typename TypeParam::Dtype Dtype;
+  Caffe::set_mode(Caffe::CPU);
+  Caffe::set_random_seed(this->seed_);
+  const string& proto =
+      "name: 'ChannelsLastNetwork' "
+      "state { phase: TEST } "
+      "layer { "
+      "  name: 'data' "
+      "  type: 'Input' "
+      "  top: 'data' "
+      "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 6 } } "
+      "} "
+      "layer { "
+      "  name: 'conv1' "
+      "  type: 'Convolution' "
+      "  bottom: 'data' "
+      "  top: 'conv1' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 3 "
+      "    pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } "
+      "    bias_filler { type: 'gaussian' std: 0.5 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'bn' "
+      "  type: 'BatchNorm' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'scale' "
+      "  type: 'Scale' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "  scale_param { "
+      "    filler { type: 'gaussian' } "
+      "    bias_term: true "
+      "    bias_filler { type: 'gaussian' } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'relu1' "
+      "  type: 'ReLU' "
+      "  bottom: 'conv1' "
+      "  top: 'conv1' "
+      "} "
+      "layer { "
+      "  name: 'pool' "
+      "  type: 'Pooling' "
+      "  bottom: 'conv1' "
+      "  top: 'pool' "
+      "  pooling_param { pool: MAX kernel_size: 2 stride: 2 } "
+      "} "
+      "layer { "
+      "  name: 'dw' "
+      "  type: 'ConvolutionDepthwise' "
+      "  bottom: 'pool' "
+      "  top: 'dw' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    group: 4 "
+      "    kernel_size: 3 "
+      "    pad: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } "
+      "    bias_filler { type: 'gaussian' std: 0.5 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'proj' "
+      "  type: 'Convolution' "
+      "  bottom: 'pool' "
+      "  top: 'proj' "
+      "  convolution_param { "
+      "    num_output: 4 "
+      "    kernel_size: 1 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } "
+      "    bias_filler { type: 'gaussian' std: 0.5 } "
+      "  } "
+      "} "
+      "layer { "
+      "  name: 'sum' "
+      "  type: 'Eltwise' "
+      "  bottom: 'dw' "
+      "  bottom: 'proj' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'relu2' "
+      "  type: 'ReLU' "
+      "  bottom: 'sum' "
+      "  top: 'sum' "
+      "} "
+      "layer { "
+      "  name: 'concat' "
+      "  type: 'Concat' "
+      "  bottom: 'sum' "
+      "  bottom: 'pool' "
+      "  top: 'concat' "
+      "} "
+      "layer { "
+      "  name: 'ip' "
+      "  type: 'InnerProduct' "
+      "  bottom: 'sum' "
+      "  top: 'ip' "
+      "  inner_product_param { "
+      "    num_output: 5 "
+      "    weight_filler { type: 'gaussian' std: 0.5 } "
+      "  } "
+      "} ";
+  NetParameter param;
+  CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+  Net<Dtype> net(param);
+  FillerParameter filler_param;
+  filler_param.set_min(0.5);
+  filler_param.set_max(2);
+  UniformFiller<Dtype> stats_filler(filler_param);
+  const vector<shared_ptr<Blob<Dtype> > >& bn_blobs =
+      net.layer_by_name("bn")->blobs();
+  for (int i = 0; i < bn_blobs.size(); ++i) {
+    stats_filler.Fill(bn_blobs[i].get());
+  }
+  NetParameter trained;
+  net.ToProto(&trained);
+
+  param.set_channels_last(true);
+  Net<Dtype> net_nhwc(param);
+  net_nhwc.CopyTrainedLayersFrom(trained);
+  // Layouts change only where a layer cannot run channels-last.
+  EXPECT_TRUE(net_nhwc.has_layer("data_to_nhwc"));
+  EXPECT_TRUE(net_nhwc.has_layer("sum_to_nchw"));
+  EXPECT_TRUE(net_nhwc.has_layer("concat_to_nchw"));
+  EXPECT_FALSE(net_nhwc.has_layer("pool_to_nchw"));
+  EXPECT_EQ(net.layers().size() + 3, net_nhwc.layers().size());
+
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(net.blob_by_name("data").get());
+  net_nhwc.blob_by_name("data")->CopyFrom(*net.blob_by_name("data"));
+  net.Forward();
+  net_nhwc.Forward();
+  const char* const kOutputs[] = {"ip", "concat"};
+  for (int i = 0; i < 2; ++i) {
+    const Blob<Dtype>& expected = *net.blob_by_name(kOutputs[i]);
+    const Blob<Dtype>& actual = *net_nhwc.blob_by_name(kOutputs[i]);
+    ASSERT_TRUE(expected.shape() == actual.shape()) << kOutputs[i];
+    for (int j = 0; j < expected.count(); ++j) {
+      EXPECT_NEAR(expected.cpu_data()[j], actual.cpu_data()[j], 1e-4)
+          << kOutputs[i];
+    }
+  }
+}
+
 TYPED_TEST(NetTest, TestSkipPropagateDown) {
   // check bottom_need_backward if propagate_down is true
   this->InitSkipPropNet(false);
@@ -0,0 +1,138 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <string>
+#include <vector>
+
+#include "google/protobuf/text_format.h"
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/net.hpp"
+#include "caffe/net_model.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class NetModelTest : public CPUDeviceTest<Dtype> {
+  protected:
+  virtual void SetUp() {
+    const string proto =
+        "name: 'NetModelNet' "
+        "layer { "
+        "  name: 'data' "
+        "  type: 'Input' "
+        "  top: 'data' "
+        "  input_param { shape { dim: 2 dim: 3 dim: 6 dim: 5 } } "
+        "} "
+        "layer { "
+        "  name: 'conv' "
+        "  type: 'Convolution' "
+        "  convolution_param { "
+        "    num_output: 4 "
+        "    kernel_size: 3 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  bottom: 'data' "
+        "  top: 'conv' "
+        "} "
+        "layer { "
+        "  name: 'innerproduct' "
+        "  type: 'InnerProduct' "
+        "  inner_product_param { "
+        "    num_output: 5 "
+        "    weight_filler { type: 'gaussian' std: 0.1 } "
+        "    bias_filler { type: 'gaussian' std: 0.1 } "
+        "  } "
+        "  bottom: 'conv' "
+        "  top: 'innerproduct' "
+        "} ";
+    NetParameter param;
+    CHECK(google::protobuf::TextFormat::ParseFromString(proto, &param));
+    model_.reset(new NetModel<Dtype>(param, ""));
+  }
+
+  void FillInput(Net<Dtype>* net) {
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(net->input_blobs()[0]);
+  }
+
+  shared_ptr<NetModel<Dtype> > model_;
+};
+
+TYPED_TEST_CASE(NetModelTest, TestDtypes);
+
+TYPED_TEST(NetModelTest, TestContextsShareWeights) {
+  shared_ptr<Net<TypeParam> > context0 = this->model_->CreateContext();
+  shared_ptr<Net<TypeParam> > context1 = this->model_->CreateContext();
+  const vector<shared_ptr<Blob<TypeParam> > >& params =
+      this->model_->net().params();
+  ASSERT_EQ(params.size(), context0->params().size());
+  ASSERT_EQ(params.size(), context1->params().size());
+  for (int i = 0; i < params.size(); ++i) {
+    EXPECT_EQ(params[i]->cpu_data(), context0->params()[i]->cpu_data());
+    EXPECT_EQ(params[i]->cpu_data(), context1->params()[i]->cpu_data());
+  }
+  // Activations are private to each context.
+  EXPECT_NE(context0->blob_by_name("conv").get(),
+            context1->blob_by_name("conv").get());
+}
+
+TYPED_TEST(NetModelTest, TestForward) {
+  typedef TypeParam Dtype;
+  shared_ptr<Net<Dtype> > context0 = this->model_->CreateContext();
+  shared_ptr<Net<Dtype> > context1 = this->model_->CreateContext();
+  // A plain net holding its own copy of the weights serves as reference.
+  Net<Dtype> reference(this->model_->param());
+  reference.ShareTrainedLayersWith(&this->model_->net());
+  this->FillInput(context0.get());
+  this->FillInput(context1.get());
+  reference.input_blobs()[0]->CopyFrom(*context0->input_blobs()[0]);
+  context0->Forward();
+  context1->Forward();
+  reference.Forward();
+  const Blob<Dtype>* output0 = context0->output_blobs()[0];
+  const Blob<Dtype>* output1 = context1->output_blobs()[0];
+  const Blob<Dtype>* expected = reference.output_blobs()[0];
+  ASSERT_EQ(output0->count(), expected->count());
+  bool same_output = true;
+  for (int i = 0; i < output0->count(); ++i) {
+    EXPECT_EQ(output0->cpu_data()[i], expected->cpu_data()[i]);
+    same_output &= output0->cpu_data()[i] == output1->cpu_data()[i];
+  }
+  EXPECT_FALSE(same_output);
+}
+
+}  // namespace caffe
@@ -364,6 +364,46 @@ TYPED_TEST(NeuronLayerTest, TestSigmoid) {
   }
 }
 
+TYPED_TEST(NeuronLayerTest, TestElementwiseChain) {
+  typedef typename TypeParam::Dtype Dtype;
+  if (Caffe::mode() != Caffe::CPU) {
+    return;
+  }
+  // Large enough to be split across the thread pool.
+  Blob<Dtype> bottom(3, 7, 61, 67);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+  Blob<Dtype> expected;
+  vector<Blob<Dtype>*> expected_vec(1, &expected);
+  LayerParameter layer_param;
+  ELULayer<Dtype> elu(layer_param);
+  TanHLayer<Dtype> tanh(layer_param);
+  layer_param.mutable_power_param()->set_power(2);
+  layer_param.mutable_power_param()->set_scale(0.5);
+  layer_param.mutable_power_param()->set_shift(1);
+  PowerLayer<Dtype> power(layer_param);
+  // Layer by layer, the last two in-place.
+  elu.SetUp(bottom_vec, expected_vec);
+  tanh.SetUp(expected_vec, expected_vec);
+  power.SetUp(expected_vec, expected_vec);
+  elu.Forward(bottom_vec, expected_vec);
+  tanh.Forward(expected_vec, expected_vec);
+  power.Forward(expected_vec, expected_vec);
+  // Fused into one pass over the data.
+  vector<Layer<Dtype>*> chain;
+  chain.push_back(&elu);
+  chain.push_back(&tanh);
+  chain.push_back(&power);
+  Blob<Dtype> top(bottom.shape());
+  ForwardElementwiseChain(chain, bottom.count(), bottom.cpu_data(),
+                          top.mutable_cpu_data());
+  for (int i = 0; i < bottom.count(); ++i) {
+    EXPECT_EQ(expected.cpu_data()[i], top.cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(NeuronLayerTest, TestSigmoidGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
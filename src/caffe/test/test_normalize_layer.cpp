@@ -238,6 +238,40 @@ TYPED_TEST(NormalizeLayerTest, TestEps) {
   this->TestForward(channel_shared, across_spatial, eps);
 }
 
+TYPED_TEST(NormalizeLayerTest, TestForwardLarge) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Several spatial tiles per image.
+  this->blob_bottom_->Reshape(2, 40, 19, 23);
+  bool channel_shared = false;
+  bool across_spatial = false;
+  Dtype eps = 1e-10;
+  this->TestForward(channel_shared, across_spatial, eps);
+}
+
+TYPED_TEST(NormalizeLayerTest, TestGradient) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_norm_param()->mutable_scale_filler()->set_type(
+      "uniform");
+  NormalizeLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  this->SetUp();
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+                                  this->blob_top_vec_);
+}
+
+TYPED_TEST(NormalizeLayerTest, TestGradientAcrossSpatial) {
+  typedef typename TypeParam::Dtype Dtype;
+  LayerParameter layer_param;
+  layer_param.mutable_norm_param()->set_across_spatial(true);
+  layer_param.mutable_norm_param()->set_channel_shared(true);
+  NormalizeLayer<Dtype> layer(layer_param);
+  GradientChecker<Dtype> checker(1e-2, 1e-2);
+  this->SetUp();
+  checker.CheckGradientExhaustive(&layer, this->blob_bottom_vec_,
+                                  this->blob_top_vec_);
+}
+
 #ifdef USE_MLU
 
 template <typename TypeParam>
@@ -172,6 +172,33 @@ TYPED_TEST(PermuteLayerTest, TestForward2) {
   this->TestForward(orders);
 }
 
+TYPED_TEST(PermuteLayerTest, TestForwardChannelsLastRoundTrip) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Large enough to cover whole and partial transpose tiles.
+  this->blob_bottom_->Reshape(2, 37, 9, 5);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(this->blob_bottom_);
+  this->TestForward(vector<int>({0, 2, 3, 1}));
+  Blob<Dtype> nhwc;
+  nhwc.CopyFrom(*this->blob_top_, false, true);
+  LayerParameter layer_param;
+  PermuteParameter* permute_param = layer_param.mutable_permute_param();
+  permute_param->add_order(0);
+  permute_param->add_order(3);
+  permute_param->add_order(1);
+  permute_param->add_order(2);
+  PermuteLayer<Dtype> layer(layer_param);
+  vector<Blob<Dtype>*> bottom_vec(1, &nhwc);
+  layer.SetUp(bottom_vec, this->blob_top_vec_);
+  layer.Forward(bottom_vec, this->blob_top_vec_);
+  ASSERT_TRUE(this->blob_top_->shape() == this->blob_bottom_->shape());
+  for (int i = 0; i < this->blob_bottom_->count(); ++i) {
+    EXPECT_EQ(this->blob_bottom_->cpu_data()[i],
+              this->blob_top_->cpu_data()[i]);
+  }
+}
+
 TYPED_TEST(PermuteLayerTest, TestForwardorders) {
   vector<int> orders = {3, 1};
   this->TestForward(orders);
@@ -0,0 +1,108 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/pixel_transform.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+template <typename Dtype>
+class PixelTransformTest : public ::testing::Test {
+  protected:
+  PixelTransformTest() : height_(5), width_(7), src_step_(40) {}
+
+  // Checks PixelsToCHW against the per-pixel definition for one setting.
+  void Check(int channels, bool mirror, PixelMeanMode mean_mode) {
+    vector<uint8_t> src(height_ * src_step_);
+    for (int i = 0; i < src.size(); ++i) {
+      src[i] = static_cast<uint8_t>(i * 7 + 3);
+    }
+    vector<Dtype> mean(channels * height_ * width_);
+    for (int i = 0; i < mean.size(); ++i) {
+      mean[i] = Dtype(i % 11) / 2;
+    }
+    PixelTransformArgs<Dtype, uint8_t> args;
+    args.src = &src[0];
+    args.src_step = src_step_;
+    args.channels = channels;
+    args.height = height_;
+    args.width = width_;
+    args.mirror = mirror;
+    args.mean_mode = mean_mode;
+    args.mean = mean_mode == PIXEL_MEAN_NONE ? NULL : &mean[0];
+    args.mean_step = width_;
+    args.mean_plane_step = height_ * width_;
+    args.scale = Dtype(0.25);
+    vector<Dtype> dst(channels * height_ * width_);
+    PixelsToCHW(args, &dst[0]);
+    for (int c = 0; c < channels; ++c) {
+      for (int h = 0; h < height_; ++h) {
+        for (int w = 0; w < width_; ++w) {
+          Dtype expected = src[h * src_step_ + w * channels + c];
+          if (mean_mode == PIXEL_MEAN_VALUES) {
+            expected -= mean[c];
+          } else if (mean_mode == PIXEL_MEAN_FILE) {
+            expected -= mean[(c * height_ + h) * width_ + w];
+          }
+          expected *= args.scale;
+          const int out_w = mirror ? width_ - 1 - w : w;
+          EXPECT_EQ(expected, dst[(c * height_ + h) * width_ + out_w]);
+        }
+      }
+    }
+  }
+
+  int height_;
+  int width_;
+  int src_step_;
+};
+
+TYPED_TEST_CASE(PixelTransformTest, TestDtypes);
+
+TYPED_TEST(PixelTransformTest, TestAllKernels) {
+  const int channels[] = {1, 2, 3, 4};
+  const PixelMeanMode mean_modes[] = {PIXEL_MEAN_NONE, PIXEL_MEAN_VALUES,
+                                      PIXEL_MEAN_FILE};
+  for (int i = 0; i < 4; ++i) {
+    for (int mirror = 0; mirror < 2; ++mirror) {
+      for (int j = 0; j < 3; ++j) {
+        this->Check(channels[i], mirror, mean_modes[j]);
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -27,6 +27,9 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <algorithm>
+#include <cfloat>
+#include <numeric>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -35,6 +38,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/filler.hpp"
 #include "caffe/layers/pooling_layer.hpp"
+#include "caffe/util/channels_last.hpp"
 
 #ifdef USE_CUDNN
 #include "caffe/layers/cudnn_pooling_layer.hpp"
@@ -786,6 +790,161 @@ TYPED_TEST(PoolingLayerTest, TestGradientAvePadded) {
   }
 }
 
+TYPED_TEST(PoolingLayerTest, TestForwardKernelShapes) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Covers the fixed-size fast paths, their clipped borders and the
+  // global window against a direct evaluation of the pooling windows.
+  const int kernels[] = {2, 3, 4};
+  for (int pool = 0; pool < 2; ++pool) {
+    for (int k = 0; k < 3; ++k) {
+      for (int pad = 0; pad < kernels[k] && pad < 2; ++pad) {
+        LayerParameter layer_param;
+        PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+        pooling_param->set_kernel_size(kernels[k]);
+        pooling_param->set_stride(2);
+        pooling_param->set_pad(pad);
+        pooling_param->set_pool(pool == 0 ? PoolingParameter_PoolMethod_MAX :
+                                PoolingParameter_PoolMethod_AVE);
+        PoolingLayer<Dtype> layer(layer_param);
+        layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+        layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+        const Blob<Dtype>& bottom = *this->blob_bottom_;
+        const Blob<Dtype>& top = *this->blob_top_;
+        for (int n = 0; n < top.num(); ++n) {
+          for (int c = 0; c < top.channels(); ++c) {
+            for (int ph = 0; ph < top.height(); ++ph) {
+              for (int pw = 0; pw < top.width(); ++pw) {
+                const int hstart = ph * 2 - pad;
+                const int wstart = pw * 2 - pad;
+                const int pool_size =
+                    (std::min(hstart + kernels[k], bottom.height() + pad) -
+                     hstart) *
+                    (std::min(wstart + kernels[k], bottom.width() + pad) -
+                     wstart);
+                Dtype expected = pool == 0 ? Dtype(-FLT_MAX) : Dtype(0);
+                for (int h = std::max(hstart, 0);
+                     h < std::min(hstart + kernels[k], bottom.height()); ++h) {
+                  for (int w = std::max(wstart, 0);
+                       w < std::min(wstart + kernels[k], bottom.width());
+                       ++w) {
+                    const Dtype value = bottom.data_at(n, c, h, w);
+                    expected = pool == 0 ? std::max(expected, value) :
+                        expected + value;
+                  }
+                }
+                if (pool == 1) {
+                  expected /= pool_size;
+                }
+                EXPECT_NEAR(top.data_at(n, c, ph, pw), expected, 1e-5);
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  for (int pool = 0; pool < 2; ++pool) {
+    LayerParameter layer_param;
+    PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+    pooling_param->set_global_pooling(true);
+    pooling_param->set_pool(pool == 0 ? PoolingParameter_PoolMethod_MAX :
+                            PoolingParameter_PoolMethod_AVE);
+    PoolingLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    const Blob<Dtype>& bottom = *this->blob_bottom_;
+    const int dim = bottom.height() * bottom.width();
+    for (int i = 0; i < this->blob_top_->count(); ++i) {
+      const Dtype* plane = bottom.cpu_data() + i * dim;
+      Dtype expected = pool == 0 ? *std::max_element(plane, plane + dim) :
+          std::accumulate(plane, plane + dim, Dtype(0)) / dim;
+      EXPECT_NEAR(this->blob_top_->cpu_data()[i], expected, 1e-5);
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestForwardChannelsLast) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Channels-last is a CPU inference layout.
+  Caffe::set_mode(Caffe::CPU);
+  Blob<Dtype> bottom(2, 5, 7, 6);
+  FillerParameter filler_param;
+  GaussianFiller<Dtype> filler(filler_param);
+  filler.Fill(&bottom);
+  Blob<Dtype> bottom_nhwc(ChannelsLastShape(bottom.shape()));
+  caffe_cpu_nchw_to_nhwc(2, 5, 42, bottom.cpu_data(),
+                         bottom_nhwc.mutable_cpu_data());
+  // kernel, stride, pad; a kernel of 0 pools globally.
+  const int kConfigs[][3] = {{2, 2, 0}, {3, 2, 1}, {3, 1, 1}, {0, 1, 0}};
+  for (int pool = 0; pool < 2; ++pool) {
+    for (int i = 0; i < sizeof(kConfigs) / sizeof(kConfigs[0]); ++i) {
+      LayerParameter layer_param;
+      PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+      if (kConfigs[i][0] == 0) {
+        pooling_param->set_global_pooling(true);
+      } else {
+        pooling_param->set_kernel_size(kConfigs[i][0]);
+        pooling_param->set_stride(kConfigs[i][1]);
+        pooling_param->set_pad(kConfigs[i][2]);
+      }
+      pooling_param->set_pool(pool == 0 ? PoolingParameter_PoolMethod_MAX :
+                              PoolingParameter_PoolMethod_AVE);
+      layer_param.set_phase(TEST);
+      vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+      PoolingLayer<Dtype> layer(layer_param);
+      layer.SetUp(bottom_vec, this->blob_top_vec_);
+      layer.Forward(bottom_vec, this->blob_top_vec_);
+
+      layer_param.set_channels_last(true);
+      PoolingLayer<Dtype> nhwc_layer(layer_param);
+      Blob<Dtype> top_nhwc;
+      vector<Blob<Dtype>*> nhwc_bottom_vec(1, &bottom_nhwc);
+      vector<Blob<Dtype>*> nhwc_top_vec(1, &top_nhwc);
+      nhwc_layer.SetUp(nhwc_bottom_vec, nhwc_top_vec);
+      nhwc_layer.Forward(nhwc_bottom_vec, nhwc_top_vec);
+      const Blob<Dtype>& top = *this->blob_top_;
+      ASSERT_TRUE(top_nhwc.shape() == ChannelsLastShape(top.shape()));
+      for (int n = 0; n < top.num(); ++n) {
+        for (int c = 0; c < top.channels(); ++c) {
+          for (int h = 0; h < top.height(); ++h) {
+            for (int w = 0; w < top.width(); ++w) {
+              EXPECT_NEAR(top_nhwc.data_at(n, h, w, c),
+                          top.data_at(n, c, h, w), 1e-5);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+TYPED_TEST(PoolingLayerTest, TestGradientMaxTestPhase) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The TEST phase skips the mask in Forward; Backward must still match.
+  LayerParameter layer_param;
+  PoolingParameter* pooling_param = layer_param.mutable_pooling_param();
+  pooling_param->set_kernel_size(3);
+  pooling_param->set_stride(2);
+  pooling_param->set_pool(PoolingParameter_PoolMethod_MAX);
+  vector<bool> propagate_down(1, true);
+  vector<Dtype> diffs[2];
+  for (int phase = 0; phase < 2; ++phase) {
+    layer_param.set_phase(phase == 0 ? TRAIN : TEST);
+    PoolingLayer<Dtype> layer(layer_param);
+    layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+    layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+    caffe_set(this->blob_top_->count(), Dtype(1),
+              this->blob_top_->mutable_cpu_diff());
+    layer.Backward(this->blob_top_vec_, propagate_down,
+                   this->blob_bottom_vec_);
+    diffs[phase].assign(this->blob_bottom_->cpu_diff(),
+        this->blob_bottom_->cpu_diff() + this->blob_bottom_->count());
+  }
+  for (int i = 0; i < diffs[0].size(); ++i) {
+    EXPECT_EQ(diffs[0][i], diffs[1][i]);
+  }
+}
+
 #ifdef USE_CUDNN
 template <typename Dtype>
 class CuDNNPoolingLayerTest : public GPUDeviceTest<Dtype> {
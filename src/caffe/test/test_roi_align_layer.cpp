@@ -0,0 +1,207 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/blob.hpp"
+#include "caffe/common.hpp"
+#include "caffe/filler.hpp"
+#include "caffe/layers/roi_align_layer.hpp"
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+// Bilinear interpolation of one input plane, as in Detectron's ROIAlign.
+template <typename Dtype>
+Dtype bilinear_interpolate(const Dtype* plane, int height, int width,
+                           Dtype y, Dtype x) {
+  if (y < -1.0 || y > height || x < -1.0 || x > width) {
+    return 0;
+  }
+  y = std::max<Dtype>(y, 0);
+  x = std::max<Dtype>(x, 0);
+  int y_low = static_cast<int>(y);
+  int x_low = static_cast<int>(x);
+  int y_high = y_low + 1;
+  int x_high = x_low + 1;
+  if (y_low >= height - 1) {
+    y_high = y_low = height - 1;
+    y = y_low;
+  }
+  if (x_low >= width - 1) {
+    x_high = x_low = width - 1;
+    x = x_low;
+  }
+  const Dtype ly = y - y_low, lx = x - x_low;
+  const Dtype hy = 1 - ly, hx = 1 - lx;
+  return hy * hx * plane[y_low * width + x_low] +
+         hy * lx * plane[y_low * width + x_high] +
+         ly * hx * plane[y_high * width + x_low] +
+         ly * lx * plane[y_high * width + x_high];
+}
+
+template <typename Dtype>
+void caffe_roialign(const Blob<Dtype>* in, const Blob<Dtype>* rois,
+                    const ROIAlignParameter& param, Blob<Dtype>* out) {
+  const int channels = in->channels();
+  const int height = in->height();
+  const int width = in->width();
+  const int pooled_h = param.pooled_h();
+  const int pooled_w = param.pooled_w();
+  const Dtype scale = param.spatial_scale();
+  for (int n = 0; n < rois->num(); ++n) {
+    const Dtype* roi = rois->cpu_data() + n * 5;
+    const Dtype start_w = roi[1] * scale, start_h = roi[2] * scale;
+    const Dtype roi_w = std::max<Dtype>(roi[3] * scale - start_w, 1);
+    const Dtype roi_h = std::max<Dtype>(roi[4] * scale - start_h, 1);
+    const Dtype bin_h = roi_h / pooled_h, bin_w = roi_w / pooled_w;
+    const int grid_h = param.sampling_ratio() > 0 ? param.sampling_ratio() :
+                       std::ceil(roi_h / pooled_h);
+    const int grid_w = param.sampling_ratio() > 0 ? param.sampling_ratio() :
+                       std::ceil(roi_w / pooled_w);
+    for (int c = 0; c < channels; ++c) {
+      const Dtype* plane = in->cpu_data() + in->offset(roi[0], c);
+      for (int ph = 0; ph < pooled_h; ++ph) {
+        for (int pw = 0; pw < pooled_w; ++pw) {
+          Dtype sum = 0;
+          for (int iy = 0; iy < grid_h; ++iy) {
+            const Dtype y = start_h + ph * bin_h + (iy + .5) * bin_h / grid_h;
+            for (int ix = 0; ix < grid_w; ++ix) {
+              const Dtype x = start_w + pw * bin_w +
+                              (ix + .5) * bin_w / grid_w;
+              sum += bilinear_interpolate(plane, height, width, y, x);
+            }
+          }
+          out->mutable_cpu_data()[out->offset(n, c, ph, pw)] =
+              sum / (grid_h * grid_w);
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype>
+class ROIAlignLayerTest : public CPUDeviceTest<Dtype> {
+  protected:
+  ROIAlignLayerTest()
+      : blob_bottom_(new Blob<Dtype>(2, 24, 16, 20)),
+        blob_bottom_rois_(new Blob<Dtype>(vector<int>{40, 5})),
+        blob_top_(new Blob<Dtype>()) {
+    Caffe::set_random_seed(1701);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    // Boxes in input coordinates at twice the feature map resolution, some
+    // of them reaching past its border.
+    filler_param.set_min(-8);
+    filler_param.set_max(48);
+    UniformFiller<Dtype> box_filler(filler_param);
+    box_filler.Fill(blob_bottom_rois_);
+    Dtype* rois = blob_bottom_rois_->mutable_cpu_data();
+    for (int n = 0; n < blob_bottom_rois_->num(); ++n) {
+      Dtype* roi = rois + n * 5;
+      roi[0] = 0;
+      if (roi[1] > roi[3]) std::swap(roi[1], roi[3]);
+      if (roi[2] > roi[4]) std::swap(roi[2], roi[4]);
+    }
+    blob_bottom_vec_.push_back(blob_bottom_);
+    blob_bottom_vec_.push_back(blob_bottom_rois_);
+    blob_top_vec_.push_back(blob_top_);
+  }
+  virtual ~ROIAlignLayerTest() {
+    delete blob_bottom_;
+    delete blob_bottom_rois_;
+    delete blob_top_;
+  }
+
+  void TestForward(const LayerParameter& layer_param) {
+    // One batch of ROIs, all on the first image.
+    blob_bottom_->Reshape(1, 24, 16, 20);
+    FillerParameter filler_param;
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(blob_bottom_);
+    ROIAlignLayer<Dtype> layer(layer_param);
+    layer.SetUp(blob_bottom_vec_, blob_top_vec_);
+    layer.Forward(blob_bottom_vec_, blob_top_vec_);
+    Blob<Dtype> expected;
+    expected.ReshapeLike(*blob_top_);
+    caffe_roialign(blob_bottom_, blob_bottom_rois_,
+                   layer_param.roi_align_param(), &expected);
+    for (int i = 0; i < blob_top_->count(); ++i) {
+      EXPECT_NEAR(blob_top_->cpu_data()[i], expected.cpu_data()[i], 1e-5);
+    }
+  }
+
+  Blob<Dtype>* const blob_bottom_;
+  Blob<Dtype>* const blob_bottom_rois_;
+  Blob<Dtype>* const blob_top_;
+  vector<Blob<Dtype>*> blob_bottom_vec_;
+  vector<Blob<Dtype>*> blob_top_vec_;
+};
+
+TYPED_TEST_CASE(ROIAlignLayerTest, TestDtypes);
+
+TYPED_TEST(ROIAlignLayerTest, TestSetUp) {
+  LayerParameter layer_param;
+  ROIAlignParameter* roi_align_param = layer_param.mutable_roi_align_param();
+  roi_align_param->set_pooled_h(7);
+  roi_align_param->set_pooled_w(5);
+  ROIAlignLayer<TypeParam> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  EXPECT_EQ(this->blob_top_->num(), 2 * this->blob_bottom_rois_->num());
+  EXPECT_EQ(this->blob_top_->channels(), this->blob_bottom_->channels());
+  EXPECT_EQ(this->blob_top_->height(), 7);
+  EXPECT_EQ(this->blob_top_->width(), 5);
+}
+
+TYPED_TEST(ROIAlignLayerTest, TestForward) {
+  LayerParameter layer_param;
+  ROIAlignParameter* roi_align_param = layer_param.mutable_roi_align_param();
+  roi_align_param->set_pooled_h(7);
+  roi_align_param->set_pooled_w(5);
+  roi_align_param->set_spatial_scale(0.5);
+  this->TestForward(layer_param);
+}
+
+TYPED_TEST(ROIAlignLayerTest, TestForwardSamplingRatio) {
+  LayerParameter layer_param;
+  ROIAlignParameter* roi_align_param = layer_param.mutable_roi_align_param();
+  roi_align_param->set_pooled_h(3);
+  roi_align_param->set_pooled_w(3);
+  roi_align_param->set_spatial_scale(0.5);
+  roi_align_param->set_sampling_ratio(2);
+  this->TestForward(layer_param);
+}
+
+}  // namespace caffe
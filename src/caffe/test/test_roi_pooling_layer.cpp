@@ -315,6 +315,29 @@ TYPED_TEST(RoiPoolingLayerTest, Forward) {
   }
 }
 
+TYPED_TEST(RoiPoolingLayerTest, ForwardManyRois) {
+  typedef typename TypeParam::Dtype Dtype;
+  // Enough ROIs and channels to spread the tiles over the thread pool.
+  this->blob_bottom2_->Reshape(vector<int>{300, 5});
+  setInputData(this->blob_bottom_, this->blob_bottom2_, 0);
+  LayerParameter layer_param;
+  ROIPoolingParameter* roi_pool_param = layer_param.mutable_roi_pooling_param();
+  roi_pool_param->set_pooled_h(7);
+  roi_pool_param->set_pooled_w(7);
+  roi_pool_param->set_spatial_scale(0.5);
+  ROIPoolingLayer<Dtype> layer(layer_param);
+  layer.SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  layer.Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const Dtype* top_data = this->blob_top_->cpu_data();
+  caffe_roipool(this->blob_bottom_, this->blob_bottom2_, roi_pool_param,
+                this->MakeReferenceTop(this->blob_top_), 0);
+  const Dtype* ref_top_data = this->ref_blob_top_->cpu_data();
+  const int count = this->blob_top_->count();
+  for (int i = 0; i < count; i++) {
+    EXPECT_NEAR(top_data[i], ref_top_data[i], 5e-3);
+  }
+}
+
 #ifdef USE_MLU
 
 template <typename TypeParam>
@@ -399,6 +399,45 @@ TYPED_TEST(ScaleLayerTest, TestForwardBroadcastEnd) {
   }
 }
 
+TYPED_TEST(ScaleLayerTest, TestForwardLastAxisWithBias) {
+  typedef typename TypeParam::Dtype Dtype;
+  // The channel-wise Scale of a channels-last net: one value per element of
+  // the innermost axis, applied directly and through ForwardElementwise.
+  LayerParameter layer_param;
+  layer_param.set_phase(TEST);
+  layer_param.add_bottom("data");
+  ScaleParameter* scale_param = layer_param.mutable_scale_param();
+  scale_param->set_axis(3);
+  scale_param->mutable_filler()->set_type("gaussian");
+  scale_param->set_bias_term(true);
+  scale_param->mutable_bias_filler()->set_type("gaussian");
+  shared_ptr<ScaleLayer<Dtype>> layer(new ScaleLayer<Dtype>(layer_param));
+  layer->SetUp(this->blob_bottom_vec_, this->blob_top_vec_);
+  ASSERT_TRUE(layer->IsElementwise());
+  layer->Forward(this->blob_bottom_vec_, this->blob_top_vec_);
+  const int count = this->blob_bottom_->count();
+  vector<Dtype> piece_data(count);
+  const int kPiece = 7;
+  for (int offset = 0; offset < count; offset += kPiece) {
+    layer->ForwardElementwise_cpu(offset, std::min(kPiece, count - offset),
+        this->blob_bottom_->cpu_data() + offset, &piece_data[offset]);
+  }
+  for (int n = 0; n < this->blob_bottom_->num(); ++n) {
+    for (int c = 0; c < this->blob_bottom_->channels(); ++c) {
+      for (int h = 0; h < this->blob_bottom_->height(); ++h) {
+        for (int w = 0; w < this->blob_bottom_->width(); ++w) {
+          const Dtype expected = this->blob_bottom_->data_at(n, c, h, w) *
+                                     layer->blobs()[0]->cpu_data()[w] +
+                                 layer->blobs()[1]->cpu_data()[w];
+          EXPECT_NEAR(this->blob_top_->data_at(n, c, h, w), expected, 1e-5);
+          EXPECT_NEAR(piece_data[this->blob_top_->offset(n, c, h, w)],
+                      expected, 1e-5);
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(ScaleLayerTest, TestForwardScale) {
   typedef typename TypeParam::Dtype Dtype;
   this->blob_bottom_vec_.push_back(this->blob_bottom_scale_);
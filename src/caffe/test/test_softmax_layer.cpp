@@ -105,6 +105,40 @@ TYPED_TEST(SoftmaxLayerTest, TestForward) {
   }
 }
 
+TYPED_TEST(SoftmaxLayerTest, TestForwardShapes) {
+  typedef typename TypeParam::Dtype Dtype;
+  // A contiguous softmax axis, and an inner size spanning several tiles.
+  const int shapes[][4] = {{3, 1000, 1, 1}, {2, 7, 19, 31}};
+  for (int s = 0; s < 2; ++s) {
+    Blob<Dtype> bottom(shapes[s][0], shapes[s][1], shapes[s][2],
+                       shapes[s][3]);
+    FillerParameter filler_param;
+    filler_param.set_std(4);
+    GaussianFiller<Dtype> filler(filler_param);
+    filler.Fill(&bottom);
+    vector<Blob<Dtype>*> bottom_vec(1, &bottom);
+    LayerParameter layer_param;
+    SoftmaxLayer<Dtype> layer(layer_param);
+    layer.SetUp(bottom_vec, this->blob_top_vec_);
+    layer.Forward(bottom_vec, this->blob_top_vec_);
+    const int channels = bottom.channels();
+    const int inner = bottom.count(2);
+    for (int i = 0; i < bottom.num(); ++i) {
+      for (int k = 0; k < inner; ++k) {
+        double scale = 0;
+        for (int j = 0; j < channels; ++j) {
+          scale += exp(bottom.cpu_data()[(i * channels + j) * inner + k]);
+        }
+        for (int j = 0; j < channels; ++j) {
+          const int index = (i * channels + j) * inner + k;
+          EXPECT_NEAR(exp(bottom.cpu_data()[index]) / scale,
+                      this->blob_top_->cpu_data()[index], 1e-5);
+        }
+      }
+    }
+  }
+}
+
 TYPED_TEST(SoftmaxLayerTest, TestGradient) {
   typedef typename TypeParam::Dtype Dtype;
   LayerParameter layer_param;
@@ -34,6 +34,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/common.hpp"
 #include "caffe/syncedmem.hpp"
 #include "caffe/util/device_alternate.hpp"
+#include "caffe/util/device_staging.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/layout_cast.hpp"
 #include "caffe/util/math_functions.hpp"
 
 #include "caffe/test/test_caffe_main.hpp"
@@ -96,6 +99,107 @@ TEST_F(SyncedMemoryTest, TestCPUWrite) {
   }
 }
 
+// A 2x3 float tensor, which the device stores transposed.
+static LayoutCastParam TransposeParam() {
+  LayoutCastParam param;
+  param.src_shape.push_back(2);
+  param.src_shape.push_back(3);
+  param.order.push_back(1);
+  param.order.push_back(0);
+  return param;
+}
+
+TEST_F(SyncedMemoryTest, TestPrefetchToDevice) {
+  HostArenaBackend backend;
+  SyncedMemory mem(6 * sizeof(float));
+  float* cpu_data = static_cast<float*>(mem.mutable_cpu_data());
+  for (int i = 0; i < 6; ++i) {
+    cpu_data[i] = i;
+  }
+  mem.prefetch_to(SyncedMemory::STAGE_TO_DEVICE, TransposeParam(), &backend);
+  mem.wait();
+  const float* device_data = static_cast<const float*>(mem.device_data());
+  for (int i = 0; i < 2; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      EXPECT_EQ(device_data[j * 2 + i], cpu_data[i * 3 + j]);
+    }
+  }
+  EXPECT_EQ(backend.bytes_to_device(), 6 * sizeof(float));
+  EXPECT_EQ(mem.head(), SyncedMemory::HEAD_AT_CPU);
+}
+
+TEST_F(SyncedMemoryTest, TestPrefetchToDeviceDoubleBuffered) {
+  HostArenaBackend backend;
+  SyncedMemory mem(6 * sizeof(float));
+  caffe_set(6, 0.f, static_cast<float*>(mem.mutable_cpu_data()));
+  mem.prefetch_to(SyncedMemory::STAGE_TO_DEVICE, TransposeParam(), &backend);
+  for (int batch = 1; batch < 8; ++batch) {
+    mem.wait();
+    // The next batch is staged while the device reads this one.
+    caffe_set(6, static_cast<float>(batch),
+              static_cast<float*>(mem.mutable_cpu_data()));
+    mem.prefetch_to(SyncedMemory::STAGE_TO_DEVICE, TransposeParam(),
+                    &backend);
+    const float* device_data = static_cast<const float*>(mem.device_data());
+    for (int i = 0; i < 6; ++i) {
+      EXPECT_EQ(device_data[i], batch - 1);
+    }
+  }
+  mem.wait();
+  const float* device_data = static_cast<const float*>(mem.device_data());
+  for (int i = 0; i < 6; ++i) {
+    EXPECT_EQ(device_data[i], 7);
+  }
+  EXPECT_EQ(backend.bytes_to_device(), 8 * 6 * sizeof(float));
+}
+
+TEST_F(SyncedMemoryTest, TestPrefetchWaitsBeforeWrite) {
+  HostArenaBackend backend;
+  LayoutCastParam param;
+  param.src_shape.push_back(1000);
+  SyncedMemory mem(1000 * sizeof(float));
+  caffe_set(1000, 1.f, static_cast<float*>(mem.mutable_cpu_data()));
+  mem.prefetch_to(SyncedMemory::STAGE_TO_DEVICE, param, &backend);
+  // Writing the host data waits for the transfer reading it.
+  caffe_set(1000, 2.f, static_cast<float*>(mem.mutable_cpu_data()));
+  const float* device_data = static_cast<const float*>(mem.device_data());
+  for (int i = 0; i < 1000; ++i) {
+    EXPECT_EQ(device_data[i], 1);
+  }
+}
+
+TEST_F(SyncedMemoryTest, TestPrefetchToHost) {
+  HostArenaBackend backend;
+  LayoutCastParam param;
+  param.src_type = DT_FLOAT16;
+  param.src_shape.push_back(3);
+  param.src_shape.push_back(2);
+  param.order.push_back(1);
+  param.order.push_back(0);
+  SyncedMemory mem(6 * sizeof(float));
+  float values[6];
+  for (int batch = 0; batch < 4; ++batch) {
+    // The device writes a batch as 3x2 half, then the host reads it as 2x3.
+    for (int i = 0; i < 6; ++i) {
+      values[i] = batch * 6 + i;
+    }
+    caffe_cpu_float_to_half(6, values, static_cast<uint16_t*>(
+        mem.mutable_device_data(&backend, 6 * sizeof(uint16_t))));
+    mem.prefetch_to(SyncedMemory::STAGE_TO_HOST, param, &backend);
+    // The next batch may be written while this one is in flight.
+    caffe_memset(6 * sizeof(uint16_t), 0,
+                 mem.mutable_device_data(&backend, 6 * sizeof(uint16_t)));
+    const float* cpu_data = static_cast<const float*>(mem.cpu_data());
+    EXPECT_EQ(mem.head(), SyncedMemory::HEAD_AT_CPU);
+    for (int i = 0; i < 2; ++i) {
+      for (int j = 0; j < 3; ++j) {
+        EXPECT_EQ(cpu_data[i * 3 + j], values[j * 2 + i]);
+      }
+    }
+  }
+  EXPECT_EQ(backend.bytes_to_host(), 4 * 6 * sizeof(uint16_t));
+}
+
 #ifdef USE_CUDA  // GPU test
 
 TEST_F(SyncedMemoryTest, TestGPURead) {
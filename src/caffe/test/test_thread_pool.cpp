@@ -0,0 +1,159 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdint.h>
+
+#include <atomic>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class ThreadPoolTest : public ::testing::Test {
+  protected:
+  ThreadPoolTest() : pool_(4) {}
+
+  // Runs ParallelFor and checks that every index was visited exactly once.
+  void CheckCoverage(int64_t begin, int64_t end, int64_t grain) {
+    std::vector<std::atomic<int> > visits(end);
+    for (int64_t i = 0; i < end; ++i) {
+      visits[i] = 0;
+    }
+    pool_.ParallelFor(begin, end, grain, [&](int64_t b, int64_t e) {
+      EXPECT_LE(begin, b);
+      EXPECT_LT(b, e);
+      EXPECT_LE(e, end);
+      for (int64_t i = b; i < e; ++i) {
+        ++visits[i];
+      }
+    });
+    for (int64_t i = 0; i < end; ++i) {
+      EXPECT_EQ(visits[i], i < begin ? 0 : 1) << "index " << i;
+    }
+  }
+
+  ThreadPool pool_;
+};
+
+TEST_F(ThreadPoolTest, TestCoverage) {
+  CheckCoverage(0, 1, 1);
+  CheckCoverage(0, 7, 1);
+  CheckCoverage(3, 1000, 1);
+  CheckCoverage(0, 1000, 7);
+  CheckCoverage(5, 100003, 64);
+}
+
+TEST_F(ThreadPoolTest, TestChunkSize) {
+  std::atomic<int> short_chunks(0);
+  pool_.ParallelFor(0, 1000, 16, [&](int64_t b, int64_t e) {
+    if (e - b < 16) {
+      ++short_chunks;
+    }
+  });
+  // Only the last chunk of each participant's block may be short.
+  EXPECT_LE(short_chunks, pool_.num_threads());
+}
+
+TEST_F(ThreadPoolTest, TestUsesWorkers) {
+  std::atomic<int> main_thread_chunks(0);
+  std::atomic<int> chunks(0);
+  const std::thread::id main_thread = std::this_thread::get_id();
+  pool_.ParallelFor(0, 64, 1, [&](int64_t b, int64_t e) {
+    if (std::this_thread::get_id() == main_thread) {
+      ++main_thread_chunks;
+    }
+    ++chunks;
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  });
+  EXPECT_EQ(chunks, 64);
+  EXPECT_LT(main_thread_chunks, 64);
+}
+
+TEST_F(ThreadPoolTest, TestNested) {
+  std::atomic<int64_t> sum(0);
+  pool_.ParallelFor(0, 8, 1, [&](int64_t b, int64_t e) {
+    EXPECT_TRUE(ThreadPool::InParallelRegion());
+    const std::thread::id outer = std::this_thread::get_id();
+    // Runs inline on the thread of the enclosing chunk.
+    pool_.ParallelFor(0, 100, 1, [&](int64_t ib, int64_t ie) {
+      EXPECT_EQ(std::this_thread::get_id(), outer);
+      sum += ie - ib;
+    });
+  });
+  EXPECT_EQ(sum, 800);
+  EXPECT_FALSE(ThreadPool::InParallelRegion());
+}
+
+TEST_F(ThreadPoolTest, TestConcurrentCallers) {
+  std::atomic<int64_t> sum(0);
+  std::vector<std::thread> callers;
+  for (int t = 0; t < 4; ++t) {
+    callers.push_back(std::thread([&] {
+      for (int iter = 0; iter < 50; ++iter) {
+        pool_.ParallelFor(0, 1000, 10, [&](int64_t b, int64_t e) {
+          sum += e - b;
+        });
+      }
+    }));
+  }
+  for (int t = 0; t < callers.size(); ++t) {
+    callers[t].join();
+  }
+  EXPECT_EQ(sum, 4 * 50 * 1000);
+}
+
+TEST_F(ThreadPoolTest, TestSingleThread) {
+  ThreadPool pool(1);
+  int64_t sum = 0;
+  pool.ParallelFor(0, 100, 1, [&](int64_t b, int64_t e) { sum += e - b; });
+  EXPECT_EQ(sum, 100);
+}
+
+TEST_F(ThreadPoolTest, TestGlobalParallelFor) {
+  Caffe::set_num_threads(3);
+  EXPECT_EQ(Caffe::num_threads(), 3);
+  std::vector<int> values(1000, 0);
+  parallel_for(0, values.size(), 8, [&](int64_t b, int64_t e) {
+    for (int64_t i = b; i < e; ++i) {
+      values[i] = i;
+    }
+  });
+  for (int i = 0; i < values.size(); ++i) {
+    EXPECT_EQ(values[i], i);
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,99 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <cstring>
+#include <string>
+
+#include "gtest/gtest.h"
+
+#include "caffe/common.hpp"
+#include "caffe/syncedmem.hpp"
+#include "caffe/util/weight_cache.hpp"
+
+#include "caffe/test/test_caffe_main.hpp"
+
+namespace caffe {
+
+class WeightCacheTest : public ::testing::Test {
+  protected:
+  WeightCacheTest() : source_(new SyncedMemory(4 * sizeof(float))),
+                      derived_(0) {
+    float* data = static_cast<float*>(source_->mutable_cpu_data());
+    for (int i = 0; i < 4; ++i) {
+      data[i] = i;
+    }
+  }
+
+  // The weights in reverse order, counting the copies made.
+  shared_ptr<SyncedMemory> Reversed(const string& layout) {
+    return SharedWeightCopy(source_, layout, [this]() {
+      ++derived_;
+      shared_ptr<SyncedMemory> copy(new SyncedMemory(4 * sizeof(float)));
+      const float* data = static_cast<const float*>(source_->cpu_data());
+      float* reversed = static_cast<float*>(copy->mutable_cpu_data());
+      for (int i = 0; i < 4; ++i) {
+        reversed[i] = data[3 - i];
+      }
+      return copy;
+    });
+  }
+
+  shared_ptr<SyncedMemory> source_;
+  int derived_;
+};
+
+TEST_F(WeightCacheTest, TestShared) {
+  shared_ptr<SyncedMemory> first = Reversed("reversed");
+  shared_ptr<SyncedMemory> second = Reversed("reversed");
+  EXPECT_EQ(first, second);
+  EXPECT_EQ(1, derived_);
+  EXPECT_EQ(3, static_cast<const float*>(first->cpu_data())[0]);
+  // Another layout of the same weights is another copy.
+  shared_ptr<SyncedMemory> other = Reversed("other");
+  EXPECT_NE(first, other);
+  EXPECT_EQ(2, derived_);
+}
+
+TEST_F(WeightCacheTest, TestWritten) {
+  shared_ptr<SyncedMemory> first = Reversed("reversed");
+  static_cast<float*>(source_->mutable_cpu_data())[3] = 7;
+  shared_ptr<SyncedMemory> second = Reversed("reversed");
+  EXPECT_NE(first, second);
+  EXPECT_EQ(2, derived_);
+  EXPECT_EQ(7, static_cast<const float*>(second->cpu_data())[0]);
+}
+
+TEST_F(WeightCacheTest, TestReleased) {
+  Reversed("reversed");
+  // No user is left, so the copy is made again.
+  Reversed("reversed");
+  EXPECT_EQ(2, derived_);
+}
+
+}  // namespace caffe
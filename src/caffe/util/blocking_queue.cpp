@@ -32,6 +32,9 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <vector>
 
 #include "caffe/layers/base_data_layer.hpp"
+#ifdef USE_HDF5
+#include "caffe/layers/hdf5_data_layer.hpp"
+#endif
 #include "caffe/parallel.hpp"
 #include "caffe/util/blocking_queue.hpp"
 
@@ -120,6 +123,10 @@ size_t BlockingQueue<T>::size() const {
 
 template class BlockingQueue<Batch<float>*>;
 template class BlockingQueue<Batch<double>*>;
+#ifdef USE_HDF5
+template class BlockingQueue<HDF5Chunk<float>*>;
+template class BlockingQueue<HDF5Chunk<double>*>;
+#endif
 template class BlockingQueue<void**>;
 template class BlockingQueue<float*>;
 template class BlockingQueue<vector<string>>;
@@ -0,0 +1,299 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "caffe/util/channels_last.hpp"
+#include "caffe/util/format.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+// Tiles of kTransposeTile x kTransposeTile elements are read and written
+// while both their rows and their columns are in cache.
+const int kTransposeTile = 32;
+// Chunks of at least this many elements are worth a parallel task.
+const int kTransposeGrain = 65536;
+
+vector<int> ChannelsFirstShape(const vector<int>& nhwc_shape) {
+  CHECK_EQ(nhwc_shape.size(), 4) << "Channels-last blobs must have 4 axes.";
+  vector<int> shape(4);
+  shape[0] = nhwc_shape[0];
+  shape[1] = nhwc_shape[3];
+  shape[2] = nhwc_shape[1];
+  shape[3] = nhwc_shape[2];
+  return shape;
+}
+
+vector<int> ChannelsLastShape(const vector<int>& nchw_shape) {
+  CHECK_EQ(nchw_shape.size(), 4) << "Channels-last blobs must have 4 axes.";
+  vector<int> shape(4);
+  shape[0] = nchw_shape[0];
+  shape[1] = nchw_shape[2];
+  shape[2] = nchw_shape[3];
+  shape[3] = nchw_shape[1];
+  return shape;
+}
+
+// Transposes num planes of rows x cols elements, one strip of
+// kTransposeTile rows per task.
+template <typename Dtype>
+static void TransposePlanes(const int num, const int rows, const int cols,
+                            const Dtype* src, Dtype* dst) {
+  const int64_t plane = static_cast<int64_t>(rows) * cols;
+  if (rows == 1 || cols == 1) {
+    caffe_copy(num * plane, src, dst);
+    return;
+  }
+  const int strips = (rows + kTransposeTile - 1) / kTransposeTile;
+  const int64_t grain = std::max<int64_t>(1,
+      kTransposeGrain / (static_cast<int64_t>(kTransposeTile) * cols));
+  parallel_for(0, static_cast<int64_t>(num) * strips, grain,
+      [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; ++t) {
+      const Dtype* plane_src = src + t / strips * plane;
+      Dtype* plane_dst = dst + t / strips * plane;
+      const int row_begin = t % strips * kTransposeTile;
+      const int row_end = std::min(rows, row_begin + kTransposeTile);
+      for (int col_begin = 0; col_begin < cols; col_begin += kTransposeTile) {
+        const int col_end = std::min(cols, col_begin + kTransposeTile);
+        for (int r = row_begin; r < row_end; ++r) {
+          const Dtype* row = plane_src + static_cast<int64_t>(r) * cols;
+          for (int c = col_begin; c < col_end; ++c) {
+            plane_dst[static_cast<int64_t>(c) * rows + r] = row[c];
+          }
+        }
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+void caffe_cpu_nchw_to_nhwc(const int num, const int channels,
+    const int spatial, const Dtype* nchw, Dtype* nhwc) {
+  TransposePlanes(num, channels, spatial, nchw, nhwc);
+}
+
+template <typename Dtype>
+void caffe_cpu_nhwc_to_nchw(const int num, const int channels,
+    const int spatial, const Dtype* nhwc, Dtype* nchw) {
+  TransposePlanes(num, spatial, channels, nhwc, nchw);
+}
+
+template void caffe_cpu_nchw_to_nhwc<float>(const int num,
+    const int channels, const int spatial, const float* nchw, float* nhwc);
+template void caffe_cpu_nchw_to_nhwc<double>(const int num,
+    const int channels, const int spatial, const double* nchw, double* nhwc);
+template void caffe_cpu_nhwc_to_nchw<float>(const int num,
+    const int channels, const int spatial, const float* nhwc, float* nchw);
+template void caffe_cpu_nhwc_to_nchw<double>(const int num,
+    const int channels, const int spatial, const double* nhwc, double* nchw);
+
+string ChannelsLastBlobName(const string& blob_name) {
+  return blob_name + "_nhwc";
+}
+
+static bool IsChannelAxis(const int axis) {
+  return axis == 1 || axis == -3;
+}
+
+// Layers that are always worth running channels-last, transposing their
+// input if need be.
+static bool PrefersChannelsLast(const LayerParameter& layer) {
+  if (layer.bottom_size() != 1 || layer.top_size() != 1) {
+    return false;
+  }
+  if (layer.type() == "Convolution" ||
+      layer.type() == "ConvolutionDepthwise") {
+    // A first convolution that also normalises its input is left alone.
+    const ConvolutionParameter& conv_param = layer.convolution_param();
+    return conv_param.axis() == 1 && !conv_param.force_nd_im2col() &&
+        conv_param.kernel_size_size() <= 2 && !conv_param.has_mean_file() &&
+        conv_param.mean_value_size() == 0 && !conv_param.has_std() &&
+        !conv_param.has_scale();
+  }
+  if (layer.type() == "Pooling") {
+    return layer.pooling_param().pool() !=
+        PoolingParameter_PoolMethod_STOCHASTIC;
+  }
+  return false;
+}
+
+// Layers that run channels-last when their inputs already are.
+static bool SupportsChannelsLast(const LayerParameter& layer) {
+  static const char* const kElementwise[] = {"AbsVal", "BNLL", "Dropout",
+      "ELU", "Power", "ReLU", "Sigmoid", "TanH"};
+  const string& type = layer.type();
+  for (int i = 0; i < sizeof(kElementwise) / sizeof(kElementwise[0]); ++i) {
+    if (type == kElementwise[i]) {
+      return true;
+    }
+  }
+  if (type == "Eltwise") {
+    return true;
+  }
+  if (type == "BatchNorm") {
+    return layer.bottom_size() == 1;
+  }
+  if (type == "Scale") {
+    return layer.bottom_size() == 1 &&
+        IsChannelAxis(layer.scale_param().axis()) &&
+        layer.scale_param().num_axes() == 1;
+  }
+  if (type == "Concat") {
+    const ConcatParameter& concat_param = layer.concat_param();
+    return concat_param.has_concat_dim() ? concat_param.concat_dim() == 1 :
+        IsChannelAxis(concat_param.axis());
+  }
+  return false;
+}
+
+namespace {
+
+// Which versions of an original blob hold its current contents.
+struct BlobLayouts {
+  bool nchw;
+  bool nhwc;
+};
+
+class ChannelsLastInserter {
+  public:
+  explicit ChannelsLastInserter(NetParameter* param) : param_(param) {}
+
+  void Produced(const string& blob_name, const bool channels_last) {
+    layouts_[blob_name].nchw = !channels_last;
+    layouts_[blob_name].nhwc = channels_last;
+  }
+  bool HasChannelsLast(const string& blob_name) const {
+    map<string, BlobLayouts>::const_iterator it = layouts_.find(blob_name);
+    return it != layouts_.end() && it->second.nhwc;
+  }
+  // Adds a Permute layer making the given version of the blob current.
+  void Require(const string& blob_name, const bool channels_last) {
+    map<string, BlobLayouts>::iterator it = layouts_.find(blob_name);
+    if (it == layouts_.end()) {
+      // Not produced by any layer; Net will report it.
+      return;
+    }
+    if (channels_last ? it->second.nhwc : it->second.nchw) {
+      return;
+    }
+    const string nhwc_name = ChannelsLastBlobName(blob_name);
+    string layer_name = blob_name + (channels_last ? "_to_nhwc" : "_to_nchw");
+    const int uses = permute_count_[layer_name]++;
+    if (uses > 0) {
+      layer_name += "_" + format_int(uses);
+    }
+    LayerParameter* permute = param_->add_layer();
+    permute->set_name(layer_name);
+    permute->set_type("Permute");
+    permute->add_bottom(channels_last ? blob_name : nhwc_name);
+    permute->add_top(channels_last ? nhwc_name : blob_name);
+    const int order[4] = {0, channels_last ? 2 : 3, channels_last ? 3 : 1,
+                          channels_last ? 1 : 2};
+    for (int i = 0; i < 4; ++i) {
+      permute->mutable_permute_param()->add_order(order[i]);
+    }
+    if (channels_last) {
+      it->second.nhwc = true;
+    } else {
+      it->second.nchw = true;
+    }
+  }
+
+  private:
+  NetParameter* param_;
+  map<string, BlobLayouts> layouts_;
+  map<string, int> permute_count_;
+};
+
+}  // namespace
+
+void InsertChannelsLast(const NetParameter& param, NetParameter* param_nhwc) {
+  param_nhwc->CopyFrom(param);
+  param_nhwc->clear_layer();
+  ChannelsLastInserter inserter(param_nhwc);
+  // Track the net outputs as Net does: the blobs no layer consumes.
+  vector<string> outputs;
+  for (int i = 0; i < param.input_size(); ++i) {
+    inserter.Produced(param.input(i), false);
+    outputs.push_back(param.input(i));
+  }
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer = param.layer(i);
+    bool channels_last = PrefersChannelsLast(layer);
+    if (!channels_last && SupportsChannelsLast(layer)) {
+      channels_last = layer.bottom_size() > 0;
+      for (int j = 0; j < layer.bottom_size(); ++j) {
+        channels_last = channels_last &&
+            inserter.HasChannelsLast(layer.bottom(j));
+      }
+    }
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      inserter.Require(layer.bottom(j), channels_last);
+      outputs.erase(std::remove(outputs.begin(), outputs.end(),
+                                layer.bottom(j)), outputs.end());
+    }
+    LayerParameter* layer_nhwc = param_nhwc->add_layer();
+    layer_nhwc->CopyFrom(layer);
+    for (int j = 0; j < layer.top_size(); ++j) {
+      inserter.Produced(layer.top(j), channels_last);
+      if (std::find(outputs.begin(), outputs.end(), layer.top(j)) ==
+          outputs.end()) {
+        outputs.push_back(layer.top(j));
+      }
+    }
+    if (!channels_last) {
+      continue;
+    }
+    layer_nhwc->set_channels_last(true);
+    for (int j = 0; j < layer.bottom_size(); ++j) {
+      layer_nhwc->set_bottom(j, ChannelsLastBlobName(layer.bottom(j)));
+    }
+    for (int j = 0; j < layer.top_size(); ++j) {
+      layer_nhwc->set_top(j, ChannelsLastBlobName(layer.top(j)));
+    }
+    if (layer.type() == "Scale") {
+      layer_nhwc->mutable_scale_param()->set_axis(3);
+    } else if (layer.type() == "Concat") {
+      layer_nhwc->mutable_concat_param()->clear_concat_dim();
+      layer_nhwc->mutable_concat_param()->set_axis(3);
+    }
+  }
+  for (int i = 0; i < outputs.size(); ++i) {
+    inserter.Require(outputs[i], false);
+  }
+}
+
+}  // namespace caffe
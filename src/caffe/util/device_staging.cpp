@@ -0,0 +1,189 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <boost/thread.hpp>
+#include <cstring>
+#include <deque>
+#include <map>
+
+#include "caffe/internal_thread.hpp"
+#include "caffe/util/device_staging.hpp"
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+// The I/O thread of a DeviceBackend: runs the submitted jobs in order and
+// counts the completed ones, which the tickets are compared against.
+class StagingThread : public InternalThread {
+  public:
+  explicit StagingThread(DeviceBackend* backend)
+      : backend_(backend), submitted_(0), completed_(0) {}
+  virtual ~StagingThread() { StopInternalThread(); }
+
+  uint64_t Submit(const std::function<void()>& job) {
+    boost::mutex::scoped_lock lock(mutex_);
+    if (!is_started()) {
+      StartInternalThread();
+    }
+    jobs_.push_back(job);
+    const uint64_t ticket = ++submitted_;
+    lock.unlock();
+    queued_.notify_one();
+    return ticket;
+  }
+
+  void Wait(uint64_t ticket) {
+    boost::mutex::scoped_lock lock(mutex_);
+    CHECK_LE(ticket, submitted_) << "Waiting for a job never submitted.";
+    while (completed_ < ticket) {
+      done_.wait(lock);
+    }
+  }
+
+  protected:
+  virtual void InternalThreadEntry() {
+    backend_->InitThread();
+    // Waiting for a job is an interruption point, which is how
+    // StopInternalThread ends the loop.
+    try {
+      while (true) {
+        std::function<void()> job;
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          while (jobs_.empty()) {
+            queued_.wait(lock);
+          }
+          job = jobs_.front();
+          jobs_.pop_front();
+        }
+        job();
+        {
+          boost::mutex::scoped_lock lock(mutex_);
+          ++completed_;
+        }
+        done_.notify_all();
+      }
+    } catch (boost::thread_interrupted&) {
+      // Interrupted exception is expected on shutdown
+    }
+  }
+
+  private:
+  DeviceBackend* backend_;
+  boost::mutex mutex_;
+  boost::condition_variable queued_;
+  boost::condition_variable done_;
+  std::deque<std::function<void()> > jobs_;
+  uint64_t submitted_;
+  uint64_t completed_;
+};
+
+DeviceBackend::DeviceBackend() : thread_(new StagingThread(this)) {}
+
+DeviceBackend::~DeviceBackend() {}
+
+uint64_t DeviceBackend::Submit(const std::function<void()>& job) {
+  return thread_->Submit(job);
+}
+
+void DeviceBackend::Wait(uint64_t ticket) {
+  thread_->Wait(ticket);
+}
+
+void* HostArenaBackend::Malloc(size_t size) {
+  return HostAllocator::Get().Allocate(size, "HostArenaBackend");
+}
+
+void HostArenaBackend::Free(void* ptr) {
+  HostAllocator::Get().Free(ptr);
+}
+
+void HostArenaBackend::CopyToDevice(void* dst, const void* src, size_t size) {
+  memcpy(dst, src, size);
+  bytes_to_device_ += size;
+}
+
+void HostArenaBackend::CopyToHost(void* dst, const void* src, size_t size) {
+  memcpy(dst, src, size);
+  bytes_to_host_ += size;
+}
+
+#ifdef USE_MLU
+namespace {
+
+class MLUBackend : public DeviceBackend {
+  public:
+  explicit MLUBackend(cnrtDev_t device) : device_(device) {}
+
+  virtual void* Malloc(size_t size) {
+    void* ptr = NULL;
+    CNRT_CHECK(cnrtMalloc(&ptr, size));
+    return CHECK_NOTNULL(ptr);
+  }
+  virtual void Free(void* ptr) {
+    CNRT_CHECK(cnrtFree(ptr));
+  }
+  virtual void CopyToDevice(void* dst, const void* src, size_t size) {
+    CNRT_CHECK(cnrtMemcpy(dst, const_cast<void*>(src), size,
+          CNRT_MEM_TRANS_DIR_HOST2DEV));
+  }
+  virtual void CopyToHost(void* dst, const void* src, size_t size) {
+    CNRT_CHECK(cnrtMemcpy(dst, const_cast<void*>(src), size,
+          CNRT_MEM_TRANS_DIR_DEV2HOST));
+  }
+
+  protected:
+  // InternalThread does not carry the MLU binding over to its thread.
+  virtual void InitThread() {
+    CNRT_CHECK(cnrtSetCurrentDevice(device_));
+  }
+
+  private:
+  cnrtDev_t device_;
+};
+
+}  // namespace
+
+DeviceBackend* MLUStagingBackend() {
+  // Threads of the multicore examples each bind their own MLU, whose memory
+  // only a thread bound to the same MLU may copy.
+  static boost::mutex mutex;
+  static std::map<cnrtDev_t, shared_ptr<MLUBackend> > backends;
+  cnrtDev_t device;
+  CNRT_CHECK(cnrtGetCurrentDevice(&device));
+  boost::mutex::scoped_lock lock(mutex);
+  shared_ptr<MLUBackend>& backend = backends[device];
+  if (!backend) {
+    backend.reset(new MLUBackend(device));
+  }
+  return backend.get();
+}
+#endif
+
+}  // namespace caffe
@@ -0,0 +1,246 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+
+// Conversions between float and the 16-bit storage types.
+//
+// The array versions do the bit manipulation four lanes at a time with the
+// GCC vector extensions, as util/vector_math.cpp does, so they vectorise
+// on SSE2 and NEON without target-specific code. Where the CPU has F16C,
+// which is checked at run time, the FLOAT16 ones use its conversions
+// instead, as widening in software costs about as much as the memory
+// traffic FLOAT16 storage saves.
+
+#include <stdint.h>
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define CAFFE_HALF_F16C
+#endif
+
+#include "caffe/util/half.hpp"
+
+namespace caffe {
+
+namespace {
+
+typedef float vfloat __attribute__((vector_size(16)));
+typedef uint32_t vuint __attribute__((vector_size(16)));
+typedef int32_t vint __attribute__((vector_size(16)));
+const int kLanes = 4;
+
+inline vuint SplatUint(uint32_t x) {
+  const vuint v = {x, x, x, x};
+  return v;
+}
+
+inline vuint Select(vint mask, vuint a, vuint b) {
+  return ((vuint)mask & a) | (~(vuint)mask & b);
+}
+
+inline vuint LoadBits(const float* p) {
+  vuint v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline vuint LoadHalves(const uint16_t* p) {
+  const vuint v = {p[0], p[1], p[2], p[3]};
+  return v;
+}
+
+inline void StoreHalves(uint16_t* p, vuint v) {
+  for (int i = 0; i < kLanes; ++i) {
+    p[i] = static_cast<uint16_t>(v[i]);
+  }
+}
+
+// FLOAT16 bits in the low half of each lane to float bits.
+inline vuint HalfToFloat(vuint h) {
+  const vuint exponent_mask = SplatUint(0x7c00 << 13);
+  vuint o = (h & SplatUint(0x7fff)) << 13;
+  const vuint exponent = o & exponent_mask;
+  // Rebias the exponent from 15 to 127.
+  o += SplatUint((127 - 15) << 23);
+  // Infinities and NaN keep the maximal exponent.
+  const vint inf_nan = exponent == exponent_mask;
+  o += (vuint)inf_nan & SplatUint((128 - 16) << 23);
+  // Denormals are renormalised by the FPU: 2^-14 * 0.m = (1.m - 1) 2^-14.
+  const vint denormal = exponent == SplatUint(0);
+  const vfloat magic = (vfloat)SplatUint(113 << 23);
+  const vuint renormalised =
+      (vuint)((vfloat)(o + SplatUint(1 << 23)) - magic);
+  o = Select(denormal, renormalised, o);
+  return o | ((h & SplatUint(0x8000)) << 16);
+}
+
+// Float bits to FLOAT16 bits in the low half of each lane.
+inline vuint FloatToHalf(vuint u) {
+  const vuint sign = u & SplatUint(0x80000000u);
+  u ^= sign;
+  // Too large for FLOAT16: infinity, or a quiet NaN.
+  const vuint inf_nan = Select(u > SplatUint(0x7f800000), SplatUint(0x7e00),
+                               SplatUint(0x7c00));
+  // Results below 2^-14 are denormal: adding 0.5 aligns the mantissa so the
+  // FPU does the rounding.
+  const vfloat denormal_magic = (vfloat)SplatUint(126 << 23);
+  const vuint denormal =
+      (vuint)((vfloat)u + denormal_magic) - (vuint)denormal_magic;
+  // Normal results: rebias the exponent and round the mantissa to even.
+  const vuint odd = (u >> 13) & SplatUint(1);
+  const vuint normal =
+      (u + SplatUint(((15u - 127u) << 23) + 0xfff) + odd) >> 13;
+  vuint o = Select(u < SplatUint(113 << 23), denormal, normal);
+  o = Select(u >= SplatUint((127 + 16) << 23), inf_nan, o);
+  return o | (sign >> 16);
+}
+
+inline vuint FloatToBfloat16(vuint u) {
+  const vuint odd = (u >> 16) & SplatUint(1);
+  const vuint rounded = (u + SplatUint(0x7fff) + odd) >> 16;
+  // Rounding would turn a NaN with a small payload into infinity.
+  const vuint nan = (u >> 16) | SplatUint(0x40);
+  return Select((u & SplatUint(0x7fffffff)) > SplatUint(0x7f800000), nan,
+                rounded);
+}
+
+#ifdef CAFFE_HALF_F16C
+bool HasF16C() {
+  static const bool has_f16c = __builtin_cpu_supports("f16c") &&
+                               __builtin_cpu_supports("avx");
+  return has_f16c;
+}
+
+__attribute__((target("avx,f16c")))
+int HalfToFloatF16C(const int n, const uint16_t* x, float* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + i));
+    _mm256_storeu_ps(y + i, _mm256_cvtph_ps(h));
+  }
+  return i;
+}
+
+__attribute__((target("avx,f16c")))
+int FloatToHalfF16C(const int n, const float* x, uint16_t* y) {
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    const __m128i h = _mm256_cvtps_ph(_mm256_loadu_ps(x + i),
+                                      _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(y + i), h);
+  }
+  return i;
+}
+#endif  // CAFFE_HALF_F16C
+
+}  // namespace
+
+float caffe_half_to_float(const uint16_t x) {
+  const vuint o = HalfToFloat(SplatUint(x));
+  float y;
+  memcpy(&y, &o, sizeof(y));
+  return y;
+}
+
+uint16_t caffe_float_to_half(const float x) {
+  uint32_t u;
+  memcpy(&u, &x, sizeof(u));
+  return static_cast<uint16_t>(FloatToHalf(SplatUint(u))[0]);
+}
+
+float caffe_bfloat16_to_float(const uint16_t x) {
+  const uint32_t u = static_cast<uint32_t>(x) << 16;
+  float y;
+  memcpy(&y, &u, sizeof(y));
+  return y;
+}
+
+uint16_t caffe_float_to_bfloat16(const float x) {
+  uint32_t u;
+  memcpy(&u, &x, sizeof(u));
+  return static_cast<uint16_t>(FloatToBfloat16(SplatUint(u))[0]);
+}
+
+void caffe_cpu_half_to_float(const int n, const uint16_t* x, float* y) {
+  int i = 0;
+#ifdef CAFFE_HALF_F16C
+  if (HasF16C()) {
+    i = HalfToFloatF16C(n, x, y);
+  }
+#endif
+  for (; i + kLanes <= n; i += kLanes) {
+    const vuint o = HalfToFloat(LoadHalves(x + i));
+    memcpy(y + i, &o, sizeof(o));
+  }
+  for (; i < n; ++i) {
+    y[i] = caffe_half_to_float(x[i]);
+  }
+}
+
+void caffe_cpu_float_to_half(const int n, const float* x, uint16_t* y) {
+  int i = 0;
+#ifdef CAFFE_HALF_F16C
+  if (HasF16C()) {
+    i = FloatToHalfF16C(n, x, y);
+  }
+#endif
+  for (; i + kLanes <= n; i += kLanes) {
+    StoreHalves(y + i, FloatToHalf(LoadBits(x + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] = caffe_float_to_half(x[i]);
+  }
+}
+
+void caffe_cpu_bfloat16_to_float(const int n, const uint16_t* x, float* y) {
+  int i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    const vuint o = LoadHalves(x + i) << 16;
+    memcpy(y + i, &o, sizeof(o));
+  }
+  for (; i < n; ++i) {
+    y[i] = caffe_bfloat16_to_float(x[i]);
+  }
+}
+
+void caffe_cpu_float_to_bfloat16(const int n, const float* x, uint16_t* y) {
+  int i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    StoreHalves(y + i, FloatToBfloat16(LoadBits(x + i)));
+  }
+  for (; i < n; ++i) {
+    y[i] = caffe_float_to_bfloat16(x[i]);
+  }
+}
+
+}  // namespace caffe
@@ -35,11 +35,16 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 namespace caffe {
 
-// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
-template <typename Dtype>
-void hdf5_load_nd_dataset_helper(
-    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
-    Blob<Dtype>* blob, bool reshape) {
+boost::recursive_mutex& hdf5_mutex() {
+  // Never destroyed, like the library state it guards.
+  static boost::recursive_mutex* mutex = new boost::recursive_mutex();
+  return *mutex;
+}
+
+// Verifies format of data stored in HDF5 file and returns its dimensions.
+vector<hsize_t> hdf5_get_nd_dataset_dims(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   // Verify that the dataset exists.
   CHECK(H5LTfind_dataset(file_id, dataset_name_))
       << "Failed to find HDF5 dataset " << dataset_name_;
@@ -85,8 +90,17 @@ void hdf5_load_nd_dataset_helper(
   default:
     LOG(FATAL) << "Datatype class unknown";
   }
+  return dims;
+}
 
-
+// Verifies format of data stored in HDF5 file and reshapes blob accordingly.
+template <typename Dtype>
+void hdf5_load_nd_dataset_helper(
+    hid_t file_id, const char* dataset_name_, int min_dim, int max_dim,
+    Blob<Dtype>* blob, bool reshape) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+  vector<hsize_t> dims = hdf5_get_nd_dataset_dims(file_id, dataset_name_,
+                                                  min_dim, max_dim);
   vector<int> blob_dims(dims.size());
   for (int i = 0; i < dims.size(); ++i) {
     blob_dims[i] = dims[i];
@@ -133,10 +147,62 @@ void hdf5_load_nd_dataset<double>(hid_t file_id, const char* dataset_name_,
   CHECK_GE(status, 0) << "Failed to read double dataset " << dataset_name_;
 }
 
+// Reads rows [start, start + rows) along the first axis of a dataset.
+template <typename Dtype>
+static void hdf5_load_nd_dataset_rows_helper(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, hsize_t start,
+    int rows, hid_t mem_type, Blob<Dtype>* blob) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
+  vector<hsize_t> dims = hdf5_get_nd_dataset_dims(file_id, dataset_name_,
+                                                  min_dim, max_dim);
+  CHECK_LE(start + rows, dims[0]) << "Rows out of range for dataset "
+      << dataset_name_;
+  vector<int> blob_dims(dims.begin(), dims.end());
+  blob_dims[0] = rows;
+  blob->Reshape(blob_dims);
+  if (rows == 0) {
+    return;
+  }
+
+  vector<hsize_t> offset(dims.size(), 0);
+  offset[0] = start;
+  vector<hsize_t> count(dims);
+  count[0] = rows;
+  hid_t dataset = H5Dopen2(file_id, dataset_name_, H5P_DEFAULT);
+  CHECK_GE(dataset, 0) << "Failed to open dataset " << dataset_name_;
+  hid_t file_space = H5Dget_space(dataset);
+  herr_t status = H5Sselect_hyperslab(file_space, H5S_SELECT_SET,
+      offset.data(), NULL, count.data(), NULL);
+  CHECK_GE(status, 0) << "Failed to select rows of dataset " << dataset_name_;
+  hid_t mem_space = H5Screate_simple(count.size(), count.data(), NULL);
+  status = H5Dread(dataset, mem_type, mem_space, file_space, H5P_DEFAULT,
+                   blob->mutable_cpu_data());
+  CHECK_GE(status, 0) << "Failed to read rows of dataset " << dataset_name_;
+  H5Sclose(mem_space);
+  H5Sclose(file_space);
+  H5Dclose(dataset);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<float>(hid_t file_id, const char* dataset_name_,
+    int min_dim, int max_dim, hsize_t start, int rows, Blob<float>* blob) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, min_dim, max_dim,
+                                   start, rows, H5T_NATIVE_FLOAT, blob);
+}
+
+template <>
+void hdf5_load_nd_dataset_rows<double>(hid_t file_id,
+    const char* dataset_name_, int min_dim, int max_dim, hsize_t start,
+    int rows, Blob<double>* blob) {
+  hdf5_load_nd_dataset_rows_helper(file_id, dataset_name_, min_dim, max_dim,
+                                   start, rows, H5T_NATIVE_DOUBLE, blob);
+}
+
 template <>
 void hdf5_save_nd_dataset<float>(
     const hid_t file_id, const string& dataset_name, const Blob<float>& blob,
     bool write_diff) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -158,6 +224,7 @@ template <>
 void hdf5_save_nd_dataset<double>(
     hid_t file_id, const string& dataset_name, const Blob<double>& blob,
     bool write_diff) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int num_axes = blob.num_axes();
   hsize_t *dims = new hsize_t[num_axes];
   for (int i = 0; i < num_axes; ++i) {
@@ -176,6 +243,7 @@ void hdf5_save_nd_dataset<double>(
 }
 
 string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   // Get size of dataset
   size_t size;
   H5T_class_t class_;
@@ -193,6 +261,7 @@ string hdf5_load_string(hid_t loc_id, const string& dataset_name) {
 
 void hdf5_save_string(hid_t loc_id, const string& dataset_name,
                       const string& s) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   herr_t status = \
     H5LTmake_dataset_string(loc_id, dataset_name.c_str(), s.c_str());
   CHECK_GE(status, 0)
@@ -200,6 +269,7 @@ void hdf5_save_string(hid_t loc_id, const string& dataset_name,
 }
 
 int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   int val;
   herr_t status = H5LTread_dataset_int(loc_id, dataset_name.c_str(), &val);
   CHECK_GE(status, 0)
@@ -208,6 +278,7 @@ int hdf5_load_int(hid_t loc_id, const string& dataset_name) {
 }
 
 void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   hsize_t one = 1;
   herr_t status = \
     H5LTmake_dataset_int(loc_id, dataset_name.c_str(), 1, &one, &i);
@@ -216,6 +287,7 @@ void hdf5_save_int(hid_t loc_id, const string& dataset_name, int i) {
 }
 
 int hdf5_get_num_links(hid_t loc_id) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   H5G_info_t info;
   herr_t status = H5Gget_info(loc_id, &info);
   CHECK_GE(status, 0) << "Error while counting HDF5 links.";
@@ -223,6 +295,7 @@ int hdf5_get_num_links(hid_t loc_id) {
 }
 
 string hdf5_get_name_by_idx(hid_t loc_id, int idx) {
+  boost::recursive_mutex::scoped_lock lock(hdf5_mutex());
   ssize_t str_size = H5Lget_name_by_idx(
       loc_id, ".", H5_INDEX_NAME, H5_ITER_NATIVE, idx, NULL, 0, H5P_DEFAULT);
   CHECK_GE(str_size, 0) << "Error retrieving HDF5 dataset at index " << idx;
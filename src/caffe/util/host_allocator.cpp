@@ -0,0 +1,285 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "caffe/util/host_allocator.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Bookkeeping stored in the first kHostAllocAlignment bytes of a block,
+// right in front of the pointer handed out.
+struct BlockHeader {
+  size_t class_size;  // usable bytes behind the header
+  size_t requested;
+  int size_class;     // -1 for blocks that are never cached
+};
+
+const int kMinSizeClassLog = 6;  // 64 bytes
+const int kClassesPerDoubling = 4;
+const int kNumSizeClasses = 1 + kClassesPerDoubling *
+    (28 - kMinSizeClassLog);  // up to kHostAllocMaxCachedSize
+
+// Rounds size up to its class size; returns the class index, or -1 when
+// the block is too large to be cached.
+int SizeClass(size_t size, size_t* class_size) {
+  if (size <= (size_t(1) << kMinSizeClassLog)) {
+    *class_size = size_t(1) << kMinSizeClassLog;
+    return 0;
+  }
+  if (size > kHostAllocMaxCachedSize) {
+    *class_size = (size + kHostAllocAlignment - 1) / kHostAllocAlignment *
+                  kHostAllocAlignment;
+    return -1;
+  }
+  // 2^lg < size <= 2^(lg + 1), split into four classes of 2^lg / 4.
+  int lg = 0;
+  for (size_t s = size - 1; s > 1; s >>= 1) {
+    ++lg;
+  }
+  const size_t step = (size_t(1) << lg) / kClassesPerDoubling;
+  const size_t steps = (size + step - 1) / step;
+  *class_size = steps * step;
+  return 1 + (lg - kMinSizeClassLog) * kClassesPerDoubling +
+         static_cast<int>(steps - kClassesPerDoubling - 1);
+}
+
+inline BlockHeader* HeaderOf(void* ptr) {
+  return reinterpret_cast<BlockHeader*>(
+      static_cast<char*>(ptr) - kHostAllocAlignment);
+}
+
+inline void* UserPointer(BlockHeader* header) {
+  return reinterpret_cast<char*>(header) + kHostAllocAlignment;
+}
+
+}  // namespace
+
+// The free lists are touched by the owning thread only; mutex guards the
+// counters and cached_bytes against stats() reading them, so it is only
+// ever contended while statistics are read.
+struct HostAllocator::ThreadCache {
+  ThreadCache() : free_lists(kNumSizeClasses), cached_bytes(0) {}
+  ~ThreadCache() {
+    HostAllocator::Get().ReleaseCache(this);
+    HostAllocator::Get().RetireCache(this);
+  }
+
+  vector<vector<BlockHeader*> > free_lists;
+  size_t cached_bytes;
+  Counters counters;
+  boost::mutex mutex;
+};
+
+HostAllocator& HostAllocator::Get() {
+  // Never destroyed: blobs owned by static objects may still be freed
+  // after main returns.
+  static HostAllocator* instance = new HostAllocator();
+  return *instance;
+}
+
+HostAllocator::HostAllocator()
+    : max_cached_bytes_(size_t(1) << 29), use_hugepages_(false),
+      live_bytes_(0), peak_bytes_(0) {}
+
+HostAllocator::ThreadCache* HostAllocator::thread_cache() {
+  if (!thread_cache_.get()) {
+    ThreadCache* cache = new ThreadCache();
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      caches_.insert(cache);
+    }
+    thread_cache_.reset(cache);
+  }
+  return thread_cache_.get();
+}
+
+void HostAllocator::AddLiveBytes(size_t size) {
+  const size_t live = live_bytes_.fetch_add(size) + size;
+  size_t peak = peak_bytes_.load(std::memory_order_relaxed);
+  while (live > peak && !peak_bytes_.compare_exchange_weak(peak, live)) {}
+}
+
+void* HostAllocator::SystemAllocate(size_t class_size) {
+  const size_t bytes = kHostAllocAlignment + class_size;
+  const bool huge = use_hugepages_ && bytes >= kHostAllocHugePageSize;
+  void* block = NULL;
+  CHECK_EQ(posix_memalign(&block,
+      huge ? kHostAllocHugePageSize : kHostAllocAlignment, bytes), 0)
+      << "host allocation of size " << class_size << " failed";
+#ifdef MADV_HUGEPAGE
+  if (huge && madvise(block, bytes, MADV_HUGEPAGE) != 0) {
+    LOG_FIRST_N(WARNING, 1) << "madvise(MADV_HUGEPAGE) failed; "
+                            << "transparent huge pages may be disabled";
+  }
+#endif
+  return block;
+}
+
+void* HostAllocator::Allocate(size_t size, const char* site) {
+  size_t class_size;
+  const int size_class = SizeClass(size, &class_size);
+  ThreadCache* cache = thread_cache();
+  BlockHeader* header = NULL;
+  if (size_class >= 0) {
+    vector<BlockHeader*>& free_list = cache->free_lists[size_class];
+    if (!free_list.empty()) {
+      header = free_list.back();
+      free_list.pop_back();
+    }
+  }
+  const bool cache_hit = header != NULL;
+  if (!cache_hit) {
+    header = static_cast<BlockHeader*>(SystemAllocate(class_size));
+    header->class_size = class_size;
+    header->size_class = size_class;
+  }
+  header->requested = size;
+
+  AddLiveBytes(size);
+  boost::mutex::scoped_lock lock(cache->mutex);
+  ++cache->counters.allocations;
+  if (cache_hit) {
+    ++cache->counters.cache_hits;
+    cache->cached_bytes -= class_size;
+  }
+  SiteStats& site_stats = cache->counters.sites[site];
+  ++site_stats.allocations;
+  site_stats.bytes += size;
+  return UserPointer(header);
+}
+
+void HostAllocator::Free(void* ptr) {
+  if (!ptr) {
+    return;
+  }
+  BlockHeader* header = HeaderOf(ptr);
+  const size_t class_size = header->class_size;
+  live_bytes_ -= header->requested;
+  ThreadCache* cache = thread_cache();
+  const bool cached = header->size_class >= 0 &&
+      cache->cached_bytes + class_size <= max_cached_bytes_;
+  if (cached) {
+    cache->free_lists[header->size_class].push_back(header);
+  } else {
+    free(header);
+  }
+
+  boost::mutex::scoped_lock lock(cache->mutex);
+  ++cache->counters.frees;
+  if (cached) {
+    cache->cached_bytes += class_size;
+  }
+}
+
+void HostAllocator::ReleaseCache(ThreadCache* cache) {
+  for (int i = 0; i < cache->free_lists.size(); ++i) {
+    for (int j = 0; j < cache->free_lists[i].size(); ++j) {
+      free(cache->free_lists[i][j]);
+    }
+    cache->free_lists[i].clear();
+  }
+  boost::mutex::scoped_lock lock(cache->mutex);
+  cache->cached_bytes = 0;
+}
+
+// Keeps the counters of an exiting thread in retired_.
+void HostAllocator::RetireCache(ThreadCache* cache) {
+  boost::mutex::scoped_lock lock(mutex_);
+  caches_.erase(cache);
+  retired_.allocations += cache->counters.allocations;
+  retired_.frees += cache->counters.frees;
+  retired_.cache_hits += cache->counters.cache_hits;
+  for (std::map<const char*, SiteStats>::const_iterator it =
+       cache->counters.sites.begin(); it != cache->counters.sites.end();
+       ++it) {
+    SiteStats& site_stats = retired_.sites[it->first];
+    site_stats.allocations += it->second.allocations;
+    site_stats.bytes += it->second.bytes;
+  }
+}
+
+void HostAllocator::ReleaseThreadCache() {
+  if (thread_cache_.get()) {
+    ReleaseCache(thread_cache_.get());
+  }
+}
+
+void HostAllocator::AddCounters(const Counters& counters, Stats* stats) {
+  stats->allocations += counters.allocations;
+  stats->frees += counters.frees;
+  stats->cache_hits += counters.cache_hits;
+  for (std::map<const char*, SiteStats>::const_iterator it =
+       counters.sites.begin(); it != counters.sites.end(); ++it) {
+    SiteStats& site_stats = stats->sites[it->first];
+    site_stats.allocations += it->second.allocations;
+    site_stats.bytes += it->second.bytes;
+  }
+}
+
+HostAllocator::Stats HostAllocator::stats() {
+  Stats stats;
+  stats.live_bytes = live_bytes_;
+  stats.peak_bytes = peak_bytes_;
+  stats.cached_bytes = 0;
+  stats.allocations = 0;
+  stats.frees = 0;
+  stats.cache_hits = 0;
+  boost::mutex::scoped_lock lock(mutex_);
+  AddCounters(retired_, &stats);
+  for (std::set<ThreadCache*>::const_iterator it = caches_.begin();
+       it != caches_.end(); ++it) {
+    boost::mutex::scoped_lock cache_lock((*it)->mutex);
+    AddCounters((*it)->counters, &stats);
+    stats.cached_bytes += (*it)->cached_bytes;
+  }
+  return stats;
+}
+
+void HostAllocator::ResetStats() {
+  boost::mutex::scoped_lock lock(mutex_);
+  // Live and cached bytes describe memory that is still around.
+  peak_bytes_ = live_bytes_.load();
+  retired_ = Counters();
+  for (std::set<ThreadCache*>::const_iterator it = caches_.begin();
+       it != caches_.end(); ++it) {
+    boost::mutex::scoped_lock cache_lock((*it)->mutex);
+    (*it)->counters = Counters();
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,666 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Fused reorder, cast, quantisation and padding of host tensors, replacing
+// cnrtTransOrderAndCast, cnrtCastDataType and cnrtAddDataStride and their
+// temporary buffers.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "caffe/util/half.hpp"
+#include "caffe/util/layout_cast.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Tiles of up to kCastTile source rows by kCastTileSize / rows columns are
+// read and written while both their source and destination rows are in
+// cache; few rows, such as 3 or 4 image channels, make for wide tiles.
+const int kCastTile = 32;
+const int kCastTileSize = kCastTile * kCastTile;
+// Rows are cast through a float buffer of this many elements.
+const int kCastChunk = 256;
+// Chunks of at least this many elements are worth a parallel task.
+const int64_t kCastGrain = 65536;
+
+// Adding 1.5 * 2^23 to a float of magnitude below 2^22 rounds it to the
+// nearest integer, ties to even, and leaves that in the low mantissa bits.
+const float kRoundMagic = 12582912.f;
+
+// One destination axis: its extent in the source, the zeros appended to
+// it, and the element strides of the two tensors along it.
+struct CastAxis {
+  int64_t extent;
+  int64_t pad;
+  int64_t src_stride;
+  int64_t dst_stride;
+};
+
+template <BaseDataType type> struct CastStorage;
+template <> struct CastStorage<DT_FLOAT32> { typedef float T; };
+template <> struct CastStorage<DT_FLOAT16> { typedef uint16_t T; };
+template <> struct CastStorage<DT_BFLOAT16> { typedef uint16_t T; };
+template <> struct CastStorage<DT_INT8> { typedef int8_t T; };
+template <> struct CastStorage<DT_UINT8> { typedef uint8_t T; };
+template <> struct CastStorage<DT_INT16> { typedef int16_t T; };
+template <> struct CastStorage<DT_INT32> { typedef int32_t T; };
+
+bool IsIntegerType(BaseDataType type) {
+  return type == DT_INT8 || type == DT_UINT8 || type == DT_INT16 ||
+         type == DT_INT32;
+}
+
+typedef float vfloat __attribute__((vector_size(16)));
+typedef int32_t vint __attribute__((vector_size(16)));
+const int kLanes = 4;
+
+inline vfloat Splat(float x) {
+  const vfloat v = {x, x, x, x};
+  return v;
+}
+
+// mask ? a : b, lane by lane; mask lanes are all ones or all zeros.
+inline vfloat Select(vint mask, vfloat a, vfloat b) {
+  return (vfloat)((mask & (vint)a) | (~mask & (vint)b));
+}
+
+// Widens n source elements, stride apart, to floats multiplied by scale;
+// here for the integer types narrower than 2^22, four lanes at a time when
+// they are contiguous.
+template <BaseDataType type>
+void LoadRow(const typename CastStorage<type>::T* src, const int64_t stride,
+             const int n, const float scale, float* buf) {
+  int k = 0;
+  if (stride == 1) {
+    const vfloat magic = Splat(kRoundMagic);
+    const vfloat vscale = Splat(scale);
+    for (; k + kLanes <= n; k += kLanes) {
+      const vint q = {src[k], src[k + 1], src[k + 2], src[k + 3]};
+      const vfloat x = ((vfloat)(q + (vint)magic) - magic) * vscale;
+      memcpy(buf + k, &x, sizeof(x));
+    }
+  }
+  for (; k < n; ++k) {
+    buf[k] = static_cast<float>(src[k * stride]) * scale;
+  }
+}
+
+template <>
+void LoadRow<DT_INT32>(const int32_t* src, const int64_t stride,
+                       const int n, const float scale, float* buf) {
+  for (int k = 0; k < n; ++k) {
+    buf[k] = static_cast<float>(src[k * stride]) * scale;
+  }
+}
+
+template <>
+void LoadRow<DT_FLOAT32>(const float* src, const int64_t stride,
+                         const int n, const float scale, float* buf) {
+  if (stride == 1) {
+    memcpy(buf, src, n * sizeof(float));
+  } else {
+    for (int k = 0; k < n; ++k) {
+      buf[k] = src[k * stride];
+    }
+  }
+}
+
+template <>
+void LoadRow<DT_FLOAT16>(const uint16_t* src, const int64_t stride,
+                         const int n, const float scale, float* buf) {
+  if (stride == 1) {
+    caffe_cpu_half_to_float(n, src, buf);
+  } else {
+    for (int k = 0; k < n; ++k) {
+      buf[k] = caffe_half_to_float(src[k * stride]);
+    }
+  }
+}
+
+template <>
+void LoadRow<DT_BFLOAT16>(const uint16_t* src, const int64_t stride,
+                          const int n, const float scale, float* buf) {
+  if (stride == 1) {
+    caffe_cpu_bfloat16_to_float(n, src, buf);
+  } else {
+    for (int k = 0; k < n; ++k) {
+      buf[k] = caffe_bfloat16_to_float(src[k * stride]);
+    }
+  }
+}
+
+// x rounded to an integer, ties to even, saturated to [lo, hi]; NaN is 0.
+inline float RoundSaturate(float x, float lo, float hi) {
+  if (x != x) {
+    return 0;
+  }
+  x = std::min(std::max(x, lo), hi);
+  return (x + kRoundMagic) - kRoundMagic;
+}
+
+// Stores n floats multiplied by scale to consecutive elements of dst;
+// here for the integer types narrower than 2^22, four lanes at a time.
+template <BaseDataType type>
+void StoreRow(const float* buf, const int n, const float scale,
+              typename CastStorage<type>::T* dst) {
+  typedef typename CastStorage<type>::T T;
+  const float lo = static_cast<float>(std::numeric_limits<T>::min());
+  const float hi = static_cast<float>(std::numeric_limits<T>::max());
+  const vfloat vlo = Splat(lo);
+  const vfloat vhi = Splat(hi);
+  const vfloat vscale = Splat(scale);
+  const vfloat magic = Splat(kRoundMagic);
+  int k = 0;
+  for (; k + kLanes <= n; k += kLanes) {
+    vfloat x;
+    memcpy(&x, buf + k, sizeof(x));
+    x *= vscale;
+    x = Select(x < vlo, vlo, x);
+    x = Select(x > vhi, vhi, x);
+    x = Select(x != x, Splat(0), x);
+    const vint q = (vint)(x + magic) - (vint)magic;
+    for (int l = 0; l < kLanes; ++l) {
+      dst[k + l] = static_cast<T>(q[l]);
+    }
+  }
+  for (; k < n; ++k) {
+    dst[k] = static_cast<T>(RoundSaturate(buf[k] * scale, lo, hi));
+  }
+}
+
+template <>
+void StoreRow<DT_INT32>(const float* buf, const int n, const float scale,
+                        int32_t* dst) {
+  // The largest float below 2^31; the magic rounding is too narrow here.
+  const float hi = 2147483520.f;
+  for (int k = 0; k < n; ++k) {
+    const float x = buf[k] * scale;
+    dst[k] = x != x ? 0 : static_cast<int32_t>(
+        std::nearbyint(std::min(std::max(x, -hi - 128.f), hi)));
+  }
+}
+
+template <>
+void StoreRow<DT_FLOAT32>(const float* buf, const int n, const float scale,
+                          float* dst) {
+  memcpy(dst, buf, n * sizeof(float));
+}
+
+template <>
+void StoreRow<DT_FLOAT16>(const float* buf, const int n, const float scale,
+                          uint16_t* dst) {
+  caffe_cpu_float_to_half(n, buf, dst);
+}
+
+template <>
+void StoreRow<DT_BFLOAT16>(const float* buf, const int n, const float scale,
+                           uint16_t* dst) {
+  caffe_cpu_float_to_bfloat16(n, buf, dst);
+}
+
+// Casts strided source rows, or transposed tiles, into destination rows.
+template <BaseDataType src_type, BaseDataType dst_type>
+class CastRowOp {
+  public:
+  typedef typename CastStorage<src_type>::T SrcT;
+  typedef typename CastStorage<dst_type>::T DstT;
+
+  CastRowOp(const void* src, void* dst, float load_scale, float store_scale)
+      : src_(static_cast<const SrcT*>(src)), dst_(static_cast<DstT*>(dst)),
+        load_scale_(load_scale), store_scale_(store_scale) {}
+
+  void operator()(const int64_t src_offset, const int64_t src_stride,
+                  const int n, const int64_t dst_offset) const {
+    float buf[kCastChunk];
+    for (int k = 0; k < n; k += kCastChunk) {
+      const int m = std::min(kCastChunk, n - k);
+      LoadRow<src_type>(src_ + src_offset + k * src_stride, src_stride, m,
+                        load_scale_, buf);
+      StoreRow<dst_type>(buf, m, store_scale_, dst_ + dst_offset + k);
+    }
+  }
+
+  // Transposes rows x columns source elements, whose rows are src_stride
+  // apart, into columns destination rows of rows elements followed by pad
+  // zeros, dst_stride apart.
+  void Tile(const int64_t src_offset, const int64_t src_stride,
+            const int rows, const int columns, const int pad,
+            const int64_t dst_offset, const int64_t dst_stride) const {
+    float line[kCastTileSize];
+    float transposed[kCastTileSize];
+    const int pitch = rows + pad;
+    for (int r = 0; r < rows; ++r) {
+      const SrcT* src = src_ + src_offset + r * src_stride;
+      const float* values = reinterpret_cast<const float*>(src);
+      if (src_type != DT_FLOAT32) {
+        LoadRow<src_type>(src, 1, columns, load_scale_, line);
+        values = line;
+      }
+      for (int c = 0; c < columns; ++c) {
+        transposed[c * pitch + r] = values[c];
+      }
+    }
+    for (int r = rows; r < pitch; ++r) {
+      for (int c = 0; c < columns; ++c) {
+        transposed[c * pitch + r] = 0;
+      }
+    }
+    if (dst_stride == pitch) {
+      StoreRow<dst_type>(transposed, columns * pitch, store_scale_,
+                         dst_ + dst_offset);
+      return;
+    }
+    for (int c = 0; c < columns; ++c) {
+      StoreRow<dst_type>(transposed + c * pitch, pitch, store_scale_,
+                         dst_ + dst_offset + c * dst_stride);
+    }
+  }
+
+  private:
+  const SrcT* src_;
+  DstT* dst_;
+  const float load_scale_;
+  const float store_scale_;
+};
+
+// Copies strided rows, or transposed tiles, of elements of type T, for
+// matching types.
+template <typename T>
+class CopyRowOp {
+  public:
+  CopyRowOp(const void* src, void* dst)
+      : src_(static_cast<const T*>(src)), dst_(static_cast<T*>(dst)) {}
+
+  void operator()(const int64_t src_offset, const int64_t src_stride,
+                  const int n, const int64_t dst_offset) const {
+    const T* src = src_ + src_offset;
+    T* dst = dst_ + dst_offset;
+    if (src_stride == 1) {
+      memcpy(dst, src, n * sizeof(T));
+    } else {
+      for (int k = 0; k < n; ++k) {
+        dst[k] = src[k * src_stride];
+      }
+    }
+  }
+
+  void Tile(const int64_t src_offset, const int64_t src_stride,
+            const int rows, const int columns, const int pad,
+            const int64_t dst_offset, const int64_t dst_stride) const {
+    for (int r = 0; r < rows; ++r) {
+      const T* src = src_ + src_offset + r * src_stride;
+      T* dst = dst_ + dst_offset + r;
+      for (int c = 0; c < columns; ++c) {
+        dst[c * dst_stride] = src[c];
+      }
+    }
+    if (pad > 0) {
+      for (int c = 0; c < columns; ++c) {
+        memset(dst_ + dst_offset + c * dst_stride + rows, 0, pad * sizeof(T));
+      }
+    }
+  }
+
+  private:
+  const T* src_;
+  T* dst_;
+};
+
+// Offsets of the index-th combination of the given axes, the last of them
+// varying fastest.
+void AxesOffsets(const vector<CastAxis>& axes, const vector<int>& which,
+                 int64_t index, int64_t* src_offset, int64_t* dst_offset) {
+  *src_offset = 0;
+  *dst_offset = 0;
+  for (int i = which.size() - 1; i >= 0; --i) {
+    const CastAxis& axis = axes[which[i]];
+    const int64_t position = index % axis.extent;
+    index /= axis.extent;
+    *src_offset += position * axis.src_stride;
+    *dst_offset += position * axis.dst_stride;
+  }
+}
+
+// Calls op on every destination row. Rows of the innermost axis are written
+// whole when it is also innermost in the source, or has no unit-stride
+// partner; otherwise op transposes tiles of the innermost source and
+// destination axes.
+template <typename RowOp>
+void WalkAxes(const vector<CastAxis>& axes, const size_t dst_element,
+              const bool zero_row_pad, void* dst, const RowOp& op) {
+  const int last = axes.size() - 1;
+  const CastAxis& row = axes[last];
+  char* dst_bytes = static_cast<char*>(dst);
+  const auto zero_pad = [&](const int64_t dst_offset) {
+    if (zero_row_pad && row.pad > 0) {
+      memset(dst_bytes + (dst_offset + row.extent) * dst_element, 0,
+             row.pad * dst_element);
+    }
+  };
+
+  int tile_axis = -1;
+  for (int i = 0; i < last; ++i) {
+    if (axes[i].src_stride == 1 && row.src_stride != 1) {
+      tile_axis = i;
+    }
+  }
+  vector<int> outer;
+  int64_t outer_count = 1;
+  for (int i = 0; i < last; ++i) {
+    if (i != tile_axis) {
+      outer.push_back(i);
+      outer_count *= axes[i].extent;
+    }
+  }
+
+  if (tile_axis < 0) {
+    const int64_t grain = std::max<int64_t>(1, kCastGrain / row.extent);
+    parallel_for(0, outer_count, grain, [&](int64_t begin, int64_t end) {
+      for (int64_t r = begin; r < end; ++r) {
+        int64_t src_offset, dst_offset;
+        AxesOffsets(axes, outer, r, &src_offset, &dst_offset);
+        op(src_offset, row.src_stride, row.extent, dst_offset);
+        zero_pad(dst_offset);
+      }
+    });
+    return;
+  }
+
+  // The last block of rows carries the padding of the destination rows;
+  // CastAxes keeps it below kCastTile.
+  const CastAxis& column = axes[tile_axis];
+  const int row_pad = zero_row_pad ? row.pad : 0;
+  const int last_rows = (row.extent - 1) % kCastTile + 1;
+  const int tile_rows = std::max<int>(
+      std::min<int64_t>(kCastTile, row.extent), last_rows + row_pad);
+  const int tile_columns = kCastTileSize / tile_rows;
+  const int64_t strips = (column.extent + tile_columns - 1) / tile_columns;
+  const int64_t grain = std::max<int64_t>(1,
+      kCastGrain / (static_cast<int64_t>(tile_columns) * row.extent));
+  parallel_for(0, outer_count * strips, grain,
+      [&](int64_t begin, int64_t end) {
+    for (int64_t t = begin; t < end; ++t) {
+      int64_t src_base, dst_base;
+      AxesOffsets(axes, outer, t / strips, &src_base, &dst_base);
+      const int64_t column_begin = t % strips * tile_columns;
+      const int columns =
+          std::min<int64_t>(tile_columns, column.extent - column_begin);
+      src_base += column_begin * column.src_stride;
+      dst_base += column_begin * column.dst_stride;
+      for (int64_t r = 0; r < row.extent; r += kCastTile) {
+        const int rows = std::min<int64_t>(kCastTile, row.extent - r);
+        op.Tile(src_base + r * row.src_stride, row.src_stride, rows, columns,
+                r + rows == row.extent ? row_pad : 0, dst_base + r,
+                column.dst_stride);
+      }
+    }
+  });
+}
+
+template <typename RowOp>
+void CastAxes(const vector<CastAxis>& axes, const LayoutCastParam& param,
+              void* dst, const RowOp& op) {
+  const size_t dst_element = LayoutCastTypeSize(param.dst_type);
+  bool outer_pad = axes.back().pad >= kCastTile;
+  for (int i = 0; i + 1 < axes.size(); ++i) {
+    outer_pad = outer_pad || axes[i].pad > 0;
+  }
+  // Padding of an outer axis covers whole slabs, and wide padding of the
+  // rows would not fit a tile; clearing the destination up front is
+  // cheaper than tracking them.
+  if (outer_pad) {
+    memset(dst, 0, LayoutCastDstBytes(param));
+  }
+  WalkAxes(axes, dst_element, !outer_pad, dst, op);
+}
+
+template <BaseDataType src_type, BaseDataType dst_type>
+void CastTyped(const vector<CastAxis>& axes, const LayoutCastParam& param,
+               const void* src, void* dst) {
+  const float unit = param.quantized ?
+      std::ldexp(1.f, param.position) / param.scale : 1.f;
+  const float load_scale = IsIntegerType(src_type) ? unit : 1.f;
+  const float store_scale = IsIntegerType(dst_type) ? 1.f / unit : 1.f;
+  CastAxes(axes, param, dst,
+           CastRowOp<src_type, dst_type>(src, dst, load_scale, store_scale));
+}
+
+template <BaseDataType src_type>
+void CastToAny(const vector<CastAxis>& axes, const LayoutCastParam& param,
+               const void* src, void* dst) {
+  switch (param.dst_type) {
+  case DT_FLOAT32:
+    CastTyped<src_type, DT_FLOAT32>(axes, param, src, dst);
+    break;
+  case DT_FLOAT16:
+    CastTyped<src_type, DT_FLOAT16>(axes, param, src, dst);
+    break;
+  case DT_BFLOAT16:
+    CastTyped<src_type, DT_BFLOAT16>(axes, param, src, dst);
+    break;
+  case DT_INT8:
+    CastTyped<src_type, DT_INT8>(axes, param, src, dst);
+    break;
+  case DT_UINT8:
+    CastTyped<src_type, DT_UINT8>(axes, param, src, dst);
+    break;
+  case DT_INT16:
+    CastTyped<src_type, DT_INT16>(axes, param, src, dst);
+    break;
+  case DT_INT32:
+    CastTyped<src_type, DT_INT32>(axes, param, src, dst);
+    break;
+  default:
+    LOG(FATAL) << "Unsupported layout cast type: " << param.dst_type;
+  }
+}
+
+// The destination axes of param, with unit axes dropped and axes that are
+// adjacent in both tensors merged.
+vector<CastAxis> CastAxesOf(const LayoutCastParam& param) {
+  const int num_axes = param.src_shape.size();
+  vector<int64_t> src_strides(num_axes, 1);
+  for (int i = num_axes - 2; i >= 0; --i) {
+    src_strides[i] = src_strides[i + 1] * param.src_shape[i + 1];
+  }
+  const vector<int> dst_shape = LayoutCastDstShape(param);
+  vector<CastAxis> axes(num_axes);
+  int64_t dst_stride = 1;
+  for (int i = num_axes - 1; i >= 0; --i) {
+    const int axis = param.order.empty() ? i : param.order[i];
+    axes[i].extent = param.src_shape[axis];
+    axes[i].pad = dst_shape[i] - axes[i].extent;
+    axes[i].src_stride = src_strides[axis];
+    axes[i].dst_stride = dst_stride;
+    dst_stride *= dst_shape[i];
+  }
+
+  vector<CastAxis> merged;
+  for (int i = 0; i < num_axes; ++i) {
+    const CastAxis& axis = axes[i];
+    if (axis.extent == 1 && axis.pad == 0) {
+      continue;
+    }
+    if (!merged.empty()) {
+      CastAxis& outer = merged.back();
+      if (axis.pad == 0 && outer.src_stride == axis.extent * axis.src_stride) {
+        outer.extent *= axis.extent;
+        outer.pad *= axis.extent;
+        outer.src_stride = axis.src_stride;
+        outer.dst_stride = axis.dst_stride;
+        continue;
+      }
+    }
+    merged.push_back(axis);
+  }
+  if (merged.empty()) {
+    const CastAxis scalar = {1, 0, 1, 1};
+    merged.push_back(scalar);
+  }
+  return merged;
+}
+
+void CheckLayoutCastParam(const LayoutCastParam& param) {
+  const int num_axes = param.src_shape.size();
+  CHECK_GT(LayoutCastTypeSize(param.src_type), 0)
+      << "Unsupported layout cast type: " << param.src_type;
+  CHECK_GT(LayoutCastTypeSize(param.dst_type), 0)
+      << "Unsupported layout cast type: " << param.dst_type;
+  for (int i = 0; i < num_axes; ++i) {
+    CHECK_GE(param.src_shape[i], 0);
+  }
+  if (!param.order.empty()) {
+    CHECK_EQ(param.order.size(), num_axes);
+    vector<bool> seen(num_axes, false);
+    for (int i = 0; i < num_axes; ++i) {
+      const int axis = param.order[i];
+      CHECK(axis >= 0 && axis < num_axes && !seen[axis])
+          << "order must be a permutation of the source axes.";
+      seen[axis] = true;
+    }
+  }
+  if (!param.pad.empty()) {
+    CHECK_EQ(param.pad.size(), num_axes);
+    for (int i = 0; i < num_axes; ++i) {
+      CHECK_GE(param.pad[i], 0);
+    }
+  }
+  if (param.quantized) {
+    CHECK_NE(param.scale, 0);
+  }
+}
+
+}  // namespace
+
+vector<int> LayoutCastDstShape(const LayoutCastParam& param) {
+  vector<int> shape(param.src_shape.size());
+  for (int i = 0; i < shape.size(); ++i) {
+    shape[i] = param.src_shape[param.order.empty() ? i : param.order[i]];
+    if (!param.pad.empty()) {
+      shape[i] += param.pad[i];
+    }
+  }
+  return shape;
+}
+
+size_t LayoutCastDstBytes(const LayoutCastParam& param) {
+  const vector<int> shape = LayoutCastDstShape(param);
+  size_t count = 1;
+  for (int i = 0; i < shape.size(); ++i) {
+    count *= shape[i];
+  }
+  return count * LayoutCastTypeSize(param.dst_type);
+}
+
+size_t LayoutCastTypeSize(BaseDataType type) {
+  switch (type) {
+  case DT_FLOAT32:
+  case DT_INT32:
+    return 4;
+  case DT_FLOAT16:
+  case DT_BFLOAT16:
+  case DT_INT16:
+    return 2;
+  case DT_INT8:
+  case DT_UINT8:
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+bool LayoutCastIsCopy(const LayoutCastParam& param) {
+  CheckLayoutCastParam(param);
+  if (param.src_type != param.dst_type) {
+    return false;
+  }
+  const vector<CastAxis> axes = CastAxesOf(param);
+  return axes.size() == 1 && axes[0].pad == 0 && axes[0].src_stride == 1;
+}
+
+void caffe_cpu_layout_cast(const LayoutCastParam& param, const void* src,
+                           void* dst) {
+  CheckLayoutCastParam(param);
+  const vector<CastAxis> axes = CastAxesOf(param);
+  for (int i = 0; i < axes.size(); ++i) {
+    if (axes[i].extent == 0) {
+      memset(dst, 0, LayoutCastDstBytes(param));
+      return;
+    }
+  }
+  if (param.src_type == param.dst_type) {
+    switch (LayoutCastTypeSize(param.src_type)) {
+    case 1:
+      CastAxes(axes, param, dst, CopyRowOp<uint8_t>(src, dst));
+      break;
+    case 2:
+      CastAxes(axes, param, dst, CopyRowOp<uint16_t>(src, dst));
+      break;
+    default:
+      CastAxes(axes, param, dst, CopyRowOp<uint32_t>(src, dst));
+      break;
+    }
+    return;
+  }
+  switch (param.src_type) {
+  case DT_FLOAT32:
+    CastToAny<DT_FLOAT32>(axes, param, src, dst);
+    break;
+  case DT_FLOAT16:
+    CastToAny<DT_FLOAT16>(axes, param, src, dst);
+    break;
+  case DT_BFLOAT16:
+    CastToAny<DT_BFLOAT16>(axes, param, src, dst);
+    break;
+  case DT_INT8:
+    CastToAny<DT_INT8>(axes, param, src, dst);
+    break;
+  case DT_UINT8:
+    CastToAny<DT_UINT8>(axes, param, src, dst);
+    break;
+  case DT_INT16:
+    CastToAny<DT_INT16>(axes, param, src, dst);
+    break;
+  case DT_INT32:
+    CastToAny<DT_INT32>(axes, param, src, dst);
+    break;
+  default:
+    LOG(FATAL) << "Unsupported layout cast type: " << param.src_type;
+  }
+}
+
+}  // namespace caffe
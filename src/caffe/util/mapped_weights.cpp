@@ -0,0 +1,228 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <fstream>  // NOLINT(readability/streams)
+#include <string>
+#include <vector>
+
+#include "caffe/util/mapped_weights.hpp"
+
+namespace caffe {
+
+static inline uint64_t AlignUp(uint64_t value, uint64_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+static void PadTo(std::ofstream* output, uint64_t offset) {
+  const uint64_t pos = output->tellp();
+  CHECK_LE(pos, offset);
+  if (pos < offset) {
+    vector<char> zeros(offset - pos, 0);
+    output->write(zeros.data(), zeros.size());
+  }
+}
+
+static void BlobProtoShape(const BlobProto& proto, BlobShape* shape) {
+  shape->Clear();
+  if (proto.has_num() || proto.has_channels() || proto.has_height() ||
+      proto.has_width()) {
+    // Deprecated 4D Blob dimensions, same convention as Blob::FromProto.
+    shape->add_dim(proto.num());
+    shape->add_dim(proto.channels());
+    shape->add_dim(proto.height());
+    shape->add_dim(proto.width());
+  } else {
+    shape->CopyFrom(proto.shape());
+  }
+}
+
+static uint64_t ShapeCount(const BlobShape& shape) {
+  uint64_t count = 1;
+  for (int i = 0; i < shape.dim_size(); ++i) {
+    CHECK_GE(shape.dim(i), 0);
+    count *= shape.dim(i);
+  }
+  return count;
+}
+
+bool IsMappedWeightsFile(const string& filename) {
+  std::ifstream input(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!input.is_open()) {
+    return false;
+  }
+  char magic[sizeof(kMappedWeightsMagic)];
+  input.read(magic, sizeof(magic));
+  return input.gcount() == sizeof(magic) &&
+         memcmp(magic, kMappedWeightsMagic, sizeof(magic)) == 0;
+}
+
+void WriteNetParamsToMappedWeights(const NetParameter& param,
+                                   const string& filename) {
+  std::ofstream output(filename.c_str(),
+                       std::ios::out | std::ios::trunc | std::ios::binary);
+  CHECK(output.is_open()) << "Failed to open " << filename;
+
+  MappedWeightsHeader header;
+  memset(&header, 0, sizeof(header));
+  output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  MappedWeightsIndex index;
+  index.set_name(param.name());
+  for (int i = 0; i < param.layer_size(); ++i) {
+    const LayerParameter& layer_param = param.layer(i);
+    if (layer_param.blobs_size() == 0) {
+      continue;
+    }
+    MappedLayerIndex* layer_index = index.add_layer();
+    layer_index->set_name(layer_param.name());
+    for (int j = 0; j < layer_param.blobs_size(); ++j) {
+      const BlobProto& proto = layer_param.blobs(j);
+      MappedBlobIndex* blob_index = layer_index->add_blobs();
+      BlobProtoShape(proto, blob_index->mutable_shape());
+      const uint64_t count = ShapeCount(blob_index->shape());
+      const char* data = NULL;
+      if (proto.double_data_size() > 0) {
+        CHECK_EQ(count, proto.double_data_size())
+            << "Blob " << j << " of layer " << layer_param.name()
+            << " has a shape that does not match its data";
+        blob_index->set_dtype(DT_DOUBLE);
+        data = reinterpret_cast<const char*>(proto.double_data().data());
+      } else {
+        CHECK_EQ(count, proto.data_size())
+            << "Blob " << j << " of layer " << layer_param.name()
+            << " has a shape that does not match its data";
+        blob_index->set_dtype(DT_FLOAT32);
+        data = reinterpret_cast<const char*>(proto.data().data());
+      }
+      const uint64_t offset = AlignUp(output.tellp(), kMappedWeightsAlignment);
+      PadTo(&output, offset);
+      blob_index->set_offset(offset);
+      output.write(data, MappedWeights::blob_bytes(*blob_index));
+    }
+  }
+
+  string index_string;
+  CHECK(index.SerializeToString(&index_string));
+  header.index_offset = AlignUp(output.tellp(), kMappedWeightsAlignment);
+  header.index_size = index_string.size();
+  PadTo(&output, header.index_offset);
+  output.write(index_string.data(), index_string.size());
+
+  memcpy(header.magic, kMappedWeightsMagic, sizeof(header.magic));
+  header.version = kMappedWeightsVersion;
+  header.alignment = kMappedWeightsAlignment;
+  output.seekp(0);
+  output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  output.close();
+  CHECK(!output.fail()) << "Failed to write " << filename;
+}
+
+MappedWeights::MappedWeights(const string& filename)
+    : filename_(filename), addr_(NULL), size_(0) {
+  int fd = open(filename.c_str(), O_RDONLY);
+  CHECK_NE(fd, -1) << "File not found: " << filename;
+  struct stat file_stat;
+  CHECK_EQ(fstat(fd, &file_stat), 0) << "Failed to stat " << filename;
+  size_ = file_stat.st_size;
+  CHECK_GE(size_, sizeof(MappedWeightsHeader))
+      << "Truncated mapped weights file: " << filename;
+  // MAP_PRIVATE keeps the pages shared with every other process mapping the
+  // same file until someone writes to them.
+  addr_ = mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  CHECK(addr_ != MAP_FAILED) << "Failed to mmap " << filename;
+
+  const MappedWeightsHeader* header =
+      static_cast<const MappedWeightsHeader*>(addr_);
+  CHECK_EQ(memcmp(header->magic, kMappedWeightsMagic, sizeof(header->magic)),
+           0) << filename << " is not a mapped weights file";
+  CHECK_EQ(header->version, kMappedWeightsVersion)
+      << "Unsupported mapped weights version " << header->version;
+  CHECK_GT(header->alignment, 0u)
+      << "Invalid alignment in mapped weights file: " << filename;
+  CHECK_LE(header->index_offset + header->index_size, size_)
+      << "Truncated mapped weights file: " << filename;
+  CHECK(index_.ParseFromArray(
+      static_cast<const char*>(addr_) + header->index_offset,
+      header->index_size)) << "Failed to parse index of " << filename;
+
+  for (int i = 0; i < index_.layer_size(); ++i) {
+    const MappedLayerIndex& layer_index = index_.layer(i);
+    for (int j = 0; j < layer_index.blobs_size(); ++j) {
+      const MappedBlobIndex& blob_index = layer_index.blobs(j);
+      CHECK_EQ(blob_index.offset() % header->alignment, 0)
+          << "Misaligned blob " << j << " of layer " << layer_index.name();
+      CHECK_LE(blob_index.offset() + blob_bytes(blob_index), size_)
+          << "Blob " << j << " of layer " << layer_index.name()
+          << " exceeds " << filename;
+    }
+    layer_names_index_[layer_index.name()] = i;
+  }
+}
+
+MappedWeights::~MappedWeights() {
+  if (addr_ != NULL) {
+    munmap(addr_, size_);
+  }
+}
+
+const MappedLayerIndex* MappedWeights::layer(const string& layer_name) const {
+  map<string, int>::const_iterator it = layer_names_index_.find(layer_name);
+  if (it == layer_names_index_.end()) {
+    return NULL;
+  }
+  return &index_.layer(it->second);
+}
+
+void* MappedWeights::blob_data(const MappedBlobIndex& blob) const {
+  return static_cast<char*>(addr_) + blob.offset();
+}
+
+size_t MappedWeights::blob_bytes(const MappedBlobIndex& blob) {
+  size_t element_size = 0;
+  switch (blob.dtype()) {
+  case DT_FLOAT32:
+    element_size = sizeof(float);
+    break;
+  case DT_DOUBLE:
+    element_size = sizeof(double);
+    break;
+  default:
+    LOG(FATAL) << "Unsupported mapped blob data type: " << blob.dtype();
+  }
+  return ShapeCount(blob.shape()) * element_size;
+}
+
+}  // namespace caffe
@@ -236,21 +236,11 @@ void caffe_sqrt<double>(const int n, const double* a, double* y) {
   vdSqrt(n, a, y);
 }
 
-template <>
-void caffe_exp<float>(const int n, const float* a, float* y) {
-  vsExp(n, a, y);
-}
-
 template <>
 void caffe_exp<double>(const int n, const double* a, double* y) {
   vdExp(n, a, y);
 }
 
-template <>
-void caffe_log<float>(const int n, const float* a, float* y) {
-  vsLn(n, a, y);
-}
-
 template <>
 void caffe_log<double>(const int n, const double* a, double* y) {
   vdLn(n, a, y);
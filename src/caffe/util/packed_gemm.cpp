@@ -0,0 +1,349 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+// Small-batch products against panel-packed weights.
+//
+// The kernels hold the sums of one panel for all M rows in vector registers
+// using the GCC vector extensions, as util/vector_math.cpp does, so they
+// vectorise at -O2 on both SSE and NEON without target-specific code.
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "caffe/common.hpp"
+#include "caffe/util/half.hpp"
+#include "caffe/util/packed_gemm.hpp"
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+namespace {
+
+// Roughly the number of weights one parallel task should stream.
+const int64_t kPackedGrain = 65536;
+
+template <typename Dtype> struct PanelVec;
+template <> struct PanelVec<float> {
+  typedef float type __attribute__((vector_size(16)));
+};
+template <> struct PanelVec<double> {
+  typedef double type __attribute__((vector_size(16)));
+};
+
+// Adds A[m][0, depth) . panel[0, depth) to the kPackedPanel sums acc[m]
+// of each of the M rows of A, whose rows are lda apart.
+template <typename Dtype, int M>
+inline void PanelSums(const int depth, const Dtype* A, const int lda,
+                      const Dtype* panel,
+                      typename PanelVec<Dtype>::type* acc) {
+  typedef typename PanelVec<Dtype>::type V;
+  const int kVecs = kPackedPanel * sizeof(Dtype) / sizeof(V);
+  for (int k = 0; k < depth; ++k) {
+    V w[kVecs];
+    memcpy(w, panel + k * kPackedPanel, sizeof(w));
+    for (int m = 0; m < M; ++m) {
+      const V a = V() + A[m * lda + k];
+      for (int v = 0; v < kVecs; ++v) {
+        acc[m * kVecs + v] += a * w[v];
+      }
+    }
+  }
+}
+
+// C[m][0, n) = acc[m] (+ bias) for the M rows.
+template <typename Dtype, int M>
+inline void StoreSums(const typename PanelVec<Dtype>::type* acc,
+                      const Dtype* bias, const int n, Dtype* C,
+                      const int ldc) {
+  for (int m = 0; m < M; ++m) {
+    Dtype out[kPackedPanel];
+    memcpy(out, reinterpret_cast<const Dtype*>(acc) + m * kPackedPanel,
+           sizeof(out));
+    for (int j = 0; j < n; ++j) {
+      C[m * ldc + j] = bias ? out[j] + bias[j] : out[j];
+    }
+  }
+}
+
+// C[m][0, n) = A[m] . panel (+ bias) for the M rows of A.
+template <typename Dtype, int M>
+void PanelKernel(const int K, const Dtype* A, const Dtype* panel,
+                 const Dtype* bias, const int n, Dtype* C, const int ldc) {
+  typedef typename PanelVec<Dtype>::type V;
+  V acc[M * kPackedPanel * sizeof(Dtype) / sizeof(V)];
+  memset(acc, 0, sizeof(acc));
+  PanelSums<Dtype, M>(K, A, K, panel, acc);
+  StoreSums<Dtype, M>(acc, bias, n, C, ldc);
+}
+
+// Inputs of a 16-bit panel widened at a time; the widened block stays in
+// the L1 cache.
+const int kWidenDepth = 256;
+
+void Widen(const int n, const uint16_t* x, const BaseDataType type,
+           float* y) {
+  if (type == DT_FLOAT16) {
+    caffe_cpu_half_to_float(n, x, y);
+  } else {
+    caffe_cpu_bfloat16_to_float(n, x, y);
+  }
+}
+
+void Widen(const int n, const uint16_t* x, const BaseDataType type,
+           double* y) {
+  float block[kWidenDepth * kPackedPanel];
+  Widen(n, x, type, block);
+  for (int i = 0; i < n; ++i) {
+    y[i] = block[i];
+  }
+}
+
+void Narrow(const int n, const float* x, const BaseDataType type,
+            uint16_t* y) {
+  if (type == DT_FLOAT16) {
+    caffe_cpu_float_to_half(n, x, y);
+  } else {
+    caffe_cpu_float_to_bfloat16(n, x, y);
+  }
+}
+
+// As PanelKernel, with a FLOAT16 or BFLOAT16 panel.
+template <typename Dtype, int M>
+void Panel16Kernel(const int K, const Dtype* A, const uint16_t* panel,
+                   const BaseDataType type, const Dtype* bias, const int n,
+                   Dtype* C, const int ldc) {
+  typedef typename PanelVec<Dtype>::type V;
+  V acc[M * kPackedPanel * sizeof(Dtype) / sizeof(V)];
+  memset(acc, 0, sizeof(acc));
+  Dtype block[kWidenDepth * kPackedPanel];
+  for (int k = 0; k < K; k += kWidenDepth) {
+    const int depth = std::min(kWidenDepth, K - k);
+    Widen(depth * kPackedPanel, panel + k * kPackedPanel, type, block);
+    PanelSums<Dtype, M>(depth, A + k, K, block, acc);
+  }
+  StoreSums<Dtype, M>(acc, bias, n, C, ldc);
+}
+
+// BFLOAT16 is the top half of a float, so a float product can widen a
+// BFLOAT16 panel in registers. Read as four 32-bit lanes, a panel row holds
+// outputs 0, 2, 4 and 6 in the low halves and 1, 3, 5 and 7 in the high
+// ones, given a little-endian host.
+template <int M>
+void Bfloat16PanelKernel(const int K, const float* A, const uint16_t* panel,
+                         const BaseDataType type, const float* bias,
+                         const int n, float* C, const int ldc) {
+  typedef PanelVec<float>::type V;
+  typedef uint32_t U __attribute__((vector_size(16)));
+  const U high = {0xffff0000u, 0xffff0000u, 0xffff0000u, 0xffff0000u};
+  V even[M], odd[M];
+  memset(even, 0, sizeof(even));
+  memset(odd, 0, sizeof(odd));
+  for (int k = 0; k < K; ++k) {
+    U w;
+    memcpy(&w, panel + k * kPackedPanel, sizeof(w));
+    const V w_even = (V)(w << 16);
+    const V w_odd = (V)(w & high);
+    for (int m = 0; m < M; ++m) {
+      const V a = V() + A[m * K + k];
+      even[m] += a * w_even;
+      odd[m] += a * w_odd;
+    }
+  }
+  for (int m = 0; m < M; ++m) {
+    float out[2][kPackedPanel / 2];
+    memcpy(out[0], &even[m], sizeof(out[0]));
+    memcpy(out[1], &odd[m], sizeof(out[1]));
+    for (int j = 0; j < n; ++j) {
+      const float sum = out[j % 2][j / 2];
+      C[m * ldc + j] = bias ? sum + bias[j] : sum;
+    }
+  }
+}
+
+template <typename Dtype>
+struct Panel16Kernels {
+  typedef void (*Kernel)(const int, const Dtype*, const uint16_t*,
+                         const BaseDataType, const Dtype*, const int, Dtype*,
+                         const int);
+
+  static Kernel Get(const BaseDataType type, const int M) {
+    static const Kernel kernels[kPackedGemmMaxRows] = {
+      Panel16Kernel<Dtype, 1>, Panel16Kernel<Dtype, 2>,
+      Panel16Kernel<Dtype, 3>, Panel16Kernel<Dtype, 4>,
+    };
+    return kernels[M - 1];
+  }
+};
+
+template <>
+Panel16Kernels<float>::Kernel Panel16Kernels<float>::Get(
+    const BaseDataType type, const int M) {
+  static const Kernel kernels[kPackedGemmMaxRows] = {
+    Panel16Kernel<float, 1>, Panel16Kernel<float, 2>,
+    Panel16Kernel<float, 3>, Panel16Kernel<float, 4>,
+  };
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  static const Kernel bfloat16_kernels[kPackedGemmMaxRows] = {
+    Bfloat16PanelKernel<1>, Bfloat16PanelKernel<2>,
+    Bfloat16PanelKernel<3>, Bfloat16PanelKernel<4>,
+  };
+  if (type == DT_BFLOAT16) {
+    return bfloat16_kernels[M - 1];
+  }
+#endif
+  return kernels[M - 1];
+}
+
+void CheckPanel16Type(const BaseDataType type) {
+  CHECK(type == DT_FLOAT16 || type == DT_BFLOAT16)
+      << "Packed weights are stored as FLOAT16 or BFLOAT16, not "
+      << BaseDataType_Name(type);
+}
+
+}  // namespace
+
+template <typename Dtype>
+void caffe_cpu_pack_weights(const int N, const int K, const Dtype* W,
+                            const bool transposed, Dtype* packed) {
+  const int panels = (N + kPackedPanel - 1) / kPackedPanel;
+  const int64_t grain =
+      std::max<int64_t>(1, kPackedGrain / (int64_t(K) * kPackedPanel));
+  parallel_for(0, panels, grain, [&](int64_t begin, int64_t end) {
+    for (int64_t p = begin; p < end; ++p) {
+      Dtype* panel = packed + p * K * kPackedPanel;
+      for (int j = 0; j < kPackedPanel; ++j) {
+        const int n = p * kPackedPanel + j;
+        for (int k = 0; k < K; ++k) {
+          panel[k * kPackedPanel + j] = n >= N ? Dtype(0) :
+              transposed ? W[k * N + n] : W[n * K + k];
+        }
+      }
+    }
+  });
+}
+
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const int M, const int N, const int K,
+                           const Dtype* A, const Dtype* packed,
+                           const Dtype* bias, Dtype* C) {
+  typedef void (*Kernel)(const int, const Dtype*, const Dtype*,
+                         const Dtype*, const int, Dtype*, const int);
+  static const Kernel kernels[kPackedGemmMaxRows] = {
+    PanelKernel<Dtype, 1>, PanelKernel<Dtype, 2>, PanelKernel<Dtype, 3>,
+    PanelKernel<Dtype, 4>,
+  };
+  CHECK_GT(M, 0);
+  CHECK_LE(M, kPackedGemmMaxRows);
+  const Kernel kernel = kernels[M - 1];
+  const int panels = (N + kPackedPanel - 1) / kPackedPanel;
+  const int64_t grain =
+      std::max<int64_t>(1, kPackedGrain / (int64_t(K) * kPackedPanel));
+  parallel_for(0, panels, grain, [&](int64_t begin, int64_t end) {
+    for (int64_t p = begin; p < end; ++p) {
+      const int offset = p * kPackedPanel;
+      kernel(K, A, packed + int64_t(offset) * K, bias ? bias + offset : NULL,
+             std::min(kPackedPanel, N - offset), C + offset, N);
+    }
+  });
+}
+
+template <typename Dtype>
+void caffe_cpu_pack_weights(const int N, const int K, const Dtype* W,
+                            const bool transposed, const BaseDataType type,
+                            uint16_t* packed) {
+  CheckPanel16Type(type);
+  const int panels = (N + kPackedPanel - 1) / kPackedPanel;
+  const int64_t grain =
+      std::max<int64_t>(1, kPackedGrain / (int64_t(K) * kPackedPanel));
+  parallel_for(0, panels, grain, [&](int64_t begin, int64_t end) {
+    vector<float> panel(int64_t(K) * kPackedPanel);
+    for (int64_t p = begin; p < end; ++p) {
+      for (int j = 0; j < kPackedPanel; ++j) {
+        const int n = p * kPackedPanel + j;
+        for (int k = 0; k < K; ++k) {
+          panel[k * kPackedPanel + j] = n >= N ? 0.f : static_cast<float>(
+              transposed ? W[k * N + n] : W[n * K + k]);
+        }
+      }
+      Narrow(panel.size(), &panel[0], type, packed + p * panel.size());
+    }
+  });
+}
+
+template <typename Dtype>
+void caffe_cpu_packed_gemm(const int M, const int N, const int K,
+                           const Dtype* A, const BaseDataType type,
+                           const uint16_t* packed, const Dtype* bias,
+                           Dtype* C) {
+  CHECK_GT(M, 0);
+  CHECK_LE(M, kPackedGemmMaxRows);
+  CheckPanel16Type(type);
+  const typename Panel16Kernels<Dtype>::Kernel kernel =
+      Panel16Kernels<Dtype>::Get(type, M);
+  const int panels = (N + kPackedPanel - 1) / kPackedPanel;
+  const int64_t grain =
+      std::max<int64_t>(1, kPackedGrain / (int64_t(K) * kPackedPanel));
+  parallel_for(0, panels, grain, [&](int64_t begin, int64_t end) {
+    for (int64_t p = begin; p < end; ++p) {
+      const int offset = p * kPackedPanel;
+      kernel(K, A, packed + int64_t(offset) * K, type,
+             bias ? bias + offset : NULL, std::min(kPackedPanel, N - offset),
+             C + offset, N);
+    }
+  });
+}
+
+template void caffe_cpu_pack_weights<float>(const int N, const int K,
+    const float* W, const bool transposed, float* packed);
+template void caffe_cpu_pack_weights<double>(const int N, const int K,
+    const double* W, const bool transposed, double* packed);
+template void caffe_cpu_packed_gemm<float>(const int M, const int N,
+    const int K, const float* A, const float* packed, const float* bias,
+    float* C);
+template void caffe_cpu_packed_gemm<double>(const int M, const int N,
+    const int K, const double* A, const double* packed, const double* bias,
+    double* C);
+template void caffe_cpu_pack_weights<float>(const int N, const int K,
+    const float* W, const bool transposed, const BaseDataType type,
+    uint16_t* packed);
+template void caffe_cpu_pack_weights<double>(const int N, const int K,
+    const double* W, const bool transposed, const BaseDataType type,
+    uint16_t* packed);
+template void caffe_cpu_packed_gemm<float>(const int M, const int N,
+    const int K, const float* A, const BaseDataType type,
+    const uint16_t* packed, const float* bias, float* C);
+template void caffe_cpu_packed_gemm<double>(const int M, const int N,
+    const int K, const double* A, const BaseDataType type,
+    const uint16_t* packed, const double* bias, double* C);
+
+}  // namespace caffe
@@ -0,0 +1,135 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <stdint.h>
+
+#include "caffe/common.hpp"
+#include "caffe/util/pixel_transform.hpp"
+
+namespace caffe {
+
+namespace {
+
+// kChannels == 0 takes the channel count from args at run time.
+template <typename Dtype, typename SrcType, int kChannels, bool kMirror,
+          PixelMeanMode kMeanMode>
+void PixelsToCHWKernel(const PixelTransformArgs<Dtype, SrcType>& args,
+                       Dtype* dst) {
+  const int channels = kChannels ? kChannels : args.channels;
+  const int height = args.height;
+  const int width = args.width;
+  const Dtype scale = args.scale;
+  for (int h = 0; h < height; ++h) {
+    const SrcType* src_row = args.src + h * args.src_step;
+    for (int c = 0; c < channels; ++c) {
+      const SrcType* src = src_row + c;
+      Dtype* dst_row = dst + (c * height + h) * width;
+      if (kMeanMode == PIXEL_MEAN_FILE) {
+        const Dtype* mean = args.mean + c * args.mean_plane_step +
+                            h * args.mean_step;
+        for (int w = 0; w < width; ++w) {
+          const Dtype value =
+              (static_cast<Dtype>(src[w * channels]) - mean[w]) * scale;
+          dst_row[kMirror ? width - 1 - w : w] = value;
+        }
+      } else {
+        const Dtype mean =
+            kMeanMode == PIXEL_MEAN_VALUES ? args.mean[c] : Dtype(0);
+        for (int w = 0; w < width; ++w) {
+          const Dtype value =
+              (static_cast<Dtype>(src[w * channels]) - mean) * scale;
+          dst_row[kMirror ? width - 1 - w : w] = value;
+        }
+      }
+    }
+  }
+}
+
+template <typename Dtype, typename SrcType, int kChannels, bool kMirror>
+void DispatchMeanMode(const PixelTransformArgs<Dtype, SrcType>& args,
+                      Dtype* dst) {
+  switch (args.mean_mode) {
+  case PIXEL_MEAN_NONE:
+    PixelsToCHWKernel<Dtype, SrcType, kChannels, kMirror, PIXEL_MEAN_NONE>(
+        args, dst);
+    break;
+  case PIXEL_MEAN_VALUES:
+    PixelsToCHWKernel<Dtype, SrcType, kChannels, kMirror, PIXEL_MEAN_VALUES>(
+        args, dst);
+    break;
+  case PIXEL_MEAN_FILE:
+    PixelsToCHWKernel<Dtype, SrcType, kChannels, kMirror, PIXEL_MEAN_FILE>(
+        args, dst);
+    break;
+  default:
+    LOG(FATAL) << "Unknown mean mode: " << args.mean_mode;
+  }
+}
+
+template <typename Dtype, typename SrcType, int kChannels>
+void DispatchMirror(const PixelTransformArgs<Dtype, SrcType>& args,
+                    Dtype* dst) {
+  if (args.mirror) {
+    DispatchMeanMode<Dtype, SrcType, kChannels, true>(args, dst);
+  } else {
+    DispatchMeanMode<Dtype, SrcType, kChannels, false>(args, dst);
+  }
+}
+
+}  // namespace
+
+template <typename Dtype, typename SrcType>
+void PixelsToCHW(const PixelTransformArgs<Dtype, SrcType>& args, Dtype* dst) {
+  CHECK_GT(args.channels, 0);
+  CHECK_GE(args.src_step, args.width * args.channels);
+  switch (args.channels) {
+  case 1:
+    DispatchMirror<Dtype, SrcType, 1>(args, dst);
+    break;
+  case 3:
+    DispatchMirror<Dtype, SrcType, 3>(args, dst);
+    break;
+  case 4:
+    DispatchMirror<Dtype, SrcType, 4>(args, dst);
+    break;
+  default:
+    DispatchMirror<Dtype, SrcType, 0>(args, dst);
+  }
+}
+
+template void PixelsToCHW<float, uint8_t>(
+    const PixelTransformArgs<float, uint8_t>& args, float* dst);
+template void PixelsToCHW<double, uint8_t>(
+    const PixelTransformArgs<double, uint8_t>& args, double* dst);
+template void PixelsToCHW<float, float>(
+    const PixelTransformArgs<float, float>& args, float* dst);
+template void PixelsToCHW<double, float>(
+    const PixelTransformArgs<double, float>& args, double* dst);
+
+}  // namespace caffe
@@ -0,0 +1,209 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "caffe/util/roi_util.hpp"
+
+using std::max;
+using std::min;
+using std::floor;
+using std::ceil;
+
+namespace caffe {
+
+template <typename Dtype>
+void ROIPoolingBins(const Dtype* roi, const Dtype spatial_scale,
+                    const int height, const int width,
+                    const int pooled_h, const int pooled_w, ROIBin* bins) {
+  const int roi_start_w = round(roi[0] * spatial_scale);
+  const int roi_start_h = round(roi[1] * spatial_scale);
+  const int roi_end_w = round(roi[2] * spatial_scale);
+  const int roi_end_h = round(roi[3] * spatial_scale);
+  const int roi_height = max(roi_end_h - roi_start_h + 1, 1);
+  const int roi_width = max(roi_end_w - roi_start_w + 1, 1);
+  const Dtype bin_size_h =
+      static_cast<Dtype>(roi_height) / static_cast<Dtype>(pooled_h);
+  const Dtype bin_size_w =
+      static_cast<Dtype>(roi_width) / static_cast<Dtype>(pooled_w);
+  for (int ph = 0; ph < pooled_h; ++ph) {
+    // start (included) = floor(ph * roi_height / pooled_h)
+    // end (excluded) = ceil((ph + 1) * roi_height / pooled_h)
+    const int hstart =
+        static_cast<int>(floor(static_cast<Dtype>(ph) * bin_size_h));
+    const int hend =
+        static_cast<int>(ceil(static_cast<Dtype>(ph + 1) * bin_size_h));
+    for (int pw = 0; pw < pooled_w; ++pw) {
+      const int wstart =
+          static_cast<int>(floor(static_cast<Dtype>(pw) * bin_size_w));
+      const int wend =
+          static_cast<int>(ceil(static_cast<Dtype>(pw + 1) * bin_size_w));
+      ROIBin& bin = bins[ph * pooled_w + pw];
+      bin.hstart = min(max(hstart + roi_start_h, 0), height);
+      bin.hend = min(max(hend + roi_start_h, 0), height);
+      bin.wstart = min(max(wstart + roi_start_w, 0), width);
+      bin.wend = min(max(wend + roi_start_w, 0), width);
+    }
+  }
+}
+
+template <typename Dtype>
+void PSROIPoolingBins(const Dtype* roi, const Dtype spatial_scale,
+                      const int height, const int width,
+                      const int group_size, ROIBin* bins) {
+  // [start, end) interval for spatial sampling
+  const Dtype roi_start_w =
+      static_cast<Dtype>(round(roi[0])) * spatial_scale;
+  const Dtype roi_start_h =
+      static_cast<Dtype>(round(roi[1])) * spatial_scale;
+  const Dtype roi_end_w =
+      static_cast<Dtype>(round(roi[2]) + 1.) * spatial_scale;
+  const Dtype roi_end_h =
+      static_cast<Dtype>(round(roi[3]) + 1.) * spatial_scale;
+  // Force too small ROIs to be 1x1
+  const Dtype roi_width = max<Dtype>(roi_end_w - roi_start_w, 0.1);
+  const Dtype roi_height = max<Dtype>(roi_end_h - roi_start_h, 0.1);
+  const Dtype bin_size_h = roi_height / static_cast<Dtype>(group_size);
+  const Dtype bin_size_w = roi_width / static_cast<Dtype>(group_size);
+  for (int ph = 0; ph < group_size; ++ph) {
+    const int hstart = floor(static_cast<Dtype>(ph) * bin_size_h
+                             + roi_start_h);
+    const int hend = ceil(static_cast<Dtype>(ph + 1) * bin_size_h
+                          + roi_start_h);
+    for (int pw = 0; pw < group_size; ++pw) {
+      const int wstart = floor(static_cast<Dtype>(pw) * bin_size_w
+                               + roi_start_w);
+      const int wend = ceil(static_cast<Dtype>(pw + 1) * bin_size_w
+                            + roi_start_w);
+      ROIBin& bin = bins[ph * group_size + pw];
+      bin.hstart = min(max(hstart, 0), height);
+      bin.hend = min(max(hend, 0), height);
+      bin.wstart = min(max(wstart, 0), width);
+      bin.wend = min(max(wend, 0), width);
+    }
+  }
+}
+
+template <typename Dtype>
+int ROIAlignSamples(const Dtype* roi, const Dtype spatial_scale,
+                    const int height, const int width,
+                    const int pooled_h, const int pooled_w,
+                    const int sampling_ratio,
+                    vector<ROISample<Dtype> >* samples) {
+  // Do not using rounding; this implementation detail is critical
+  const Dtype roi_start_w = roi[0] * spatial_scale;
+  const Dtype roi_start_h = roi[1] * spatial_scale;
+  const Dtype roi_end_w = roi[2] * spatial_scale;
+  const Dtype roi_end_h = roi[3] * spatial_scale;
+  // Force malformed ROIs to be 1x1
+  const Dtype roi_width = max(roi_end_w - roi_start_w, Dtype(1.0));
+  const Dtype roi_height = max(roi_end_h - roi_start_h, Dtype(1.0));
+  const Dtype bin_size_h = roi_height / static_cast<Dtype>(pooled_h);
+  const Dtype bin_size_w = roi_width / static_cast<Dtype>(pooled_w);
+  // We use roi_bin_grid to sample the grid and mimic integral
+  const int grid_h = (sampling_ratio > 0) ? sampling_ratio :
+                     ceil(roi_height / pooled_h);  // e.g., = 2
+  const int grid_w = (sampling_ratio > 0) ? sampling_ratio :
+                     ceil(roi_width / pooled_w);
+
+  samples->resize(pooled_h * pooled_w * grid_h * grid_w);
+  ROISample<Dtype>* pc = samples->data();
+  for (int ph = 0; ph < pooled_h; ++ph) {
+    for (int pw = 0; pw < pooled_w; ++pw) {
+      for (int iy = 0; iy < grid_h; ++iy) {
+        Dtype y = roi_start_h + ph * bin_size_h +
+            (static_cast<Dtype>(iy) + Dtype(0.5)) * bin_size_h /
+            static_cast<Dtype>(grid_h);  // e.g., 0.5, 1.5
+        for (int ix = 0; ix < grid_w; ++ix, ++pc) {
+          Dtype x = roi_start_w + pw * bin_size_w +
+              (static_cast<Dtype>(ix) + Dtype(0.5)) * bin_size_w /
+              static_cast<Dtype>(grid_w);
+          // Samples out of the feature map contribute nothing.
+          if (y < -1.0 || y > height || x < -1.0 || x > width) {
+            for (int k = 0; k < 4; ++k) {
+              pc->pos[k] = 0;
+              pc->w[k] = 0;
+            }
+            continue;
+          }
+          const Dtype yc = max(y, Dtype(0));
+          const Dtype xc = max(x, Dtype(0));
+          int y_low = floor(yc);
+          int x_low = floor(xc);
+          int y_high, x_high;
+          Dtype ly, lx;
+          if (y_low >= height - 1) {
+            y_high = y_low = height - 1;
+            ly = 0;
+          } else {
+            y_high = ceil(yc);
+            ly = yc - static_cast<Dtype>(y_low);
+          }
+          if (x_low >= width - 1) {
+            x_high = x_low = width - 1;
+            lx = 0;
+          } else {
+            x_high = ceil(xc);
+            lx = xc - static_cast<Dtype>(x_low);
+          }
+          const Dtype hy = 1 - ly, hx = 1 - lx;
+          pc->pos[0] = y_low * width + x_low;
+          pc->pos[1] = y_low * width + x_high;
+          pc->pos[2] = y_high * width + x_low;
+          pc->pos[3] = y_high * width + x_high;
+          pc->w[0] = hy * hx;
+          pc->w[1] = hy * lx;
+          pc->w[2] = ly * hx;
+          pc->w[3] = ly * lx;
+        }
+      }
+    }
+  }
+  return grid_h * grid_w;
+}
+
+template void ROIPoolingBins<float>(const float*, const float, const int,
+    const int, const int, const int, ROIBin*);
+template void ROIPoolingBins<double>(const double*, const double, const int,
+    const int, const int, const int, ROIBin*);
+template void PSROIPoolingBins<float>(const float*, const float, const int,
+    const int, const int, ROIBin*);
+template void PSROIPoolingBins<double>(const double*, const double,
+    const int, const int, const int, ROIBin*);
+template int ROIAlignSamples<float>(const float*, const float, const int,
+    const int, const int, const int, const int,
+    vector<ROISample<float> >*);
+template int ROIAlignSamples<double>(const double*, const double, const int,
+    const int, const int, const int, const int,
+    vector<ROISample<double> >*);
+
+}  // namespace caffe
@@ -0,0 +1,164 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include <algorithm>
+#include <vector>
+
+#include "caffe/util/thread_pool.hpp"
+
+namespace caffe {
+
+static thread_local bool in_parallel_region = false;
+
+// Marks the current thread as running a chunk for its lifetime.
+class ParallelRegionGuard {
+  public:
+  ParallelRegionGuard() : outer_(in_parallel_region) {
+    in_parallel_region = true;
+  }
+  ~ParallelRegionGuard() { in_parallel_region = outer_; }
+
+  private:
+  bool outer_;
+};
+
+bool ThreadPool::InParallelRegion() {
+  return in_parallel_region;
+}
+
+ThreadPool::ThreadPool(int num_threads, const vector<int>& cpus)
+    : num_threads_(num_threads), blocks_(num_threads), body_(NULL),
+      grain_(1), num_participants_(0), pending_(0), generation_(0),
+      stop_(false) {
+  CHECK_GE(num_threads, 1);
+  for (int i = 1; i < num_threads; ++i) {
+    const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+    workers_.push_back(std::thread(&ThreadPool::WorkerLoop, this, i, cpu));
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  work_cond_.notify_all();
+  for (int i = 0; i < workers_.size(); ++i) {
+    workers_[i].join();
+  }
+}
+
+void ThreadPool::ParallelFor(int64_t begin, int64_t end, int64_t grain,
+                             const Body& body) {
+  CHECK_GT(grain, 0);
+  if (begin >= end) {
+    return;
+  }
+  std::unique_lock<std::mutex> job_lock(job_mutex_, std::try_to_lock);
+  const int64_t num_chunks = (end - begin + grain - 1) / grain;
+  if (num_threads_ == 1 || num_chunks == 1 || in_parallel_region ||
+      !job_lock.owns_lock()) {
+    ParallelRegionGuard guard;
+    body(begin, end);
+    return;
+  }
+  const int participants = std::min<int64_t>(num_threads_, num_chunks);
+  for (int i = 0; i < participants; ++i) {
+    blocks_[i].next = begin + num_chunks * i / participants * grain;
+    blocks_[i].end = std::min(end,
+        begin + num_chunks * (i + 1) / participants * grain);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    body_ = &body;
+    grain_ = grain;
+    num_participants_ = participants;
+    pending_ = participants - 1;
+    ++generation_;
+  }
+  work_cond_.notify_all();
+  RunParticipant(0);
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cond_.wait(lock, [this] { return pending_ == 0; });
+}
+
+void ThreadPool::RunParticipant(int index) {
+  ParallelRegionGuard guard;
+  const int participants = num_participants_;
+  for (int i = 0; i < participants; ++i) {
+    Block& block = blocks_[(index + i) % participants];
+    for (int64_t chunk = block.next.fetch_add(grain_); chunk < block.end;
+         chunk = block.next.fetch_add(grain_)) {
+      (*body_)(chunk, std::min(chunk + grain_, block.end));
+    }
+  }
+}
+
+void ThreadPool::WorkerLoop(int index, int cpu) {
+#ifdef __linux__
+  if (cpu >= 0) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set)) {
+      LOG(WARNING) << "Failed to pin pool thread " << index << " to cpu "
+                   << cpu;
+    }
+  }
+#endif
+  uint64_t generation = 0;
+  while (true) {
+    int participants;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      work_cond_.wait(lock, [this, generation] {
+        return stop_ || generation_ != generation;
+      });
+      if (stop_) {
+        return;
+      }
+      generation = generation_;
+      participants = num_participants_;
+    }
+    if (index < participants) {
+      RunParticipant(index);
+      if (pending_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        done_cond_.notify_one();
+      }
+    }
+  }
+}
+
+}  // namespace caffe
@@ -0,0 +1,250 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Elementwise transcendental functions on float arrays.
+//
+// Without MKL, caffe_exp and caffe_log used to fall back to a scalar libm
+// loop. These kernels evaluate Cephes-style polynomials four lanes at a time
+// using the GCC vector extensions, which map onto SSE on x86 and NEON on
+// ARM without any target-specific code. Over the whole float range they
+// stay within a few ulp of the correctly rounded result, and they keep the
+// libm behaviour for 0, infinities, NaN and denormals; see
+// test_math_functions.cpp for the bounds that are checked.
+
+#include <stdint.h>
+
+#include <cmath>
+#include <cstring>
+
+#include "caffe/common.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/mkl_alternate.hpp"
+
+namespace caffe {
+
+typedef float vfloat __attribute__((vector_size(16)));
+typedef int32_t vint __attribute__((vector_size(16)));
+const int kLanes = 4;
+
+static inline vfloat Splat(float x) {
+  const vfloat v = {x, x, x, x};
+  return v;
+}
+
+static inline vint SplatInt(int32_t x) {
+  const vint v = {x, x, x, x};
+  return v;
+}
+
+static inline vfloat Load(const float* p) {
+  vfloat v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline void Store(float* p, vfloat v) {
+  memcpy(p, &v, sizeof(v));
+}
+
+// mask ? a : b, lane by lane; mask lanes are all ones or all zeros.
+static inline vfloat Select(vint mask, vfloat a, vfloat b) {
+  return (vfloat)((mask & (vint)a) | (~mask & (vint)b));
+}
+
+// Exact for |x| < 2^22: adding 1.5 * 2^23 rounds to an integer and leaves
+// it in the low mantissa bits.
+static const float kRoundMagic = 12582912.f;
+
+static inline vint RoundToInt(vfloat x, vfloat* rounded) {
+  const vfloat magic = Splat(kRoundMagic);
+  const vfloat t = x + magic;
+  *rounded = t - magic;
+  return (vint)t - (vint)magic;
+}
+
+static inline vfloat IntToFloat(vint n) {
+  const vfloat magic = Splat(kRoundMagic);
+  return (vfloat)(n + (vint)magic) - magic;
+}
+
+// 2^n for -126 <= n <= 127.
+static inline vfloat Pow2(vint n) {
+  return (vfloat)((n + SplatInt(127)) << 23);
+}
+
+static inline vfloat VExp(vfloat x) {
+  const vint nan = x != x;
+  const vint overflow = x > Splat(88.7228391f);
+  // Below this exp(x) rounds to zero even as a denormal.
+  vfloat v = Select(x < Splat(-104.f), Splat(-104.f), x);
+  v = Select(overflow, Splat(88.f), v);
+  // exp(x) = 2^n * exp(r) with r = x - n * ln(2), |r| <= ln(2) / 2.
+  vfloat fn;
+  const vint n = RoundToInt(v * Splat(1.44269504088896341f), &fn);
+  vfloat r = v - fn * Splat(0.693359375f);
+  r = r - fn * Splat(-2.12194440e-4f);
+  const vfloat r2 = r * r;
+  vfloat p = Splat(1.9875691500e-4f);
+  p = p * r + Splat(1.3981999507e-3f);
+  p = p * r + Splat(8.3334519073e-3f);
+  p = p * r + Splat(4.1665795894e-2f);
+  p = p * r + Splat(1.6666665459e-1f);
+  p = p * r + Splat(5.0000001201e-1f);
+  p = p * r2 + r + Splat(1.f);
+  // Scaling in two steps keeps both factors normal, so results in the
+  // denormal range and 2^128 * p for p < 1 come out right.
+  const vint half = n >> 1;
+  const vfloat y = p * Pow2(half) * Pow2(n - half);
+  return Select(nan, x, Select(overflow, Splat(INFINITY), y));
+}
+
+static inline vfloat VLog(vfloat x) {
+  const vint nan = (x != x) | (x < Splat(0.f));
+  const vint zero = x == Splat(0.f);
+  const vint inf = x == Splat(INFINITY);
+  // Bring denormals into the normal range first.
+  const vint denormal = x < Splat(1.17549435e-38f);
+  const vfloat v = Select(denormal, x * Splat(8388608.f), x);
+  // v = m * 2^e with m in [sqrt(1/2), sqrt(2)).
+  const vint bits = (vint)v;
+  vint e = ((bits >> 23) & SplatInt(0xff)) - SplatInt(126);
+  e = e - (denormal & SplatInt(23));
+  vfloat m = (vfloat)((bits & SplatInt(0x007fffff)) | SplatInt(0x3f000000));
+  const vint small = m < Splat(0.707106781186547524f);
+  e = e + small;
+  m = m + Select(small, m, Splat(0.f)) - Splat(1.f);
+  const vfloat fe = IntToFloat(e);
+  const vfloat m2 = m * m;
+  vfloat p = Splat(7.0376836292e-2f);
+  p = p * m + Splat(-1.1514610310e-1f);
+  p = p * m + Splat(1.1676998740e-1f);
+  p = p * m + Splat(-1.2420140846e-1f);
+  p = p * m + Splat(1.4249322787e-1f);
+  p = p * m + Splat(-1.6668057665e-1f);
+  p = p * m + Splat(2.0000714765e-1f);
+  p = p * m + Splat(-2.4999993993e-1f);
+  p = p * m + Splat(3.3333331174e-1f);
+  vfloat y = p * m * m2;
+  y = y + fe * Splat(-2.12194440e-4f);
+  y = y - Splat(0.5f) * m2;
+  y = m + y + fe * Splat(0.693359375f);
+  y = Select(inf, Splat(INFINITY), y);
+  y = Select(zero, Splat(-INFINITY), y);
+  return Select(nan, Splat(NAN), y);
+}
+
+static inline vfloat VTanh(vfloat x) {
+  const vint sign = SplatInt(0x80000000);
+  const vfloat abs = (vfloat)((vint)x & ~sign);
+  // Small arguments: odd polynomial, avoids the cancellation below.
+  const vfloat x2 = x * x;
+  vfloat p = Splat(-5.70498872745e-3f);
+  p = p * x2 + Splat(2.06390887954e-2f);
+  p = p * x2 + Splat(-5.37397155531e-2f);
+  p = p * x2 + Splat(1.33314422036e-1f);
+  p = p * x2 + Splat(-3.33332819422e-1f);
+  const vfloat small = p * x2 * x + x;
+  // Otherwise tanh|x| = 1 - 2 / (exp(2|x|) + 1), with the sign of x.
+  const vfloat large = Splat(1.f) -
+      Splat(2.f) / (VExp(abs + abs) + Splat(1.f));
+  const vfloat signed_large = (vfloat)((vint)large | ((vint)x & sign));
+  return Select(abs < Splat(0.625f), small, signed_large);
+}
+
+// 1 / (1 + exp(-x)), evaluated as exp(x) / (1 + exp(x)) for negative x so
+// that exp never overflows and tiny results keep their precision.
+static inline vfloat VSigmoid(vfloat x) {
+  const vint sign = SplatInt(0x80000000);
+  const vfloat e = VExp((vfloat)((vint)x | sign));
+  const vfloat numerator = Select(x < Splat(0.f), e, Splat(1.f));
+  return numerator / (Splat(1.f) + e);
+}
+
+// Applies op to n floats; the tail is padded with pad, a value op accepts.
+template <vfloat (*op)(vfloat)>
+static void Apply(const int n, const float* a, float* y, float pad) {
+  int i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    Store(y + i, op(Load(a + i)));
+  }
+  if (i < n) {
+    float tail[kLanes] = {pad, pad, pad, pad};
+    memcpy(tail, a + i, (n - i) * sizeof(float));
+    Store(tail, op(Load(tail)));
+    memcpy(y + i, tail, (n - i) * sizeof(float));
+  }
+}
+
+template <>
+void caffe_exp<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
+  vsExp(n, a, y);
+#else
+  Apply<VExp>(n, a, y, 0.f);
+#endif
+}
+
+template <>
+void caffe_log<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
+  vsLn(n, a, y);
+#else
+  Apply<VLog>(n, a, y, 1.f);
+#endif
+}
+
+template <>
+void caffe_tanh<float>(const int n, const float* a, float* y) {
+#ifdef USE_MKL
+  vsTanh(n, a, y);
+#else
+  Apply<VTanh>(n, a, y, 0.f);
+#endif
+}
+
+template <>
+void caffe_tanh<double>(const int n, const double* a, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = tanh(a[i]);
+  }
+}
+
+template <>
+void caffe_sigmoid<float>(const int n, const float* a, float* y) {
+  Apply<VSigmoid>(n, a, y, 0.f);
+}
+
+template <>
+void caffe_sigmoid<double>(const int n, const double* a, double* y) {
+  for (int i = 0; i < n; ++i) {
+    y[i] = 1. / (1. + exp(-a[i]));
+  }
+}
+
+}  // namespace caffe
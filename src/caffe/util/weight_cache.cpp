@@ -0,0 +1,73 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <boost/thread/mutex.hpp>
+#include <boost/weak_ptr.hpp>
+#include <map>
+#include <string>
+#include <tuple>
+
+#include "caffe/util/weight_cache.hpp"
+
+namespace caffe {
+
+shared_ptr<SyncedMemory> SharedWeightCopy(
+    const shared_ptr<SyncedMemory>& source, const string& layout,
+    const std::function<shared_ptr<SyncedMemory>()>& derive) {
+  typedef std::tuple<const SyncedMemory*, size_t, string> Key;
+  struct Entry {
+    boost::weak_ptr<SyncedMemory> source;
+    boost::weak_ptr<SyncedMemory> copy;
+  };
+  static boost::mutex mutex;
+  static std::map<Key, Entry> cache;
+
+  boost::mutex::scoped_lock lock(mutex);
+  const Key key(source.get(), source->version(), layout);
+  Entry& entry = cache[key];
+  shared_ptr<SyncedMemory> copy = entry.copy.lock();
+  // The address of freed weights may come back for others.
+  if (copy && entry.source.lock() == source) {
+    return copy;
+  }
+  for (std::map<Key, Entry>::iterator it = cache.begin();
+       it != cache.end();) {
+    if (it->first != key && it->second.copy.expired()) {
+      cache.erase(it++);
+    } else {
+      ++it;
+    }
+  }
+  copy = derive();
+  entry.source = source;
+  entry.copy = copy;
+  return copy;
+}
+
+}  // namespace caffe
@@ -111,6 +111,18 @@ DEFINE_string(dataorder, "0,0",
 DEFINE_string(output_dtype, "INVALID",
     "Specifies the type of output in the middle of the model.");
 DEFINE_int32(opt_level, 1, "Optimized the model.");
+DEFINE_string(cpu_weight_dtype, "",
+    "Optional; FLOAT16 or BFLOAT16 to have the CPU layers that support it "
+    "also store their weights in that type when testing. This halves the "
+    "weight memory each pass reads, but adds half the size of those "
+    "weights to the resident memory, as the FP32 weights are kept.");
+DEFINE_bool(channels_last, false,
+    "Optional; run the CPU layers that support it channels-last (NHWC) "
+    "when testing.");
+DEFINE_bool(pack_weights, false,
+    "Optional; have the InnerProduct layers keep a packed copy of their "
+    "weights for batches of up to 4 items when testing, which doubles "
+    "their memory.");
 
 // A simple registry for caffe commands.
 typedef int (*BrewFunction)();
@@ -363,7 +375,32 @@ int test() {
   #endif  // USE_MLU
   }
   // Instantiate the caffe net.
-  Net<float> caffe_net(FLAGS_model, caffe::TEST, FLAGS_level, &stages);
+  NetParameter net_param;
+  ReadNetParamsFromTextFileOrDie(FLAGS_model, &net_param);
+  net_param.mutable_state()->set_phase(caffe::TEST);
+  net_param.mutable_state()->set_level(FLAGS_level);
+  for (int i = 0; i < stages.size(); ++i) {
+    net_param.mutable_state()->add_stage(stages[i]);
+  }
+  if (FLAGS_cpu_weight_dtype.size()) {
+    caffe::BaseDataType dtype;
+    CHECK(caffe::BaseDataType_Parse("DT_" + FLAGS_cpu_weight_dtype, &dtype))
+        << "Unknown cpu_weight_dtype: " << FLAGS_cpu_weight_dtype;
+    net_param.set_cpu_weight_dtype(dtype);
+  }
+  if (FLAGS_channels_last) {
+    net_param.set_channels_last(true);
+  }
+  if (FLAGS_pack_weights) {
+    for (int i = 0; i < net_param.layer_size(); ++i) {
+      caffe::LayerParameter* layer = net_param.mutable_layer(i);
+      if (layer->type() == "InnerProduct" &&
+          !layer->inner_product_param().has_pack_weights()) {
+        layer->mutable_inner_product_param()->set_pack_weights(true);
+      }
+    }
+  }
+  Net<float> caffe_net(net_param);
   if (FLAGS_weights.size()) caffe_net.CopyTrainedLayersFrom(FLAGS_weights);
   LOG(INFO) << "Running for " << FLAGS_iterations << " iterations.";
 
@@ -0,0 +1,520 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Benchmarks inference of whole models. Each model of the suite is run,
+// for every thread count of the sweep, through a warm-up and a measured
+// phase of forward passes on the CPU. The report is JSON: throughput,
+// latency percentiles and peak RSS per model and thread count. Each model
+// runs in a child process, so that its peak RSS is its own. Given a saved
+// report as --baseline, the exit status is 1 when any configuration
+// lost more than --threshold of its throughput or p50 latency.
+// Usage:
+//    caffe_bench [--suite=models/bench/suite.txt | --model=a.prototxt,...]
+//        [--threads=1,2,4] [--batch_size=0] [--warmup=5] [--iterations=50]
+//        [--output=report.json] [--baseline=baseline.json]
+//        [--threshold=0.05]
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "boost/foreach.hpp"
+#include "boost/property_tree/json_parser.hpp"
+#include "boost/property_tree/ptree.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/caffe.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
+#include "caffe/util/upgrade_proto.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(suite, "models/bench/suite.txt",
+    "A file listing the model definitions to run, one per line, relative "
+    "to the file.");
+DEFINE_string(model, "",
+    "Comma-separated model definitions to run instead of --suite.");
+DEFINE_string(weights, "",
+    "Trained weights, with a single --model. Otherwise the weights are "
+    "synthetic.");
+DEFINE_string(input_file, "",
+    "A BlobProto copied into every input, whole or once per batch item. "
+    "Otherwise the inputs are synthetic.");
+DEFINE_int32(batch_size, 0,
+    "The batch size of the inputs; 0 keeps the one of the model.");
+DEFINE_string(threads, "",
+    "Comma-separated thread counts to sweep; empty keeps the Caffe "
+    "default.");
+DEFINE_int32(warmup, 5, "The number of forward passes before measuring.");
+DEFINE_int32(iterations, 50, "The number of measured forward passes.");
+DEFINE_int32(seed, 1701, "The seed of the synthetic weights and inputs.");
+DEFINE_string(cpu_weight_dtype, "",
+    "Optional; FLOAT16 or BFLOAT16 to store a packed copy of the "
+    "InnerProduct weights in, used at every batch size, next to the FP32 "
+    "weights.");
+DEFINE_bool(channels_last, false,
+    "Optional; run the layers that support it channels-last (NHWC).");
+DEFINE_bool(pack_weights, false,
+    "Optional; have the InnerProduct layers keep a packed copy of their "
+    "weights for batches of up to 4 items.");
+DEFINE_string(output, "", "The JSON report; stdout when empty.");
+DEFINE_string(baseline, "", "Optional; a JSON report to compare with.");
+DEFINE_double(threshold, 0.05,
+    "The relative throughput loss or p50 latency gain over --baseline "
+    "that counts as a regression.");
+
+struct BenchResult {
+  BenchResult()
+      : batch_size(0), threads(0), throughput(0), mean_ms(0), min_ms(0),
+        p50_ms(0), p90_ms(0), p99_ms(0), max_ms(0), peak_rss_kb(0),
+        baseline_throughput(-1), baseline_p50_ms(-1), regression(false) {}
+
+  string model;
+  string name;
+  int batch_size;
+  int threads;
+  double throughput;  // batch items per second
+  double mean_ms, min_ms, p50_ms, p90_ms, p99_ms, max_ms;
+  long peak_rss_kb;  // NOLINT(runtime/int)
+  double baseline_throughput;
+  double baseline_p50_ms;
+  bool regression;
+};
+
+static vector<string> SplitList(const string& list) {
+  vector<string> items;
+  if (!list.empty()) {
+    boost::split(items, list, boost::is_any_of(","));
+  }
+  return items;
+}
+
+static vector<string> SuiteModels() {
+  if (!FLAGS_model.empty()) {
+    return SplitList(FLAGS_model);
+  }
+  std::ifstream suite(FLAGS_suite.c_str());
+  CHECK(suite) << "Cannot read the suite " << FLAGS_suite;
+  const size_t slash = FLAGS_suite.rfind('/');
+  const string dir =
+      slash == string::npos ? "" : FLAGS_suite.substr(0, slash + 1);
+  vector<string> models;
+  string line;
+  while (std::getline(suite, line)) {
+    boost::trim(line);
+    if (!line.empty() && line[0] != '#') {
+      models.push_back(line[0] == '/' ? line : dir + line);
+    }
+  }
+  return models;
+}
+
+// Weights that keep the activations in range without a trained model, so
+// that detection outputs do realistic work: He-scaled gaussian weights and
+// BatchNorm statistics of a unit normal. One-axis parameters such as
+// biases and scales keep the values of their fillers.
+static void SyntheticWeights(Net<float>* net) {
+  const vector<shared_ptr<Layer<float> > >& layers = net->layers();
+  for (int i = 0; i < layers.size(); ++i) {
+    vector<shared_ptr<Blob<float> > >& blobs = layers[i]->blobs();
+    if (string(layers[i]->type()) == "BatchNorm") {
+      caffe_set(blobs[0]->count(), 0.f, blobs[0]->mutable_cpu_data());
+      caffe_set(blobs[1]->count(), 1.f, blobs[1]->mutable_cpu_data());
+      caffe_set(blobs[2]->count(), 1.f, blobs[2]->mutable_cpu_data());
+      continue;
+    }
+    for (int j = 0; j < blobs.size(); ++j) {
+      Blob<float>* blob = blobs[j].get();
+      if (blob->num_axes() < 2 || blob->count() == 0) {
+        continue;
+      }
+      const float std = std::sqrt(2.f / blob->count(1));
+      caffe_rng_gaussian(blob->count(), 0.f, std, blob->mutable_cpu_data());
+    }
+  }
+}
+
+static void FillInputs(Net<float>* net) {
+  const vector<Blob<float>*>& inputs = net->input_blobs();
+  if (FLAGS_input_file.empty()) {
+    for (int i = 0; i < inputs.size(); ++i) {
+      caffe_rng_gaussian(inputs[i]->count(), 0.f, 1.f,
+                         inputs[i]->mutable_cpu_data());
+    }
+    return;
+  }
+  BlobProto proto;
+  ReadProtoFromBinaryFileOrDie(FLAGS_input_file, &proto);
+  Blob<float> source;
+  source.FromProto(proto);
+  for (int i = 0; i < inputs.size(); ++i) {
+    Blob<float>* input = inputs[i];
+    float* data = input->mutable_cpu_data();
+    if (source.count() == input->count()) {
+      caffe_copy(input->count(), source.cpu_data(), data);
+    } else {
+      CHECK_EQ(source.count() * input->shape(0), input->count())
+          << FLAGS_input_file << " fits neither input " << i
+          << " nor one of its items.";
+      for (int n = 0; n < input->shape(0); ++n) {
+        caffe_copy(source.count(), source.cpu_data(),
+                   data + n * source.count());
+      }
+    }
+  }
+}
+
+// The nearest-rank percentile p of the sorted samples.
+static double Percentile(const vector<double>& sorted, double p) {
+  const int rank = static_cast<int>(std::ceil(p * sorted.size())) - 1;
+  return sorted[std::min<int>(std::max(rank, 0), sorted.size() - 1)];
+}
+
+static long PeakRssKB() {  // NOLINT(runtime/int)
+  struct rusage usage;
+  CHECK_EQ(getrusage(RUSAGE_SELF, &usage), 0);
+  return usage.ru_maxrss;
+}
+
+static BenchResult Measure(Net<float>* net, int threads) {
+  for (int i = 0; i < FLAGS_warmup; ++i) {
+    net->Forward();
+  }
+  vector<double> latency_ms(FLAGS_iterations);
+  CPUTimer timer;
+  double total_ms = 0;
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    timer.Start();
+    net->Forward();
+    latency_ms[i] = timer.MicroSeconds() / 1000.;
+    total_ms += latency_ms[i];
+  }
+  std::sort(latency_ms.begin(), latency_ms.end());
+
+  BenchResult result;
+  result.name = net->name();
+  result.batch_size =
+      net->input_blobs().empty() ? 1 : net->input_blobs()[0]->shape(0);
+  result.threads = threads;
+  result.throughput = result.batch_size * FLAGS_iterations * 1000. / total_ms;
+  result.mean_ms = total_ms / FLAGS_iterations;
+  result.min_ms = latency_ms.front();
+  result.p50_ms = Percentile(latency_ms, 0.5);
+  result.p90_ms = Percentile(latency_ms, 0.9);
+  result.p99_ms = Percentile(latency_ms, 0.99);
+  result.max_ms = latency_ms.back();
+  result.peak_rss_kb = PeakRssKB();
+  return result;
+}
+
+static void RunModel(const string& model, const vector<int>& threads,
+                     vector<BenchResult>* results) {
+  NetParameter param;
+  ReadNetParamsFromTextFileOrDie(model, &param);
+  param.mutable_state()->set_phase(TEST);
+  if (FLAGS_batch_size > 0) {
+    for (int i = 0; i < param.layer_size(); ++i) {
+      LayerParameter* layer = param.mutable_layer(i);
+      if (layer->type() != "Input") {
+        continue;
+      }
+      InputParameter* input = layer->mutable_input_param();
+      for (int j = 0; j < input->shape_size(); ++j) {
+        input->mutable_shape(j)->set_dim(0, FLAGS_batch_size);
+      }
+    }
+  }
+  if (FLAGS_cpu_weight_dtype.size()) {
+    BaseDataType dtype;
+    CHECK(BaseDataType_Parse("DT_" + FLAGS_cpu_weight_dtype, &dtype))
+        << "Unknown cpu_weight_dtype: " << FLAGS_cpu_weight_dtype;
+    param.set_cpu_weight_dtype(dtype);
+  }
+  if (FLAGS_channels_last) {
+    param.set_channels_last(true);
+  }
+  if (FLAGS_pack_weights) {
+    for (int i = 0; i < param.layer_size(); ++i) {
+      LayerParameter* layer = param.mutable_layer(i);
+      if (layer->type() == "InnerProduct" &&
+          !layer->inner_product_param().has_pack_weights()) {
+        layer->mutable_inner_product_param()->set_pack_weights(true);
+      }
+    }
+  }
+
+  Caffe::set_random_seed(FLAGS_seed);
+  Net<float> net(param);
+  if (FLAGS_weights.size()) {
+    net.CopyTrainedLayersFrom(FLAGS_weights);
+  } else {
+    SyntheticWeights(&net);
+  }
+  FillInputs(&net);
+
+  for (int i = 0; i < threads.size(); ++i) {
+    if (threads[i] > 0) {
+      Caffe::set_num_threads(threads[i]);
+    }
+    BenchResult result = Measure(&net, Caffe::num_threads());
+    result.model = model;
+    LOG(INFO) << result.name << ", batch " << result.batch_size << ", "
+              << result.threads << " threads: " << result.throughput
+              << " items/s, p50 " << result.p50_ms << " ms, p99 "
+              << result.p99_ms << " ms";
+    results->push_back(result);
+  }
+}
+
+// Runs RunModel in a child process and collects its results through a pipe,
+// one line with the name and one with the figures per result. The parent
+// never builds a net, so each model starts from the same footprint and its
+// peak RSS does not carry those of the models before it.
+static void RunModelInChild(const string& model, const vector<int>& threads,
+                            vector<BenchResult>* results) {
+  int fds[2];
+  CHECK_EQ(pipe(fds), 0) << "Failed to create a pipe";
+  const pid_t pid = fork();
+  CHECK_GE(pid, 0) << "Failed to fork";
+  if (pid == 0) {
+    close(fds[0]);
+    vector<BenchResult> child_results;
+    RunModel(model, threads, &child_results);
+    std::ostringstream out;
+    out.precision(17);
+    for (int i = 0; i < child_results.size(); ++i) {
+      const BenchResult& r = child_results[i];
+      out << r.name << "\n" << r.batch_size << " " << r.threads << " "
+          << r.throughput << " " << r.mean_ms << " " << r.min_ms << " "
+          << r.p50_ms << " " << r.p90_ms << " " << r.p99_ms << " "
+          << r.max_ms << " " << r.peak_rss_kb << "\n";
+    }
+    const string text = out.str();
+    for (size_t done = 0; done < text.size(); ) {
+      const ssize_t n = write(fds[1], text.data() + done, text.size() - done);
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      CHECK_GT(n, 0) << "Failed to send the results";
+      done += n;
+    }
+    close(fds[1]);
+    google::FlushLogFiles(GLOG_INFO);
+    _exit(0);
+  }
+  close(fds[1]);
+  string text;
+  char buffer[4096];
+  for (;;) {
+    const ssize_t n = read(fds[0], buffer, sizeof(buffer));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    CHECK_GE(n, 0) << "Failed to read the results";
+    if (n == 0) {
+      break;
+    }
+    text.append(buffer, n);
+  }
+  close(fds[0]);
+  int status;
+  while (waitpid(pid, &status, 0) < 0) {
+    CHECK_EQ(errno, EINTR) << "Failed to wait for " << model;
+  }
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0)
+      << "Benchmarking " << model << " failed.";
+
+  std::istringstream in(text);
+  BenchResult result;
+  while (std::getline(in, result.name)) {
+    string figures;
+    CHECK(std::getline(in, figures)) << "Truncated results of " << model;
+    std::istringstream fields(figures);
+    fields >> result.batch_size >> result.threads >> result.throughput
+           >> result.mean_ms >> result.min_ms >> result.p50_ms
+           >> result.p90_ms >> result.p99_ms >> result.max_ms
+           >> result.peak_rss_kb;
+    CHECK(fields) << "Malformed results of " << model << ": " << figures;
+    result.model = model;
+    results->push_back(result);
+  }
+}
+
+static string ResultKey(const string& model, int batch_size, int threads) {
+  std::ostringstream key;
+  key << model << " batch " << batch_size << " threads " << threads;
+  return key.str();
+}
+
+// Marks the results that regressed against the report at path; returns
+// their number.
+static int CompareWithBaseline(const string& path,
+                               vector<BenchResult>* results) {
+  boost::property_tree::ptree report;
+  boost::property_tree::read_json(path, report);
+  std::map<string, std::pair<double, double> > baseline;
+  BOOST_FOREACH(const boost::property_tree::ptree::value_type& entry,
+                report.get_child("results")) {
+    const boost::property_tree::ptree& result = entry.second;
+    const string key = ResultKey(result.get<string>("model"),
+        result.get<int>("batch_size"), result.get<int>("threads"));
+    baseline[key] = std::make_pair(result.get<double>("throughput"),
+                                   result.get<double>("latency_ms.p50"));
+  }
+  int regressions = 0;
+  for (int i = 0; i < results->size(); ++i) {
+    BenchResult& result = (*results)[i];
+    const string key =
+        ResultKey(result.model, result.batch_size, result.threads);
+    if (!baseline.count(key)) {
+      LOG(WARNING) << "No baseline for " << key;
+      continue;
+    }
+    result.baseline_throughput = baseline[key].first;
+    result.baseline_p50_ms = baseline[key].second;
+    result.regression =
+        result.throughput < result.baseline_throughput * (1 - FLAGS_threshold)
+        || result.p50_ms > result.baseline_p50_ms * (1 + FLAGS_threshold);
+    if (result.regression) {
+      LOG(ERROR) << "Regression in " << key << ": " << result.throughput
+                 << " items/s, p50 " << result.p50_ms << " ms (baseline "
+                 << result.baseline_throughput << " items/s, p50 "
+                 << result.baseline_p50_ms << " ms)";
+      ++regressions;
+    }
+  }
+  return regressions;
+}
+
+static string JsonString(const string& s) {
+  string quoted = "\"";
+  for (int i = 0; i < s.size(); ++i) {
+    if (s[i] == '"' || s[i] == '\\') {
+      quoted += '\\';
+    }
+    quoted += s[i];
+  }
+  return quoted + "\"";
+}
+
+static void WriteReport(const vector<BenchResult>& results,
+                        std::ostream* out) {
+  std::ostream& json = *out;
+  json << "{\n"
+       << "  \"warmup\": " << FLAGS_warmup << ",\n"
+       << "  \"iterations\": " << FLAGS_iterations << ",\n"
+       << "  \"input\": " << JsonString(FLAGS_input_file.empty() ?
+           "synthetic" : FLAGS_input_file) << ",\n"
+       << "  \"weights\": " << JsonString(FLAGS_weights.empty() ?
+           "synthetic" : FLAGS_weights) << ",\n"
+       << "  \"results\": [";
+  for (int i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    json << (i ? "," : "") << "\n    {\n"
+         << "      \"model\": " << JsonString(r.model) << ",\n"
+         << "      \"name\": " << JsonString(r.name) << ",\n"
+         << "      \"batch_size\": " << r.batch_size << ",\n"
+         << "      \"threads\": " << r.threads << ",\n"
+         << "      \"throughput\": " << r.throughput << ",\n"
+         << "      \"latency_ms\": {\"mean\": " << r.mean_ms
+         << ", \"min\": " << r.min_ms << ", \"p50\": " << r.p50_ms
+         << ", \"p90\": " << r.p90_ms << ", \"p99\": " << r.p99_ms
+         << ", \"max\": " << r.max_ms << "},\n"
+         << "      \"peak_rss_kb\": " << r.peak_rss_kb;
+    if (r.baseline_throughput >= 0) {
+      json << ",\n      \"baseline\": {\"throughput\": "
+           << r.baseline_throughput << ", \"p50\": " << r.baseline_p50_ms
+           << "},\n      \"regression\": "
+           << (r.regression ? "true" : "false");
+    }
+    json << "\n    }";
+  }
+  json << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Benchmarks model inference and reports JSON.\n"
+      "Usage:\n    caffe_bench [FLAGS]\n");
+  GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_iterations, 0);
+  Caffe::set_mode(Caffe::CPU);
+
+  const vector<string> models = SuiteModels();
+  CHECK(!models.empty()) << "No model to run.";
+  CHECK(FLAGS_weights.empty() || models.size() == 1)
+      << "--weights needs a single --model.";
+  vector<int> threads;
+  const vector<string> thread_list = SplitList(FLAGS_threads);
+  for (int i = 0; i < thread_list.size(); ++i) {
+    threads.push_back(atoi(thread_list[i].c_str()));
+    CHECK_GT(threads.back(), 0) << "Invalid thread count: " << thread_list[i];
+  }
+  if (threads.empty()) {
+    threads.push_back(0);
+  }
+
+  vector<BenchResult> results;
+  for (int i = 0; i < models.size(); ++i) {
+    LOG(INFO) << "Benchmarking " << models[i];
+    RunModelInChild(models[i], threads, &results);
+  }
+  const int regressions = FLAGS_baseline.empty() ? 0 :
+      CompareWithBaseline(FLAGS_baseline, &results);
+
+  if (FLAGS_output.empty()) {
+    WriteReport(results, &std::cout);
+  } else {
+    std::ofstream out(FLAGS_output.c_str());
+    CHECK(out) << "Cannot write " << FLAGS_output;
+    WriteReport(results, &out);
+  }
+  if (regressions) {
+    LOG(ERROR) << regressions << " of " << results.size()
+               << " configurations regressed by more than "
+               << FLAGS_threshold * 100 << "%.";
+    return 1;
+  }
+  return 0;
+}
@@ -27,9 +27,20 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+// Computes the per-pixel mean image and the per-channel mean and standard
+// deviation of the images in a leveldb/lmdb.
+// Usage:
+//    compute_image_mean [FLAGS] INPUT_DB [OUTPUT_FILE]
+//
+// The cursor is read on the main thread; --threads workers decode the
+// records and keep partial statistics that are merged at the end. With
+// --sample_every=k only every k-th record is used, for a quick estimate.
+
 #include <stdint.h>
 #include <algorithm>
+#include <cmath>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
@@ -38,6 +49,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "glog/logging.h"
 
 #include "caffe/proto/caffe.pb.h"
+#include "caffe/util/blocking_queue.hpp"
 #include "caffe/util/db.hpp"
 #include "caffe/util/io.hpp"
 
@@ -49,6 +61,123 @@ using boost::scoped_ptr;
 
 DEFINE_string(backend, "lmdb",
         "The backend {leveldb, lmdb} containing the images");
+DEFINE_int32(threads, 0,
+        "Number of decoding threads; 0 uses all hardware threads.");
+DEFINE_int32(sample_every, 1, "Only use every k-th record.");
+
+#ifdef USE_OPENCV
+// Records handed from the cursor to the workers at a time.
+const int kRecordsPerBatch = 256;
+
+// Count, mean and sum of squared deviations of the values of one channel.
+// Images are folded in with the pairwise update of Chan et al., so the
+// statistics stay accurate over millions of images.
+struct ChannelStats {
+  ChannelStats() : count(0), mean(0), m2(0) {}
+
+  void Merge(double other_count, double other_mean, double other_m2) {
+    if (other_count == 0) {
+      return;
+    }
+    const double total = count + other_count;
+    const double delta = other_mean - mean;
+    mean += delta * other_count / total;
+    m2 += other_m2 + delta * delta * count * other_count / total;
+    count = total;
+  }
+
+  double count;
+  double mean;
+  double m2;
+};
+
+// Partial statistics of the records seen by one worker.
+class MeanAccumulator {
+  public:
+  MeanAccumulator(int channels, int data_size, bool pixel_mean)
+      : channels_(channels), data_size_(data_size), count_(0),
+        pixel_sum_(pixel_mean ? data_size : 0, 0.), channel_stats_(channels) {}
+
+  void Add(const string& record) {
+    Datum datum;
+    datum.ParseFromString(record);
+    DecodeDatumNative(&datum);
+    const std::string& data = datum.data();
+    const int size_in_datum = std::max<int>(datum.data().size(),
+        datum.float_data_size());
+    CHECK_EQ(size_in_datum, data_size_) << "Incorrect data field size " <<
+        size_in_datum;
+    if (data.size() != 0) {
+      Add(reinterpret_cast<const uint8_t*>(data.data()));
+    } else {
+      Add(datum.float_data().data());
+    }
+  }
+
+  void Merge(const MeanAccumulator& other) {
+    count_ += other.count_;
+    for (int i = 0; i < pixel_sum_.size(); ++i) {
+      pixel_sum_[i] += other.pixel_sum_[i];
+    }
+    for (int c = 0; c < channels_; ++c) {
+      const ChannelStats& stats = other.channel_stats_[c];
+      channel_stats_[c].Merge(stats.count, stats.mean, stats.m2);
+    }
+  }
+
+  int count() const { return count_; }
+  const std::vector<double>& pixel_sum() const { return pixel_sum_; }
+  const ChannelStats& channel_stats(int c) const { return channel_stats_[c]; }
+
+  private:
+  template <typename T>
+  void Add(const T* values) {
+    for (int i = 0; i < pixel_sum_.size(); ++i) {
+      pixel_sum_[i] += values[i];
+    }
+    // Exact two-pass statistics within the image, then merged.
+    const int dim = data_size_ / channels_;
+    for (int c = 0; c < channels_; ++c) {
+      const T* plane = values + c * dim;
+      double sum = 0;
+      for (int i = 0; i < dim; ++i) {
+        sum += plane[i];
+      }
+      const double mean = sum / dim;
+      double m2 = 0;
+      for (int i = 0; i < dim; ++i) {
+        m2 += (plane[i] - mean) * (plane[i] - mean);
+      }
+      channel_stats_[c].Merge(dim, mean, m2);
+    }
+    ++count_;
+  }
+
+  const int channels_;
+  const int data_size_;
+  int count_;
+  std::vector<double> pixel_sum_;
+  std::vector<ChannelStats> channel_stats_;
+};
+
+// An empty batch tells a worker to stop.
+static void AccumulateRecords(
+    BlockingQueue<std::vector<string> >* full_batches,
+    BlockingQueue<std::vector<string> >* free_batches,
+    MeanAccumulator* accumulator) {
+  while (true) {
+    std::vector<string> batch = full_batches->pop();
+    if (batch.empty()) {
+      return;
+    }
+    for (int i = 0; i < batch.size(); ++i) {
+      accumulator->Add(batch[i]);
+    }
+    batch.clear();
+    free_batches->push(batch);
+  }
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -71,13 +200,12 @@ int main(int argc, char** argv) {
     gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/compute_image_mean");
     return 1;
   }
+  CHECK_GT(FLAGS_sample_every, 0);
 
   scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
   db->Open(argv[1], db::READ);
   scoped_ptr<db::Cursor> cursor(db->NewCursor());
 
-  BlobProto sum_blob;
-  int count = 0;
   // load first datum
   Datum datum;
   datum.ParseFromString(cursor->value());
@@ -86,66 +214,80 @@ int main(int argc, char** argv) {
     LOG(INFO) << "Decoding Datum";
   }
 
-  sum_blob.set_num(1);
-  sum_blob.set_channels(datum.channels());
-  sum_blob.set_height(datum.height());
-  sum_blob.set_width(datum.width());
+  const int channels = datum.channels();
   const int data_size = datum.channels() * datum.height() * datum.width();
-  int size_in_datum = std::max<int>(datum.data().size(),
-                                    datum.float_data_size());
-  for (int i = 0; i < size_in_datum; ++i) {
-    sum_blob.add_data(0.);
+  // The per-pixel mean is only needed for the output file.
+  const bool pixel_mean = argc == 3;
+
+  const int num_threads = FLAGS_threads > 0 ? FLAGS_threads :
+      std::max(1u, std::thread::hardware_concurrency());
+  BlockingQueue<std::vector<string> > full_batches;
+  BlockingQueue<std::vector<string> > free_batches;
+  for (int i = 0; i < 4 * num_threads; ++i) {
+    free_batches.push(std::vector<string>());
   }
+  std::vector<MeanAccumulator> accumulators(num_threads,
+      MeanAccumulator(channels, data_size, pixel_mean));
+  std::vector<std::thread> workers;
+  for (int i = 0; i < num_threads; ++i) {
+    workers.push_back(std::thread(AccumulateRecords, &full_batches,
+                                  &free_batches, &accumulators[i]));
+  }
+
   LOG(INFO) << "Starting iteration";
+  int count = 0;
+  int record = 0;
+  std::vector<string> batch = free_batches.pop();
   while (cursor->valid()) {
-    Datum datum;
-    datum.ParseFromString(cursor->value());
-    DecodeDatumNative(&datum);
-
-    const std::string& data = datum.data();
-    size_in_datum = std::max<int>(datum.data().size(),
-        datum.float_data_size());
-    CHECK_EQ(size_in_datum, data_size) << "Incorrect data field size " <<
-        size_in_datum;
-    if (data.size() != 0) {
-      CHECK_EQ(data.size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) + (uint8_t)data[i]);
+    if (record++ % FLAGS_sample_every == 0) {
+      batch.push_back(cursor->value());
+      if (batch.size() == kRecordsPerBatch) {
+        full_batches.push(batch);
+        batch = free_batches.pop();
       }
-    } else {
-      CHECK_EQ(datum.float_data_size(), size_in_datum);
-      for (int i = 0; i < size_in_datum; ++i) {
-        sum_blob.set_data(i, sum_blob.data(i) +
-            static_cast<float>(datum.float_data(i)));
+      if (++count % 10000 == 0) {
+        LOG(INFO) << "Processed " << count << " files.";
       }
     }
-    ++count;
-    if (count % 10000 == 0) {
-      LOG(INFO) << "Processed " << count << " files.";
-    }
     cursor->Next();
   }
+  if (!batch.empty()) {
+    full_batches.push(batch);
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    full_batches.push(std::vector<string>());
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    workers[i].join();
+    if (i > 0) {
+      accumulators[0].Merge(accumulators[i]);
+    }
+  }
+  const MeanAccumulator& total = accumulators[0];
+  CHECK_EQ(total.count(), count);
 
   if (count % 10000 != 0) {
     LOG(INFO) << "Processed " << count << " files.";
   }
-  for (int i = 0; i < sum_blob.data_size(); ++i) {
-    sum_blob.set_data(i, sum_blob.data(i) / count);
-  }
   // Write to disk
   if (argc == 3) {
+    BlobProto sum_blob;
+    sum_blob.set_num(1);
+    sum_blob.set_channels(datum.channels());
+    sum_blob.set_height(datum.height());
+    sum_blob.set_width(datum.width());
+    for (int i = 0; i < data_size; ++i) {
+      sum_blob.add_data(total.pixel_sum()[i] / count);
+    }
     LOG(INFO) << "Write to " << argv[2];
     WriteProtoToBinaryFile(sum_blob, argv[2]);
   }
-  const int channels = sum_blob.channels();
-  const int dim = sum_blob.height() * sum_blob.width();
-  std::vector<float> mean_values(channels, 0.0);
   LOG(INFO) << "Number of channels: " << channels;
   for (int c = 0; c < channels; ++c) {
-    for (int i = 0; i < dim; ++i) {
-      mean_values[c] += sum_blob.data(dim * c + i);
-    }
-    LOG(INFO) << "mean_value channel [" << c << "]: " << mean_values[c] / dim;
+    const ChannelStats& stats = total.channel_stats(c);
+    LOG(INFO) << "mean_value channel [" << c << "]: " << stats.mean;
+    LOG(INFO) << "std channel [" << c << "]: "
+              << std::sqrt(stats.m2 / std::max(stats.count, 1.));
   }
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
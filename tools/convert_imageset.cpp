@@ -36,14 +36,28 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // should be a list of files as well as their labels, in the format as
 //   subfolder1/file1.JPEG 7
 //   ....
+//
+// Images are read, resized and encoded by --threads workers while the main
+// thread writes them in list order. With --shards=N > 1 the items are dealt
+// round-robin into DB_NAME_0 ... DB_NAME_<N-1>. After every transaction the
+// position reached is saved to DB_NAME.checkpoint, and --resume continues an
+// interrupted conversion from there.
 
 #include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstdio>
 #include <fstream>  // NOLINT(readability/streams)
+#include <functional>
+#include <map>
+#include <mutex>  // NOLINT(build/c++11)
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 #include <vector>
 
 #include "boost/scoped_ptr.hpp"
+#include "boost/shared_ptr.hpp"
 #include "gflags/gflags.h"
 #include "glog/logging.h"
 
@@ -51,6 +65,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
 #include "caffe/util/io.hpp"
+#include "caffe/util/math_functions.hpp"
 #include "caffe/util/rng.hpp"
 
 using namespace caffe;  // NOLINT(build/namespaces)
@@ -67,6 +82,126 @@ DEFINE_bool(encoded, false,
     "When this option is on, the encoded image will be save in datum");
 DEFINE_string(encode_type, "",
     "Optional: What type should we encode the image as ('png','jpg',...).");
+DEFINE_int32(threads, 0,
+    "Number of image decoding threads; 0 uses all hardware threads.");
+DEFINE_int32(txn_size, 10000, "Number of items written per transaction.");
+DEFINE_int32(shards, 1, "Number of output databases.");
+DEFINE_bool(resume, false,
+    "Continue an interrupted conversion from DB_NAME.checkpoint.");
+DEFINE_int32(seed, 0, "Shuffle seed; 0 picks a random one.");
+DEFINE_int32(progress_interval, 10,
+    "Seconds between progress reports, 0 to disable.");
+
+#ifdef USE_OPENCV
+// A converted image; value is empty when the image could not be read.
+struct ConvertedItem {
+  string key;
+  string value;
+  int data_size;
+};
+
+// Hands list lines to the workers and returns their results in list order.
+// Workers stay at most window lines ahead of the writer.
+class OrderedResults {
+  public:
+  OrderedResults(int first_line, int window)
+      : next_line_(first_line), next_result_(first_line), window_(window) {}
+
+  // Returns the next line to convert, waiting while the window is full.
+  int TakeLine() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_.wait(lock, [this] { return next_line_ < next_result_ + window_; });
+    return next_line_++;
+  }
+
+  void Put(int line_id, const ConvertedItem& item) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      results_[line_id] = item;
+    }
+    ready_.notify_all();
+  }
+
+  ConvertedItem Take() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait(lock, [this] { return results_.count(next_result_) > 0; });
+    ConvertedItem item = results_[next_result_];
+    results_.erase(next_result_++);
+    lock.unlock();
+    space_.notify_all();
+    return item;
+  }
+
+  private:
+  int next_line_;
+  int next_result_;
+  const int window_;
+  std::map<int, ConvertedItem> results_;
+  std::mutex mutex_;
+  std::condition_variable space_;
+  std::condition_variable ready_;
+};
+
+struct Checkpoint {
+  int next_line;
+  int count;
+  int seed;
+};
+
+static bool ReadCheckpoint(const string& filename, Checkpoint* checkpoint) {
+  std::ifstream file(filename.c_str());
+  return static_cast<bool>(file >> checkpoint->next_line >> checkpoint->count
+                                >> checkpoint->seed);
+}
+
+// Writes to a temporary file first so that a crash never leaves a torn one.
+static void WriteCheckpoint(const string& filename,
+                            const Checkpoint& checkpoint) {
+  const string temp_filename = filename + ".tmp";
+  {
+    std::ofstream file(temp_filename.c_str());
+    file << checkpoint.next_line << " " << checkpoint.count << " "
+         << checkpoint.seed << std::endl;
+    CHECK(file.good()) << "Failed to write " << temp_filename;
+  }
+  CHECK_EQ(rename(temp_filename.c_str(), filename.c_str()), 0)
+      << "Failed to write " << filename;
+}
+
+static void ConvertLines(const std::vector<std::pair<std::string, int> >& lines,
+                         const string& root_folder, OrderedResults* results) {
+  const bool is_color = !FLAGS_gray;
+  const bool encoded = FLAGS_encoded;
+  const int resize_height = std::max<int>(0, FLAGS_resize_height);
+  const int resize_width = std::max<int>(0, FLAGS_resize_width);
+  Datum datum;
+  for (int line_id = results->TakeLine(); line_id < lines.size();
+       line_id = results->TakeLine()) {
+    std::string enc = FLAGS_encode_type;
+    if (encoded && !enc.size()) {
+      // Guess the encoding type from the file name
+      string fn = lines[line_id].first;
+      size_t p = fn.rfind('.');
+      if (p == fn.npos) {
+        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
+      }
+      enc = fn.substr(p);
+      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
+    }
+    ConvertedItem item;
+    item.data_size = 0;
+    if (ReadImageToDatum(root_folder + lines[line_id].first,
+                         lines[line_id].second, resize_height, resize_width,
+                         is_color, enc, &datum)) {
+      // sequential
+      item.key = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
+      CHECK(datum.SerializeToString(&item.value));
+      item.data_size = datum.data().size();
+    }
+    results->Put(line_id, item);
+  }
+}
+#endif  // USE_OPENCV
 
 int main(int argc, char** argv) {
 #ifdef USE_OPENCV
@@ -91,11 +226,23 @@ int main(int argc, char** argv) {
     gflags::ShowUsageWithFlagsRestrict(argv[0], "tools/convert_imageset");
     return 1;
   }
+  CHECK_GT(FLAGS_txn_size, 0);
+  CHECK_GT(FLAGS_shards, 0);
 
-  const bool is_color = !FLAGS_gray;
   const bool check_size = FLAGS_check_size;
-  const bool encoded = FLAGS_encoded;
-  const string encode_type = FLAGS_encode_type;
+  const string db_name(argv[3]);
+  const string checkpoint_filename = db_name + ".checkpoint";
+
+  Checkpoint checkpoint;
+  checkpoint.next_line = 0;
+  checkpoint.count = 0;
+  checkpoint.seed = FLAGS_seed ? FLAGS_seed : caffe_rng_rand() & 0x7fffffff;
+  if (FLAGS_resume) {
+    CHECK(ReadCheckpoint(checkpoint_filename, &checkpoint))
+        << "Cannot resume without " << checkpoint_filename;
+    LOG(INFO) << "Resuming at line " << checkpoint.next_line << " after "
+              << checkpoint.count << " files.";
+  }
 
   std::ifstream infile(argv[2]);
   std::vector<std::pair<std::string, int>> lines;
@@ -108,83 +255,91 @@ int main(int argc, char** argv) {
     lines.push_back(std::make_pair(line.substr(0, pos), label));
   }
   if (FLAGS_shuffle) {
-    // randomly shuffle data
+    // randomly shuffle data, in the same order when resuming
     LOG(INFO) << "Shuffling data";
+    Caffe::set_random_seed(checkpoint.seed);
     shuffle(lines.begin(), lines.end());
   }
   LOG(INFO) << "A total of " << lines.size() << " images.";
 
-  if (encode_type.size() && !encoded)
+  if (FLAGS_encode_type.size() && !FLAGS_encoded)
     LOG(INFO) << "encode_type specified, assuming encoded=true.";
 
-  int resize_height = std::max<int>(0, FLAGS_resize_height);
-  int resize_width = std::max<int>(0, FLAGS_resize_width);
-
-  // Create new DB
-  scoped_ptr<db::DB> db(db::GetDB(FLAGS_backend));
-  db->Open(argv[3], db::NEW);
-  scoped_ptr<db::Transaction> txn(db->NewTransaction());
+  // Create new DBs, or reopen them when resuming
+  std::vector<boost::shared_ptr<db::DB> > dbs(FLAGS_shards);
+  std::vector<boost::shared_ptr<db::Transaction> > txns(FLAGS_shards);
+  for (int i = 0; i < FLAGS_shards; ++i) {
+    const string shard_name = FLAGS_shards == 1 ? db_name :
+        db_name + "_" + caffe::format_int(i);
+    dbs[i].reset(db::GetDB(FLAGS_backend));
+    dbs[i]->Open(shard_name, FLAGS_resume ? db::WRITE : db::NEW);
+    txns[i].reset(dbs[i]->NewTransaction());
+  }
 
   // Storing to db
-  std::string root_folder(argv[1]);
-  Datum datum;
-  int count = 0;
+  const int num_threads = FLAGS_threads > 0 ? FLAGS_threads :
+      std::max(1u, std::thread::hardware_concurrency());
+  OrderedResults results(checkpoint.next_line, 64 * num_threads);
+  std::vector<std::thread> workers;
+  for (int i = 0; i < num_threads; ++i) {
+    workers.push_back(std::thread(ConvertLines, std::cref(lines),
+                                  string(argv[1]), &results));
+  }
+
+  const int first_line = checkpoint.next_line;
+  int count = checkpoint.count;
   int data_size = 0;
   bool data_size_initialized = false;
-
-  for (int line_id = 0; line_id < lines.size(); ++line_id) {
-    bool status;
-    std::string enc = encode_type;
-    if (encoded && !enc.size()) {
-      // Guess the encoding type from the file name
-      string fn = lines[line_id].first;
-      size_t p = fn.rfind('.');
-      if (p == fn.npos) {
-        LOG(WARNING) << "Failed to guess the encoding of '" << fn << "'";
-      }
-      enc = fn.substr(p);
-      std::transform(enc.begin(), enc.end(), enc.begin(), ::tolower);
-    }
-    status = ReadImageToDatum(
-        root_folder + lines[line_id].first,
-        lines[line_id].second,
-        resize_height,
-        resize_width,
-        is_color,
-        enc,
-        &datum);
-    if (status == false) {
-      continue;
-    }
-    if (check_size) {
-      if (!data_size_initialized) {
-        data_size = datum.channels() * datum.height() * datum.width();
-        data_size_initialized = true;
-      } else {
-        const std::string& data = datum.data();
-        CHECK_EQ(data.size(), data_size) << "Incorrect data field size " << data.size();
+  int pending = 0;
+  typedef std::chrono::steady_clock Clock;
+  const Clock::time_point start_time = Clock::now();
+  Clock::time_point report_time = start_time;
+  for (int line_id = first_line; line_id < lines.size(); ++line_id) {
+    const ConvertedItem item = results.Take();
+    if (item.value.size()) {
+      if (check_size) {
+        if (!data_size_initialized) {
+          data_size = item.data_size;
+          data_size_initialized = true;
+        } else {
+          CHECK_EQ(item.data_size, data_size)
+              << "Incorrect data field size " << item.data_size;
+        }
       }
+      // Put in db
+      txns[count % FLAGS_shards]->Put(item.key, item.value);
+      ++count;
+      ++pending;
     }
-    // sequential
-    string key_str = caffe::format_int(line_id, 8) + "_" + lines[line_id].first;
 
-    // Put in db
-    string out;
-    CHECK(datum.SerializeToString(&out));
-    txn->Put(key_str, out);
-
-    if (++count % 1000 == 0) {
+    const bool last = line_id + 1 == lines.size();
+    if (pending >= FLAGS_txn_size || (last && pending > 0)) {
       // Commit db
-      txn->Commit();
-      txn.reset(db->NewTransaction());
-      LOG(INFO) << "Processed " << count << " files.";
+      for (int i = 0; i < FLAGS_shards; ++i) {
+        txns[i]->Commit();
+        txns[i].reset(dbs[i]->NewTransaction());
+      }
+      pending = 0;
+      checkpoint.next_line = line_id + 1;
+      checkpoint.count = count;
+      WriteCheckpoint(checkpoint_filename, checkpoint);
+    }
+    if (FLAGS_progress_interval > 0 && !last && Clock::now() - report_time >
+        std::chrono::seconds(FLAGS_progress_interval)) {
+      report_time = Clock::now();
+      const double seconds =
+          std::chrono::duration<double>(report_time - start_time).count();
+      const double rate = (line_id + 1 - first_line) / seconds;
+      LOG(INFO) << "Processed " << count << " files, " << line_id + 1 << " of "
+                << lines.size() << " lines, " << rate << " lines/s, ETA "
+                << static_cast<int>((lines.size() - line_id - 1) / rate)
+                << " s.";
     }
   }
-  // write the last batch
-  if (count % 1000 != 0) {
-    txn->Commit();
-    LOG(INFO) << "Processed " << count << " files.";
+  for (int i = 0; i < workers.size(); ++i) {
+    workers[i].join();
   }
+  LOG(INFO) << "Processed " << count << " files.";
 #else
   LOG(FATAL) << "This tool requires OpenCV; compile with USE_OPENCV.";
 #endif  // USE_OPENCV
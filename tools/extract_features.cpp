@@ -27,7 +27,18 @@ OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
 OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstring>
+#include <deque>
+#include <mutex>  // NOLINT(build/c++11)
+#include <sstream>
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
 #include "boost/algorithm/string.hpp"
@@ -39,6 +50,7 @@ OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "caffe/proto/caffe.pb.h"
 #include "caffe/util/db.hpp"
 #include "caffe/util/format.hpp"
+#include "caffe/util/half.hpp"
 #include "caffe/util/io.hpp"
 
 using caffe::Blob;
@@ -48,6 +60,228 @@ using caffe::Net;
 using std::string;
 namespace db = caffe::db;
 
+// Where the features of one blob go. Write() is only called from the
+// writer thread, with the samples of one mini-batch.
+template<typename Dtype>
+class FeatureSink {
+  public:
+  virtual ~FeatureSink() {}
+  virtual void Write(int first_index, int num, const Dtype* data) = 0;
+  virtual void Close() = 0;
+};
+
+// One serialized Datum per sample in a leveldb/lmdb, keyed by its index.
+template<typename Dtype>
+class DBFeatureSink : public FeatureSink<Dtype> {
+  public:
+  DBFeatureSink(const string& name, const string& db_type,
+                const Blob<Dtype>& blob)
+      : db_(db::GetDB(db_type)), blob_name_(name), count_(0) {
+    db_->Open(name, db::NEW);
+    txn_.reset(db_->NewTransaction());
+    datum_.set_channels(blob.channels());
+    datum_.set_height(blob.height());
+    datum_.set_width(blob.width());
+  }
+
+  virtual void Write(int first_index, int num, const Dtype* data) {
+    const int dim = datum_.channels() * datum_.height() * datum_.width();
+    string out;
+    for (int n = 0; n < num; ++n) {
+      datum_.clear_float_data();
+      for (int d = 0; d < dim; ++d) {
+        datum_.add_float_data(data[n * dim + d]);
+      }
+      CHECK(datum_.SerializeToString(&out));
+      txn_->Put(caffe::format_int(first_index + n, 10), out);
+      if (++count_ % 1000 == 0) {
+        txn_->Commit();
+        txn_.reset(db_->NewTransaction());
+        LOG(ERROR)<< "Extracted features of " << count_ <<
+            " query images for feature blob " << blob_name_;
+      }
+    }
+  }
+
+  virtual void Close() {
+    if (count_ % 1000 != 0) {
+      txn_->Commit();
+    }
+    db_->Close();
+  }
+
+  private:
+  boost::shared_ptr<db::DB> db_;
+  boost::shared_ptr<db::Transaction> txn_;
+  Datum datum_;
+  string blob_name_;
+  int count_;
+};
+
+// A preallocated float32 or float16 array of shape (num_samples, ...) in a
+// shared file mapping, with a .npy header or none (raw). The array is
+// written in place, so it can be mmap'ed by readers without any parsing.
+template<typename Dtype>
+class ArrayFeatureSink : public FeatureSink<Dtype> {
+  public:
+  ArrayFeatureSink(const string& filename, bool npy, bool half,
+                   const Blob<Dtype>& blob, int num_samples)
+      : filename_(filename), half_(half), dim_(blob.count(1)),
+        num_samples_(num_samples) {
+    string header;
+    if (npy) {
+      header = NpyHeader(blob.shape(), num_samples);
+    }
+    data_offset_ = header.size();
+    size_ = data_offset_ +
+        static_cast<size_t>(num_samples_) * dim_ * element_size();
+    const int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    CHECK_GE(fd, 0) << "Failed to open " << filename;
+    CHECK_EQ(ftruncate(fd, size_), 0) << "Failed to resize " << filename;
+    addr_ = static_cast<char*>(
+        mmap(NULL, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    close(fd);
+    CHECK(addr_ != MAP_FAILED) << "Failed to mmap " << filename;
+    memcpy(addr_, header.data(), header.size());
+  }
+
+  virtual void Write(int first_index, int num, const Dtype* data) {
+    CHECK_LE(first_index + num, num_samples_);
+    char* dst = addr_ + data_offset_ +
+        static_cast<size_t>(first_index) * dim_ * element_size();
+    const size_t count = static_cast<size_t>(num) * dim_;
+    if (half_) {
+      uint16_t* out = reinterpret_cast<uint16_t*>(dst);
+      for (size_t i = 0; i < count; ++i) {
+        out[i] = caffe::caffe_float_to_half(data[i]);
+      }
+    } else {
+      float* out = reinterpret_cast<float*>(dst);
+      for (size_t i = 0; i < count; ++i) {
+        out[i] = data[i];
+      }
+    }
+  }
+
+  virtual void Close() {
+    CHECK_EQ(munmap(addr_, size_), 0) << "Failed to unmap " << filename_;
+  }
+
+  private:
+  size_t element_size() const { return half_ ? 2 : 4; }
+
+  // Version 1.0 header, padded with spaces so the data is 64-byte aligned.
+  string NpyHeader(const std::vector<int>& shape, int num_samples) const {
+    std::ostringstream dict;
+    dict << "{'descr': '" << (half_ ? "<f2" : "<f4")
+         << "', 'fortran_order': False, 'shape': (" << num_samples << ",";
+    for (int i = 1; i < shape.size(); ++i) {
+      dict << (i > 1 ? ", " : " ") << shape[i];
+    }
+    dict << "), }";
+    string header = dict.str();
+    const size_t preamble = 10;
+    const size_t padded = (preamble + header.size() + 1 + 63) / 64 * 64;
+    header.append(padded - preamble - header.size() - 1, ' ');
+    header.push_back('\n');
+    const uint16_t header_len = header.size();
+    string magic("\x93NUMPY\x01\x00", 8);
+    magic.push_back(header_len & 0xff);
+    magic.push_back(header_len >> 8);
+    return magic + header;
+  }
+
+  string filename_;
+  bool half_;
+  int dim_;
+  int num_samples_;
+  size_t data_offset_;
+  size_t size_;
+  char* addr_;
+};
+
+// Copies of the feature blobs of one mini-batch.
+template<typename Dtype>
+struct FeatureBatch {
+  int first_index;
+  int num;
+  std::vector<std::vector<Dtype> > features;
+};
+
+// Hands filled batches to the writer thread and recycles written ones, so
+// Forward() of the next mini-batch overlaps writing the previous one.
+template<typename Dtype>
+class FeatureWriter {
+  public:
+  FeatureWriter(const std::vector<boost::shared_ptr<FeatureSink<Dtype> > >&
+                sinks, int depth)
+      : sinks_(sinks), batches_(depth), done_(false) {
+    for (int i = 0; i < depth; ++i) {
+      free_.push_back(&batches_[i]);
+    }
+    thread_ = std::thread(&FeatureWriter::Run, this);
+  }
+
+  FeatureBatch<Dtype>* GetFree() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return !free_.empty(); });
+    FeatureBatch<Dtype>* batch = free_.front();
+    free_.pop_front();
+    return batch;
+  }
+
+  void Submit(FeatureBatch<Dtype>* batch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    full_.push_back(batch);
+    cond_.notify_all();
+  }
+
+  // Writes the remaining batches and closes the sinks.
+  void Finish() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      done_ = true;
+      cond_.notify_all();
+    }
+    thread_.join();
+    for (int i = 0; i < sinks_.size(); ++i) {
+      sinks_[i]->Close();
+    }
+  }
+
+  private:
+  void Run() {
+    while (true) {
+      FeatureBatch<Dtype>* batch;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, [this] { return !full_.empty() || done_; });
+        if (full_.empty()) {
+          return;
+        }
+        batch = full_.front();
+        full_.pop_front();
+      }
+      for (int i = 0; i < sinks_.size(); ++i) {
+        sinks_[i]->Write(batch->first_index, batch->num,
+                         batch->features[i].data());
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      free_.push_back(batch);
+      cond_.notify_all();
+    }
+  }
+
+  std::vector<boost::shared_ptr<FeatureSink<Dtype> > > sinks_;
+  std::vector<FeatureBatch<Dtype> > batches_;
+  std::deque<FeatureBatch<Dtype>*> free_;
+  std::deque<FeatureBatch<Dtype>*> full_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  bool done_;
+  std::thread thread_;
+};
+
 template<typename Dtype>
 int feature_extraction_pipeline(int argc, char** argv);
 
@@ -71,7 +305,10 @@ int feature_extraction_pipeline(int argc, char** argv) {
     "Note: you can extract multiple features in one pass by specifying"
     " multiple feature blob names and dataset names separated by ','."
     " The names cannot contain white space characters and the number of blobs"
-    " and datasets must be equal.";
+    " and datasets must be equal.\n"
+    "db_type is leveldb or lmdb for one Datum per image, or npy, raw,"
+    " npy_fp16 or raw_fp16 to write each blob as one preallocated"
+    " (num_images, ...) array in the named file, ready to be mmap'ed.";
     return 1;
   }
   int arg_pos = num_required_args;
@@ -120,64 +357,54 @@ int feature_extraction_pipeline(int argc, char** argv) {
 
   int num_mini_batches = atoi(argv[++arg_pos]);
 
-  std::vector<boost::shared_ptr<db::DB> > feature_dbs;
-  std::vector<boost::shared_ptr<db::Transaction> > txns;
-  const char* db_type = argv[++arg_pos];
+  std::vector<boost::shared_ptr<FeatureSink<Dtype> > > sinks;
+  const string db_type = argv[++arg_pos];
+  const bool array_output = db_type == "npy" || db_type == "raw" ||
+      db_type == "npy_fp16" || db_type == "raw_fp16";
   for (size_t i = 0; i < num_features; ++i) {
     LOG(INFO)<< "Opening dataset " << dataset_names[i];
-    boost::shared_ptr<db::DB> db(db::GetDB(db_type));
-    db->Open(dataset_names.at(i), db::NEW);
-    feature_dbs.push_back(db);
-    boost::shared_ptr<db::Transaction> txn(db->NewTransaction());
-    txns.push_back(txn);
+    const Blob<Dtype>& blob =
+        *feature_extraction_net->blob_by_name(blob_names[i]);
+    if (array_output) {
+      // The blob shapes of the net are known before the first Forward().
+      sinks.push_back(boost::shared_ptr<FeatureSink<Dtype> >(
+          new ArrayFeatureSink<Dtype>(dataset_names[i],
+              db_type.compare(0, 3, "npy") == 0,
+              db_type.find("_fp16") != string::npos,
+              blob, num_mini_batches * blob.num())));
+    } else {
+      sinks.push_back(boost::shared_ptr<FeatureSink<Dtype> >(
+          new DBFeatureSink<Dtype>(dataset_names[i], db_type, blob)));
+    }
   }
 
   LOG(ERROR)<< "Extracting Features";
 
-  Datum datum;
-  std::vector<int> image_indices(num_features, 0);
+  FeatureWriter<Dtype> writer(sinks, 2);
+  int num_images = 0;
   for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index) {
     feature_extraction_net->Forward();
+    FeatureBatch<Dtype>* batch = writer.GetFree();
+    batch->first_index = num_images;
+    batch->features.resize(num_features);
     for (int i = 0; i < num_features; ++i) {
       const boost::shared_ptr<Blob<Dtype> > feature_blob =
         feature_extraction_net->blob_by_name(blob_names[i]);
-      int batch_size = feature_blob->num();
-      int dim_features = feature_blob->count() / batch_size;
-      const Dtype* feature_blob_data;
-      for (int n = 0; n < batch_size; ++n) {
-        datum.set_height(feature_blob->height());
-        datum.set_width(feature_blob->width());
-        datum.set_channels(feature_blob->channels());
-        datum.clear_data();
-        datum.clear_float_data();
-        feature_blob_data = feature_blob->cpu_data() +
-            feature_blob->offset(n);
-        for (int d = 0; d < dim_features; ++d) {
-          datum.add_float_data(feature_blob_data[d]);
-        }
-        string key_str = caffe::format_int(image_indices[i], 10);
-
-        string out;
-        CHECK(datum.SerializeToString(&out));
-        txns.at(i)->Put(key_str, out);
-        ++image_indices[i];
-        if (image_indices[i] % 1000 == 0) {
-          txns.at(i)->Commit();
-          txns.at(i).reset(feature_dbs.at(i)->NewTransaction());
-          LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
-              " query images for feature blob " << blob_names[i];
-        }
-      }  // for (int n = 0; n < batch_size; ++n)
-    }  // for (int i = 0; i < num_features; ++i)
+      if (i == 0) {
+        batch->num = feature_blob->num();
+      }
+      CHECK_EQ(feature_blob->num(), batch->num)
+          << "Feature blobs must have the same batch size";
+      batch->features[i].assign(feature_blob->cpu_data(),
+          feature_blob->cpu_data() + feature_blob->count());
+    }
+    num_images += batch->num;
+    writer.Submit(batch);
   }  // for (int batch_index = 0; batch_index < num_mini_batches; ++batch_index)
-  // write the last batch
+  writer.Finish();
   for (int i = 0; i < num_features; ++i) {
-    if (image_indices[i] % 1000 != 0) {
-      txns.at(i)->Commit();
-    }
-    LOG(ERROR)<< "Extracted features of " << image_indices[i] <<
+    LOG(ERROR)<< "Extracted features of " << num_images <<
         " query images for feature blob " << blob_names[i];
-    feature_dbs.at(i)->Close();
   }
 
   LOG(ERROR)<< "Successfully extracted the features!";
@@ -0,0 +1,446 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Serves a network over a Unix domain socket. Concurrent requests are
+// coalesced into batches of up to --max_batch_size samples, or whatever
+// arrived within --max_latency_us of the first request of a batch.
+// Usage:
+//    inference_server --model=deploy.prototxt --weights=net.caffemodel
+//        [--socket=/tmp/caffe_server.sock] [--max_batch_size=8]
+//        [--max_latency_us=2000] [--workers=1] [--stats_interval=10]
+//
+// Wire protocol, every integer is a native-endian uint32:
+//    request:  type (0 = forward, 1 = stats), count, count floats of payload
+//    response: status (0 = ok, 1 = bad request), count, payload
+// A forward request carries one sample of the first net input, i.e. input
+// shape without the batch axis. Its response carries the sample's slice of
+// every net output along that output's batch axis, concatenated in output
+// order; outputs without a batch axis are sent whole. A stats request
+// carries no payload; its response carries count bytes of text holding the
+// queue depth, the batch size histogram and the latency percentiles. Any
+// other request is skipped and answered with a bad request status.
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>  // NOLINT(build/c++11)
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstring>
+#include <deque>
+#include <mutex>  // NOLINT(build/c++11)
+#include <sstream>
+#include <string>
+#include <thread>  // NOLINT(build/c++11)
+#include <vector>
+
+#include "caffe/caffe.hpp"
+
+using caffe::Blob;
+using caffe::Caffe;
+using caffe::Net;
+using caffe::NetModel;
+using caffe::shared_ptr;
+using caffe::string;
+using caffe::vector;
+typedef std::chrono::steady_clock Clock;
+
+DEFINE_string(model, "", "The model definition protocol buffer text file.");
+DEFINE_string(weights, "", "The trained weights.");
+DEFINE_string(socket, "/tmp/caffe_server.sock",
+    "Path of the Unix domain socket to listen on.");
+DEFINE_int32(max_batch_size, 8, "Largest batch handed to a worker.");
+DEFINE_int32(max_latency_us, 2000,
+    "How long a batch waits for more requests after its first one.");
+DEFINE_int32(workers, 1,
+    "Number of forward threads; they share one copy of the weights.");
+DEFINE_int32(stats_interval, 10,
+    "Seconds between statistics reports in the log, 0 to disable.");
+
+enum RequestType { kForward = 0, kStats = 1 };
+enum ResponseStatus { kOk = 0, kBadRequest = 1 };
+
+struct Request {
+  vector<float> input;
+  vector<float> output;
+  Clock::time_point arrival;
+  bool done;
+  std::mutex mutex;
+  std::condition_variable cond;
+};
+
+// Requests waiting for a worker; PopBatch implements the batching policy.
+class RequestQueue {
+  public:
+  void Push(const shared_ptr<Request>& request) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(request);
+    }
+    cond_.notify_one();
+  }
+
+  // Blocks for the first request, then collects more until max_size
+  // requests are gathered or the latency budget of the first one is spent.
+  void PopBatch(int max_size, int max_latency_us,
+                vector<shared_ptr<Request> >* batch) {
+    batch->clear();
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return !queue_.empty(); });
+    const Clock::time_point deadline =
+        queue_.front()->arrival + std::chrono::microseconds(max_latency_us);
+    while (batch->size() < max_size) {
+      if (queue_.empty() &&
+          !cond_.wait_until(lock, deadline, [this] { return !queue_.empty(); })) {
+        break;
+      }
+      batch->push_back(queue_.front());
+      queue_.pop_front();
+    }
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+  private:
+  std::deque<shared_ptr<Request> > queue_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+};
+
+class ServerStats {
+  public:
+  explicit ServerStats(int max_batch_size)
+      : batch_sizes_(max_batch_size + 1, 0), requests_(0), batches_(0) {}
+
+  void RecordBatch(int size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++batch_sizes_[size];
+    ++batches_;
+    requests_ += size;
+  }
+
+  void RecordLatency(double latency_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    latencies_.push_back(latency_us);
+    if (latencies_.size() > kLatencyWindow) {
+      latencies_.pop_front();
+    }
+  }
+
+  string Report(size_t queue_depth) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::ostringstream report;
+    report << "queue_depth " << queue_depth << "\n"
+           << "requests " << requests_ << "\n"
+           << "batches " << batches_ << "\n"
+           << "batch_size_histogram";
+    for (int i = 1; i < batch_sizes_.size(); ++i) {
+      report << " " << i << ":" << batch_sizes_[i];
+    }
+    report << "\n";
+    vector<double> sorted(latencies_.begin(), latencies_.end());
+    std::sort(sorted.begin(), sorted.end());
+    report << "latency_us p50 " << Percentile(sorted, 0.5)
+           << " p90 " << Percentile(sorted, 0.9)
+           << " p99 " << Percentile(sorted, 0.99) << "\n";
+    return report.str();
+  }
+
+  private:
+  static double Percentile(const vector<double>& sorted, double q) {
+    if (sorted.empty()) {
+      return 0;
+    }
+    return sorted[std::min(sorted.size() - 1,
+                           static_cast<size_t>(q * sorted.size()))];
+  }
+
+  // Percentiles are computed over the most recent requests only.
+  static const size_t kLatencyWindow = 10000;
+
+  vector<uint64_t> batch_sizes_;
+  std::deque<double> latencies_;
+  uint64_t requests_;
+  uint64_t batches_;
+  std::mutex mutex_;
+};
+
+static bool ReadFull(int fd, void* buffer, size_t size) {
+  char* data = static_cast<char*>(buffer);
+  while (size > 0) {
+    ssize_t n = read(fd, data, size);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+// Skips size bytes of fd without buffering them.
+static bool Discard(int fd, uint64_t size) {
+  char buffer[4096];
+  while (size > 0) {
+    const size_t chunk = std::min<uint64_t>(size, sizeof(buffer));
+    if (!ReadFull(fd, buffer, chunk)) {
+      return false;
+    }
+    size -= chunk;
+  }
+  return true;
+}
+
+static bool WriteFull(int fd, const void* buffer, size_t size) {
+  const char* data = static_cast<const char*>(buffer);
+  while (size > 0) {
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+static bool WriteResponse(int fd, uint32_t status, const void* payload,
+                          uint32_t count, size_t element_size) {
+  const uint32_t header[2] = {status, count};
+  return WriteFull(fd, header, sizeof(header)) &&
+         WriteFull(fd, payload, count * element_size);
+}
+
+class InferenceServer {
+  public:
+  explicit InferenceServer(const shared_ptr<NetModel<float> >& model)
+      : model_(model), stats_(FLAGS_max_batch_size) {
+    const Net<float>& net = model_->net();
+    CHECK_GE(net.num_inputs(), 1) << "The net has no Input layer";
+    CHECK_GE(net.num_outputs(), 1) << "The net produces no output";
+    sample_count_ = net.input_blobs()[0]->count(1);
+  }
+
+  void Start() {
+    for (int i = 0; i < FLAGS_workers; ++i) {
+      std::thread(&InferenceServer::Work, this).detach();
+    }
+    if (FLAGS_stats_interval > 0) {
+      std::thread(&InferenceServer::ReportStats, this).detach();
+    }
+  }
+
+  void Serve(int fd) {
+    uint32_t header[2];
+    while (ReadFull(fd, header, sizeof(header))) {
+      if (header[0] == kStats && header[1] == 0) {
+        const string report = stats_.Report(queue_.size());
+        if (!WriteResponse(fd, kOk, report.data(), report.size(), 1)) break;
+        continue;
+      }
+      // The header is checked before anything is allocated; the payload of a
+      // bad request is skipped so that the stream stays in sync.
+      if (header[0] != kForward || header[1] != sample_count_) {
+        LOG(WARNING) << "Rejecting request of type " << header[0] << " with "
+                     << header[1] << " values; expected " << sample_count_;
+        if (!Discard(fd, static_cast<uint64_t>(header[1]) * sizeof(float)) ||
+            !WriteResponse(fd, kBadRequest, NULL, 0, 0)) {
+          break;
+        }
+        continue;
+      }
+      shared_ptr<Request> request(new Request());
+      request->input.resize(sample_count_);
+      if (!ReadFull(fd, request->input.data(), sample_count_ * sizeof(float))) {
+        break;
+      }
+      request->arrival = Clock::now();
+      request->done = false;
+      queue_.Push(request);
+      {
+        std::unique_lock<std::mutex> lock(request->mutex);
+        request->cond.wait(lock, [&request] { return request->done; });
+      }
+      if (!WriteResponse(fd, kOk, request->output.data(),
+                         request->output.size(), sizeof(float))) {
+        break;
+      }
+    }
+    close(fd);
+  }
+
+  private:
+  void Work() {
+    Caffe::set_mode(Caffe::CPU);
+    shared_ptr<Net<float> > net = model_->CreateContext();
+    Blob<float>* input = net->input_blobs()[0];
+    vector<int> input_shape = input->shape();
+    const vector<int> batch_axes = OutputBatchAxes(net.get());
+    vector<shared_ptr<Request> > batch;
+    while (true) {
+      queue_.PopBatch(FLAGS_max_batch_size, FLAGS_max_latency_us, &batch);
+      input_shape[0] = batch.size();
+      input->Reshape(input_shape);
+      net->Reshape();
+      float* input_data = input->mutable_cpu_data();
+      for (int i = 0; i < batch.size(); ++i) {
+        caffe::caffe_copy(sample_count_, batch[i]->input.data(),
+                          input_data + i * sample_count_);
+      }
+      const vector<Blob<float>*>& outputs = net->Forward();
+      for (int i = 0; i < batch.size(); ++i) {
+        Request* request = batch[i].get();
+        for (int j = 0; j < outputs.size(); ++j) {
+          AppendSample(*outputs[j], batch_axes[j], i, &request->output);
+        }
+        stats_.RecordLatency(std::chrono::duration<double, std::micro>(
+            Clock::now() - request->arrival).count());
+        {
+          std::lock_guard<std::mutex> lock(request->mutex);
+          request->done = true;
+        }
+        request->cond.notify_one();
+      }
+      stats_.RecordBatch(batch.size());
+    }
+  }
+
+  // Finds the axis of every net output that follows the batch size of the
+  // input by reshaping to batches of 1 and 2; -1 if there is none.
+  vector<int> OutputBatchAxes(Net<float>* net) {
+    Blob<float>* input = net->input_blobs()[0];
+    vector<int> input_shape = input->shape();
+    vector<vector<int> > shapes[2];
+    for (int n = 1; n <= 2; ++n) {
+      input_shape[0] = n;
+      input->Reshape(input_shape);
+      net->Reshape();
+      for (int j = 0; j < net->num_outputs(); ++j) {
+        shapes[n - 1].push_back(net->output_blobs()[j]->shape());
+      }
+    }
+    vector<int> batch_axes(net->num_outputs(), -1);
+    for (int j = 0; j < net->num_outputs(); ++j) {
+      const vector<int>& one = shapes[0][j];
+      const vector<int>& two = shapes[1][j];
+      for (int axis = 0; axis < one.size() && one.size() == two.size();
+           ++axis) {
+        if (two[axis] == 2 * one[axis] && one[axis] > 0) {
+          batch_axes[j] = axis;
+          break;
+        }
+        if (two[axis] != one[axis]) {
+          break;
+        }
+      }
+      if (batch_axes[j] < 0) {
+        LOG(WARNING) << "Output "
+            << net->blob_names()[net->output_blob_indices()[j]]
+            << " has no batch axis; every request gets all of it.";
+      }
+    }
+    return batch_axes;
+  }
+
+  // Appends the slice of output for batch item n along batch_axis, or all
+  // of output if batch_axis is -1.
+  static void AppendSample(const Blob<float>& output, int batch_axis, int n,
+                           vector<float>* sample) {
+    const float* data = output.cpu_data();
+    if (batch_axis < 0) {
+      sample->insert(sample->end(), data, data + output.count());
+      return;
+    }
+    const int outer = output.count(0, batch_axis);
+    const int inner = output.count(batch_axis + 1);
+    const int items = output.shape(batch_axis);
+    for (int i = 0; i < outer; ++i) {
+      const float* slice = data + (i * items + n) * inner;
+      sample->insert(sample->end(), slice, slice + inner);
+    }
+  }
+
+  void ReportStats() {
+    while (true) {
+      std::this_thread::sleep_for(std::chrono::seconds(FLAGS_stats_interval));
+      LOG(INFO) << "Server statistics:\n" << stats_.Report(queue_.size());
+    }
+  }
+
+  shared_ptr<NetModel<float> > model_;
+  RequestQueue queue_;
+  ServerStats stats_;
+  int sample_count_;
+};
+
+int main(int argc, char** argv) {
+  FLAGS_alsologtostderr = 1;  // Print output to stderr (while still logging)
+  gflags::SetUsageMessage("Serve a network over a Unix domain socket.\n"
+      "Usage:\n"
+      "    inference_server --model=deploy.prototxt --weights=net.caffemodel");
+  caffe::GlobalInit(&argc, &argv);
+  CHECK_GT(FLAGS_model.size(), 0) << "Need a model definition to serve.";
+  CHECK_GT(FLAGS_max_batch_size, 0);
+  CHECK_GE(FLAGS_max_latency_us, 0);
+  CHECK_GT(FLAGS_workers, 0);
+
+  Caffe::set_mode(Caffe::CPU);
+  shared_ptr<NetModel<float> > model(
+      new NetModel<float>(FLAGS_model, FLAGS_weights));
+  InferenceServer server(model);
+  server.Start();
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK_GE(listen_fd, 0) << "Failed to create socket";
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  CHECK_LT(FLAGS_socket.size(), sizeof(address.sun_path))
+      << "Socket path too long: " << FLAGS_socket;
+  strncpy(address.sun_path, FLAGS_socket.c_str(), sizeof(address.sun_path) - 1);
+  unlink(FLAGS_socket.c_str());
+  CHECK_EQ(bind(listen_fd, reinterpret_cast<struct sockaddr*>(&address),
+                sizeof(address)), 0) << "Failed to bind " << FLAGS_socket;
+  CHECK_EQ(listen(listen_fd, SOMAXCONN), 0) << "Failed to listen";
+  LOG(INFO) << "Serving " << FLAGS_model << " on " << FLAGS_socket;
+
+  while (true) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0) {
+      PLOG(WARNING) << "accept failed";
+      continue;
+    }
+    std::thread(&InferenceServer::Serve, &server, fd).detach();
+  }
+  return 0;
+}
@@ -0,0 +1,203 @@
+/*
+All modification made by Cambricon Corporation: © 2018-2019 Cambricon Corporation
+All rights reserved.
+All other contributions:
+Copyright (c) 2014--2019, the respective contributors
+All rights reserved.
+For the list of contributors go to https://github.com/BVLC/caffe/blob/master/CONTRIBUTORS.md
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright notice,
+      this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of Intel Corporation nor the names of its contributors
+      may be used to endorse or promote products derived from this software
+      without specific prior written permission.
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE
+FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Times the host conversions done around device I/O: an NCHW float blob
+// reordered to NHWC and cast (H2D), or the reverse (D2H). The fused
+// caffe_cpu_layout_cast is compared with the separate cast, stride and
+// reorder passes over temporary buffers that it replaces.
+// Usage:
+//    layout_cast_benchmark [--shape=1,3,224,224] [--direction=H2D]
+//        [--type=FLOAT16] [--pad_channels=0] [--iterations=100]
+
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "boost/algorithm/string.hpp"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+
+#include "caffe/common.hpp"
+#include "caffe/util/benchmark.hpp"
+#include "caffe/util/layout_cast.hpp"
+
+using namespace caffe;  // NOLINT(build/namespaces)
+
+DEFINE_string(shape, "1,3,224,224", "The NCHW shape of the host blob.");
+DEFINE_string(direction, "H2D",
+    "H2D reorders NCHW float to NHWC of --type; D2H the reverse.");
+DEFINE_string(type, "FLOAT16",
+    "The device type: FLOAT32, FLOAT16, INT8, UINT8 or INT16.");
+DEFINE_int32(pad_channels, 0,
+    "Zero channels appended on the device side, as for the first "
+    "convolution (H2D only).");
+DEFINE_int32(iterations, 100, "The number of timed conversions.");
+DEFINE_int32(threads, 0,
+    "Threads of the conversion pool; 0 keeps the Caffe default.");
+
+// The unfused conversion: one pass per step, each into a new buffer.
+static void UnfusedCast(const LayoutCastParam& param, const void* src,
+                        void* dst) {
+  LayoutCastParam cast = param;
+  cast.order.clear();
+  cast.pad.clear();
+  const size_t cast_bytes = LayoutCastDstBytes(cast);
+  vector<char> cast_buffer(cast_bytes);
+  caffe_cpu_layout_cast(cast, src, cast_buffer.data());
+
+  LayoutCastParam reorder;
+  reorder.src_type = param.dst_type;
+  reorder.dst_type = param.dst_type;
+  reorder.src_shape = param.src_shape;
+  const void* reorder_src = cast_buffer.data();
+  vector<char> stride_buffer;
+  if (!param.pad.empty()) {
+    LayoutCastParam stride = reorder;
+    stride.pad.resize(param.pad.size());
+    for (int i = 0; i < param.pad.size(); ++i) {
+      stride.pad[param.order[i]] = param.pad[i];
+    }
+    stride_buffer.resize(LayoutCastDstBytes(stride));
+    caffe_cpu_layout_cast(stride, cast_buffer.data(), stride_buffer.data());
+    reorder.src_shape = LayoutCastDstShape(stride);
+    reorder_src = stride_buffer.data();
+  }
+  reorder.order = param.order;
+  caffe_cpu_layout_cast(reorder, reorder_src, dst);
+}
+
+static BaseDataType ParseType(const string& name) {
+  BaseDataType type = DT_INVALID;
+  CHECK(BaseDataType_Parse("DT_" + name, &type)) << "Unknown type " << name;
+  CHECK_GT(LayoutCastTypeSize(type), 0) << "Unsupported type " << name;
+  return type;
+}
+
+static float TimeConversion(const LayoutCastParam& param, const void* src,
+                            void* dst, bool fused) {
+  // One untimed pass to fault the pages in.
+  fused ? caffe_cpu_layout_cast(param, src, dst)
+        : UnfusedCast(param, src, dst);
+  CPUTimer timer;
+  timer.Start();
+  for (int i = 0; i < FLAGS_iterations; ++i) {
+    fused ? caffe_cpu_layout_cast(param, src, dst)
+          : UnfusedCast(param, src, dst);
+  }
+  timer.Stop();
+  return timer.MilliSeconds() / FLAGS_iterations;
+}
+
+int main(int argc, char** argv) {
+  ::google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = 1;
+  gflags::SetUsageMessage("Times host layout and type conversions.\n"
+      "Usage:\n    layout_cast_benchmark [FLAGS]\n");
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  if (FLAGS_threads > 0) {
+    Caffe::set_num_threads(FLAGS_threads);
+  }
+
+  vector<string> dims;
+  boost::split(dims, FLAGS_shape, boost::is_any_of(","));
+  vector<int> nchw;
+  for (int i = 0; i < dims.size(); ++i) {
+    nchw.push_back(atoi(dims[i].c_str()));
+  }
+  CHECK_GE(nchw.size(), 3) << "--shape needs N, C and spatial axes.";
+  const int num_axes = nchw.size();
+  const BaseDataType device_type = ParseType(FLAGS_type);
+
+  LayoutCastParam param;
+  param.order.resize(num_axes);
+  param.order[0] = 0;
+  if (FLAGS_direction == "H2D") {
+    // N(D)HWC axis i is NC(D)HW axis i + 1, and C is last.
+    for (int i = 1; i < num_axes - 1; ++i) {
+      param.order[i] = i + 1;
+    }
+    param.order[num_axes - 1] = 1;
+    param.src_shape = nchw;
+    param.src_type = DT_FLOAT32;
+    param.dst_type = device_type;
+    if (FLAGS_pad_channels > 0) {
+      param.pad.assign(num_axes, 0);
+      param.pad[num_axes - 1] = FLAGS_pad_channels;
+    }
+  } else {
+    CHECK_EQ(FLAGS_direction, "D2H") << "--direction is H2D or D2H.";
+    param.order[1] = num_axes - 1;
+    for (int i = 2; i < num_axes; ++i) {
+      param.order[i] = i - 1;
+    }
+    param.src_shape.push_back(nchw[0]);
+    for (int i = 2; i < num_axes; ++i) {
+      param.src_shape.push_back(nchw[i]);
+    }
+    param.src_shape.push_back(nchw[1]);
+    param.src_type = device_type;
+    param.dst_type = DT_FLOAT32;
+  }
+  if (device_type == DT_INT8 || device_type == DT_INT16) {
+    param.quantized = true;
+    param.position = -4;
+    param.scale = 1.f;
+  }
+
+  size_t count = 1;
+  for (int i = 0; i < num_axes; ++i) {
+    count *= nchw[i];
+  }
+  // Values the integer types can hold, so the casts do not saturate.
+  vector<float> values(count);
+  for (size_t i = 0; i < count; ++i) {
+    values[i] = static_cast<float>(i % 200) * 0.0625f;
+  }
+  LayoutCastParam fill;
+  fill.src_shape = vector<int>(1, count);
+  fill.dst_type = param.src_type;
+  fill.quantized = param.quantized;
+  fill.position = param.position;
+  fill.scale = param.scale;
+  vector<char> src(count * LayoutCastTypeSize(param.src_type));
+  caffe_cpu_layout_cast(fill, values.data(), src.data());
+  vector<char> dst(LayoutCastDstBytes(param));
+
+  const float fused_ms = TimeConversion(param, src.data(), dst.data(), true);
+  const float unfused_ms =
+      TimeConversion(param, src.data(), dst.data(), false);
+  const double bytes = src.size() + dst.size();
+  LOG(INFO) << FLAGS_direction << " " << FLAGS_shape << " "
+            << FLAGS_type << ", " << Caffe::num_threads() << " threads:";
+  LOG(INFO) << "  fused:   " << fused_ms << " ms, "
+            << bytes / fused_ms / 1e6 << " GB/s";
+  LOG(INFO) << "  unfused: " << unfused_ms << " ms, "
+            << bytes / unfused_ms / 1e6 << " GB/s";
+  return 0;
+}